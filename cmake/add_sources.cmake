@@ -18,6 +18,14 @@ function(declare_library binary_name subdirectory)
     get_property(sources GLOBAL PROPERTY ALL_SRC_FILES)
     add_library("${binary_name}" STATIC "${sources}")
 
+    # Kept for building the same sources again, e.g. as position-independent
+    # objects for a shared library
+    set_property(
+        GLOBAL PROPERTY
+        "${binary_name}_SOURCES"
+        "${sources}"
+    )
+
     set_property(
         GLOBAL PROPERTY
         "ALL_SRC_FILES"
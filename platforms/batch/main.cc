@@ -0,0 +1,81 @@
+#include "../../src/gameboy_prelude.h"
+#include "../../src/batch_runner.h"
+#include "../../src/command_line.h"
+#include "../../src/config.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static void usage() {
+    fatal_error("usage: gbemu-batch [--threads=N] [--frames=N] [--quantum=N] [--until=TEXT]... "
+                "[--frame-skip=N] [--skip-idle-loops] [--no-block-cache] [--mute-audio] [--option=value]... "
+                "<rom_file>...");
+}
+
+/* Last non-empty line of a session's serial output */
+static auto last_line(const std::string& output) -> std::string {
+    auto end = output.find_last_not_of("\r\n");
+    if (end == std::string::npos) { return ""; }
+
+    auto start = output.find_last_of('\n', end);
+    start = start == std::string::npos ? 0 : start + 1;
+    return output.substr(start, end - start + 1);
+}
+
+static auto run_batch(int argc, char* argv[]) -> int {
+    BatchConfig config;
+    Options options;
+    options.disable_logs = true;
+    std::vector<std::string> roms;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+
+        if (arg.rfind("--threads=", 0) == 0) { config.threads = flag_value(arg, "--threads="); }
+        else if (arg.rfind("--frames=", 0) == 0) { config.max_frames = flag_value(arg, "--frames="); }
+        else if (arg.rfind("--quantum=", 0) == 0) { config.frames_per_quantum = flag_value(arg, "--quantum="); }
+        else if (arg.rfind("--until=", 0) == 0) { config.stop_strings.push_back(arg.substr(8)); }
+        else if (arg.rfind("--frame-skip=", 0) == 0) { options.frame_skip = flag_value(arg, "--frame-skip="); }
+        else if (arg == "--skip-idle-loops") { options.skip_idle_loops = true; }
+        else if (arg == "--no-block-cache") { options.block_cache = false; }
+        else if (arg == "--mute-audio") { options.mute_audio = true; }
+        /* The emulator's own options, e.g. --watchdog=10 --watchdog-action=stop */
+        else if (arg.rfind("--", 0) == 0) { apply_flag(options, arg); }
+        else { roms.push_back(arg); }
+    }
+
+    if (roms.empty()) { usage(); }
+
+    BatchRunner runner(config);
+    for (const std::string& rom : roms) {
+        runner.add_session(rom, RomImage::load_file(rom), options);
+    }
+
+    int status = 0;
+    for (const BatchResult& result : runner.run()) {
+        if (!result.error.empty()) {
+            printf("%s: (error) frames=%u %s\n", result.name.c_str(), result.frames, result.error.c_str());
+            status = 1;
+            continue;
+        }
+
+        printf("%s: %s frames=%u hash=%016llx %s\n",
+               result.name.c_str(),
+               result.matched.empty() ? "(frame limit)" : result.matched.c_str(),
+               result.frames,
+               static_cast<unsigned long long>(result.frame_hash),
+               last_line(result.serial_output).c_str());
+    }
+
+    return status;
+}
+
+int main(int argc, char* argv[]) {
+    /* Bad arguments and unreadable ROMs are reported where they're found */
+    try {
+        return run_batch(argc, argv);
+    } catch (const FatalError&) {
+        return 1;
+    }
+}
@@ -0,0 +1,284 @@
+#include "kernels.h"
+
+#include <algorithm>
+#include <initializer_list>
+
+namespace {
+
+const uint ROM_SIZE = 0x8000;
+const u16 ENTRY_POINT = 0x0150;
+
+/* Checked by the boot ROM before it hands over to the cartridge */
+const u8 NINTENDO_LOGO[] = {
+    0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B, 0x03, 0x73, 0x00, 0x83, 0x00, 0x0C, 0x00, 0x0D,
+    0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E, 0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99,
+    0xBB, 0xBB, 0x67, 0x63, 0x6E, 0x0E, 0xEC, 0xCC, 0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E,
+};
+
+/* Just enough of an assembler to lay out the kernels: raw bytes, plus
+ * relative jumps back to a label */
+class RomBuilder {
+public:
+    explicit RomBuilder(const std::string& title) : rom(ROM_SIZE, 0x00), pc(ENTRY_POINT) {
+        /* nop; jp ENTRY_POINT */
+        const u8 entry[] = { 0x00, 0xC3, ENTRY_POINT & 0xFF, ENTRY_POINT >> 8 };
+        std::copy(std::begin(entry), std::end(entry), rom.begin() + 0x100);
+        std::copy(std::begin(NINTENDO_LOGO), std::end(NINTENDO_LOGO), rom.begin() + 0x104);
+        std::copy_n(title.begin(), std::min<size_t>(title.size(), 16), rom.begin() + 0x134);
+    }
+
+    auto here() const -> u16 { return pc; }
+
+    void emit(std::initializer_list<u8> bytes) {
+        for (u8 byte : bytes) { rom[pc++] = byte; }
+    }
+
+    /* jr (0x18) or a conditional jr (0x20/0x28/0x30/0x38) back to 'target' */
+    void jr(u8 opcode, u16 target) {
+        int offset = target - (pc + 2);
+        emit({ opcode, static_cast<u8>(static_cast<s8>(offset)) });
+    }
+
+    void data(u16 address, uint length, u8 (*value)(uint)) {
+        for (uint i = 0; i < length; i++) { rom[address + i] = value(i); }
+    }
+
+    auto finish() -> std::vector<u8> {
+        /* Cartridge type, ROM size and RAM size (0x147-0x149) stay zero:
+         * a plain 32KB ROM */
+        u8 checksum = 0;
+        for (uint address = 0x134; address <= 0x14C; address++) {
+            checksum = static_cast<u8>(checksum - rom[address] - 1);
+        }
+        rom[0x14D] = checksum;
+        return rom;
+    }
+
+private:
+    std::vector<u8> rom;
+    u16 pc;
+};
+
+/* di; ld sp,$FFFE */
+void prologue(RomBuilder& b) {
+    b.emit({ 0xF3, 0x31, 0xFE, 0xFF });
+}
+
+/* Register-only arithmetic: the dispatch loop and flag computation */
+auto alu_kernel() -> std::vector<u8> {
+    RomBuilder b("BENCH ALU");
+    prologue(b);
+    b.emit({ 0x3E, 0x01, 0x06, 0x03, 0x0E, 0x05, 0x16, 0x00 }); // ld a,1; ld b,3; ld c,5; ld d,0
+
+    u16 loop = b.here();
+    b.emit({
+        0x80,       // add a,b
+        0xA9,       // xor c
+        0x04,       // inc b
+        0x0D,       // dec c
+        0x07,       // rlca
+        0xCB, 0x11, // rl c
+        0x91,       // sub c
+        0xB0,       // or b
+        0x8A,       // adc a,d
+        0x2F,       // cpl
+        0x27,       // daa
+        0x14,       // inc d
+    });
+    b.jr(0x18, loop);
+
+    return b.finish();
+}
+
+/* Copies 4KB of ROM to WRAM over and over: MMU reads and writes */
+auto memcpy_kernel() -> std::vector<u8> {
+    RomBuilder b("BENCH MEMCPY");
+    b.data(0x1000, 0x1000, [](uint i) { return static_cast<u8>(i * 7 + (i >> 8)); });
+    prologue(b);
+
+    u16 outer = b.here();
+    b.emit({
+        0x21, 0x00, 0x10, // ld hl,$1000
+        0x11, 0x00, 0xC0, // ld de,$C000
+        0x01, 0x00, 0x10, // ld bc,$1000
+    });
+
+    u16 inner = b.here();
+    b.emit({
+        0x2A,       // ld a,(hl+)
+        0x12,       // ld (de),a
+        0x13,       // inc de
+        0x0B,       // dec bc
+        0x78,       // ld a,b
+        0xB1,       // or c
+    });
+    b.jr(0x20, inner);
+    b.jr(0x18, outer);
+
+    return b.finish();
+}
+
+/* OAM DMA from work RAM, as back to back as the usual routine in HRAM
+ * runs them: start the transfer, then wait it out */
+const u8 DMA_ROUTINE[] = {
+    0x3E, 0xC0, 0xE0, 0x46, // ld a,$C0; ldh (DMA),a
+    0x3E, 0x28,             // ld a,40
+    0x3D, 0x20, 0xFD,       // dec a; jr nz,-3
+    0xC9,                   // ret
+};
+
+auto dma_kernel() -> std::vector<u8> {
+    RomBuilder b("BENCH DMA");
+    b.data(0x1000, sizeof(DMA_ROUTINE), [](uint i) { return DMA_ROUTINE[i]; });
+    prologue(b);
+
+    b.emit({
+        0x21, 0x80, 0xFF,                             // ld hl,$FF80
+        0x11, 0x00, 0x10,                             // ld de,$1000
+        0x06, static_cast<u8>(sizeof(DMA_ROUTINE)),   // ld b,length
+    });
+    u16 copy = b.here();
+    b.emit({ 0x1A, 0x22, 0x13, 0x05 });               // ld a,(de); ld (hl+),a; inc de; dec b
+    b.jr(0x20, copy);
+
+    u16 loop = b.here();
+    b.emit({ 0xCD, 0x80, 0xFF });                     // call $FF80
+    b.jr(0x18, loop);
+
+    return b.finish();
+}
+
+/* Stores 'count' bytes from 'start' on: 'value' computes each one into a,
+ * with hl pointing at its address */
+void fill(RomBuilder& b, u16 start, u16 count, std::initializer_list<u8> value) {
+    b.emit({ 0x21, static_cast<u8>(start & 0xFF), static_cast<u8>(start >> 8) });
+    b.emit({ 0x01, static_cast<u8>(count & 0xFF), static_cast<u8>(count >> 8) });
+
+    u16 loop = b.here();
+    b.emit(value);
+    b.emit({ 0x22, 0x0B, 0x78, 0xB1 }); // ld (hl+),a; dec bc; ld a,b; or c
+    b.jr(0x20, loop);
+}
+
+/* Background, window and 40 sprites all on, with the scroll registers and
+ * a tile changing every few clocks, so every line is drawn from scratch */
+auto scroll_kernel() -> std::vector<u8> {
+    RomBuilder b("BENCH SCROLL");
+    prologue(b);
+
+    fill(b, 0x8000, 0x1000, { 0x7D, 0xAC });    // tiles: ld a,l; xor h
+    fill(b, 0x9800, 0x0800, { 0x7D });          // both tile maps: ld a,l
+    fill(b, 0xFE00, 0x00A0, { 0x7D, 0x87 });    // OAM: ld a,l; add a,a
+
+    b.emit({
+        0x3E, 0xE4, 0xE0, 0x47, // ld a,$E4; ldh (BGP),a
+        0xE0, 0x48,             // ldh (OBP0),a
+        0x3E, 0x48, 0xE0, 0x4A, // ld a,72; ldh (WY),a
+        0x3E, 0x57, 0xE0, 0x4B, // ld a,87; ldh (WX),a
+        0x3E, 0xF3, 0xE0, 0x40, // ld a,$F3; ldh (LCDC),a: window map $9C00, window, sprites
+        0x21, 0x10, 0x80,       // ld hl,$8010
+    });
+
+    u16 loop = b.here();
+    b.emit({
+        0xF0, 0x43, 0x3C, 0xE0, 0x43, // ldh a,(SCX); inc a; ldh (SCX),a
+        0xF0, 0x42, 0x3D, 0xE0, 0x42, // ldh a,(SCY); dec a; ldh (SCY),a
+        0x34,                         // inc (hl)
+    });
+    b.jr(0x18, loop);
+
+    return b.finish();
+}
+
+/* All four channels playing to both sides, with their frequencies swept */
+auto audio_kernel() -> std::vector<u8> {
+    RomBuilder b("BENCH AUDIO");
+    prologue(b);
+
+    b.emit({
+        0x3E, 0x80, 0xE0, 0x26, // ld a,$80; ldh (NR52),a
+        0x3E, 0x77, 0xE0, 0x24, // ld a,$77; ldh (NR50),a
+        0x3E, 0xFF, 0xE0, 0x25, // ld a,$FF; ldh (NR51),a
+    });
+
+    /* Wave RAM, while channel 3's DAC is still off */
+    fill(b, 0xFF30, 0x0010, { 0x7D, 0x87, 0x87, 0x87, 0x87, 0xB5 }); // ld a,l; add a,a x4; or l
+
+    b.emit({
+        0x3E, 0x00, 0xE0, 0x10, // NR10: no sweep
+        0x3E, 0x80, 0xE0, 0x11, // NR11: 50% duty
+        0x3E, 0xF0, 0xE0, 0x12, // NR12: full volume
+        0x3E, 0x87, 0xE0, 0x14, // NR14: trigger
+        0x3E, 0x40, 0xE0, 0x16, // NR21: 25% duty
+        0x3E, 0xF0, 0xE0, 0x17, // NR22: full volume
+        0x3E, 0x86, 0xE0, 0x19, // NR24: trigger
+        0x3E, 0x80, 0xE0, 0x1A, // NR30: DAC on
+        0x3E, 0x20, 0xE0, 0x1C, // NR32: full volume
+        0x3E, 0x87, 0xE0, 0x1E, // NR34: trigger
+        0x3E, 0xF0, 0xE0, 0x21, // NR42: full volume
+        0x3E, 0x34, 0xE0, 0x22, // NR43: clock shift 3, divider 4
+        0x3E, 0x80, 0xE0, 0x23, // NR44: trigger
+    });
+
+    u16 loop = b.here();
+    b.emit({
+        0x1C,                   // inc e
+        0x7B,                   // ld a,e
+        0xE0, 0x13,             // ldh (NR13),a
+        0xE0, 0x18,             // ldh (NR23),a
+        0xE0, 0x1D,             // ldh (NR33),a
+        0x06, 0x40,             // ld b,$40
+    });
+    u16 delay = b.here();
+    b.emit({ 0x05 });           // dec b
+    b.jr(0x20, delay);
+    b.jr(0x18, loop);
+
+    return b.finish();
+}
+
+/* Waits out every frame in HALT, woken by the VBlank interrupt */
+auto halt_kernel() -> std::vector<u8> {
+    RomBuilder b("BENCH HALT");
+    b.data(0x0040, 1, [](uint) -> u8 { return 0xD9; }); // VBlank: reti
+    prologue(b);
+
+    b.emit({ 0x3E, 0x01, 0xE0, 0xFF, 0xFB }); // ld a,1; ldh (IE),a; ei
+
+    u16 loop = b.here();
+    b.emit({ 0x76, 0x00 });     // halt; nop
+    b.jr(0x18, loop);
+
+    return b.finish();
+}
+
+/* Busy-waits for VBlank and then for line 0 by polling LY */
+auto poll_kernel() -> std::vector<u8> {
+    RomBuilder b("BENCH POLL");
+    prologue(b);
+
+    u16 vblank = b.here();
+    b.emit({ 0xF0, 0x44, 0xFE, 0x90 }); // ldh a,(LY); cp 144
+    b.jr(0x20, vblank);
+
+    u16 top = b.here();
+    b.emit({ 0xF0, 0x44, 0xFE, 0x00 }); // ldh a,(LY); cp 0
+    b.jr(0x20, top);
+    b.jr(0x18, vblank);
+
+    return b.finish();
+}
+
+} // namespace
+
+auto synthetic_kernels() -> std::vector<Kernel> {
+    return {
+        { "cpu-alu", "tight register-only ALU loop", alu_kernel() },
+        { "mmu-memcpy", "4KB ROM to WRAM copies", memcpy_kernel() },
+        { "mmu-dma", "back to back OAM DMA from WRAM, waited out in HRAM", dma_kernel() },
+        { "ppu-scroll", "background, window and sprites with per-line scrolling", scroll_kernel() },
+        { "apu-channels", "all four channels playing with swept frequencies", audio_kernel() },
+        { "idle-halt", "every frame spent in HALT until VBlank", halt_kernel() },
+        { "idle-poll", "every frame spent polling LY for VBlank", poll_kernel() },
+    };
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "../../src/definitions.h"
+
+#include <string>
+#include <vector>
+
+/* A synthetic benchmark: a 32KB ROM with a valid header, so the boot ROM
+ * hands over to it, which spins on one part of the machine forever */
+struct Kernel {
+    std::string name;
+    std::string description;
+    std::vector<u8> rom;
+};
+
+auto synthetic_kernels() -> std::vector<Kernel>;
@@ -0,0 +1,197 @@
+#include "../../src/gameboy_prelude.h"
+#include "../../src/command_line.h"
+#include "kernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+struct BenchConfig {
+    uint frames = 600;
+    uint warmup = 100;
+    uint repeat = 3;
+    uint frame_skip = 0;
+    bool skip_idle_loops = false;
+    bool threaded_video = false;
+    std::string filter;
+    bool synthetic = true;
+};
+
+struct BenchResult {
+    std::string name;
+    std::string type;
+    std::string description;
+    uint frames = 0;
+    u64 cycles = 0;
+    std::vector<double> seconds;
+    std::string error;
+};
+
+static void usage() {
+    fatal_error("usage: gbemu-bench [--frames=N] [--warmup=N] [--repeat=N] [--filter=TEXT] "
+                "[--frame-skip=N] [--skip-idle-loops] [--threaded-video] [--no-synthetic] "
+                "[<rom_file_or_directory>...]");
+}
+
+/* Each repetition gets a fresh machine, run past the boot ROM before the
+ * clock starts, so only the emulation itself is timed */
+static void bench(BenchResult& result, const std::shared_ptr<const RomImage>& rom, const BenchConfig& config) {
+    Options options;
+    options.disable_logs = true;
+    options.headless = true;
+    options.frame_skip = config.frame_skip;
+    options.skip_idle_loops = config.skip_idle_loops;
+    options.threaded_video = config.threaded_video;
+
+    result.frames = config.frames;
+
+    for (uint run = 0; run < config.repeat; run++) {
+        Gameboy gameboy(rom, options);
+
+        for (uint frame = 0; frame < config.warmup; frame++) { gameboy.run_frame(); }
+
+        u64 cycles = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint frame = 0; frame < config.frames && !gameboy.failed(); frame++) {
+            cycles += gameboy.run_frame().cycles;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (gameboy.failed()) {
+            result.error = gameboy.error();
+            return;
+        }
+
+        result.cycles = cycles;
+        result.seconds.push_back(seconds);
+    }
+}
+
+static auto json_string(const std::string& text) -> std::string {
+    std::string escaped = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped + "\"";
+}
+
+/* One object per benchmark, always in the same order and with the same
+ * keys. Rates come from the fastest repetition, the least disturbed one */
+static void print_json(const std::vector<BenchResult>& results, const BenchConfig& config) {
+    printf("{\n");
+    printf("  \"frames\": %u,\n", config.frames);
+    printf("  \"warmup\": %u,\n", config.warmup);
+    printf("  \"repeat\": %u,\n", config.repeat);
+    printf("  \"frame_skip\": %u,\n", config.frame_skip);
+    printf("  \"skip_idle_loops\": %s,\n", config.skip_idle_loops ? "true" : "false");
+    printf("  \"threaded_video\": %s,\n", config.threaded_video ? "true" : "false");
+    printf("  \"benchmarks\": [");
+
+    for (uint i = 0; i < results.size(); i++) {
+        const BenchResult& result = results[i];
+
+        std::vector<double> sorted = result.seconds;
+        std::sort(sorted.begin(), sorted.end());
+        double best = sorted.empty() ? 0.0 : sorted.front();
+        double median = sorted.empty() ? 0.0 : sorted[sorted.size() / 2];
+        double frames_per_second = best > 0.0 ? result.frames / best : 0.0;
+        double mhz = best > 0.0 ? static_cast<double>(result.cycles) / best / 1e6 : 0.0;
+
+        printf("%s\n    {\n", i == 0 ? "" : ",");
+        printf("      \"name\": %s,\n", json_string(result.name).c_str());
+        printf("      \"type\": %s,\n", json_string(result.type).c_str());
+        printf("      \"description\": %s,\n", json_string(result.description).c_str());
+        printf("      \"frames\": %u,\n", result.frames);
+        printf("      \"cycles\": %llu,\n", static_cast<unsigned long long>(result.cycles));
+        printf("      \"best_seconds\": %.6f,\n", best);
+        printf("      \"median_seconds\": %.6f,\n", median);
+        printf("      \"frames_per_second\": %.2f,\n", frames_per_second);
+        printf("      \"emulated_mhz\": %.3f,\n", mhz);
+        printf("      \"speed\": %.2f,\n", mhz * 1e6 / CLOCK_RATE);
+        printf("      \"error\": %s\n", result.error.empty() ? "null" : json_string(result.error).c_str());
+        printf("    }");
+    }
+
+    printf("%s]\n}\n", results.empty() ? "" : "\n  ");
+}
+
+static auto run_benchmarks(int argc, char* argv[]) -> int {
+    BenchConfig config;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+
+        if (arg.rfind("--frames=", 0) == 0) { config.frames = flag_value(arg, "--frames=", 1); }
+        else if (arg.rfind("--warmup=", 0) == 0) { config.warmup = flag_value(arg, "--warmup=", 0); }
+        else if (arg.rfind("--repeat=", 0) == 0) { config.repeat = flag_value(arg, "--repeat=", 1); }
+        else if (arg.rfind("--frame-skip=", 0) == 0) { config.frame_skip = flag_value(arg, "--frame-skip=", 0); }
+        else if (arg.rfind("--filter=", 0) == 0) { config.filter = arg.substr(9); }
+        else if (arg == "--skip-idle-loops") { config.skip_idle_loops = true; }
+        else if (arg == "--threaded-video") { config.threaded_video = true; }
+        else if (arg == "--no-synthetic") { config.synthetic = false; }
+        else if (arg == "--help") { usage(); }
+        else if (arg.rfind("--", 0) == 0) { fatal_error("Unknown flag: %s", arg.c_str()); }
+        else { paths.push_back(arg); }
+    }
+
+    auto selected = [&config](const std::string& name) {
+        return config.filter.empty() || name.find(config.filter) != std::string::npos;
+    };
+
+    std::vector<BenchResult> results;
+
+    if (config.synthetic) {
+        for (Kernel& kernel : synthetic_kernels()) {
+            if (!selected(kernel.name)) { continue; }
+
+            BenchResult result;
+            result.name = kernel.name;
+            result.type = "synthetic";
+            result.description = kernel.description;
+            bench(result, RomImage::from_bytes(std::move(kernel.rom)), config);
+            results.push_back(result);
+        }
+    }
+
+    for (const std::string& rom : collect_roms(paths)) {
+        std::string name = std::filesystem::path(rom).filename().string();
+        if (!selected(name)) { continue; }
+
+        BenchResult result;
+        result.name = name;
+        result.type = "rom";
+        result.description = rom;
+        bench(result, RomImage::load_file(rom), config);
+        results.push_back(result);
+    }
+
+    if (results.empty()) { usage(); }
+
+    print_json(results, config);
+
+    bool errors = std::any_of(results.begin(), results.end(),
+                              [](const BenchResult& result) { return !result.error.empty(); });
+    return errors ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    /* Bad arguments and unreadable files are reported where they're found */
+    try {
+        return run_benchmarks(argc, argv);
+    } catch (const FatalError&) {
+        return 1;
+    }
+}
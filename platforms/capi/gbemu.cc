@@ -0,0 +1,362 @@
+#include "gbemu.h"
+
+#include "../../src/config.h"
+#include "../../src/gameboy_prelude.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct gbemu_instance {
+    /* As made, with every gbemu_set_option since */
+    Options options;
+    std::unique_ptr<Gameboy> gameboy;
+
+    std::vector<u8> saved_state;
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+auto make_options(const gbemu_config* config) -> Options {
+    gbemu_config defaults;
+    gbemu_default_config(&defaults);
+    if (config == nullptr) { config = &defaults; }
+
+    Options options;
+    options.headless = true;
+    options.speed_mode = SpeedMode::Unthrottled;
+    options.force_dmg = config->force_dmg != 0;
+    options.mute_audio = config->mute_audio != 0;
+    options.skip_idle_loops = config->skip_idle_loops != 0;
+    options.frame_skip = static_cast<uint>(std::max(config->frame_skip, 0));
+    options.disable_logs = config->disable_logs != 0;
+
+    switch (config->pixel_format) {
+        case GBEMU_FORMAT_RGBA8888: options.pixel_format = PixelFormat::RGBA8888; break;
+        case GBEMU_FORMAT_RGB565: options.pixel_format = PixelFormat::RGB565; break;
+        default: options.pixel_format = PixelFormat::Index8; break;
+    }
+
+    return options;
+}
+
+auto create(std::shared_ptr<const RomImage> rom, const gbemu_config* config, const std::vector<u8>& save_data)
+    -> gbemu_instance* {
+    try {
+        auto instance = std::make_unique<gbemu_instance>();
+        instance->options = make_options(config);
+        instance->gameboy = std::make_unique<Gameboy>(std::move(rom), instance->options, save_data);
+        return instance.release();
+    } catch (const std::exception& error) {
+        last_error = error.what();
+        return nullptr;
+    }
+}
+
+} // namespace
+
+extern "C" {
+
+int gbemu_api_version(void) { return GBEMU_API_VERSION; }
+
+void gbemu_default_config(gbemu_config* config) {
+    config->pixel_format = GBEMU_FORMAT_INDEX8;
+    config->force_dmg = 0;
+    config->mute_audio = 1;
+    config->skip_idle_loops = 0;
+    config->frame_skip = 0;
+    config->disable_logs = 1;
+}
+
+gbemu_instance* gbemu_create(const uint8_t* rom, size_t rom_size, const gbemu_config* config,
+                             const uint8_t* save_data, size_t save_size) {
+    if (rom == nullptr || rom_size == 0) {
+        last_error = "No ROM given";
+        return nullptr;
+    }
+
+    try {
+        std::vector<u8> save;
+        if (save_data != nullptr) { save = unpack_save(std::vector<u8>(save_data, save_data + save_size), "save data"); }
+
+        std::vector<u8> rom_data = detect_container(rom, rom_size) == Container::None
+                                        ? std::vector<u8>(rom, rom + rom_size)
+                                        : unpack_rom(rom, rom_size, "ROM");
+        return create(RomImage::from_bytes(std::move(rom_data)), config, save);
+    } catch (const std::exception& error) {
+        last_error = error.what();
+        return nullptr;
+    }
+}
+
+gbemu_instance* gbemu_create_from_file(const char* rom_path, const gbemu_config* config) {
+    try {
+        return create(RomImage::load_file(rom_path), config, {});
+    } catch (const std::exception& error) {
+        last_error = error.what();
+        return nullptr;
+    }
+}
+
+gbemu_instance* gbemu_fork(gbemu_instance* instance) {
+    try {
+        auto child = std::make_unique<gbemu_instance>();
+        child->options = instance->options;
+        child->gameboy = instance->gameboy->fork();
+        return child.release();
+    } catch (const std::exception& error) {
+        last_error = error.what();
+        return nullptr;
+    }
+}
+
+void gbemu_destroy(gbemu_instance* instance) { delete instance; }
+
+const char* gbemu_last_error(void) { return last_error.c_str(); }
+
+const char* gbemu_error(const gbemu_instance* instance) { return instance->gameboy->error().c_str(); }
+
+int gbemu_set_option(gbemu_instance* instance, const char* name, const char* value) {
+    if (name == nullptr || value == nullptr) {
+        last_error = "No option given";
+        return -1;
+    }
+    if (!is_runtime_option(name)) {
+        last_error = std::string("Not an option which can be changed while running: ") + name;
+        return -1;
+    }
+
+    /* The error is handed back instead, so nothing of it goes to the console */
+    Logger quiet;
+    quiet.set_sink([](LogLevel, const std::string&) {});
+    LogScope log_scope(quiet);
+
+    try {
+        Options options = instance->options;
+        set_option(options, name, value);
+        instance->options = options;
+        instance->gameboy->configure(instance->options);
+        return 0;
+    } catch (const std::exception& error) {
+        last_error = error.what();
+        return -1;
+    }
+}
+
+int gbemu_health(const gbemu_instance* instance, gbemu_health_report* health) {
+    try {
+        HealthReport report = instance->gameboy->health();
+
+        *health = {};
+        health->cycles = report.cycles;
+        health->frames = report.frames;
+        health->frames_drawn = report.frames_drawn;
+        health->cycles_per_second = report.cycles_per_second;
+        health->seconds_since_vblank = report.seconds_since_vblank;
+        health->lcd_enabled = report.lcd_enabled;
+        switch (report.stall) {
+            case StallReason::None: health->stall = GBEMU_STALL_NONE; break;
+            case StallReason::LcdOff: health->stall = GBEMU_STALL_LCD_OFF; break;
+            case StallReason::Locked: health->stall = GBEMU_STALL_LOCKED; break;
+        }
+        health->throttled = report.throttled;
+        health->pc_samples = report.pc_samples;
+
+        size_t count = std::min<size_t>(report.hotspots.size(), GBEMU_HEALTH_HOTSPOTS);
+        health->hotspot_count = static_cast<uint32_t>(count);
+        for (size_t i = 0; i < count; i++) {
+            health->hotspot_pc[i] = report.hotspots[i].pc;
+            health->hotspot_samples[i] = report.hotspots[i].samples;
+        }
+        return 0;
+    } catch (const std::exception&) {
+        return -1;
+    }
+}
+
+int gbemu_step(gbemu_instance* instance, uint32_t frames, uint8_t buttons) {
+    Gameboy& gameboy = *instance->gameboy;
+    if (gameboy.failed()) { return -1; }
+
+    gameboy.set_buttons(buttons);
+
+    /* run_frame() turns a FatalError into failed(); anything else, e.g.
+     * running out of memory, must not unwind into the caller either */
+    try {
+        uint32_t run = 0;
+        while (run < frames) {
+            StepResult result = gameboy.run_frame();
+            run += result.frames;
+            if (result.stopped) { break; }
+        }
+
+        if (gameboy.failed()) { return -1; }
+        return static_cast<int>(std::min(run, frames));
+    } catch (const std::exception&) {
+        return -1;
+    }
+}
+
+uint64_t gbemu_frame_count(const gbemu_instance* instance) {
+    return instance->gameboy->frame_count();
+}
+
+const uint8_t* gbemu_frame(gbemu_instance* instance) { return instance->gameboy->frame_buffer().front(); }
+
+size_t gbemu_frame_pitch(const gbemu_instance* instance) { return instance->gameboy->frame_buffer().pitch(); }
+
+uint8_t* gbemu_work_ram(gbemu_instance* instance, size_t* size) {
+    auto& work_ram = instance->gameboy->work_ram();
+    if (size != nullptr) { *size = work_ram.size(); }
+    return work_ram.data();
+}
+
+const uint8_t* gbemu_cartridge_ram(gbemu_instance* instance, size_t* size) {
+    const std::vector<u8>& ram = instance->gameboy->get_cartridge_ram();
+    if (size != nullptr) { *size = ram.size(); }
+    return ram.data();
+}
+
+const uint8_t* gbemu_save_state(gbemu_instance* instance, size_t* size) {
+    try {
+        instance->saved_state = instance->gameboy->save_state();
+    } catch (const std::exception& error) {
+        last_error = error.what();
+        return nullptr;
+    }
+
+    if (size != nullptr) { *size = instance->saved_state.size(); }
+    return instance->saved_state.data();
+}
+
+int gbemu_load_state(gbemu_instance* instance, const uint8_t* state, size_t size) {
+    if (state == nullptr) {
+        last_error = "No state given";
+        return -1;
+    }
+
+    try {
+        if (instance->gameboy->load_state(std::vector<u8>(state, state + size))) { return 0; }
+        last_error = "The state doesn't belong to this ROM or is damaged";
+        return -1;
+    } catch (const std::exception& error) {
+        last_error = error.what();
+        return -1;
+    }
+}
+
+} // extern "C"
+
+/*
+ * Workers sleep until a batch step bumps the generation, then take
+ * instances off a shared counter until none are left. The thread which
+ * asked for the step takes its share too, then waits for the rest.
+ */
+struct gbemu_batch {
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+    u64 generation = 0;
+    uint busy_workers = 0;
+    bool stopping = false;
+
+    /* The step in progress */
+    gbemu_instance* const* instances = nullptr;
+    const uint8_t* buttons = nullptr;
+    size_t count = 0;
+    uint32_t frames = 0;
+    int32_t* results = nullptr;
+    std::atomic<size_t> next_instance{0};
+    std::atomic<int> short_steps{0};
+
+    void run_share() {
+        for (size_t i = next_instance.fetch_add(1); i < count; i = next_instance.fetch_add(1)) {
+            int result = gbemu_step(instances[i], frames, buttons != nullptr ? buttons[i] : 0);
+            if (results != nullptr) { results[i] = result; }
+            if (result != static_cast<int>(frames)) { short_steps.fetch_add(1); }
+        }
+    }
+
+    void run_worker() {
+        u64 seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (true) {
+            work_ready.wait(lock, [&]() { return stopping || generation != seen; });
+            if (stopping) { return; }
+            seen = generation;
+
+            lock.unlock();
+            run_share();
+            lock.lock();
+
+            if (--busy_workers == 0) { work_done.notify_all(); }
+        }
+    }
+};
+
+extern "C" {
+
+gbemu_batch* gbemu_batch_create(uint32_t threads) {
+    if (threads == 0) { threads = std::max(std::thread::hardware_concurrency(), 1u); }
+
+    auto* batch = new (std::nothrow) gbemu_batch();
+    if (batch == nullptr) { return nullptr; }
+
+    try {
+        for (uint32_t i = 1; i < threads; i++) {
+            batch->workers.emplace_back([batch]() { batch->run_worker(); });
+        }
+    } catch (const std::exception&) {
+        gbemu_batch_destroy(batch);
+        return nullptr;
+    }
+
+    return batch;
+}
+
+void gbemu_batch_destroy(gbemu_batch* batch) {
+    {
+        std::lock_guard<std::mutex> lock(batch->mutex);
+        batch->stopping = true;
+    }
+    batch->work_ready.notify_all();
+
+    for (std::thread& worker : batch->workers) { worker.join(); }
+    delete batch;
+}
+
+int gbemu_batch_step(gbemu_batch* batch, gbemu_instance* const* instances, const uint8_t* buttons,
+                     size_t count, uint32_t frames, int32_t* results) {
+    {
+        std::lock_guard<std::mutex> lock(batch->mutex);
+        batch->instances = instances;
+        batch->buttons = buttons;
+        batch->count = count;
+        batch->frames = frames;
+        batch->results = results;
+        batch->next_instance = 0;
+        batch->short_steps = 0;
+        batch->busy_workers = static_cast<uint>(batch->workers.size());
+        batch->generation++;
+    }
+    batch->work_ready.notify_all();
+
+    batch->run_share();
+
+    std::unique_lock<std::mutex> lock(batch->mutex);
+    batch->work_done.wait(lock, [batch]() { return batch->busy_workers == 0; });
+    return batch->short_steps;
+}
+
+} // extern "C"
@@ -0,0 +1,188 @@
+#ifndef GBEMU_H
+#define GBEMU_H
+
+/*
+ * A C API around the emulator, for embedding it in other languages (see
+ * platforms/python) or driving many instances from one process, e.g. as
+ * environments for reinforcement learning agents.
+ *
+ * Nothing here throws or aborts: calls which can fail return NULL or a
+ * negative value, and the reason is left in gbemu_last_error() or, once an
+ * instance exists, gbemu_error(). An instance must not be used from two
+ * threads at once, except for gbemu_health(), and separate instances are
+ * fully independent.
+ *
+ * Pointers handed out into an instance (its frame, work RAM, save state)
+ * are views of its own memory, so observing a game copies nothing. How long
+ * each one stays valid is given with its function.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#define GBEMU_EXPORT __declspec(dllexport)
+#else
+#define GBEMU_EXPORT __attribute__((visibility("default")))
+#endif
+
+/* Bumped whenever a function or struct here changes incompatibly */
+#define GBEMU_API_VERSION 1
+
+#define GBEMU_SCREEN_WIDTH 160
+#define GBEMU_SCREEN_HEIGHT 144
+
+/* Input masks: bit n for GbButton n */
+#define GBEMU_BUTTON_UP 0x01
+#define GBEMU_BUTTON_DOWN 0x02
+#define GBEMU_BUTTON_LEFT 0x04
+#define GBEMU_BUTTON_RIGHT 0x08
+#define GBEMU_BUTTON_A 0x10
+#define GBEMU_BUTTON_B 0x20
+#define GBEMU_BUTTON_SELECT 0x40
+#define GBEMU_BUTTON_START 0x80
+
+/* Frame layouts, as PixelFormat: 0xRRGGBBAA words and 5:6:5 words, both
+ * in host byte order, or one byte per pixel holding the shade (0 is white,
+ * 3 black) */
+#define GBEMU_FORMAT_RGBA8888 0
+#define GBEMU_FORMAT_RGB565 1
+#define GBEMU_FORMAT_INDEX8 2
+
+/* Why the watchdog finds an instance stuck, as StallReason */
+#define GBEMU_STALL_NONE 0
+#define GBEMU_STALL_LCD_OFF 1
+#define GBEMU_STALL_LOCKED 2
+
+/* Most-sampled program counters in a gbemu_health_report */
+#define GBEMU_HEALTH_HOTSPOTS 8
+
+typedef struct gbemu_instance gbemu_instance;
+typedef struct gbemu_batch gbemu_batch;
+
+typedef struct gbemu_config {
+    /* GBEMU_FORMAT_*; INDEX8 by default, the smallest observation */
+    int32_t pixel_format;
+    /* Run CGB cartridges as on a DMG */
+    int32_t force_dmg;
+    /* Produce no audio samples; on by default */
+    int32_t mute_audio;
+    /* Jump over idle loops (see Options::skip_idle_loops); exact */
+    int32_t skip_idle_loops;
+    /* Draw only one frame in every frame_skip + 1 */
+    int32_t frame_skip;
+    /* Keep the emulator's log messages off the console; on by default */
+    int32_t disable_logs;
+} gbemu_config;
+
+/* An instance's health metrics: the fields are HealthReport's (see
+ * src/watchdog.h for what they mean), with its hotspots laid out as
+ * hotspot_count entries of hotspot_pc and hotspot_samples. The watchdog
+ * and its PC sampling are turned on with the "watchdog" and
+ * "watchdog-action" options (see gbemu_set_option) */
+typedef struct gbemu_health_report {
+    /* Emulated clocks, 4194304 a second, and frames completed and drawn */
+    uint64_t cycles;
+    uint64_t frames;
+    uint64_t frames_drawn;
+    double cycles_per_second;
+    double seconds_since_vblank;
+    int32_t lcd_enabled;
+    /* GBEMU_STALL_*, once a stall has lasted the watchdog's window */
+    int32_t stall;
+    int32_t throttled;
+    uint32_t hotspot_count;
+    uint64_t pc_samples;
+    uint16_t hotspot_pc[GBEMU_HEALTH_HOTSPOTS];
+    uint64_t hotspot_samples[GBEMU_HEALTH_HOTSPOTS];
+} gbemu_health_report;
+
+GBEMU_EXPORT int gbemu_api_version(void);
+
+GBEMU_EXPORT void gbemu_default_config(gbemu_config* config);
+
+/* A new instance running a copy of the ROM, or NULL. The config and save
+ * data (cartridge RAM, as in a .sav file) may be NULL. Either may be packed
+ * in a zip, gzip or zstd container, if the library was built with zlib or
+ * libzstd */
+GBEMU_EXPORT gbemu_instance* gbemu_create(const uint8_t* rom, size_t rom_size, const gbemu_config* config,
+                                          const uint8_t* save_data, size_t save_size);
+/* The same, with the ROM mapped from a file, or unpacked from it if it's
+ * packed, and shared between instances created from the same file */
+GBEMU_EXPORT gbemu_instance* gbemu_create_from_file(const char* rom_path, const gbemu_config* config);
+/* A second instance carrying on from exactly where this one is, with the
+ * same ROM and options, or NULL with the reason in gbemu_last_error().
+ * Takes microseconds, so a search can fork many and step them all at once
+ * with gbemu_batch_step(). Each must be destroyed on its own */
+GBEMU_EXPORT gbemu_instance* gbemu_fork(gbemu_instance* instance);
+GBEMU_EXPORT void gbemu_destroy(gbemu_instance* instance);
+
+/* Why the last gbemu_create*, gbemu_fork, gbemu_set_option, gbemu_save_state
+ * or gbemu_load_state on this thread failed */
+GBEMU_EXPORT const char* gbemu_last_error(void);
+/* Empty unless the instance stopped on a fatal error, after which it won't run again */
+GBEMU_EXPORT const char* gbemu_error(const gbemu_instance* instance);
+
+/* Changes an option of a running instance by name, as a value would be
+ * given to the frontends' --name=value flags, e.g. ("frame-skip", "2") or
+ * ("sample-rate", "48000"). Only the options config.h lists as runtime
+ * ones can be changed; they take effect as the next frame starts. Returns
+ * 0, or -1 with the reason in gbemu_last_error() */
+GBEMU_EXPORT int gbemu_set_option(gbemu_instance* instance, const char* name, const char* value);
+
+/* Fills in the instance's health. Unlike everything else here it may be
+ * called from another thread while the instance is being stepped, e.g.
+ * by a monitoring thread polling every instance. Returns 0, or -1 if
+ * there wasn't the memory to gather it */
+GBEMU_EXPORT int gbemu_health(const gbemu_instance* instance, gbemu_health_report* health);
+
+/* Holds the buttons in the mask and runs 'frames' frames. The buttons are
+ * passed to the game as each frame starts. Returns the frames run, fewer
+ * if the instance stopped, or -1 if it has failed. Never sleeps: holding a
+ * throttled instance (see gbemu_health) to real time is up to the caller */
+GBEMU_EXPORT int gbemu_step(gbemu_instance* instance, uint32_t frames, uint8_t buttons);
+
+/* Frames completed since power on */
+GBEMU_EXPORT uint64_t gbemu_frame_count(const gbemu_instance* instance);
+
+/* The latest frame drawn, GBEMU_SCREEN_HEIGHT lines of gbemu_frame_pitch()
+ * bytes in the configured format. Valid until the next step */
+GBEMU_EXPORT const uint8_t* gbemu_frame(gbemu_instance* instance);
+GBEMU_EXPORT size_t gbemu_frame_pitch(const gbemu_instance* instance);
+
+/* Work RAM (0xC000-0xDFFF, all eight banks on a CGB) and its size. Valid
+ * for the instance's lifetime; the game only changes it during steps */
+GBEMU_EXPORT uint8_t* gbemu_work_ram(gbemu_instance* instance, size_t* size);
+
+/* Cartridge RAM, as a .sav file would hold it. Valid until the next step */
+GBEMU_EXPORT const uint8_t* gbemu_cartridge_ram(gbemu_instance* instance, size_t* size);
+
+/* A snapshot of the whole machine, valid until the next call for the
+ * same instance, or NULL with the reason in gbemu_last_error() */
+GBEMU_EXPORT const uint8_t* gbemu_save_state(gbemu_instance* instance, size_t* size);
+/* Restores a snapshot for the same ROM. Returns 0, or -1 leaving the
+ * instance untouched if the snapshot doesn't match, with the reason in
+ * gbemu_last_error() */
+GBEMU_EXPORT int gbemu_load_state(gbemu_instance* instance, const uint8_t* state, size_t size);
+
+/* A pool of worker threads stepping many instances at once; 0 threads
+ * uses one per hardware thread. The calling thread works too */
+GBEMU_EXPORT gbemu_batch* gbemu_batch_create(uint32_t threads);
+GBEMU_EXPORT void gbemu_batch_destroy(gbemu_batch* batch);
+
+/* gbemu_step() for each of 'count' instances with its own buttons,
+ * spread over the pool, returning once all are done. 'results' (may be
+ * NULL) gets what each step returned. Returns how many steps didn't run
+ * the full 'frames'. An instance must not appear twice */
+GBEMU_EXPORT int gbemu_batch_step(gbemu_batch* batch, gbemu_instance* const* instances, const uint8_t* buttons,
+                                  size_t count, uint32_t frames, int32_t* results);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
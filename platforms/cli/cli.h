@@ -1,7 +1,8 @@
 #pragma once
 
+#include "../../src/config.h"
 #include "../../src/options.h"
-#include <vector>
+#include <string>
 
 struct CliOptions {
     Options options;
@@ -17,17 +18,11 @@ CliOptions get_cli_options(int argc, char* argv[]) {
     CliOptions cliOptions;
     cliOptions.filename = argv[1];
 
-    std::vector<std::string> flags(argv + 2, argv + argc);
+    /* Every option takes the same form in every frontend (see config.h) */
+    for (int i = 2; i < argc; i++) { apply_flag(cliOptions.options, argv[i]); }
 
-    for (std::string& flag : flags) {
-        if (flag == "--debug") { cliOptions.options.debugger = true; }
-        else if (flag == "--trace") { cliOptions.options.trace = true; }
-        else if (flag == "--silent") { cliOptions.options.disable_logs = true; }
-        else if (flag == "--headless") { cliOptions.options.headless = true; }
-        else if (flag == "--whole-framebuffer") { cliOptions.options.show_full_framebuffer = true; }
-        else if (flag == "--exit-on-infinite-jr") { cliOptions.options.exit_on_infinite_jr = true; }
-        else if (flag == "--print-serial-output") { cliOptions.options.print_serial = true; }
-        else { fatal_error("Unknown flag: %s", flag.c_str()); }
+    if (!cliOptions.options.record_movie.empty() && !cliOptions.options.play_movie.empty()) {
+        fatal_error("A movie can't be recorded and played at the same time");
     }
 
     return cliOptions;
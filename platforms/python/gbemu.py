@@ -0,0 +1,355 @@
+"""Python bindings for gbemu, over the C API in platforms/capi/gbemu.h.
+
+Build the shared library first (the gbemu-c CMake target). It is looked
+for in $GBEMU_LIBRARY, then next to this file, then in ../../build.
+
+Observations are NumPy views of the emulator's own memory, so nothing is
+copied: GameBoy.frame is valid until the next step, GameBoy.work_ram for
+as long as the instance lives. Copy them (e.g. frame.copy()) to keep them.
+
+Stepping releases the GIL (ctypes drops it around every foreign call), and
+Batch.step spreads many instances over a pool of native threads:
+
+    envs = [GameBoy("game.gb") for _ in range(64)]
+    batch = Batch()
+    batch.step(envs, actions, frames=4)
+    observations = [env.frame for env in envs]
+"""
+
+import ctypes
+import os
+
+SCREEN_WIDTH = 160
+SCREEN_HEIGHT = 144
+
+BUTTON_UP = 0x01
+BUTTON_DOWN = 0x02
+BUTTON_LEFT = 0x04
+BUTTON_RIGHT = 0x08
+BUTTON_A = 0x10
+BUTTON_B = 0x20
+BUTTON_SELECT = 0x40
+BUTTON_START = 0x80
+
+FORMAT_RGBA8888 = 0
+FORMAT_RGB565 = 1
+FORMAT_INDEX8 = 2
+
+_API_VERSION = 1
+
+_FORMATS = {
+    "rgba8888": FORMAT_RGBA8888,
+    "rgb565": FORMAT_RGB565,
+    "index8": FORMAT_INDEX8,
+}
+
+
+class GbemuError(RuntimeError):
+    pass
+
+
+class _Config(ctypes.Structure):
+    _fields_ = [
+        ("pixel_format", ctypes.c_int32),
+        ("force_dmg", ctypes.c_int32),
+        ("mute_audio", ctypes.c_int32),
+        ("skip_idle_loops", ctypes.c_int32),
+        ("frame_skip", ctypes.c_int32),
+        ("disable_logs", ctypes.c_int32),
+    ]
+
+
+STALL_NONE = 0
+STALL_LCD_OFF = 1
+STALL_LOCKED = 2
+
+_HEALTH_HOTSPOTS = 8
+
+
+class _Health(ctypes.Structure):
+    _fields_ = [
+        ("cycles", ctypes.c_uint64),
+        ("frames", ctypes.c_uint64),
+        ("frames_drawn", ctypes.c_uint64),
+        ("cycles_per_second", ctypes.c_double),
+        ("seconds_since_vblank", ctypes.c_double),
+        ("lcd_enabled", ctypes.c_int32),
+        ("stall", ctypes.c_int32),
+        ("throttled", ctypes.c_int32),
+        ("hotspot_count", ctypes.c_uint32),
+        ("pc_samples", ctypes.c_uint64),
+        ("hotspot_pc", ctypes.c_uint16 * _HEALTH_HOTSPOTS),
+        ("hotspot_samples", ctypes.c_uint64 * _HEALTH_HOTSPOTS),
+    ]
+
+
+def _library_candidates():
+    if "GBEMU_LIBRARY" in os.environ:
+        yield os.environ["GBEMU_LIBRARY"]
+
+    here = os.path.dirname(os.path.abspath(__file__))
+    build = os.path.join(here, "..", "..", "build")
+    for directory in (here, build):
+        for name in ("libgbemu-c.so", "libgbemu-c.dylib", "gbemu-c.dll"):
+            yield os.path.join(directory, name)
+
+
+def _load_library():
+    for path in _library_candidates():
+        if os.path.exists(path):
+            break
+    else:
+        raise GbemuError("libgbemu-c not found; build the gbemu-c target or set GBEMU_LIBRARY")
+
+    lib = ctypes.CDLL(path)
+    u8_p = ctypes.POINTER(ctypes.c_uint8)
+    size_p = ctypes.POINTER(ctypes.c_size_t)
+
+    signatures = {
+        "gbemu_api_version": (ctypes.c_int, []),
+        "gbemu_default_config": (None, [ctypes.POINTER(_Config)]),
+        "gbemu_create": (ctypes.c_void_p, [ctypes.c_char_p, ctypes.c_size_t, ctypes.POINTER(_Config),
+                                           ctypes.c_char_p, ctypes.c_size_t]),
+        "gbemu_create_from_file": (ctypes.c_void_p, [ctypes.c_char_p, ctypes.POINTER(_Config)]),
+        "gbemu_fork": (ctypes.c_void_p, [ctypes.c_void_p]),
+        "gbemu_destroy": (None, [ctypes.c_void_p]),
+        "gbemu_last_error": (ctypes.c_char_p, []),
+        "gbemu_error": (ctypes.c_char_p, [ctypes.c_void_p]),
+        "gbemu_set_option": (ctypes.c_int, [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p]),
+        "gbemu_health": (ctypes.c_int, [ctypes.c_void_p, ctypes.POINTER(_Health)]),
+        "gbemu_step": (ctypes.c_int, [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint8]),
+        "gbemu_frame_count": (ctypes.c_uint64, [ctypes.c_void_p]),
+        "gbemu_frame": (u8_p, [ctypes.c_void_p]),
+        "gbemu_frame_pitch": (ctypes.c_size_t, [ctypes.c_void_p]),
+        "gbemu_work_ram": (u8_p, [ctypes.c_void_p, size_p]),
+        "gbemu_cartridge_ram": (u8_p, [ctypes.c_void_p, size_p]),
+        "gbemu_save_state": (u8_p, [ctypes.c_void_p, size_p]),
+        "gbemu_load_state": (ctypes.c_int, [ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t]),
+        "gbemu_batch_create": (ctypes.c_void_p, [ctypes.c_uint32]),
+        "gbemu_batch_destroy": (None, [ctypes.c_void_p]),
+        "gbemu_batch_step": (ctypes.c_int, [ctypes.c_void_p, ctypes.POINTER(ctypes.c_void_p), u8_p,
+                                            ctypes.c_size_t, ctypes.c_uint32, ctypes.POINTER(ctypes.c_int32)]),
+    }
+    for name, (restype, argtypes) in signatures.items():
+        function = getattr(lib, name)
+        function.restype = restype
+        function.argtypes = argtypes
+
+    if lib.gbemu_api_version() != _API_VERSION:
+        raise GbemuError("libgbemu-c has API version %d, these bindings expect %d"
+                         % (lib.gbemu_api_version(), _API_VERSION))
+    return lib
+
+
+_lib = None
+
+
+def _library():
+    global _lib
+    if _lib is None:
+        _lib = _load_library()
+    return _lib
+
+
+def _view(pointer, shape, ctype):
+    import numpy
+    return numpy.ctypeslib.as_array(ctypes.cast(pointer, ctypes.POINTER(ctype)), shape=shape)
+
+
+class GameBoy:
+    """One emulator instance. 'rom' is a path or the ROM's bytes."""
+
+    def __init__(self, rom, pixel_format="index8", dmg=False, mute_audio=True, skip_idle_loops=False,
+                 frame_skip=0, save_data=None):
+        self._handle = None
+        lib = _library()
+        config = _Config()
+        lib.gbemu_default_config(ctypes.byref(config))
+        config.pixel_format = _FORMATS[pixel_format]
+        config.force_dmg = int(dmg)
+        config.mute_audio = int(mute_audio)
+        config.skip_idle_loops = int(skip_idle_loops)
+        config.frame_skip = frame_skip
+
+        if isinstance(rom, (bytes, bytearray, memoryview)):
+            rom = bytes(rom)
+            save = bytes(save_data) if save_data is not None else None
+            handle = lib.gbemu_create(rom, len(rom), ctypes.byref(config), save, len(save) if save else 0)
+        else:
+            if save_data is not None:
+                raise ValueError("save_data needs the ROM as bytes")
+            handle = lib.gbemu_create_from_file(os.fsencode(rom), ctypes.byref(config))
+
+        if not handle:
+            raise GbemuError(lib.gbemu_last_error().decode(errors="replace"))
+
+        self._handle = handle
+        self._format = config.pixel_format
+        self._work_ram = None
+
+    def _open_handle(self):
+        if not self._handle:
+            raise GbemuError("The GameBoy has been closed")
+        return self._handle
+
+    def fork(self):
+        """A second GameBoy carrying on from exactly where this one is, e.g.
+        to try several inputs from the same point with Batch.step."""
+        lib = _library()
+        handle = lib.gbemu_fork(self._open_handle())
+        if not handle:
+            raise GbemuError(lib.gbemu_last_error().decode(errors="replace"))
+
+        child = GameBoy.__new__(GameBoy)
+        child._handle = handle
+        child._format = self._format
+        child._work_ram = None
+        return child
+
+    def close(self):
+        if self._handle:
+            _library().gbemu_destroy(self._handle)
+            self._handle = None
+            self._work_ram = None
+
+    def __del__(self):
+        self.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def set_option(self, name, value):
+        """Changes an option while running, by its command-line name, e.g.
+        set_option("frame-skip", 2). Takes effect as the next frame starts."""
+        lib = _library()
+        if isinstance(value, bool):
+            value = "true" if value else "false"
+        if lib.gbemu_set_option(self._open_handle(), name.encode(), str(value).encode()) != 0:
+            raise GbemuError(lib.gbemu_last_error().decode(errors="replace"))
+
+    def health(self):
+        """The instance's health metrics as a dict, with 'hotspots' a list of
+        (pc, samples), most sampled first. Safe to call from another thread
+        while the instance is being stepped."""
+        health = _Health()
+        if _library().gbemu_health(self._open_handle(), ctypes.byref(health)) != 0:
+            raise GbemuError("Gathering the health metrics failed")
+
+        report = {name: getattr(health, name) for name, _ in _Health._fields_
+                  if name not in ("hotspot_count", "hotspot_pc", "hotspot_samples")}
+        for flag in ("lcd_enabled", "throttled"):
+            report[flag] = bool(report[flag])
+        report["hotspots"] = [(health.hotspot_pc[i], health.hotspot_samples[i])
+                              for i in range(health.hotspot_count)]
+        return report
+
+    def step(self, frames=1, buttons=0):
+        """Runs 'frames' frames holding the BUTTON_* mask. Returns the frames run."""
+        result = _library().gbemu_step(self._open_handle(), frames, buttons)
+        if result < 0:
+            raise GbemuError(self.error)
+        return result
+
+    @property
+    def error(self):
+        return _library().gbemu_error(self._open_handle()).decode(errors="replace")
+
+    @property
+    def frame_count(self):
+        return _library().gbemu_frame_count(self._open_handle())
+
+    @property
+    def frame(self):
+        """The latest frame: (144, 160) uint8 shades for index8, uint16 for
+        rgb565 or uint32 0xRRGGBBAA for rgba8888. Valid until the next step."""
+        lib = _library()
+        handle = self._open_handle()
+        pointer = lib.gbemu_frame(handle)
+        if self._format == FORMAT_INDEX8:
+            ctype = ctypes.c_uint8
+        elif self._format == FORMAT_RGB565:
+            ctype = ctypes.c_uint16
+        else:
+            ctype = ctypes.c_uint32
+        width = lib.gbemu_frame_pitch(handle) // ctypes.sizeof(ctype)
+        return _view(pointer, (SCREEN_HEIGHT, width), ctype)
+
+    @property
+    def work_ram(self):
+        """Work RAM as a uint8 array, live for the instance's lifetime."""
+        if self._work_ram is None:
+            size = ctypes.c_size_t()
+            pointer = _library().gbemu_work_ram(self._open_handle(), ctypes.byref(size))
+            self._work_ram = _view(pointer, (size.value,), ctypes.c_uint8)
+        return self._work_ram
+
+    def cartridge_ram(self):
+        """A copy of the cartridge RAM, as a .sav file holds it."""
+        size = ctypes.c_size_t()
+        pointer = _library().gbemu_cartridge_ram(self._open_handle(), ctypes.byref(size))
+        return ctypes.string_at(pointer, size.value)
+
+    def save_state(self):
+        lib = _library()
+        size = ctypes.c_size_t()
+        pointer = lib.gbemu_save_state(self._open_handle(), ctypes.byref(size))
+        if not pointer:
+            raise GbemuError(lib.gbemu_last_error().decode(errors="replace"))
+        return ctypes.string_at(pointer, size.value)
+
+    def load_state(self, state):
+        lib = _library()
+        state = bytes(state)
+        if lib.gbemu_load_state(self._open_handle(), state, len(state)) != 0:
+            raise GbemuError(lib.gbemu_last_error().decode(errors="replace"))
+
+
+class Batch:
+    """A pool of native threads stepping many instances at once. 0 threads
+    uses one per hardware thread."""
+
+    def __init__(self, threads=0):
+        self._handle = None
+        self._handle = _library().gbemu_batch_create(threads)
+        if not self._handle:
+            raise GbemuError("Creating the thread pool failed")
+
+    def close(self):
+        if self._handle:
+            _library().gbemu_batch_destroy(self._handle)
+            self._handle = None
+
+    def __del__(self):
+        self.close()
+
+    def step(self, instances, buttons=None, frames=1):
+        """Steps every instance, each with its own BUTTON_* mask, and
+        returns the frames each one ran."""
+        if not self._handle:
+            raise GbemuError("The batch has been closed")
+
+        count = len(instances)
+        handles = (ctypes.c_void_p * count)(*(instance._open_handle() for instance in instances))
+        masks = (ctypes.c_uint8 * count)(*(buttons if buttons is not None else [0] * count))
+        results = (ctypes.c_int32 * count)()
+
+        _library().gbemu_batch_step(self._handle, handles, masks, count, frames, results)
+
+        for instance, result in zip(instances, results):
+            if result < 0:
+                raise GbemuError(instance.error)
+        return list(results)
+
+
+_default_batch = None
+
+
+def step_batch(instances, buttons=None, frames=1):
+    """Batch.step on a pool shared by every caller."""
+    global _default_batch
+    if _default_batch is None:
+        _default_batch = Batch()
+    return _default_batch.step(instances, buttons, frames)
@@ -0,0 +1,288 @@
+#include "link_check.h"
+
+#include "../../src/gameboy_prelude.h"
+#include "../../src/boot.h"
+#include "../../src/link.h"
+
+#if !defined(_WIN32)
+#include "../../src/link_socket.h"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/* Long enough for the boot ROM and all the transfers, with time to spare
+ * for the last of them to be settled between RollbackLinks */
+const uint LINK_FRAMES = 400;
+
+/* How late batches between the RollbackLinks arrive, and how far back
+ * they may roll, in frames */
+const uint BATCH_DELAY_FRAMES = 3;
+const uint ROLLBACK_FRAMES = 8;
+
+/* Each end keeps one byte per transfer from 0xC000 */
+const uint RECEIVED_BYTES = 16;
+
+const u16 PROGRAM_START = 0x150;
+
+/* Clocks 16 bytes out, each one more than the reply to the one before,
+ * a dozen frames apart, and keeps the replies */
+auto clocking_program(const bool fast_clock) -> std::vector<u8> {
+    return {
+        0x21, 0x00, 0xC0,                   /*        ld hl, $C000  */
+        0x0E, 0x10,                         /*        ld c, 16      */
+        0xAF,                               /*        xor a         */
+        0xE0, 0x01,                         /* loop:  ldh [$01], a  */
+        0x3E, static_cast<u8>(fast_clock ? 0x83 : 0x81),
+                                            /*        ld a, SC      */
+        0xE0, 0x02,                         /*        ldh [$02], a  */
+        0xF0, 0x02,                         /* wait:  ldh a, [$02]  */
+        0x87,                               /*        add a, a      */
+        0x38, 0xFB,                         /*        jr c, wait    */
+        0x06, 0x0C,                         /*        ld b, 12      */
+        0xF0, 0x44,                         /* frame: ldh a, [$44]  */
+        0xFE, 0x90,                         /*        cp 144        */
+        0x20, 0xFA,                         /*        jr nz, frame  */
+        0xF0, 0x44,                         /* vbl:   ldh a, [$44]  */
+        0xFE, 0x90,                         /*        cp 144        */
+        0x28, 0xFA,                         /*        jr z, vbl     */
+        0x05,                               /*        dec b         */
+        0x20, 0xF1,                         /*        jr nz, frame  */
+        0xF0, 0x01,                         /*        ldh a, [$01]  */
+        0x22,                               /*        ld [hl+], a   */
+        0x3C,                               /*        inc a         */
+        0x0D,                               /*        dec c         */
+        0x20, 0xDD,                         /*        jr nz, loop   */
+        0x18, 0xFE,                         /* done:  jr done       */
+    };
+}
+
+/* Replies to each transfer with what it got XOR 0x5A, only getting ready
+ * for the next after 1 to 16 frames, as that reply has its low bits, so
+ * the clocking end finds it not ready at times. Keeps what it gets */
+auto replying_program() -> std::vector<u8> {
+    return {
+        0x21, 0x00, 0xC0,                   /*        ld hl, $C000  */
+        0xAF,                               /*        xor a         */
+        0xEE, 0x5A,                         /* loop:  xor $5A       */
+        0xE0, 0x01,                         /*        ldh [$01], a  */
+        0xE6, 0x0F,                         /*        and $0F       */
+        0x3C,                               /*        inc a         */
+        0x47,                               /*        ld b, a       */
+        0xF0, 0x44,                         /* frame: ldh a, [$44]  */
+        0xFE, 0x90,                         /*        cp 144        */
+        0x20, 0xFA,                         /*        jr nz, frame  */
+        0xF0, 0x44,                         /* vbl:   ldh a, [$44]  */
+        0xFE, 0x90,                         /*        cp 144        */
+        0x28, 0xFA,                         /*        jr z, vbl     */
+        0x05,                               /*        dec b         */
+        0x20, 0xF1,                         /*        jr nz, frame  */
+        0x3E, 0x80,                         /*        ld a, $80     */
+        0xE0, 0x02,                         /*        ldh [$02], a  */
+        0xF0, 0x02,                         /* wait:  ldh a, [$02]  */
+        0x87,                               /*        add a, a      */
+        0x38, 0xFB,                         /*        jr c, wait    */
+        0xF0, 0x01,                         /*        ldh a, [$01]  */
+        0x22,                               /*        ld [hl+], a   */
+        0x18, 0xDB,                         /*        jr loop       */
+    };
+}
+
+auto build_rom(const std::vector<u8>& program, const bool cgb) -> std::shared_ptr<const RomImage> {
+    std::vector<u8> rom(0x8000, 0x00);
+
+    /* nop, then jp over the rest of the header */
+    const std::array<u8, 4> entry = {0x00, 0xC3, PROGRAM_START & 0xFF, PROGRAM_START >> 8};
+    std::copy(entry.begin(), entry.end(), rom.begin() + header::entry_point);
+
+    /* The boot ROM only starts a cartridge with the same logo as its own */
+    std::copy_n(&bootDMG[0xA8], 48, &rom[header::logo]);
+    rom[header::cgb_flag] = cgb ? 0x80 : 0x00;
+    rom[header::header_checksum] = compute_header_checksum(rom.data());
+
+    std::copy(program.begin(), program.end(), rom.begin() + PROGRAM_START);
+    return RomImage::from_bytes(std::move(rom));
+}
+
+using Pair = std::array<std::unique_ptr<Gameboy>, 2>;
+using Received = std::array<std::vector<u8>, 2>;
+
+auto make_pair(const bool cgb) -> Pair {
+    Options options;
+    options.headless = true;
+    options.disable_logs = true;
+    options.speed_mode = SpeedMode::Unthrottled;
+
+    return {
+        std::make_unique<Gameboy>(build_rom(clocking_program(cgb), cgb), options),
+        std::make_unique<Gameboy>(build_rom(replying_program(), cgb), options),
+    };
+}
+
+auto received(const Pair& gameboys) -> Received {
+    Received bytes;
+    for (uint side = 0; side < 2; side++) {
+        const auto& work_ram = gameboys[side]->work_ram();
+        bytes[side].assign(work_ram.begin(), work_ram.begin() + RECEIVED_BYTES);
+    }
+    return bytes;
+}
+
+auto run_local(const bool cgb, const bool lockstep) -> Received {
+    Pair gameboys = make_pair(cgb);
+    LocalLink link(*gameboys[0], *gameboys[1], lockstep);
+    for (uint frame = 0; frame < LINK_FRAMES; frame++) { link.run_frame(); }
+    return received(gameboys);
+}
+
+/* Runs both ends to LINK_FRAMES, taking turns on this thread */
+auto run_rollback_pair(Pair& gameboys, std::array<LinkTransport*, 2> transports) -> Received {
+    RollbackLink first(*gameboys[0], *transports[0], ROLLBACK_FRAMES);
+    RollbackLink second(*gameboys[1], *transports[1], ROLLBACK_FRAMES);
+
+    while (first.frame() < LINK_FRAMES || second.frame() < LINK_FRAMES) {
+        if (first.frame() < LINK_FRAMES) { first.run_frame(0, 0); }
+        if (second.frame() < LINK_FRAMES) { second.run_frame(0, 0); }
+    }
+    return received(gameboys);
+}
+
+/* One end of an in-process pair. A batch is only handed over once the
+ * receiving end has run BATCH_DELAY_FRAMES past the frame it was sent in,
+ * as if it had come a long way */
+class DelayedTransport : public LinkTransport {
+public:
+    DelayedTransport(std::deque<LinkBatch>& inInbox, std::deque<LinkBatch>& inOutbox)
+        : inbox(inInbox), outbox(inOutbox) {}
+
+    void send(const LinkBatch& batch) override {
+        outbox.push_back(batch);
+        frame = batch.frame;
+    }
+
+    auto receive(LinkBatch& batch, int /* timeout_ms */) -> bool override {
+        if (inbox.empty() || inbox.front().frame + BATCH_DELAY_FRAMES > frame) { return false; }
+
+        batch = std::move(inbox.front());
+        inbox.pop_front();
+        return true;
+    }
+
+private:
+    std::deque<LinkBatch>& inbox;
+    std::deque<LinkBatch>& outbox;
+    u64 frame = 0;
+};
+
+auto run_delayed(const bool cgb) -> Received {
+    Pair gameboys = make_pair(cgb);
+    std::array<std::deque<LinkBatch>, 2> inboxes;
+    DelayedTransport first(inboxes[0], inboxes[1]);
+    DelayedTransport second(inboxes[1], inboxes[0]);
+    return run_rollback_pair(gameboys, {&first, &second});
+}
+
+#if !defined(_WIN32)
+/* Each end on a thread of its own, as they would be on two machines */
+auto run_tcp(const bool cgb, const uint port) -> Received {
+    Logger quiet;
+    quiet.set_sink([](LogLevel, const std::string&) {});
+
+    std::unique_ptr<TcpLinkTransport> listening;
+    std::thread listener([&]() {
+        LogScope log_scope(quiet);
+        try {
+            listening = TcpLinkTransport::listen(static_cast<u16>(port));
+        } catch (const FatalError&) {}
+    });
+
+    /* Until the listener is up */
+    std::unique_ptr<TcpLinkTransport> connecting;
+    for (uint attempt = 0; attempt < 100 && !connecting; attempt++) {
+        LogScope log_scope(quiet);
+        try {
+            connecting = TcpLinkTransport::connect("127.0.0.1", static_cast<u16>(port));
+        } catch (const FatalError&) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    }
+    listener.join();
+    if (!listening || !connecting) { throw FatalError("Cannot connect to localhost on the port given"); }
+
+    Pair gameboys = make_pair(cgb);
+    std::array<TcpLinkTransport*, 2> transports = {listening.get(), connecting.get()};
+    std::array<std::thread, 2> ends;
+    for (uint side = 0; side < 2; side++) {
+        ends[side] = std::thread([&gameboys, &transports, side]() {
+            RollbackLink link(*gameboys[side], *transports[side], ROLLBACK_FRAMES);
+            while (link.frame() < LINK_FRAMES) { link.run_frame(0); }
+        });
+    }
+    for (std::thread& end : ends) { end.join(); }
+
+    return received(gameboys);
+}
+#endif
+
+/* Empty if they match; otherwise where they first don't */
+auto compare(const Received& actual, const Received& expected) -> std::string {
+    for (uint side = 0; side < 2; side++) {
+        auto mismatch = std::mismatch(actual[side].begin(), actual[side].end(), expected[side].begin());
+        if (mismatch.first == actual[side].end()) { continue; }
+
+        char reason[96];
+        snprintf(reason, sizeof(reason), "%s end's byte %u is %02x, expected %02x",
+                 side == 0 ? "clocking" : "replying",
+                 static_cast<uint>(mismatch.first - actual[side].begin()),
+                 *mismatch.first,
+                 *mismatch.second);
+        return reason;
+    }
+    return "";
+}
+
+auto report(const std::string& name, const std::string& failure) -> bool {
+    printf("%s  %-32s%s%s\n", failure.empty() ? "PASS" : "FAIL", name.c_str(),
+           failure.empty() ? "" : "  ", failure.c_str());
+    return failure.empty();
+}
+
+} // namespace
+
+auto run_link_checks(const uint tcp_port) -> bool {
+    bool passed = true;
+
+    for (bool cgb : {false, true}) {
+        std::string machine = cgb ? "cgb" : "dmg";
+        Received reference = run_local(cgb, true);
+
+        /* Only worth comparing if some replies were ready in time and some
+         * weren't, which the clocking end sees as 0xFF */
+        auto ready = static_cast<uint>(std::count_if(reference[0].begin(), reference[0].end(),
+                                                     [](u8 byte) { return byte != 0xFF; }));
+        std::string uneventful = ready == 0 || ready == RECEIVED_BYTES ? "replies were all ready or none were" : "";
+        passed &= report("link " + machine + " lockstep", uneventful);
+
+        passed &= report("link " + machine + " local", compare(run_local(cgb, false), reference));
+        passed &= report("link " + machine + " rollback", compare(run_delayed(cgb), reference));
+
+#if !defined(_WIN32)
+        if (tcp_port != 0) {
+            passed &= report("link " + machine + " rollback over tcp", compare(run_tcp(cgb, tcp_port), reference));
+        }
+#else
+        unused(tcp_port);
+#endif
+    }
+
+    return passed;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "../../src/definitions.h"
+
+/*
+ * gbemu-regress --link: two small programs built here are joined by the
+ * cable, one clocking 16 transfers and one replying to each after a wait
+ * which depends on what it last got, so that some transfers find it ready
+ * and some don't. Both keep what they receive in work RAM, which has to
+ * come out as it does with the two run in lockstep:
+ *
+ *   - through LocalLink
+ *   - through two RollbackLinks, whose batches arrive some frames late
+ *   - through two RollbackLinks over TCP on localhost, given a port
+ *
+ * Once as DMGs and once as CGBs, the CGBs on the fast clock. Prints a line
+ * for each check, and returns true if all of them passed.
+ */
+auto run_link_checks(uint tcp_port) -> bool;
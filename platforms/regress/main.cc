@@ -0,0 +1,190 @@
+#include "../../src/gameboy_prelude.h"
+#include "../../src/batch_runner.h"
+#include "../../src/command_line.h"
+#include "../../src/config.h"
+#include "link_check.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+/* Golden frame hashes by ROM file name. On disk, one "<name> <frame> <hash>"
+ * per line; names can contain spaces, so the numbers are read from the end */
+using Manifest = std::map<std::string, std::vector<FrameHash>>;
+
+static void usage() {
+    fatal_error("usage: gbemu-regress [--threads=N] [--frames=N] [--pass=TEXT] [--fail=TEXT] "
+                "[--manifest=FILE] [--update-manifest] [--threaded-video] [--dmg] [<rom_file_or_directory>...]\n"
+                "       gbemu-regress --link [--link-port=PORT]");
+}
+
+static auto read_manifest(const std::string& filename) -> Manifest {
+    Manifest manifest;
+
+    /* A manifest which doesn't exist yet is just empty */
+    std::ifstream file(filename);
+    if (!file.good()) { return manifest; }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') { continue; }
+
+        auto hash_start = line.rfind(' ');
+        auto frame_start = hash_start == std::string::npos ? std::string::npos : line.rfind(' ', hash_start - 1);
+        if (frame_start == std::string::npos || frame_start == 0) {
+            fatal_error("Invalid manifest line in %s: %s", filename.c_str(), line.c_str());
+        }
+
+        FrameHash entry = {};
+        entry.frame = static_cast<uint>(std::strtoul(line.c_str() + frame_start + 1, nullptr, 10));
+        entry.hash = std::strtoull(line.c_str() + hash_start + 1, nullptr, 16);
+        manifest[line.substr(0, frame_start)].push_back(entry);
+    }
+
+    return manifest;
+}
+
+static void write_manifest(const std::string& filename, const Manifest& manifest) {
+    std::ofstream file(filename);
+    if (!file.good()) { fatal_error("Cannot write to file: %s", filename.c_str()); }
+
+    file << "# gbemu-regress frame hashes: <rom> <frame> <FNV-1a of the frame>\n";
+    for (const auto& entry : manifest) {
+        for (const FrameHash& hash : entry.second) {
+            char line[64];
+            snprintf(line, sizeof(line), " %u %016llx\n", hash.frame, static_cast<unsigned long long>(hash.hash));
+            file << entry.first << line;
+        }
+    }
+}
+
+/* Empty if the ROM passed; otherwise why it didn't */
+static auto check_result(const BatchResult& result, const std::vector<FrameHash>& expected,
+                         const std::string& pass, const std::string& fail) -> std::string {
+    if (!result.error.empty()) { return "error: " + result.error; }
+    if (result.serial_output.find(fail) != std::string::npos) { return "reported '" + fail + "'"; }
+    if (result.serial_output.find(pass) == std::string::npos) {
+        return result.stopped ? "stopped without reporting '" + pass + "'" : "frame limit reached";
+    }
+
+    for (const FrameHash& golden : expected) {
+        auto actual = std::find_if(result.checkpoint_hashes.begin(), result.checkpoint_hashes.end(),
+                                   [&golden](const FrameHash& hash) { return hash.frame == golden.frame; });
+
+        char reason[96];
+        if (actual == result.checkpoint_hashes.end()) {
+            snprintf(reason, sizeof(reason), "frame %u not reached", golden.frame);
+            return reason;
+        }
+        if (actual->hash != golden.hash) {
+            snprintf(reason, sizeof(reason), "frame %u hash %016llx, expected %016llx", golden.frame,
+                     static_cast<unsigned long long>(actual->hash), static_cast<unsigned long long>(golden.hash));
+            return reason;
+        }
+    }
+
+    return "";
+}
+
+static auto run_regression(int argc, char* argv[]) -> int {
+    BatchConfig config;
+    Options options;
+    options.disable_logs = true;
+    options.exit_on_infinite_jr = true;
+
+    std::string pass = "Passed";
+    std::string fail = "Failed";
+    std::string manifest_file;
+    bool update_manifest = false;
+    bool link = false;
+    uint link_port = 0;
+    std::vector<std::string> paths;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+
+        if (arg.rfind("--threads=", 0) == 0) { config.threads = flag_value(arg, "--threads="); }
+        else if (arg.rfind("--frames=", 0) == 0) { config.max_frames = flag_value(arg, "--frames="); }
+        else if (arg.rfind("--pass=", 0) == 0) { pass = arg.substr(7); }
+        else if (arg.rfind("--fail=", 0) == 0) { fail = arg.substr(7); }
+        else if (arg.rfind("--manifest=", 0) == 0) { manifest_file = arg.substr(11); }
+        else if (arg == "--update-manifest") { update_manifest = true; }
+        else if (arg == "--link") { link = true; }
+        else if (arg.rfind("--link-port=", 0) == 0) { link_port = flag_value(arg, "--link-port="); }
+        /* --threaded-video, --dmg and the emulator's other options (see config.h) */
+        else if (arg.rfind("--", 0) == 0) { apply_flag(options, arg); }
+        else { paths.push_back(arg); }
+    }
+
+    if (link) { return run_link_checks(link_port) ? 0 : 1; }
+    if (update_manifest && manifest_file.empty()) { usage(); }
+    if (paths.empty()) { paths.emplace_back("scripts/test_roms"); }
+
+    std::vector<std::string> roms = collect_roms(paths);
+    if (roms.empty()) { usage(); }
+
+    Manifest manifest = manifest_file.empty() ? Manifest() : read_manifest(manifest_file);
+    config.stop_strings = { pass, fail };
+
+    BatchRunner runner(config);
+    std::vector<std::string> names;
+    for (const std::string& rom : roms) {
+        names.push_back(std::filesystem::path(rom).filename().string());
+
+        std::vector<uint> checkpoints;
+        for (const FrameHash& hash : manifest[names.back()]) { checkpoints.push_back(hash.frame); }
+
+        runner.add_session(rom, RomImage::load_file(rom), options, checkpoints);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<BatchResult> results = runner.run();
+    double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint passed = 0;
+    for (uint i = 0; i < results.size(); i++) {
+        const BatchResult& result = results[i];
+        std::vector<FrameHash>& golden = manifest[names[i]];
+
+        std::string failure = check_result(result, update_manifest ? std::vector<FrameHash>() : golden, pass, fail);
+        if (failure.empty()) { passed++; }
+
+        /* New ROMs get the last frame they completed as their checkpoint */
+        if (update_manifest && result.error.empty()) {
+            golden = result.checkpoint_hashes;
+            if (golden.empty()) { golden.push_back({ result.frames, result.frame_hash }); }
+        }
+
+        double mhz = result.seconds > 0.0 ? static_cast<double>(result.cycles) / result.seconds / 1e6 : 0.0;
+        printf("%s  %-32s frames=%-6u %7.3fs %8.2f MHz (%.1fx)%s%s\n",
+               failure.empty() ? "PASS" : "FAIL",
+               names[i].c_str(),
+               result.frames,
+               result.seconds,
+               mhz,
+               mhz * 1e6 / CLOCK_RATE,
+               failure.empty() ? "" : "  ",
+               failure.c_str());
+    }
+
+    printf("%u/%zu passed in %.3fs\n", passed, results.size(), wall_seconds);
+
+    if (update_manifest) { write_manifest(manifest_file, manifest); }
+
+    return passed == results.size() ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    /* Bad arguments and unreadable files are reported where they're found */
+    try {
+        return run_regression(argc, argv);
+    } catch (const FatalError&) {
+        return 1;
+    }
+}
@@ -0,0 +1,347 @@
+#include "gl_display.h"
+
+#include "../../src/util/log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace {
+
+const char* VERTEX_SHADER = R"(
+#version 120
+attribute vec2 position;
+varying vec2 uv;
+
+void main() {
+    // A linha 0 da textura é a de cima
+    uv = vec2(position.x * 0.5 + 0.5, 0.5 - position.y * 0.5);
+    gl_Position = vec4(position, 0.0, 1.0);
+}
+)";
+
+const char* FRAGMENT_SHADER = R"(
+#version 120
+uniform sampler2D frame;
+uniform sampler2D previous;
+uniform sampler2D palette;
+uniform bool indexed;
+uniform bool xbr;
+uniform float ghosting;
+uniform vec2 size;
+varying vec2 uv;
+
+vec3 pixel(sampler2D source, vec2 position) {
+    vec4 texel = texture2D(source, (position + 0.5) / size);
+    if (!indexed) { return texel.rgb; }
+
+    // Index8: o byte é o tom, de 0 a 3
+    return texture2D(palette, vec2((texel.r * 255.0 + 0.5) / 4.0, 0.5)).rgb;
+}
+
+float difference(vec3 a, vec3 b) { return dot(abs(a - b), vec3(0.299, 0.587, 0.114)); }
+
+vec3 shade(sampler2D source) {
+    vec2 position = floor(uv * size);
+    vec3 e = pixel(source, position);
+    if (!xbr) { return e; }
+
+    // O canto do pixel em que o fragmento cai; os vizinhos são tomados
+    // girados para ele, e a regra é a do canto de baixo à direita:
+    //   A B C
+    //   D E F F4
+    //   G H I I4
+    //     H5 I5
+    vec2 corner = step(0.5, fract(uv * size)) * 2.0 - 1.0;
+    vec3 b = pixel(source, position + vec2(0.0, -1.0) * corner);
+    vec3 c = pixel(source, position + vec2(1.0, -1.0) * corner);
+    vec3 d = pixel(source, position + vec2(-1.0, 0.0) * corner);
+    vec3 f = pixel(source, position + vec2(1.0, 0.0) * corner);
+    vec3 g = pixel(source, position + vec2(-1.0, 1.0) * corner);
+    vec3 h = pixel(source, position + vec2(0.0, 1.0) * corner);
+    vec3 i = pixel(source, position + vec2(1.0, 1.0) * corner);
+    vec3 f4 = pixel(source, position + vec2(2.0, 0.0) * corner);
+    vec3 i4 = pixel(source, position + vec2(2.0, 1.0) * corner);
+    vec3 h5 = pixel(source, position + vec2(0.0, 2.0) * corner);
+    vec3 i5 = pixel(source, position + vec2(1.0, 2.0) * corner);
+
+    // Uma borda na diagonal F-H pesa menos que uma cruzando E-I
+    float along = difference(e, c) + difference(e, g) + difference(i, f4) + difference(i, h5)
+                + 4.0 * difference(h, f);
+    float across = difference(h, d) + difference(h, i5) + difference(f, i4) + difference(f, b)
+                 + 4.0 * difference(e, i);
+    if (along >= across) { return e; }
+
+    return mix(e, difference(e, f) <= difference(e, h) ? f : h, 0.5);
+}
+
+void main() {
+    vec3 color = shade(frame);
+    if (ghosting > 0.0) { color = mix(color, shade(previous), ghosting); }
+    gl_FragColor = vec4(color, 1.0);
+}
+)";
+
+const GLfloat QUAD[] = {-1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f};
+
+template <typename Function>
+void load(Function& function, const char* name) {
+    function = reinterpret_cast<Function>(SDL_GL_GetProcAddress(name));
+    if (function == nullptr) { fatal_error("OpenGL function missing: %s", name); }
+}
+
+} // namespace
+
+// Tudo carregado pelo SDL, inclusive o que é do GL 1.1
+struct GlDisplay::Functions {
+    decltype(&glGenTextures) GenTextures;
+    decltype(&glDeleteTextures) DeleteTextures;
+    decltype(&glBindTexture) BindTexture;
+    decltype(&glTexParameteri) TexParameteri;
+    decltype(&glTexImage2D) TexImage2D;
+    decltype(&glTexSubImage2D) TexSubImage2D;
+    decltype(&glPixelStorei) PixelStorei;
+    decltype(&glViewport) Viewport;
+    decltype(&glClearColor) ClearColor;
+    decltype(&glClear) Clear;
+    decltype(&glDrawArrays) DrawArrays;
+
+    PFNGLACTIVETEXTUREPROC ActiveTexture;
+    PFNGLCREATESHADERPROC CreateShader;
+    PFNGLSHADERSOURCEPROC ShaderSource;
+    PFNGLCOMPILESHADERPROC CompileShader;
+    PFNGLGETSHADERIVPROC GetShaderiv;
+    PFNGLGETSHADERINFOLOGPROC GetShaderInfoLog;
+    PFNGLDELETESHADERPROC DeleteShader;
+    PFNGLCREATEPROGRAMPROC CreateProgram;
+    PFNGLATTACHSHADERPROC AttachShader;
+    PFNGLBINDATTRIBLOCATIONPROC BindAttribLocation;
+    PFNGLLINKPROGRAMPROC LinkProgram;
+    PFNGLGETPROGRAMIVPROC GetProgramiv;
+    PFNGLGETPROGRAMINFOLOGPROC GetProgramInfoLog;
+    PFNGLDELETEPROGRAMPROC DeleteProgram;
+    PFNGLUSEPROGRAMPROC UseProgram;
+    PFNGLGETUNIFORMLOCATIONPROC GetUniformLocation;
+    PFNGLUNIFORM1IPROC Uniform1i;
+    PFNGLUNIFORM1FPROC Uniform1f;
+    PFNGLUNIFORM2FPROC Uniform2f;
+    PFNGLVERTEXATTRIBPOINTERPROC VertexAttribPointer;
+    PFNGLENABLEVERTEXATTRIBARRAYPROC EnableVertexAttribArray;
+};
+
+GlDisplay::GlDisplay(SDL_Window* inWindow, const PixelFormat inFormat, const GlDisplaySettings& inSettings) :
+    window(inWindow),
+    format(inFormat),
+    settings(inSettings),
+    gl(std::make_unique<Functions>())
+{
+    if (format == PixelFormat::RGBA8888) { fatal_error("The OpenGL display takes Index8 or RGB565 frames"); }
+
+    context = SDL_GL_CreateContext(window);
+    if (context == nullptr) { fatal_error("Cannot create an OpenGL context: %s", SDL_GetError()); }
+
+    try {
+        load_functions();
+        link_program();
+        create_textures();
+    } catch (const FatalError&) {
+        SDL_GL_DeleteContext(context);
+        throw;
+    }
+
+    // Como o SDL_Renderer com PRESENTVSYNC
+    SDL_GL_SetSwapInterval(1);
+}
+
+GlDisplay::~GlDisplay() {
+    GLuint textures[] = {current, previous, palette};
+    gl->DeleteTextures(3, textures);
+    gl->DeleteProgram(program);
+    SDL_GL_DeleteContext(context);
+}
+
+void GlDisplay::load_functions() {
+    load(gl->GenTextures, "glGenTextures");
+    load(gl->DeleteTextures, "glDeleteTextures");
+    load(gl->BindTexture, "glBindTexture");
+    load(gl->TexParameteri, "glTexParameteri");
+    load(gl->TexImage2D, "glTexImage2D");
+    load(gl->TexSubImage2D, "glTexSubImage2D");
+    load(gl->PixelStorei, "glPixelStorei");
+    load(gl->Viewport, "glViewport");
+    load(gl->ClearColor, "glClearColor");
+    load(gl->Clear, "glClear");
+    load(gl->DrawArrays, "glDrawArrays");
+
+    load(gl->ActiveTexture, "glActiveTexture");
+    load(gl->CreateShader, "glCreateShader");
+    load(gl->ShaderSource, "glShaderSource");
+    load(gl->CompileShader, "glCompileShader");
+    load(gl->GetShaderiv, "glGetShaderiv");
+    load(gl->GetShaderInfoLog, "glGetShaderInfoLog");
+    load(gl->DeleteShader, "glDeleteShader");
+    load(gl->CreateProgram, "glCreateProgram");
+    load(gl->AttachShader, "glAttachShader");
+    load(gl->BindAttribLocation, "glBindAttribLocation");
+    load(gl->LinkProgram, "glLinkProgram");
+    load(gl->GetProgramiv, "glGetProgramiv");
+    load(gl->GetProgramInfoLog, "glGetProgramInfoLog");
+    load(gl->DeleteProgram, "glDeleteProgram");
+    load(gl->UseProgram, "glUseProgram");
+    load(gl->GetUniformLocation, "glGetUniformLocation");
+    load(gl->Uniform1i, "glUniform1i");
+    load(gl->Uniform1f, "glUniform1f");
+    load(gl->Uniform2f, "glUniform2f");
+    load(gl->VertexAttribPointer, "glVertexAttribPointer");
+    load(gl->EnableVertexAttribArray, "glEnableVertexAttribArray");
+}
+
+auto GlDisplay::compile(const GLenum type, const char* source) -> GLuint {
+    GLuint shader = gl->CreateShader(type);
+    gl->ShaderSource(shader, 1, &source, nullptr);
+    gl->CompileShader(shader);
+
+    GLint compiled = GL_FALSE;
+    gl->GetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (compiled != GL_TRUE) {
+        char log[1024] = {};
+        gl->GetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        gl->DeleteShader(shader);
+        fatal_error("Cannot compile the display shader: %s", log);
+    }
+
+    return shader;
+}
+
+void GlDisplay::link_program() {
+    GLuint vertex = compile(GL_VERTEX_SHADER, VERTEX_SHADER);
+    GLuint fragment = compile(GL_FRAGMENT_SHADER, FRAGMENT_SHADER);
+
+    program = gl->CreateProgram();
+    gl->AttachShader(program, vertex);
+    gl->AttachShader(program, fragment);
+    gl->BindAttribLocation(program, 0, "position");
+    gl->LinkProgram(program);
+
+    // O programa fica com eles
+    gl->DeleteShader(vertex);
+    gl->DeleteShader(fragment);
+
+    GLint linked = GL_FALSE;
+    gl->GetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE) {
+        char log[1024] = {};
+        gl->GetProgramInfoLog(program, sizeof(log), nullptr, log);
+        fatal_error("Cannot link the display shader: %s", log);
+    }
+
+    // Nada disso muda depois: os uniforms são dados uma vez só
+    gl->UseProgram(program);
+    gl->Uniform1i(gl->GetUniformLocation(program, "frame"), 0);
+    gl->Uniform1i(gl->GetUniformLocation(program, "previous"), 1);
+    gl->Uniform1i(gl->GetUniformLocation(program, "palette"), 2);
+    gl->Uniform1i(gl->GetUniformLocation(program, "indexed"), format == PixelFormat::Index8);
+    gl->Uniform1i(gl->GetUniformLocation(program, "xbr"), settings.filter == GlFilter::Xbr);
+    gl->Uniform1f(gl->GetUniformLocation(program, "ghosting"), settings.ghosting);
+    gl->Uniform2f(gl->GetUniformLocation(program, "size"), GAMEBOY_WIDTH, GAMEBOY_HEIGHT);
+
+    gl->VertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, QUAD);
+    gl->EnableVertexAttribArray(0);
+}
+
+void GlDisplay::create_textures() {
+    gl->PixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    GLuint textures[3] = {};
+    gl->GenTextures(3, textures);
+    current = textures[0];
+    previous = textures[1];
+    palette = textures[2];
+
+    for (GLuint texture : textures) {
+        gl->BindTexture(GL_TEXTURE_2D, texture);
+        gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    // Os frames: só o espaço, preenchido a cada envio
+    for (GLuint texture : {current, previous}) {
+        gl->BindTexture(GL_TEXTURE_2D, texture);
+        if (format == PixelFormat::Index8) {
+            gl->TexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, GAMEBOY_WIDTH, GAMEBOY_HEIGHT, 0,
+                           GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr);
+        } else {
+            gl->TexImage2D(GL_TEXTURE_2D, 0, GL_RGB, GAMEBOY_WIDTH, GAMEBOY_HEIGHT, 0,
+                           GL_RGB, GL_UNSIGNED_SHORT_5_6_5, nullptr);
+        }
+    }
+
+    // A paleta do DMG, uma linha de quatro cores
+    std::array<u8, 12> colors = {};
+    for (uint shade = 0; shade < 4; shade++) {
+        colors[shade * 3] = static_cast<u8>(settings.dmg_palette[shade] >> 16);
+        colors[shade * 3 + 1] = static_cast<u8>(settings.dmg_palette[shade] >> 8);
+        colors[shade * 3 + 2] = static_cast<u8>(settings.dmg_palette[shade]);
+    }
+    gl->BindTexture(GL_TEXTURE_2D, palette);
+    gl->TexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 4, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, colors.data());
+}
+
+void GlDisplay::upload(const GLuint texture, const u8* pixels) {
+    gl->BindTexture(GL_TEXTURE_2D, texture);
+    if (format == PixelFormat::Index8) {
+        gl->TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, GAMEBOY_WIDTH, GAMEBOY_HEIGHT, GL_LUMINANCE, GL_UNSIGNED_BYTE, pixels);
+    } else {
+        gl->TexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, GAMEBOY_WIDTH, GAMEBOY_HEIGHT, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, pixels);
+    }
+}
+
+void GlDisplay::show(const u8* pixels) {
+    size_t size = GAMEBOY_WIDTH * GAMEBOY_HEIGHT * (format == PixelFormat::Index8 ? 1 : 2);
+    bool changed = uploaded.empty() || std::memcmp(pixels, uploaded.data(), size) != 0;
+
+    if (changed) {
+        // O atual vira o anterior, e o frame novo vai para a outra textura
+        std::swap(current, previous);
+        upload(current, pixels);
+        uploaded.assign(pixels, pixels + size);
+        previous_is_current = false;
+    } else if (settings.ghosting > 0.0f && !previous_is_current) {
+        // Sem mudança, o rastro some: o anterior passa a ser o mesmo frame
+        previous_is_current = true;
+    } else {
+        // A tela ficaria igual
+        return;
+    }
+
+    draw();
+}
+
+void GlDisplay::draw() {
+    int width = 0;
+    int height = 0;
+    SDL_GL_GetDrawableSize(window, &width, &height);
+
+    // A maior escala que cabe, mantendo a proporção do Gameboy
+    float scale = std::min(static_cast<float>(width) / GAMEBOY_WIDTH, static_cast<float>(height) / GAMEBOY_HEIGHT);
+    if (settings.integer_scale) { scale = std::max(1.0f, static_cast<float>(static_cast<int>(scale))); }
+    int view_width = static_cast<int>(GAMEBOY_WIDTH * scale);
+    int view_height = static_cast<int>(GAMEBOY_HEIGHT * scale);
+
+    gl->Viewport(0, 0, width, height);
+    gl->ClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    gl->Clear(GL_COLOR_BUFFER_BIT);
+    gl->Viewport((width - view_width) / 2, (height - view_height) / 2, view_width, view_height);
+
+    gl->ActiveTexture(GL_TEXTURE0);
+    gl->BindTexture(GL_TEXTURE_2D, current);
+    gl->ActiveTexture(GL_TEXTURE1);
+    gl->BindTexture(GL_TEXTURE_2D, previous_is_current ? current : previous);
+    gl->ActiveTexture(GL_TEXTURE2);
+    gl->BindTexture(GL_TEXTURE_2D, palette);
+
+    gl->DrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    SDL_GL_SwapWindow(window);
+}
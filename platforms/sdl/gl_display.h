@@ -0,0 +1,79 @@
+#pragma once
+
+#include <SDL.h>
+#include <SDL_opengl.h>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "../../src/definitions.h"
+
+// Escala do frame na janela
+enum class GlFilter {
+    // Pixels duplicados, sem suavizar
+    Nearest,
+    // Bordas diagonais suavizadas como no xBR (nível 1, um canto por pixel)
+    Xbr,
+};
+
+struct GlDisplaySettings {
+    GlFilter filter = GlFilter::Nearest;
+    // Só múltiplos inteiros do tamanho do Gameboy, com bordas pretas
+    bool integer_scale = false;
+    // Quanto do frame anterior fica na tela, de 0 a 1, como o rastro do LCD
+    float ghosting = 0.0f;
+    // As quatro cores do DMG, da mais clara, como em Options::dmg_palette
+    std::array<u32, 4> dmg_palette = {};
+};
+
+/*
+ * Mostra os frames do emulador pelo OpenGL em vez do SDL_Renderer: o frame
+ * sobe como está no FrameBuffer, um byte por pixel (Index8, com a paleta
+ * aplicada no shader) ou RGB565 no CGB, e a escala, a paleta e o rastro do
+ * LCD rodam na GPU. Um frame igual ao último não é enviado de novo.
+ *
+ * Só usa o GL 2.1, com as funções carregadas pelo SDL, então não há nada a
+ * linkar além dele. A janela precisa ter sido criada com SDL_WINDOW_OPENGL.
+ */
+class GlDisplay {
+public:
+    // Lança FatalError se o contexto ou os shaders não puderem ser criados
+    GlDisplay(SDL_Window* window, PixelFormat format, const GlDisplaySettings& settings);
+    ~GlDisplay();
+
+    GlDisplay(const GlDisplay&) = delete;
+    auto operator=(const GlDisplay&) -> GlDisplay& = delete;
+
+    // Um frame completo, GAMEBOY_HEIGHT linhas no formato dado. Desenha e
+    // troca os buffers, a não ser que nada na tela fosse mudar
+    void show(const u8* pixels);
+
+private:
+    struct Functions;
+
+    void load_functions();
+    auto compile(GLenum type, const char* source) -> GLuint;
+    void link_program();
+    void create_textures();
+    void upload(GLuint texture, const u8* pixels);
+    void draw();
+
+    SDL_Window* window;
+    SDL_GLContext context = nullptr;
+    PixelFormat format;
+    GlDisplaySettings settings;
+
+    std::unique_ptr<Functions> gl;
+
+    GLuint program = 0;
+    // O frame atual e o anterior, que trocam de papel a cada envio
+    GLuint current = 0;
+    GLuint previous = 0;
+    GLuint palette = 0;
+    // O anterior já é igual ao atual: o rastro sumiu
+    bool previous_is_current = true;
+
+    // O último frame enviado, para comparar com o próximo
+    std::vector<u8> uploaded;
+};
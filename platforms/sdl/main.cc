@@ -1,16 +1,22 @@
 #include <SDL.h>
 
+#include <array>
 #include <chrono>
+#include <cstdlib>
+#include <filesystem>
 #include <thread>
 #include <vector>
-#include <mutex>
 #include <atomic>
 #include <iostream>
 #include <optional>
 #include <fstream>
 
+#include "../../src/battery_writer.h"
+#include "../../src/cartridge/rom_archive.h"
+#include "../../src/config.h"
 #include "../../src/gameboy.h"
 #include "../../src/util/log.h"
+#include "gl_display.h"
 
 // Funções de utilidade locais
 std::vector<u8> read_bytes_from_file(const std::string& filename) {
@@ -51,83 +57,70 @@ void write_bytes_to_file(const std::string& filename, const std::vector<u8>& dat
     }
 }
 
-// Buffers globais para áudio
-std::vector<float> g_left_buffer;
-std::vector<float> g_right_buffer;
-std::mutex audio_mutex;
-std::atomic<bool> audio_callback_called(false);
-std::atomic<int> audio_sample_count(0);
-
-// Mutex para sincronização de vídeo
-std::mutex video_mutex;
-std::vector<uint8_t> current_frame_buffer(160 * 144 * 3, 0);
-bool frame_updated = false;
-
-// Flag para indicar se o callback de vídeo foi chamado
-std::atomic<bool> video_callback_called(false);
-std::atomic<int> frame_count(0);
+// Estado compartilhado com a thread de áudio do SDL, passado como userdata
+struct AudioOutput {
+    // Anel de áudio do emulador, lido direto pelo callback
+    std::atomic<AudioRing*> ring{nullptr};
+    std::atomic<bool> callback_called{false};
+    std::atomic<int> sample_count{0};
+
+    // Amostras restantes do tom de teste, mixado dentro do próprio callback
+    // (o anel só admite um produtor, que é o emulador)
+    std::atomic<int> test_tone_samples{0};
+    int test_tone_position = 0;
+
+    // Taxa de saída, escolhida antes de abrir o dispositivo
+    int sample_rate = 44100;
+};
+
+// Estado compartilhado com a thread do emulador
+struct VideoOutput {
+    // Último frame completo: o FrameBuffer já está no formato da textura,
+    // então a thread principal lê direto dele, sem conversão nem cópia
+    std::atomic<const FrameBuffer*> completed_frame{nullptr};
+    std::atomic<bool> frame_updated{false};
+
+    // Flag para indicar se o callback de vídeo foi chamado
+    std::atomic<bool> callback_called{false};
+    std::atomic<int> frame_count{0};
+};
 
 // Função de callback de áudio para SDL
 void audio_callback(void* userdata, Uint8* stream, int len) {
-    /*std::cout << "[SDL] Audio callback: requested " << len
-              << " bytes (" << (len / (int)sizeof(float)) << " float samples)"
-              << std::endl;*/
-    // Limpa o stream
-    SDL_memset(stream, 0, len);
-    
+    AudioOutput& output = *static_cast<AudioOutput*>(userdata);
+
     // Converte o stream para float (o formato que nosso sistema de áudio usa)
     float* float_stream = reinterpret_cast<float*>(stream);
-    int samples = len / (sizeof(float) * 2); // Dividido por 2 canais
-    
-    // Copia as amostras para o stream de saída (intercalando esquerdo/direito)
-    std::lock_guard<std::mutex> lock(audio_mutex);
-    int copy_samples = std::min(static_cast<int>(g_left_buffer.size()), samples);
-    
-    for (int i = 0; i < copy_samples; i++) {
-        float_stream[i*2] = g_left_buffer[i];     // Canal esquerdo
-        float_stream[i*2+1] = g_right_buffer[i];  // Canal direito
+    uint frames = static_cast<uint>(len / (sizeof(float) * 2)); // Dividido por 2 canais
+
+    // Copia as amostras intercaladas direto do anel; o que faltar vira silêncio
+    AudioRing* ring = output.ring;
+    if (ring == nullptr) {
+        SDL_memset(stream, 0, len);
+        return;
     }
-    
-    // Remove as amostras usadas dos buffers
-    if (copy_samples > 0) {
-        g_left_buffer.erase(g_left_buffer.begin(), g_left_buffer.begin() + copy_samples);
-        g_right_buffer.erase(g_right_buffer.begin(), g_right_buffer.begin() + copy_samples);
-        audio_callback_called = true;
-        audio_sample_count += copy_samples;
+
+    uint copied = ring->pop(float_stream, frames);
+    if (copied > 0) {
+        output.callback_called = true;
+        output.sample_count += static_cast<int>(copied);
     }
-    
-    // Se não temos amostras suficientes, gere silêncio
-    if (copy_samples < samples) {
-        // Preenche o restante do buffer com silêncio
-        for (int i = copy_samples; i < samples; i++) {
-            float_stream[i*2] = 0.0f;     // Canal esquerdo
-            float_stream[i*2+1] = 0.0f;   // Canal direito
-        }
+
+    // Mistura o tom de teste (440 Hz) por cima, se pedido
+    int tone = std::min(output.test_tone_samples.load(), static_cast<int>(frames));
+    for (int i = 0; i < tone; i++) {
+        float t = static_cast<float>(output.test_tone_position++) / static_cast<float>(output.sample_rate);
+        float sample = 0.5f * std::sin(2.0f * static_cast<float>(M_PI) * 440.0f * t);
+        float_stream[i*2] += sample;
+        float_stream[i*2+1] += sample;
     }
+    output.test_tone_samples -= tone;
 }
 
 // Função para gerar amostras de áudio de teste
-void generate_test_audio() {
-    // Gera um tom simples para testar o áudio
-    const int sample_rate = 44100;
-    const float frequency = 440.0f; // 440 Hz (nota A4)
-    const float amplitude = 0.5f;
-    const float duration = 0.5f; // 0.5 segundos
-    const int num_samples = static_cast<int>(sample_rate * duration);
-    
-    std::vector<float> left_samples(num_samples);
-    std::vector<float> right_samples(num_samples);
-    
-    for (int i = 0; i < num_samples; i++) {
-        float t = static_cast<float>(i) / sample_rate;
-        float sample = amplitude * std::sin(2.0f * M_PI * frequency * t);
-        left_samples[i] = sample;
-        right_samples[i] = sample;
-    }
-    
-    std::lock_guard<std::mutex> lock(audio_mutex);
-    g_left_buffer.insert(g_left_buffer.end(), left_samples.begin(), left_samples.end());
-    g_right_buffer.insert(g_right_buffer.end(), right_samples.begin(), right_samples.end());
+void generate_test_audio(AudioOutput& output) {
+    // Meio segundo de tom
+    output.test_tone_samples = output.sample_rate / 2;
 }
 
 int main(int argc, char* argv[]) {
@@ -138,6 +131,54 @@ int main(int argc, char* argv[]) {
 
     std::cout << "Starting gbemu with ROM: " << argv[1] << std::endl;
 
+    // Flags só deste frontend, para a saída de vídeo; as outras são as do
+    // emulador, como em todo frontend (ver config.h), e um arquivo de
+    // --config é relido se mudar enquanto roda
+    bool use_gl = false;
+    GlDisplaySettings display_settings;
+    std::vector<std::string> flags;
+    std::string config_file;
+    for (int i = 2; i < argc; i++) {
+        std::string arg(argv[i]);
+
+        if (arg == "--gl") {
+            use_gl = true;
+        } else if (arg == "--filter=nearest") {
+            display_settings.filter = GlFilter::Nearest;
+        } else if (arg == "--filter=xbr") {
+            display_settings.filter = GlFilter::Xbr;
+        } else if (arg == "--integer-scale") {
+            display_settings.integer_scale = true;
+        } else if (arg.rfind("--ghosting=", 0) == 0) {
+            int percent = std::atoi(arg.c_str() + 11);
+            if (percent < 0 || percent > 90) {
+                std::cerr << "--ghosting takes a percentage from 0 to 90" << std::endl;
+                return 1;
+            }
+            display_settings.ghosting = static_cast<float>(percent) / 100.0f;
+        } else {
+            if (arg.rfind("--config=", 0) == 0) { config_file = arg.substr(9); }
+            flags.push_back(arg);
+        }
+    }
+
+    auto build_options = [&flags]() {
+        Options built;
+        // O FrameBuffer grava os pixels no mesmo formato da textura
+        built.pixel_format = PixelFormat::RGBA8888;
+        for (const std::string& flag : flags) { apply_flag(built, flag); }
+        return built;
+    };
+
+    Options options;
+    try {
+        options = build_options();
+    } catch (const FatalError& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    display_settings.dmg_palette = options.dmg_palette;
+
     // Inicializa o SDL com vídeo e áudio
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0) {
         std::cerr << "SDL_Init Error: " << SDL_GetError() << std::endl;
@@ -146,12 +187,17 @@ int main(int argc, char* argv[]) {
 
     std::cout << "SDL initialized successfully" << std::endl;
 
-    // Cria a janela
+    // Cria a janela; com --gl ela desenha pelo OpenGL 2.1, sem SDL_Renderer
+    if (use_gl) {
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+        SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+    }
     SDL_Window* window = SDL_CreateWindow(
         "gbemu",
         SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
         160 * 3, 144 * 3,
-        SDL_WINDOW_SHOWN
+        SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | (use_gl ? SDL_WINDOW_OPENGL : 0u)
     );
 
     if (window == nullptr) {
@@ -162,43 +208,120 @@ int main(int argc, char* argv[]) {
 
     std::cout << "SDL window created successfully" << std::endl;
 
-    // Cria o renderer
-    SDL_Renderer* renderer = SDL_CreateRenderer(
-        window,
-        -1,
-        SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC
-    );
+    // Sem --gl, ou se o OpenGL falhar: o renderer do SDL, com o frame em RGBA
+    SDL_Renderer* renderer = nullptr;
+    SDL_Texture* texture = nullptr;
+    auto create_renderer = [&]() {
+        renderer = SDL_CreateRenderer(
+            window,
+            -1,
+            SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC
+        );
+
+        if (renderer == nullptr) {
+            std::cerr << "SDL_CreateRenderer Error: " << SDL_GetError() << std::endl;
+            return false;
+        }
+
+        std::cout << "SDL renderer created successfully" << std::endl;
 
-    if (renderer == nullptr) {
+        // Define o tamanho lógico do renderer
+        SDL_RenderSetLogicalSize(renderer, 160, 144);
+        if (display_settings.integer_scale) { SDL_RenderSetIntegerScale(renderer, 1); }
+
+        // Cria a textura para renderização
+        texture = SDL_CreateTexture(
+            renderer,
+            SDL_PIXELFORMAT_RGBA8888,
+            SDL_TEXTUREACCESS_STREAMING,
+            160, 144
+        );
+
+        std::cout << "SDL texture created successfully" << std::endl;
+        return true;
+    };
+
+    if (!use_gl && !create_renderer()) {
         SDL_DestroyWindow(window);
-        std::cerr << "SDL_CreateRenderer Error: " << SDL_GetError() << std::endl;
         SDL_Quit();
         return 1;
     }
 
-    std::cout << "SDL renderer created successfully" << std::endl;
+    // Gera um tom de teste para verificar se o áudio está funcionando
+    // generate_test_audio();
+    // std::cout << "Generated test audio tone" << std::endl;
 
-    // Define o tamanho lógico do renderer
-    SDL_RenderSetLogicalSize(renderer, 160, 144);
+    // Mapeia a ROM direto do arquivo, sem copiar, ou a descompacta se vier num zip, gzip ou zstd
+    std::cout << "Loading ROM file: " << argv[1] << std::endl;
+    std::shared_ptr<const RomImage> rom;
+    try {
+        rom = RomImage::load_file(argv[1]);
+    } catch (const FatalError&) {
+        std::cerr << "Failed to load ROM file: " << argv[1] << std::endl;
+        SDL_DestroyTexture(texture);
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        SDL_Quit();
+        return 1;
+    }
+    std::cout << "ROM loaded successfully, size: " << rom->size() << " bytes" << std::endl;
+
+    // Pelo OpenGL o frame sobe como o emulador o guarda: o tom de cada pixel
+    // num byte (a paleta fica no shader) ou, no CGB, em RGB565
+    std::unique_ptr<GlDisplay> gl_display;
+    if (use_gl) {
+        bool cgb = rom->info().supports_cgb && !options.force_dmg;
+        PixelFormat format = cgb ? PixelFormat::RGB565 : PixelFormat::Index8;
+        try {
+            gl_display = std::make_unique<GlDisplay>(window, format, display_settings);
+            options.pixel_format = format;
+            std::cout << "OpenGL display created successfully" << std::endl;
+        } catch (const FatalError& error) {
+            std::cerr << "Falling back to the SDL renderer: " << error.what() << std::endl;
+            if (!create_renderer()) {
+                SDL_DestroyWindow(window);
+                SDL_Quit();
+                return 1;
+            }
+        }
+    }
 
-    // Cria a textura para renderização
-    SDL_Texture* texture = SDL_CreateTexture(
-        renderer,
-        SDL_PIXELFORMAT_RGB24,
-        SDL_TEXTUREACCESS_STREAMING,
-        160, 144
-    );
+    // Carrega os dados de save, se existirem
+    std::vector<u8> save_data;
+    std::string save_filename = std::string(argv[1]) + ".sav";
+    if (file_exists_check(save_filename)) {
+        // Pode estar compactado como a ROM; é escrito de volta sem compactar
+        try {
+            save_data = unpack_save(read_bytes_from_file(save_filename), save_filename);
+        } catch (const FatalError&) {
+            std::cerr << "Failed to load save file: " << save_filename << std::endl;
+            gl_display.reset();
+            SDL_DestroyTexture(texture);
+            SDL_DestroyRenderer(renderer);
+            SDL_DestroyWindow(window);
+            SDL_Quit();
+            return 1;
+        }
+        std::cout << "Save data loaded, size: " << save_data.size() << " bytes" << std::endl;
+    } else {
+        std::cout << "No save data found" << std::endl;
+    }
 
-    std::cout << "SDL texture created successfully" << std::endl;
+    std::error_code config_error;
+    auto config_time = config_file.empty() ? std::filesystem::file_time_type()
+                                           : std::filesystem::last_write_time(config_file, config_error);
 
-    // Configuração do áudio
+    // Configuração do áudio, na mesma taxa em que o APU gera as amostras
+    AudioOutput audio_output;
+    audio_output.sample_rate = static_cast<int>(options.audio_sample_rate);
     SDL_AudioSpec want, have;
     SDL_memset(&want, 0, sizeof(want));
-    want.freq = 44100;
+    want.freq = static_cast<int>(options.audio_sample_rate);
     want.format = AUDIO_F32;
     want.channels = 2;
     want.samples = 1024;
     want.callback = audio_callback;
+    want.userdata = &audio_output;
 
     SDL_AudioDeviceID audio_device = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
     if (audio_device == 0) {
@@ -212,62 +335,51 @@ int main(int argc, char* argv[]) {
         std::cout << "Audio buffer size: " << have.samples << " samples" << std::endl;
     }
 
-    // Gera um tom de teste para verificar se o áudio está funcionando
-    // generate_test_audio();
-    // std::cout << "Generated test audio tone" << std::endl;
+    /* Holding Tab fast-forwards at the requested multiplier (4x unless --speed was given) */
+    SpeedMode base_speed_mode = options.speed_mode;
+    uint base_speed_multiplier = options.speed_multiplier;
+    uint fast_forward_multiplier = options.speed_multiplier > 1 ? options.speed_multiplier : 4;
 
-    // Carrega a ROM
-    std::cout << "Loading ROM file: " << argv[1] << std::endl;
-    std::vector<u8> rom_data = read_bytes_from_file(argv[1]);
-    if (rom_data.empty()) {
-        std::cerr << "Failed to load ROM file: " << argv[1] << std::endl;
+    std::cout << "Creating Gameboy instance..." << std::endl;
+
+    // Cria a instância do Gameboy; erros fatais já foram logados
+    std::unique_ptr<Gameboy> gameboy_instance;
+    try {
+        gameboy_instance = std::make_unique<Gameboy>(rom, options, save_data);
+    } catch (const FatalError& error) {
+        std::cerr << "Failed to create Gameboy instance: " << error.what() << std::endl;
+        if (audio_device != 0) { SDL_CloseAudioDevice(audio_device); }
         SDL_DestroyTexture(texture);
         SDL_DestroyRenderer(renderer);
         SDL_DestroyWindow(window);
         SDL_Quit();
         return 1;
     }
-    std::cout << "ROM loaded successfully, size: " << rom_data.size() << " bytes" << std::endl;
+    Gameboy& gameboy = *gameboy_instance;
 
-    // Carrega os dados de save, se existirem
-    std::vector<u8> save_data;
-    std::string save_filename = std::string(argv[1]) + ".sav";
-    if (file_exists_check(save_filename)) {
-        save_data = read_bytes_from_file(save_filename);
-        std::cout << "Save data loaded, size: " << save_data.size() << " bytes" << std::endl;
-    } else {
-        std::cout << "No save data found" << std::endl;
+    // Filmes de entrada: a reprodução substitui o teclado até o filme acabar
+    if (!options.play_movie.empty() && !gameboy.play_movie(read_bytes_from_file(options.play_movie))) {
+        std::cerr << "Could not play movie: " << options.play_movie << std::endl;
     }
+    if (!options.record_movie.empty() && !gameboy.playing_movie()) { gameboy.start_movie_recording(); }
 
-    // Configura as opções do emulador
-    Options options;
-    for (int i = 2; i < argc; i++) {
-        std::string arg(argv[i]);
+    std::cout << "Gameboy instance created successfully" << std::endl;
 
-        if (arg == "--debug") {
-            options.debugger = true;
-            std::cout << "Debug mode enabled" << std::endl;
-        } else if (arg == "--trace") {
-            options.trace = true;
-            std::cout << "Trace mode enabled" << std::endl;
-        } else if (arg == "--silent") {
-            options.disable_logs = true;
-            std::cout << "Silent mode enabled" << std::endl;
-        } else if (arg == "--exit-on-infinite-jr") {
-            options.exit_on_infinite_jr = true;
-            std::cout << "Exit on infinite JR enabled" << std::endl;
-        } else if (arg == "--print-serial-output") {
-            options.print_serial = true;
-            std::cout << "Print serial output enabled" << std::endl;
+    // O save é gravado aos poucos por uma thread própria, só com as páginas alteradas
+    std::unique_ptr<BatteryWriter> battery;
+    if (!gameboy.get_cartridge_ram().empty()) {
+        try {
+            battery = std::make_unique<BatteryWriter>(save_filename, gameboy.get_battery_data());
+            gameboy.register_battery_callback([&battery](const RamChanges& changes) { battery->submit(changes); });
+        } catch (const FatalError&) {
+            std::cerr << "Cartridge RAM will only be saved at exit" << std::endl;
         }
     }
 
-    std::cout << "Creating Gameboy instance..." << std::endl;
+    // A thread de áudio passa a consumir as amostras do emulador
+    audio_output.ring = &gameboy.audio_output();
 
-    // Cria a instância do Gameboy
-    Gameboy gameboy(rom_data, options, save_data);
-
-    std::cout << "Gameboy instance created successfully" << std::endl;
+    VideoOutput video_output;
 
     // Flag para controlar o loop principal
     std::atomic<bool> running(true);
@@ -309,82 +421,25 @@ int main(int argc, char* argv[]) {
                 [&running]() { 
                     return !running; 
                 },
-                [](const FrameBuffer& buffer) {
+                [&video_output](const FrameBuffer& buffer) {
                     // Marca que o callback de vídeo foi chamado
-                    video_callback_called = true;
-                    frame_count++;
+                    video_output.callback_called = true;
+                    video_output.frame_count++;
                     
-                    if (frame_count % 60 == 0) {
-                        std::cout << "Rendered frame " << frame_count << std::endl;
+                    if (video_output.frame_count % 60 == 0) {
+                        std::cout << "Rendered frame " << video_output.frame_count << std::endl;
                     }
                     
-                    // Buffer para os dados RGB
-                    std::vector<uint8_t> rgb_buffer(160 * 144 * 3, 0);
-                    
-                    // Convertemos os pixels da FrameBuffer para o formato RGB
-                    for (int y = 0; y < 144; y++) {
-                        for (int x = 0; x < 160; x++) {
-                            Color pixel = buffer.get_pixel(x, y);
-                            int idx = (y * 160 + x) * 3;
-                            
-                            // Definimos os valores RGB com base na cor
-                            switch (pixel) {
-                                case Color::White:
-                                    rgb_buffer[idx] = 255;
-                                    rgb_buffer[idx+1] = 255;
-                                    rgb_buffer[idx+2] = 255;
-                                    break;
-                                case Color::LightGray:
-                                    rgb_buffer[idx] = 192;
-                                    rgb_buffer[idx+1] = 192;
-                                    rgb_buffer[idx+2] = 192;
-                                    break;
-                                case Color::DarkGray:
-                                    rgb_buffer[idx] = 96;
-                                    rgb_buffer[idx+1] = 96;
-                                    rgb_buffer[idx+2] = 96;
-                                    break;
-                                case Color::Black:
-                                default:
-                                    rgb_buffer[idx] = 0;
-                                    rgb_buffer[idx+1] = 0;
-                                    rgb_buffer[idx+2] = 0;
-                                    break;
-                            }
-                        }
-                    }
-                    
-                    // Atualiza o buffer de frame atual
-                    std::lock_guard<std::mutex> lock(video_mutex);
-                    current_frame_buffer = rgb_buffer;
-                    frame_updated = true;
-                },
-                [](const std::vector<float>& left, const std::vector<float>& right) {
-                    // Este callback será chamado quando novas amostras de áudio estiverem disponíveis
-                    std::lock_guard<std::mutex> lock(audio_mutex);
-                    
-                    // Verifica se recebemos amostras válidas
-                    if (!left.empty() && !right.empty()) {
-                        // Adiciona as amostras aos buffers globais
-                        g_left_buffer.insert(g_left_buffer.end(), left.begin(), left.end());
-                        g_right_buffer.insert(g_right_buffer.end(), right.begin(), right.end());
-                        
-                        // Limita o tamanho dos buffers para evitar uso excessivo de memória
-                        const size_t max_buffer_size = 44100 * 2; // 2 segundos de áudio
-                        if (g_left_buffer.size() > max_buffer_size) {
-                            g_left_buffer.erase(g_left_buffer.begin(), g_left_buffer.begin() + (g_left_buffer.size() - max_buffer_size));
-                        }
-                        if (g_right_buffer.size() > max_buffer_size) {
-                            g_right_buffer.erase(g_right_buffer.begin(), g_right_buffer.begin() + (g_right_buffer.size() - max_buffer_size));
-                        }
-                        
-                        if (audio_sample_count % 44100 == 0) {
-                            std::cout << "Audio samples received: " << left.size() << " (total: " << audio_sample_count << ")" << std::endl;
-                        }
-                    }
+                    video_output.completed_frame = &buffer;
+                    video_output.frame_updated = true;
                 }
             );
+            if (gameboy.failed()) {
+                std::cerr << "Emulator stopped on a fatal error: " << gameboy.error() << std::endl;
+            }
             std::cout << "Emulator run completed" << std::endl;
+            // O emulador pode parar sozinho (erro, --exit-on-infinite-jr, exit no debugger)
+            running = false;
         } catch (const std::exception& e) {
             std::cerr << "Exception in emulator thread: " << e.what() << std::endl;
             running = false;
@@ -423,9 +478,11 @@ int main(int argc, char* argv[]) {
                     gameboy.debug_toggle_sprites();
                 } else if (e.key.keysym.sym == SDLK_3) {
                     gameboy.debug_toggle_window();
+                } else if (e.key.keysym.sym == SDLK_TAB && e.key.repeat == 0) {
+                    gameboy.set_speed(SpeedMode::FastForward, fast_forward_multiplier);
                 } else if (e.key.keysym.sym == SDLK_t) {
                     // Gera um tom de teste quando a tecla T é pressionada
-                    generate_test_audio();
+                    generate_test_audio(audio_output);
                     std::cout << "Generated test audio tone" << std::endl;
                 }
             } else if (e.type == SDL_KEYUP) {
@@ -433,41 +490,69 @@ int main(int argc, char* argv[]) {
                 if (button) {
                     gameboy.button_released(*button);
                 }
+
+                if (e.key.keysym.sym == SDLK_TAB) {
+                    gameboy.set_speed(base_speed_mode, base_speed_multiplier);
+                }
             }
         }
 
         // Verifica se o callback de vídeo foi chamado
         check_counter++;
         if (check_counter % 100 == 0) {
-            if (!video_callback_called) {
+            if (!video_output.callback_called) {
                 std::cout << "Warning: Video callback has not been called yet after " << check_counter / 100 << " seconds" << std::endl;
             } else {
-                std::cout << "Video callback has been called, frames rendered: " << frame_count << std::endl;
+                std::cout << "Video callback has been called, frames rendered: " << video_output.frame_count << std::endl;
             }
             
-            if (!audio_callback_called) {
+            if (!audio_output.callback_called) {
                 std::cout << "Warning: Audio callback has not been called yet after " << check_counter / 100 << " seconds" << std::endl;
             } else {
-                std::cout << "Audio callback has been called, samples processed: " << audio_sample_count << std::endl;
+                const AudioRing& ring = gameboy.audio_output();
+                std::cout << "Audio callback has been called, samples processed: " << audio_output.sample_count
+                          << " (underruns: " << ring.underruns() << ", overruns: " << ring.overruns() << ")" << std::endl;
+            }
+        }
+
+        // Relê o arquivo de configuração quando ele muda. O que não dá para
+        // mudar rodando fica como estava, e a taxa de amostragem também,
+        // porque o dispositivo de áudio já foi aberto nela
+        if (!config_file.empty() && check_counter % 60 == 0) {
+            auto modified = std::filesystem::last_write_time(config_file, config_error);
+            if (!config_error && modified != config_time) {
+                config_time = modified;
+                try {
+                    Options reloaded = build_options();
+                    reloaded.audio_sample_rate = options.audio_sample_rate;
+                    gameboy.configure(reloaded);
+
+                    base_speed_mode = reloaded.speed_mode;
+                    base_speed_multiplier = reloaded.speed_multiplier;
+                    fast_forward_multiplier = reloaded.speed_multiplier > 1 ? reloaded.speed_multiplier : 4;
+                    std::cout << "Reloaded " << config_file << std::endl;
+                } catch (const FatalError& error) {
+                    std::cerr << "Keeping the previous configuration: " << error.what() << std::endl;
+                }
             }
         }
 
         // Renderiza o frame atual
-        {
-            std::lock_guard<std::mutex> lock(video_mutex);
-            if (frame_updated) {
+        if (video_output.frame_updated.exchange(false)) {
+            const FrameBuffer* frame = video_output.completed_frame;
+            if (gl_display) {
+                gl_display->show(frame->front());
+            } else {
                 SDL_UpdateTexture(
                     texture,
                     NULL,
-                    current_frame_buffer.data(),
-                    160 * 3
+                    frame->front(),
+                    static_cast<int>(frame->pitch())
                 );
 
                 SDL_RenderClear(renderer);
                 SDL_RenderCopy(renderer, texture, NULL, NULL);
                 SDL_RenderPresent(renderer);
-                
-                frame_updated = false;
             }
         }
 
@@ -488,13 +573,25 @@ int main(int argc, char* argv[]) {
 
     std::cout << "Emulator thread joined" << std::endl;
 
-    // Salva o RAM do cartucho
-    if (!rom_data.empty()) {
+    if (options.print_profile) { std::cerr << gameboy.profile().report(); }
+
+    if (!options.record_movie.empty()) {
+        write_bytes_to_file(options.record_movie, gameboy.finish_movie_recording());
+    }
+
+    // Salva o RAM do cartucho: o que ainda não foi gravado em segundo plano
+    if (battery) {
+        std::cout << "Saving cartridge RAM" << std::endl;
+        if (!battery->finish(gameboy.get_battery_data())) {
+            std::cerr << "Failed to save cartridge RAM to " << save_filename << std::endl;
+        }
+    } else if (!gameboy.get_cartridge_ram().empty()) {
         std::cout << "Saving cartridge RAM" << std::endl;
-        write_bytes_to_file(save_filename, gameboy.get_cartridge_ram());
+        write_bytes_to_file(save_filename, gameboy.get_battery_data());
     }
 
     // Limpa os recursos do SDL
+    gl_display.reset();
     SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
@@ -60,9 +60,12 @@ static void set_large_pixel(uint x, uint y, sf::Color color) {
 }
 
 static void set_pixels(const FrameBuffer& buffer) {
+    /* The frame buffer is in PixelFormat::Index8: one Color per byte */
+    const u8* pixels = buffer.front();
+
     for (uint y = 0; y < GAMEBOY_HEIGHT; y++) {
         for (uint x = 0; x < GAMEBOY_WIDTH; x++) {
-            Color color = buffer.get_pixel(x, y);
+            auto color = static_cast<Color>(pixels[y * buffer.pitch() + x]);
             sf::Color pixel_color = get_real_color(color);
 
             set_large_pixel(x, y, pixel_color);
@@ -96,7 +99,7 @@ static std::vector<u8> load_state() {
     if (!file_exists(filename)) {
         return {};
     } else {
-        auto save_data = read_bytes(filename);
+        auto save_data = unpack_save(read_bytes(filename), filename);
         log_info("Read %d KB from %s", save_data.size() / 1024, filename.c_str());
         return save_data;
     }
@@ -149,7 +152,7 @@ static bool is_closed() {
     return !window->isOpen() || should_exit;
 }
 
-int main(int argc, char* argv[]) {
+static auto run_gameboy(int argc, char* argv[]) -> int {
     cliOptions = get_cli_options(argc, argv);
 
     window = std::make_unique<sf::RenderWindow>(sf::VideoMode(width, height), "gbemu", sf::Style::Titlebar | sf::Style::Close);
@@ -159,13 +162,23 @@ int main(int argc, char* argv[]) {
     window->setKeyRepeatEnabled(false);
     window->display();
 
-    auto rom_data = read_bytes(cliOptions.filename);
-    log_info("Read %d KB from %s", rom_data.size() / 1024, cliOptions.filename.c_str());
+    auto rom = RomImage::load_file(cliOptions.filename);
+    log_info("Mapped %d KB from %s", rom->size() / 1024, cliOptions.filename.c_str());
 
     auto save_data = load_state();
     log_info("");
 
-    gameboy = std::make_unique<Gameboy>(rom_data, cliOptions.options, save_data);
+    cliOptions.options.pixel_format = PixelFormat::Index8;
+    gameboy = std::make_unique<Gameboy>(rom, cliOptions.options, save_data);
     gameboy->run(&is_closed, &draw);
-    return 0;
+    return gameboy->failed() ? 1 : 0;
+}
+
+int main(int argc, char* argv[]) {
+    /* Fatal errors are logged where they happen */
+    try {
+        return run_gameboy(argc, argv);
+    } catch (const FatalError&) {
+        return 1;
+    }
 }
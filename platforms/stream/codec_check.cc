@@ -0,0 +1,171 @@
+#include "codec_check.h"
+#include "frame_codec.h"
+
+#include "../../src/gameboy_prelude.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+const size_t PACKED_SIZE = GAMEBOY_WIDTH * GAMEBOY_HEIGHT / 4;
+
+/* Half a minute of play, long enough to get past most title screens */
+const uint ROM_FRAMES = 60 * 30;
+
+/* How often the client asks for a keyframe, out of step with the buttons */
+const uint KEYFRAME_INTERVAL = 97;
+
+/*
+ * One end of the wire each: what the server last sent, and what the
+ * client has decoded. They must always be the same.
+ */
+struct Connection {
+    std::vector<u8> previous;
+    std::vector<u8> client;
+    std::vector<u8> encoded;
+};
+
+/* Empty if they match; otherwise where they first don't */
+auto compare(const std::vector<u8>& actual, const std::vector<u8>& expected) -> std::string {
+    if (actual.size() != expected.size()) { return "decoded to the wrong size"; }
+
+    auto mismatch = std::mismatch(actual.begin(), actual.end(), expected.begin());
+    if (mismatch.first == actual.end()) { return ""; }
+
+    char reason[64];
+    snprintf(reason, sizeof(reason), "byte %zu decoded as %02x, expected %02x",
+             static_cast<size_t>(mismatch.first - actual.begin()), *mismatch.first, *mismatch.second);
+    return reason;
+}
+
+/* Sends a packed frame over the connection, as queue_frame() does */
+auto send(Connection& connection, const std::vector<u8>& packed) -> std::string {
+    bool keyframe = connection.previous.empty();
+
+    connection.encoded.clear();
+    frame_codec::encode_frame(packed, connection.previous, connection.encoded);
+    connection.previous = packed;
+
+    if (keyframe) { connection.client.assign(packed.size(), 0); }
+    if (!frame_codec::decode_frame(connection.encoded.data(), connection.encoded.size(), connection.client)) {
+        return "refused by the decoder";
+    }
+    return compare(connection.client, packed);
+}
+
+auto noise(uint seed) -> std::vector<u8> {
+    std::vector<u8> packed(PACKED_SIZE);
+    u32 state = seed * 2654435761u + 1;
+    for (u8& byte : packed) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        byte = static_cast<u8>(state);
+    }
+    return packed;
+}
+
+/* Runs of every length from 1 up, across the shortest run worth encoding
+ * and the longest a chunk holds */
+auto stripes() -> std::vector<u8> {
+    std::vector<u8> packed;
+    for (uint length = 1; packed.size() < PACKED_SIZE; length++) {
+        packed.insert(packed.end(), std::min<size_t>(length, PACKED_SIZE - packed.size()), static_cast<u8>(length));
+    }
+    return packed;
+}
+
+auto report(const std::string& name, const std::string& failure) -> bool {
+    printf("%s  %-32s%s%s\n", failure.empty() ? "PASS" : "FAIL", name.c_str(),
+           failure.empty() ? "" : "  ", failure.c_str());
+    return failure.empty();
+}
+
+/* In order over one connection, so each is encoded against the one before */
+auto run_made_up_frames() -> bool {
+    bool passed = true;
+    Connection connection;
+
+    std::vector<u8> changed = noise(1);
+    changed.back() ^= 0x1;
+
+    std::vector<std::pair<std::string, std::vector<u8>>> frames = {
+        {"zeroes", std::vector<u8>(PACKED_SIZE, 0)},
+        {"zeroes again", std::vector<u8>(PACKED_SIZE, 0)},
+        {"noise", noise(1)},
+        {"noise with its last byte changed", changed},
+        {"stripes", stripes()},
+        {"noise after stripes", noise(2)},
+    };
+    for (const auto& frame : frames) {
+        passed &= report("codec " + frame.first, send(connection, frame.second));
+    }
+
+    /* The last frame sent, with its data cut short or run past its end */
+    std::vector<u8> encoded = connection.encoded;
+    std::vector<u8> scratch(PACKED_SIZE, 0);
+    bool short_refused = !frame_codec::decode_frame(encoded.data(), encoded.size() - 1, scratch);
+    passed &= report("codec refuses a short frame", short_refused ? "" : "decoded anyway");
+
+    encoded.push_back(0x80);
+    encoded.push_back(0x00);
+    bool long_refused = !frame_codec::decode_frame(encoded.data(), encoded.size(), scratch);
+    passed &= report("codec refuses a long frame", long_refused ? "" : "decoded anyway");
+
+    return passed;
+}
+
+auto run_rom_frames(const std::string& rom_file, Options options) -> bool {
+    options.pixel_format = PixelFormat::Index8;
+    Gameboy gameboy(RomImage::load_file(rom_file), options);
+
+    Connection connection;
+    std::vector<u8> packed;
+    size_t encoded_bytes = 0;
+    uint sent = 0;
+    std::string failure;
+
+    for (uint frame = 0; frame < ROM_FRAMES && failure.empty(); frame++) {
+        /* Start now and then, A a lot, to get the game going */
+        u8 buttons = frame % 120 < 5 ? button_bit(GbButton::Start)
+                   : frame % 20 < 10 ? button_bit(GbButton::A) : 0;
+        gameboy.set_buttons(buttons);
+
+        StepResult step = gameboy.run_frame();
+        if (step.stopped) {
+            failure = "the ROM stopped: " + gameboy.error();
+            break;
+        }
+        if (step.frame == nullptr) { continue; }
+
+        if (frame % KEYFRAME_INTERVAL == 0) { connection.previous.clear(); }
+        frame_codec::pack_frame(*step.frame, packed);
+        failure = send(connection, packed);
+        encoded_bytes += connection.encoded.size();
+        sent++;
+
+        /* Unpacked, the client's copy must be the frame itself */
+        const u8* pixels = step.frame->front();
+        for (uint i = 0; i < GAMEBOY_WIDTH * GAMEBOY_HEIGHT && failure.empty(); i++) {
+            uint shade = connection.client[i / 4] >> (6 - i % 4 * 2) & 0x3;
+            if (shade != (pixels[i] & 0x3u)) { failure = "pixel " + std::to_string(i) + " unpacked wrong"; }
+        }
+    }
+
+    bool passed = report("codec " + rom_file, failure);
+    if (sent > 0) {
+        printf("      %u frames, %zu bytes each on average, of %zu packed\n", sent, encoded_bytes / sent, PACKED_SIZE);
+    }
+    return passed;
+}
+
+} // namespace
+
+auto run_codec_checks(const std::string& rom_file, const Options& options) -> bool {
+    bool passed = run_made_up_frames();
+    if (!rom_file.empty()) { passed &= run_rom_frames(rom_file, options); }
+    return passed;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "../../src/definitions.h"
+#include "../../src/options.h"
+
+#include <string>
+
+/*
+ * gbemu-stream --self-test: every frame is encoded as the server would
+ * send it (see frame_codec.h) and decoded as a client would, then has to
+ * come out as it went in. The frames are made up ones which hit the
+ * encoder's edge cases, then, given a ROM, those it draws over some
+ * seconds of play with a keyframe asked for now and then. Data cut short
+ * or run past the frame's end must be refused.
+ *
+ * Prints a line for each check, and returns true if all of them passed.
+ */
+auto run_codec_checks(const std::string& rom_file, const Options& options) -> bool;
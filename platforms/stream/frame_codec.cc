@@ -0,0 +1,104 @@
+#include "frame_codec.h"
+
+#include "../../src/video/framebuffer.h"
+#include "../../src/util/log.h"
+
+namespace frame_codec {
+
+namespace {
+
+const uint MAX_CHUNK = 0x80;
+const u8 RUN_FLAG = 0x80;
+
+/* Runs shorter than this cost no less as part of a literal */
+const uint MIN_RUN = 3;
+
+void flush_literal(const u8* start, uint length, std::vector<u8>& out) {
+    while (length > 0) {
+        uint chunk = length < MAX_CHUNK ? length : MAX_CHUNK;
+        out.push_back(static_cast<u8>(chunk - 1));
+        out.insert(out.end(), start, start + chunk);
+        start += chunk;
+        length -= chunk;
+    }
+}
+
+} // namespace
+
+void pack_frame(const FrameBuffer& frame, std::vector<u8>& packed) {
+    if (frame.format() != PixelFormat::Index8) {
+        fatal_error("Streamed frames must be in the Index8 pixel format");
+    }
+
+    uint width = frame.width();
+    uint height = frame.height();
+    packed.assign(width * height / 4, 0);
+
+    const u8* pixels = frame.front();
+    u8* out = packed.data();
+
+    for (uint i = 0; i < width * height; i += 4) {
+        *out++ = static_cast<u8>((pixels[i] & 0x3) << 6 | (pixels[i + 1] & 0x3) << 4 |
+                                 (pixels[i + 2] & 0x3) << 2 | (pixels[i + 3] & 0x3));
+    }
+}
+
+void encode_frame(const std::vector<u8>& packed, const std::vector<u8>& previous, std::vector<u8>& out) {
+    bool keyframe = previous.size() != packed.size();
+    std::vector<u8> delta(packed);
+
+    if (!keyframe) {
+        for (size_t i = 0; i < delta.size(); i++) { delta[i] ^= previous[i]; }
+    }
+
+    const u8* data = delta.data();
+    size_t size = delta.size();
+    size_t literal_start = 0;
+    size_t i = 0;
+
+    while (i < size) {
+        size_t run = 1;
+        while (i + run < size && run < MAX_CHUNK && data[i + run] == data[i]) { run++; }
+
+        if (run < MIN_RUN) {
+            i += run;
+            continue;
+        }
+
+        flush_literal(data + literal_start, static_cast<uint>(i - literal_start), out);
+        out.push_back(static_cast<u8>(RUN_FLAG | (run - 1)));
+        out.push_back(data[i]);
+
+        i += run;
+        literal_start = i;
+    }
+
+    flush_literal(data + literal_start, static_cast<uint>(size - literal_start), out);
+}
+
+auto decode_frame(const u8* data, size_t size, std::vector<u8>& packed) -> bool {
+    size_t in = 0;
+    size_t at = 0;
+
+    while (in < size) {
+        u8 control = data[in++];
+        size_t length = (control & ~RUN_FLAG) + 1u;
+
+        if (at + length > packed.size()) { return false; }
+
+        if (control & RUN_FLAG) {
+            if (in >= size) { return false; }
+
+            u8 value = data[in++];
+            for (size_t i = 0; i < length; i++) { packed[at++] ^= value; }
+        } else {
+            if (in + length > size) { return false; }
+
+            for (size_t i = 0; i < length; i++) { packed[at++] ^= data[in++]; }
+        }
+    }
+
+    return at == packed.size();
+}
+
+} // namespace frame_codec
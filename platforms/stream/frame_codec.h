@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../../src/definitions.h"
+
+#include <cstddef>
+#include <vector>
+
+class FrameBuffer;
+
+/*
+ * Frames go over the wire as 2-bit shade indices, four pixels to a byte
+ * with the leftmost in the top bits, so a whole 160x144 frame packs into
+ * 5760 bytes.
+ *
+ * Each packed frame is XORed with the previous one sent on the same
+ * connection (with zeroes for a keyframe) and the result run-length
+ * encoded as a sequence of chunks, each starting with a control byte n:
+ *
+ *   n < 0x80   the next n + 1 bytes are literal
+ *   n >= 0x80  the next byte repeats (n & 0x7F) + 1 times
+ *
+ * A frame which barely changed is mostly zero after the XOR, so it comes
+ * down to a handful of 2-byte runs.
+ */
+namespace frame_codec {
+
+/* Packs a frame in PixelFormat::Index8 into 2-bit indices */
+void pack_frame(const FrameBuffer& frame, std::vector<u8>& packed);
+
+/* Appends 'packed' encoded against 'previous' to 'out'. An empty
+ * 'previous' makes a keyframe */
+void encode_frame(const std::vector<u8>& packed, const std::vector<u8>& previous, std::vector<u8>& out);
+
+/* Applies an encoded frame to 'packed', which holds the previous frame
+ * (or zeroes, for a keyframe) and has the packed frame's size. Returns
+ * false if the data is malformed */
+auto decode_frame(const u8* data, size_t size, std::vector<u8>& packed) -> bool;
+
+} // namespace frame_codec
@@ -0,0 +1,463 @@
+#include "../../src/gameboy_prelude.h"
+#include "../../src/command_line.h"
+#include "../../src/config.h"
+#include "codec_check.h"
+#include "frame_codec.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*
+ * Serves headless sessions of one ROM over TCP, one session per connection.
+ *
+ * Every message either way is a type byte, then the payload's length as a
+ * little-endian u32, then the payload. The server sends:
+ *
+ *   HELLO  once, on connecting: u8 protocol version, u8 width, u8 height,
+ *          u32 audio sample rate
+ *   FRAME  every frame drawn: u32 frame number, u8 flags (bit 0 set for a
+ *          keyframe), u32 size of the encoded frame (see frame_codec.h),
+ *          the encoded frame, then the audio mixed since the last FRAME as
+ *          interleaved (left, right) signed 16-bit samples for the rest of the payload
+ *
+ * and the client sends:
+ *
+ *   BUTTONS  u8 mask of the buttons held (see button_bit)
+ *   KEYFRAME  empty, asks for the next frame to be a keyframe
+ *
+ * Everything runs on one thread with non-blocking sockets. A client which
+ * can't keep up doesn't hold the others back: while too much is queued for
+ * it, its session goes on running without drawing, and the first frame it
+ * gets afterwards is encoded against the last one it was sent. Sockets are
+ * opened with SO_REUSEPORT, so several servers can share a port to spread
+ * sessions over more cores.
+ */
+
+namespace {
+
+const u8 PROTOCOL_VERSION = 1;
+
+const u8 MESSAGE_HELLO = 0x01;
+const u8 MESSAGE_FRAME = 0x02;
+const u8 MESSAGE_BUTTONS = 0x81;
+const u8 MESSAGE_KEYFRAME = 0x82;
+
+const uint MESSAGE_HEADER_SIZE = 5;
+const u8 FRAME_FLAG_KEYFRAME = 0x1;
+
+/* More than this much unsent and a session stops drawing for its client */
+const size_t MAX_QUEUED_BYTES = 64 * 1024;
+
+/* Clients have no business sending more than a few bytes at a time */
+const size_t MAX_RECEIVED_BYTES = 4 * 1024;
+
+/* Falling further behind than this drops the frames instead of catching up */
+const uint MAX_FRAMES_BEHIND = 4;
+
+const double FRAME_RATE = 59.73;
+
+/* Audio held for a client which isn't being sent frames: a quarter of a
+ * second at the highest sample rate, older samples are dropped */
+const size_t MAX_HELD_SAMPLES = 48000 / 4 * 2;
+
+struct StreamConfig {
+    Options options;
+    std::string rom_file;
+    uint port = 8765;
+    uint max_sessions = 256;
+};
+
+struct Session {
+    int socket = -1;
+    Options options;
+    std::unique_ptr<Gameboy> gameboy;
+
+    std::vector<u8> incoming;
+    std::vector<u8> outgoing;
+    size_t sent = 0;
+
+    /* The last frame sent, packed; empty until the first, or when a
+     * keyframe was asked for */
+    std::vector<u8> previous_frame;
+    std::vector<int16_t> audio;
+
+    /* Frames run so far, drawn or not */
+    u64 frames = 0;
+
+    bool closed = false;
+
+    auto queued() const -> size_t { return outgoing.size() - sent; }
+};
+
+void usage() {
+    fatal_error("usage: gbemu-stream [--port=N] [--max-sessions=N] [--sample-rate=N] [--frame-skip=N] "
+                "[--run-ahead=N] [--skip-idle-loops] [--no-block-cache] [--mute-audio] [--config=FILE] <rom_file>\n"
+                "       gbemu-stream --self-test [rom_file]");
+}
+
+void put_u32(std::vector<u8>& out, u32 value) {
+    for (uint i = 0; i < 4; i++) { out.push_back(static_cast<u8>(value >> (8 * i))); }
+}
+
+/* Appends a message header and returns where its length goes, to be
+ * filled in by finish_message() */
+auto start_message(std::vector<u8>& out, u8 type) -> size_t {
+    out.push_back(type);
+    size_t at = out.size();
+    put_u32(out, 0);
+    return at;
+}
+
+void finish_message(std::vector<u8>& out, size_t length_at) {
+    auto length = static_cast<u32>(out.size() - length_at - 4);
+    for (uint i = 0; i < 4; i++) { out[length_at + i] = static_cast<u8>(length >> (8 * i)); }
+}
+
+auto set_non_blocking(int socket) -> bool {
+    int flags = fcntl(socket, F_GETFL, 0);
+    return flags != -1 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+auto listen_on(uint port) -> int {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener == -1) { fatal_error("Cannot create socket: %s", strerror(errno)); }
+
+    int yes = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+#ifdef SO_REUSEPORT
+    setsockopt(listener, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes));
+#endif
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(static_cast<u16>(port));
+
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1) {
+        fatal_error("Cannot listen on port %u: %s", port, strerror(errno));
+    }
+    if (listen(listener, SOMAXCONN) == -1 || !set_non_blocking(listener)) {
+        fatal_error("Cannot listen on port %u: %s", port, strerror(errno));
+    }
+
+    return listener;
+}
+
+class StreamServer {
+public:
+    explicit StreamServer(const StreamConfig& config)
+        : config(config),
+          rom(RomImage::load_file(config.rom_file)),
+          listener(listen_on(config.port))
+    {
+        fprintf(stderr, "Streaming %s on port %u\n", config.rom_file.c_str(), config.port);
+    }
+
+    ~StreamServer() {
+        for (auto& session : sessions) { close(session->socket); }
+        close(listener);
+    }
+
+    void run() {
+        using clock = std::chrono::steady_clock;
+        const auto frame_time = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / FRAME_RATE));
+        auto next_frame = clock::now();
+
+        while (true) {
+            auto now = clock::now();
+            if (now >= next_frame) {
+                run_frame();
+                next_frame += frame_time;
+                if (now - next_frame > frame_time * MAX_FRAMES_BEHIND) { next_frame = now + frame_time; }
+            }
+
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next_frame - clock::now());
+            poll_sockets(static_cast<int>(std::max<long long>(0, wait.count())));
+            drop_closed();
+        }
+    }
+
+private:
+    void run_frame() {
+        for (auto& session : sessions) {
+            if (session->closed) { continue; }
+
+            StepResult step = session->gameboy->run_frame();
+            if (step.stopped) {
+                fprintf(stderr, "Session on socket %d stopped: %s\n", session->socket, session->gameboy->error().c_str());
+                session->closed = true;
+                continue;
+            }
+
+            session->frames += step.frames;
+            queue_audio(*session, step);
+            if (step.frame) { queue_frame(*session, *step.frame, session->frames - 1); }
+            send_queued(*session);
+        }
+    }
+
+    void queue_audio(Session& session, const StepResult& step) {
+        for (uint i = 0; i < step.audio_frames * 2; i++) {
+            float sample = std::max(-1.0f, std::min(1.0f, step.audio[i]));
+            session.audio.push_back(static_cast<int16_t>(std::lround(sample * 32767.0f)));
+        }
+
+        if (session.audio.size() > MAX_HELD_SAMPLES) {
+            session.audio.erase(session.audio.begin(), session.audio.end() - static_cast<long>(MAX_HELD_SAMPLES));
+        }
+    }
+
+    void queue_frame(Session& session, const FrameBuffer& frame, u64 frame_number) {
+        frame_codec::pack_frame(frame, packed);
+
+        bool keyframe = session.previous_frame.empty();
+        std::vector<u8>& out = session.outgoing;
+
+        size_t length_at = start_message(out, MESSAGE_FRAME);
+        put_u32(out, static_cast<u32>(frame_number));
+        out.push_back(keyframe ? FRAME_FLAG_KEYFRAME : 0);
+
+        size_t size_at = out.size();
+        put_u32(out, 0);
+        frame_codec::encode_frame(packed, session.previous_frame, out);
+        finish_message(out, size_at);
+
+        for (int16_t sample : session.audio) {
+            out.push_back(static_cast<u8>(sample));
+            out.push_back(static_cast<u8>(static_cast<u16>(sample) >> 8));
+        }
+        finish_message(out, length_at);
+
+        session.audio.clear();
+        session.previous_frame.swap(packed);
+    }
+
+    void send_queued(Session& session) {
+        while (session.queued() > 0) {
+            ssize_t sent = send(session.socket, session.outgoing.data() + session.sent, session.queued(), MSG_NOSIGNAL);
+            if (sent > 0) {
+                session.sent += static_cast<size_t>(sent);
+                continue;
+            }
+            if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) { break; }
+
+            session.closed = true;
+            return;
+        }
+
+        if (session.queued() == 0) {
+            session.outgoing.clear();
+            session.sent = 0;
+        }
+    }
+
+    void receive(Session& session) {
+        u8 buffer[512];
+
+        while (true) {
+            ssize_t received = recv(session.socket, buffer, sizeof(buffer), 0);
+            if (received > 0) {
+                session.incoming.insert(session.incoming.end(), buffer, buffer + received);
+                continue;
+            }
+            if (received == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) { break; }
+
+            /* Closed by the client, or failed */
+            session.closed = true;
+            return;
+        }
+
+        handle_messages(session);
+    }
+
+    void handle_messages(Session& session) {
+        const std::vector<u8>& in = session.incoming;
+        size_t at = 0;
+
+        while (in.size() - at >= MESSAGE_HEADER_SIZE) {
+            u32 length = static_cast<u32>(in[at + 1] | in[at + 2] << 8 | in[at + 3] << 16) | static_cast<u32>(in[at + 4]) << 24;
+            if (length > MAX_RECEIVED_BYTES) {
+                session.closed = true;
+                return;
+            }
+            if (in.size() - at - MESSAGE_HEADER_SIZE < length) { break; }
+
+            const u8* payload = &in[at + MESSAGE_HEADER_SIZE];
+            switch (in[at]) {
+                case MESSAGE_BUTTONS:
+                    if (length >= 1) { set_buttons(session, payload[0]); }
+                    break;
+                case MESSAGE_KEYFRAME:
+                    session.previous_frame.clear();
+                    break;
+                default:
+                    /* Unknown messages are skipped, for newer clients */
+                    break;
+            }
+
+            at += MESSAGE_HEADER_SIZE + length;
+        }
+
+        if (in.size() - at > MAX_RECEIVED_BYTES) {
+            session.closed = true;
+            return;
+        }
+        session.incoming.erase(session.incoming.begin(), session.incoming.begin() + static_cast<long>(at));
+    }
+
+    static void set_buttons(Session& session, u8 mask) {
+        for (uint i = 0; i < 8; i++) {
+            auto button = static_cast<GbButton>(i);
+            if (mask & button_bit(button)) { session.gameboy->button_pressed(button); }
+            else { session.gameboy->button_released(button); }
+        }
+    }
+
+    void accept_clients() {
+        while (true) {
+            int client = accept(listener, nullptr, nullptr);
+            if (client == -1) { return; }
+
+            if (sessions.size() >= config.max_sessions || !set_non_blocking(client)) {
+                close(client);
+                continue;
+            }
+
+            int yes = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+            try {
+                sessions.push_back(start_session(client));
+                fprintf(stderr, "Session started on socket %d (%zu running)\n", client, sessions.size());
+            } catch (const FatalError&) {
+                /* Already logged */
+                close(client);
+            }
+        }
+    }
+
+    auto start_session(int client) -> std::unique_ptr<Session> {
+        auto session = std::make_unique<Session>();
+        session->socket = client;
+        session->options = config.options;
+        session->gameboy = std::make_unique<Gameboy>(rom, session->options);
+
+        /* Nothing is drawn for a client which isn't keeping up. The filter
+         * takes over from the options' frame skipping, so it does that too */
+        Session* owner = session.get();
+        uint skip = config.options.frame_skip;
+        session->gameboy->set_frame_filter([owner, skip](u64 frame) {
+            return owner->queued() <= MAX_QUEUED_BYTES && frame % (skip + 1) == 0;
+        });
+
+        std::vector<u8>& out = session->outgoing;
+        size_t length_at = start_message(out, MESSAGE_HELLO);
+        out.push_back(PROTOCOL_VERSION);
+        out.push_back(static_cast<u8>(GAMEBOY_WIDTH));
+        out.push_back(static_cast<u8>(GAMEBOY_HEIGHT));
+        put_u32(out, config.options.mute_audio ? 0 : config.options.audio_sample_rate);
+        finish_message(out, length_at);
+
+        return session;
+    }
+
+    void poll_sockets(int timeout_ms) {
+        poll_fds.clear();
+        poll_fds.push_back({listener, POLLIN, 0});
+        for (auto& session : sessions) {
+            short events = POLLIN;
+            if (session->queued() > 0) { events |= POLLOUT; }
+            poll_fds.push_back({session->socket, events, 0});
+        }
+
+        if (poll(poll_fds.data(), static_cast<nfds_t>(poll_fds.size()), timeout_ms) <= 0) { return; }
+
+        for (size_t i = 0; i < sessions.size(); i++) {
+            short events = poll_fds[i + 1].revents;
+            Session& session = *sessions[i];
+
+            if (events & (POLLIN | POLLHUP | POLLERR)) { receive(session); }
+            if (!session.closed && (events & POLLOUT)) { send_queued(session); }
+        }
+
+        if (poll_fds[0].revents & POLLIN) { accept_clients(); }
+    }
+
+    void drop_closed() {
+        auto closed = std::remove_if(sessions.begin(), sessions.end(), [](const std::unique_ptr<Session>& session) {
+            if (!session->closed) { return false; }
+
+            close(session->socket);
+            return true;
+        });
+
+        if (closed == sessions.end()) { return; }
+
+        sessions.erase(closed, sessions.end());
+        fprintf(stderr, "Session ended (%zu running)\n", sessions.size());
+    }
+
+    StreamConfig config;
+    std::shared_ptr<const RomImage> rom;
+    int listener;
+
+    std::vector<std::unique_ptr<Session>> sessions;
+    std::vector<pollfd> poll_fds;
+
+    /* Scratch for the frame being sent */
+    std::vector<u8> packed;
+};
+
+auto run_server(int argc, char* argv[]) -> int {
+    StreamConfig config;
+    config.options.headless = true;
+    config.options.disable_logs = true;
+    config.options.speed_mode = SpeedMode::Unthrottled;
+    config.options.pixel_format = PixelFormat::Index8;
+    bool self_test = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+
+        if (arg.rfind("--port=", 0) == 0) { config.port = flag_value(arg, "--port="); }
+        else if (arg.rfind("--max-sessions=", 0) == 0) { config.max_sessions = flag_value(arg, "--max-sessions="); }
+        else if (arg == "--self-test") { self_test = true; }
+        /* The emulator's own options, as in every frontend (see config.h) */
+        else if (arg.rfind("--", 0) == 0) { apply_flag(config.options, arg); }
+        else if (config.rom_file.empty()) { config.rom_file = arg; }
+        else { usage(); }
+    }
+
+    if (self_test) { return run_codec_checks(config.rom_file, config.options) ? 0 : 1; }
+    if (config.rom_file.empty() || config.port > 0xFFFF) { usage(); }
+
+    StreamServer server(config);
+    server.run();
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    /* Bad arguments, unreadable ROMs and unusable ports are reported where they're found */
+    try {
+        return run_server(argc, argv);
+    } catch (const FatalError&) {
+        return 1;
+    }
+}
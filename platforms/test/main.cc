@@ -1,18 +1,29 @@
 #include "../../src/gameboy_prelude.h"
 #include "../cli/cli.h"
 
-static std::unique_ptr<Gameboy> gameboy;
-
 static void draw(const FrameBuffer& buffer) {
 }
 
-static bool is_closed() {
-    return false;
-}
-
 int main(int argc, char* argv[]) {
-    CliOptions cliOptions = get_cli_options(argc, argv);
-    auto rom_data = read_bytes(cliOptions.filename);
-    gameboy = std::make_unique<Gameboy>(rom_data, cliOptions.options);
-    gameboy->run(&is_closed, &draw);
+    try {
+        CliOptions cliOptions = get_cli_options(argc, argv);
+        const Options& options = cliOptions.options;
+        Gameboy gameboy(RomImage::load_file(cliOptions.filename), cliOptions.options);
+
+        bool replaying = !options.play_movie.empty();
+        if (replaying && !gameboy.play_movie(read_bytes(options.play_movie))) { return 1; }
+        if (!options.record_movie.empty()) { gameboy.start_movie_recording(); }
+
+        /* A replayed session ends with its movie */
+        gameboy.run([&gameboy, replaying]() { return replaying && !gameboy.playing_movie(); }, &draw);
+
+        if (!options.record_movie.empty()) {
+            write_bytes(options.record_movie, gameboy.finish_movie_recording());
+        }
+        if (cliOptions.options.print_profile) { fprintf(stderr, "%s", gameboy.profile().report().c_str()); }
+        return gameboy.failed() ? 1 : 0;
+    } catch (const FatalError&) {
+        /* Already logged */
+        return 1;
+    }
 }
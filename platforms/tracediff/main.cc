@@ -0,0 +1,155 @@
+#include "../../src/gameboy_prelude.h"
+#include "../../src/trace_file.h"
+#include "../../src/cpu/opcode_names.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+
+/* Exit codes, as for diff(1) */
+static const int TRACES_MATCH = 0;
+static const int TRACES_DIFFER = 1;
+static const int TRACE_ERROR = 2;
+
+static void usage() {
+    fatal_error("usage: gbemu-tracediff [--context=N] <trace_a> <trace_b>");
+}
+
+static auto same(const TraceRecord& a, const TraceRecord& b) -> bool {
+    return a.cycle == b.cycle && a.pc == b.pc && a.opcode == b.opcode && a.prefix == b.prefix
+        && a.af == b.af && a.bc == b.bc && a.de == b.de && a.hl == b.hl && a.sp == b.sp;
+}
+
+static void print_record(const char* label, u64 index, const TraceRecord& record) {
+    const char* name = record.prefix == 0xCB ? opcode_cb_names[record.opcode] : opcode_names[record.opcode];
+    printf("%s %12llu  %14llu  %04X  %-16s AF=%04X BC=%04X DE=%04X HL=%04X SP=%04X\n",
+           label,
+           static_cast<unsigned long long>(index),
+           static_cast<unsigned long long>(record.cycle),
+           record.pc,
+           name,
+           record.af, record.bc, record.de, record.hl, record.sp);
+}
+
+static void print_differences(const TraceRecord& a, const TraceRecord& b) {
+    std::string fields;
+    auto check = [&fields](bool differs, const char* name) {
+        if (!differs) { return; }
+        if (!fields.empty()) { fields += ", "; }
+        fields += name;
+    };
+
+    check(a.cycle != b.cycle, "cycle");
+    check(a.pc != b.pc, "pc");
+    check(a.opcode != b.opcode || a.prefix != b.prefix, "opcode");
+    check(a.af != b.af, "af");
+    check(a.bc != b.bc, "bc");
+    check(a.de != b.de, "de");
+    check(a.hl != b.hl, "hl");
+    check(a.sp != b.sp, "sp");
+    printf("Differs in: %s\n", fields.c_str());
+}
+
+/* Decodes a block pair known to differ, after filling the context from the
+ * block before it (which matched, so only one side is needed) */
+static auto find_divergence(TraceReader a, TraceReader b, TraceReader* previous,
+                            u64 index, uint context_size) -> int {
+    std::deque<std::pair<u64, TraceRecord>> context;
+    TraceRecord record_a = {};
+    TraceRecord record_b = {};
+
+    if (previous != nullptr) {
+        u64 previous_index = index - previous->block_record_count();
+        while (previous->next_record(record_a)) {
+            context.emplace_back(previous_index++, record_a);
+            if (context.size() > context_size) { context.pop_front(); }
+        }
+    }
+
+    while (true) {
+        bool has_a = a.next_record(record_a);
+        bool has_b = b.next_record(record_b);
+        if (!has_a && !has_b) { return TRACES_MATCH; }
+
+        if (has_a && has_b && same(record_a, record_b)) {
+            context.emplace_back(index++, record_a);
+            if (context.size() > context_size) { context.pop_front(); }
+            continue;
+        }
+
+        printf("          instruction           cycle    pc\n");
+        for (const auto& entry : context) { print_record("   ", entry.first, entry.second); }
+
+        if (!has_a || !has_b) {
+            print_record(has_a ? "a: " : "b: ", index, has_a ? record_a : record_b);
+            printf("Trace %s ends after %llu instructions\n", has_a ? "b" : "a", static_cast<unsigned long long>(index));
+        } else {
+            print_record("a: ", index, record_a);
+            print_record("b: ", index, record_b);
+            printf("First divergence at instruction %llu\n", static_cast<unsigned long long>(index));
+            print_differences(record_a, record_b);
+        }
+        return TRACES_DIFFER;
+    }
+}
+
+static auto diff_traces(int argc, char* argv[]) -> int {
+    uint context_size = 8;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+
+        if (arg.rfind("--context=", 0) == 0) { context_size = static_cast<uint>(std::max(0, std::atoi(arg.c_str() + 10))); }
+        else if (arg.rfind("--", 0) == 0) { fatal_error("Unknown flag: %s", arg.c_str()); }
+        else { files.push_back(arg); }
+    }
+
+    if (files.size() != 2) { usage(); }
+
+    /* Any regular file maps the same way as a ROM */
+    auto file_a = RomImage::map_file(files[0]);
+    auto file_b = RomImage::map_file(files[1]);
+
+    TraceReader a(file_a->data(), file_a->size());
+    TraceReader b(file_b->data(), file_b->size());
+
+    /* Blocks restart their delta encoding, so byte-identical blocks hold
+     * identical records and are skipped without decoding */
+    u64 index = 0;
+    TraceReader previous = a;
+    bool has_previous = false;
+
+    while (true) {
+        bool more_a = a.next_block();
+        bool more_b = b.next_block();
+
+        if (!more_a && !more_b) {
+            printf("Traces match (%llu instructions)\n", static_cast<unsigned long long>(index));
+            return TRACES_MATCH;
+        }
+
+        bool identical = more_a && more_b && a.block_size() == b.block_size()
+            && memcmp(a.block_data(), b.block_data(), a.block_size()) == 0;
+
+        if (!identical) {
+            int result = find_divergence(a, b, has_previous ? &previous : nullptr, index, context_size);
+            if (result != TRACES_MATCH) { return result; }
+        }
+
+        index += a.block_record_count();
+        previous = a;
+        has_previous = true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    /* Bad arguments and unreadable or corrupt traces are reported where they're found */
+    try {
+        return diff_traces(argc, argv);
+    } catch (const FatalError&) {
+        return TRACE_ERROR;
+    }
+}
@@ -1,16 +1,5 @@
 #include "address.h"
 
-Address::Address(u16 location) : addr(location) {
-}
-
-Address::Address(const RegisterPair& from) : addr(from.value()) {
-}
-
-Address::Address(const WordRegister& from) : addr(from.value()) {
-}
-
-auto Address::value() const -> u16 { return addr; }
-
 auto Address::in_range(Address low, Address high) const -> bool {
     return low.value() <= value() && value() <= high.value();
 }
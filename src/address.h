@@ -20,3 +20,12 @@ public:
 private:
     u16 addr = 0x0;
 };
+
+/* Inlined as every memory access constructs and unpacks an Address */
+inline Address::Address(u16 location) : addr(location) {}
+
+inline Address::Address(const RegisterPair& from) : addr(from.value()) {}
+
+inline Address::Address(const WordRegister& from) : addr(from.value()) {}
+
+inline auto Address::value() const -> u16 { return addr; }
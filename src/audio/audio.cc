@@ -2,7 +2,10 @@
 #include "../gameboy.h"
 #include "../util/log.h" // Make sure log.h is included
 #include "../util/bitwise.h"
+#include "../scheduler.h"
+#include "../save_state.h"
 #include <iostream>
+#include <algorithm>
 
 #include <cmath>
 #include <iomanip> // Required for std::hex manipulator
@@ -40,6 +43,89 @@ static const char* apu_reg_name(u16 addr) {
 }
 */
 
+namespace {
+
+// Padrões de duty (razão de trabalho), os mesmos nos dois canais de tom
+const std::array<std::array<bool, 8>, 4> DUTY_PATTERNS = {{
+    {false, false, false, false, false, false, false, true},  // 12.5%
+    {false, false, false, false, false, false, true, true},   // 25%
+    {false, false, false, false, true, true, true, true},     // 50%
+    {true, true, true, true, true, true, false, false}        // 75%
+}};
+
+// Divisores do canal de ruído (NR43 bits 0-2)
+const std::array<uint, 8> NOISE_DIVISORS = {8, 16, 32, 48, 64, 80, 96, 112};
+
+// Sem volume inicial nem aumento no NRx2, o DAC do canal fica desligado
+auto envelope_dac_on(u8 value) -> bool { return (value & 0xF8) != 0; }
+
+// Um passo do envelope de volume (passo 7 do frame sequencer, 64 Hz).
+// Com pace 0 o volume fica parado
+void step_envelope(u8& volume, u8& timer, u8 pace, bool increase) {
+    if (pace == 0) return;
+    if (timer > 1) {
+        timer--;
+        return;
+    }
+
+    timer = pace;
+    if (increase && volume < 15) {
+        volume++;
+    } else if (!increase && volume > 0) {
+        volume--;
+    }
+}
+
+// Clocks até o primeiro dos próximos passos da forma de onda em que
+// 'changes' diz que a saída muda, sem rodar o timer até lá: o primeiro passo
+// cai em 'timer' e os seguintes a cada 'period'
+template <typename Changes>
+auto clocks_until_change(uint timer, uint period, uint steps, const Changes& changes) -> uint {
+    for (uint step = 1; step < steps; step++) {
+        if (changes(step)) { return timer + (step - 1) * period; }
+    }
+    return NO_EVENT;
+}
+
+} // namespace
+
+void SoundChannel::save_state(ChannelState& state) const {
+    state.enabled = enabled;
+    state.dac_enabled = dac_enabled;
+    state.volume = volume;
+    state.length_counter = length_counter;
+    state.length_enabled = length_enabled;
+    state.timer = timer;
+}
+
+void SoundChannel::load_state(const ChannelState& state) {
+    enabled = state.enabled;
+    dac_enabled = state.dac_enabled;
+    volume = state.volume;
+    length_counter = state.length_counter;
+    length_enabled = state.length_enabled;
+    timer = state.timer;
+}
+
+void SoundChannel::clock_length() {
+    if (!length_enabled || length_counter == 0) return;
+
+    length_counter--;
+    if (length_counter == 0) { enabled = false; }
+}
+
+auto SoundChannel::run_timer(uint cycles, uint period) -> uint {
+    if (cycles < timer) {
+        timer -= cycles;
+        return 0;
+    }
+
+    // O primeiro período termina em 'timer', os outros a cada 'period'
+    cycles -= timer;
+    timer = period - cycles % period;
+    return 1 + cycles / period;
+}
+
 // Implementação do canal 1: Tone & Sweep
 ToneSweepChannel::ToneSweepChannel() {
     // Inicialização padrão
@@ -48,43 +134,96 @@ ToneSweepChannel::ToneSweepChannel() {
 void ToneSweepChannel::tick(uint cycles) {
     if (!enabled) return;
 
-    // Decrementa o timer
-    if (timer > cycles) {
-        timer -= cycles;
-    } else {
-        // Gera a próxima amostra quando o timer expira
-        duty_position = (duty_position + 1) % 8;
+    // Só a posição no ciclo de duty importa, então os passos vão de uma vez
+    duty_position = static_cast<u8>((duty_position + run_timer(cycles, timer_period())) % 8);
+}
 
-        // Recalcula o timer baseado na frequência
-        // Need to handle frequency potentially being 2048 (which would make timer 0)
-        uint freq_val = frequency;
-        if (freq_val > 2047) freq_val = 2047; // Avoid negative timer values
-        timer = (2048 - freq_val) * 4;
-        if (timer == 0) timer = 8192 * 4; // Handle frequency 2048 case? Check HW behaviour
+auto ToneSweepChannel::timer_period() const -> uint { return (2048 - frequency) * 4; }
+
+auto ToneSweepChannel::cycles_until_change() const -> uint {
+    if (!enabled || volume == 0) return NO_EVENT;
+
+    const std::array<bool, 8>& pattern = DUTY_PATTERNS[duty_pattern];
+    return clocks_until_change(timer, timer_period(), 8, [&](uint step) {
+        return pattern[(duty_position + step) % 8] != pattern[duty_position];
+    });
+}
+
+void ToneSweepChannel::clock_envelope() {
+    step_envelope(volume, envelope_timer, envelope_sweep_pace, envelope_increase);
+}
+
+void ToneSweepChannel::clock_sweep() {
+    if (sweep_timer > 1) {
+        sweep_timer--;
+        return;
     }
 
-    // TODO: Implementar lógica de sweep
-    // TODO: Implementar lógica de envelope
-    // TODO: Implementar lógica de contador de comprimento (length counter)
+    sweep_timer = sweep_time != 0 ? sweep_time : 8;
+    if (!enabled || !sweep_enabled || sweep_time == 0) return;
+
+    uint next = sweep_frequency();
+    if (next > 2047 || sweep_shift == 0) return;
+
+    shadow_frequency = next;
+    frequency = next;
+
+    // Calculada de novo só para checar o overflow, sem ser guardada
+    sweep_frequency();
+}
+
+auto ToneSweepChannel::sweep_frequency() -> uint {
+    uint delta = shadow_frequency >> sweep_shift;
+    uint next = sweep_decrease ? shadow_frequency - delta : shadow_frequency + delta;
+
+    // Desativa o canal se a frequência estiver fora dos limites
+    if (next > 2047) { enabled = false; }
+    return next;
 }
 
 
 float ToneSweepChannel::get_sample() const {
     if (!enabled) return 0.0f;
 
-    // Padrões de duty (razão de trabalho)
-    static const std::array<std::array<bool, 8>, 4> duty_patterns = {{
-        {false, false, false, false, false, false, false, true},  // 12.5%
-        {false, false, false, false, false, false, true, true},   // 25%
-        {false, false, false, false, true, true, true, true},     // 50%
-        {true, true, true, true, true, true, false, false}        // 75%
-    }};
-
     // Retorna a amostra atual baseada no padrão de duty
-    bool high = duty_patterns[duty_pattern][duty_position];
+    bool high = DUTY_PATTERNS[duty_pattern][duty_position];
     return high ? (float)volume / 15.0f : -((float)volume / 15.0f);
 }
 
+void ToneSweepChannel::save_state(ChannelState& state) const {
+    SoundChannel::save_state(state);
+    state.sweep_time = sweep_time;
+    state.sweep_decrease = sweep_decrease;
+    state.sweep_shift = sweep_shift;
+    state.sweep_timer = sweep_timer;
+    state.sweep_enabled = sweep_enabled;
+    state.shadow_frequency = shadow_frequency;
+    state.duty_pattern = duty_pattern;
+    state.position = duty_position;
+    state.envelope_initial_volume = envelope_initial_volume;
+    state.envelope_increase = envelope_increase;
+    state.envelope_sweep_pace = envelope_sweep_pace;
+    state.envelope_timer = envelope_timer;
+    state.frequency = frequency;
+}
+
+void ToneSweepChannel::load_state(const ChannelState& state) {
+    SoundChannel::load_state(state);
+    sweep_time = state.sweep_time;
+    sweep_decrease = state.sweep_decrease;
+    sweep_shift = state.sweep_shift;
+    sweep_timer = state.sweep_timer;
+    sweep_enabled = state.sweep_enabled;
+    shadow_frequency = state.shadow_frequency;
+    duty_pattern = state.duty_pattern;
+    duty_position = state.position;
+    envelope_initial_volume = state.envelope_initial_volume;
+    envelope_increase = state.envelope_increase;
+    envelope_sweep_pace = state.envelope_sweep_pace;
+    envelope_timer = state.envelope_timer;
+    frequency = state.frequency;
+}
+
 void ToneSweepChannel::set_sweep_register(u8 value) {
     sweep_time = (value >> 4) & 0x07;
     sweep_decrease = check_bit(value, 3);
@@ -101,9 +240,9 @@ void ToneSweepChannel::set_volume_envelope_register(u8 value) {
     envelope_increase = check_bit(value, 3);
     envelope_sweep_pace = value & 0x07;
 
-    // Atualiza o volume atual
-    volume = envelope_initial_volume;
-    // TODO: Initialize envelope timer based on sweep_pace
+    // O volume só é recarregado no trigger; desligar o DAC desliga o canal
+    dac_enabled = envelope_dac_on(value);
+    if (!dac_enabled) { enabled = false; }
 }
 
 void ToneSweepChannel::set_frequency_lo_register(u8 value) {
@@ -117,12 +256,10 @@ void ToneSweepChannel::set_frequency_hi_register(u8 value) {
 
     // Reinicia o canal se o bit 7 estiver definido
     if (check_bit(value, 7)) {
-        enabled = true; // Enable channel
+        // Com o DAC desligado o trigger não liga o canal
+        enabled = dac_enabled;
         // Reinicia o timer
-        uint freq_val = frequency;
-        if (freq_val > 2047) freq_val = 2047;
-        timer = (2048 - freq_val) * 4;
-        if (timer == 0) timer = 8192 * 4; // Handle frequency 2048 case?
+        timer = timer_period();
         // Reinicia o contador de comprimento se necessário
         if (length_counter == 0) {
             length_counter = 64;
@@ -131,33 +268,18 @@ void ToneSweepChannel::set_frequency_hi_register(u8 value) {
         duty_position = 0;
         // Reset envelope
         volume = envelope_initial_volume;
-        // TODO: Reset sweep timer/state
+        envelope_timer = envelope_sweep_pace;
+        // O sweep parte da frequência atual, e um shift já checa o overflow
+        shadow_frequency = frequency;
+        sweep_timer = sweep_time != 0 ? sweep_time : 8;
+        sweep_enabled = sweep_time != 0 || sweep_shift != 0;
+        if (sweep_shift != 0) { sweep_frequency(); }
     }
 
     // Habilita o contador de comprimento se o bit 6 estiver definido
     length_enabled = check_bit(value, 6);
 }
 
-void ToneSweepChannel::update_frequency() {
-    // Atualiza a frequência baseada nas configurações de sweep
-    // TODO: Implement sweep timing and frequency calculation
-    if (sweep_time > 0 && sweep_shift > 0) {
-        // Simplified placeholder - proper implementation needed
-        uint new_freq = frequency >> sweep_shift;
-
-        if (sweep_decrease) {
-            frequency -= new_freq;
-        } else {
-            frequency += new_freq;
-        }
-
-        // Desativa o canal se a frequência estiver fora dos limites
-        if (frequency > 2047) {
-            enabled = false;
-        }
-    }
-}
-
 // Implementação do canal 2: Tone
 ToneChannel::ToneChannel() {
     // Inicialização padrão
@@ -166,39 +288,55 @@ ToneChannel::ToneChannel() {
 void ToneChannel::tick(uint cycles) {
     if (!enabled) return;
 
-    // Decrementa o timer
-    if (timer > cycles) {
-        timer -= cycles;
-    } else {
-        // Gera a próxima amostra quando o timer expira
-        duty_position = (duty_position + 1) % 8;
+    // Só a posição no ciclo de duty importa, então os passos vão de uma vez
+    duty_position = static_cast<u8>((duty_position + run_timer(cycles, timer_period())) % 8);
+}
 
-        // Recalcula o timer baseado na frequência
-        uint freq_val = frequency;
-        if (freq_val > 2047) freq_val = 2047;
-        timer = (2048 - freq_val) * 4;
-        if (timer == 0) timer = 8192 * 4; // Handle frequency 2048 case?
-    }
-    // TODO: Implementar lógica de envelope
-    // TODO: Implementar lógica de contador de comprimento (length counter)
+auto ToneChannel::timer_period() const -> uint { return (2048 - frequency) * 4; }
+
+auto ToneChannel::cycles_until_change() const -> uint {
+    if (!enabled || volume == 0) return NO_EVENT;
+
+    const std::array<bool, 8>& pattern = DUTY_PATTERNS[duty_pattern];
+    return clocks_until_change(timer, timer_period(), 8, [&](uint step) {
+        return pattern[(duty_position + step) % 8] != pattern[duty_position];
+    });
+}
+
+void ToneChannel::clock_envelope() {
+    step_envelope(volume, envelope_timer, envelope_sweep_pace, envelope_increase);
 }
 
 float ToneChannel::get_sample() const {
     if (!enabled) return 0.0f;
 
-    // Padrões de duty (razão de trabalho)
-    static const std::array<std::array<bool, 8>, 4> duty_patterns = {{
-        {false, false, false, false, false, false, false, true},  // 12.5%
-        {false, false, false, false, false, false, true, true},   // 25%
-        {false, false, false, false, true, true, true, true},     // 50%
-        {true, true, true, true, true, true, false, false}        // 75%
-    }};
-
     // Retorna a amostra atual baseada no padrão de duty
-    bool high = duty_patterns[duty_pattern][duty_position];
+    bool high = DUTY_PATTERNS[duty_pattern][duty_position];
     return high ? (float)volume / 15.0f : -((float)volume / 15.0f);
 }
 
+void ToneChannel::save_state(ChannelState& state) const {
+    SoundChannel::save_state(state);
+    state.duty_pattern = duty_pattern;
+    state.position = duty_position;
+    state.envelope_initial_volume = envelope_initial_volume;
+    state.envelope_increase = envelope_increase;
+    state.envelope_sweep_pace = envelope_sweep_pace;
+    state.envelope_timer = envelope_timer;
+    state.frequency = frequency;
+}
+
+void ToneChannel::load_state(const ChannelState& state) {
+    SoundChannel::load_state(state);
+    duty_pattern = state.duty_pattern;
+    duty_position = state.position;
+    envelope_initial_volume = state.envelope_initial_volume;
+    envelope_increase = state.envelope_increase;
+    envelope_sweep_pace = state.envelope_sweep_pace;
+    envelope_timer = state.envelope_timer;
+    frequency = state.frequency;
+}
+
 void ToneChannel::set_length_duty_register(u8 value) {
     duty_pattern = (value >> 6) & 0x03;
     length_counter = 64 - (value & 0x3F);
@@ -209,9 +347,9 @@ void ToneChannel::set_volume_envelope_register(u8 value) {
     envelope_increase = check_bit(value, 3);
     envelope_sweep_pace = value & 0x07;
 
-    // Atualiza o volume atual
-    volume = envelope_initial_volume;
-    // TODO: Initialize envelope timer based on sweep_pace
+    // O volume só é recarregado no trigger; desligar o DAC desliga o canal
+    dac_enabled = envelope_dac_on(value);
+    if (!dac_enabled) { enabled = false; }
 }
 
 void ToneChannel::set_frequency_lo_register(u8 value) {
@@ -225,12 +363,10 @@ void ToneChannel::set_frequency_hi_register(u8 value) {
 
     // Reinicia o canal se o bit 7 estiver definido
     if (check_bit(value, 7)) {
-        enabled = true; // Enable channel
+        // Com o DAC desligado o trigger não liga o canal
+        enabled = dac_enabled;
         // Reinicia o timer
-        uint freq_val = frequency;
-        if (freq_val > 2047) freq_val = 2047;
-        timer = (2048 - freq_val) * 4;
-        if (timer == 0) timer = 8192 * 4; // Handle frequency 2048 case?
+        timer = timer_period();
         // Reinicia o contador de comprimento se necessário
         if (length_counter == 0) {
             length_counter = 64;
@@ -239,6 +375,7 @@ void ToneChannel::set_frequency_hi_register(u8 value) {
         duty_position = 0;
         // Reset envelope
         volume = envelope_initial_volume;
+        envelope_timer = envelope_sweep_pace;
     }
 
     // Habilita o contador de comprimento se o bit 6 estiver definido
@@ -254,20 +391,24 @@ WaveChannel::WaveChannel() {
 void WaveChannel::tick(uint cycles) {
     if (!enabled) return;
 
-    // Decrementa o timer
-    if (timer > cycles) {
-        timer -= cycles;
-    } else {
-        // Avança para a próxima posição na forma de onda
-        position = (position + 1) % 32;
+    // Avança a posição na forma de onda por todos os passos de uma vez
+    position = static_cast<u8>((position + run_timer(cycles, timer_period())) % 32);
+}
 
-        // Recalcula o timer baseado na frequência
-        uint freq_val = frequency;
-        if (freq_val > 2047) freq_val = 2047;
-        timer = (2048 - freq_val) * 2; // Wave timer is different
-        if (timer == 0) timer = 8192 * 2; // Handle frequency 2048 case?
-    }
-    // TODO: Implementar lógica de contador de comprimento (length counter)
+auto WaveChannel::timer_period() const -> uint { return (2048 - frequency) * 2; }
+
+auto WaveChannel::nibble(u8 at) const -> u8 {
+    u8 wave_byte = wave_pattern[at / 2];
+    // If position is even, use high nibble, otherwise use low nibble
+    return (at % 2 == 0) ? (wave_byte >> 4) : (wave_byte & 0x0F);
+}
+
+auto WaveChannel::cycles_until_change() const -> uint {
+    if (!enabled || output_level == 0) return NO_EVENT;
+
+    return clocks_until_change(timer, timer_period(), 32, [&](uint step) {
+        return nibble(static_cast<u8>((position + step) % 32)) != nibble(position);
+    });
 }
 
 
@@ -275,9 +416,7 @@ float WaveChannel::get_sample() const {
     if (!enabled) return 0.0f;
 
     // Obtém o valor da forma de onda atual
-    u8 wave_byte = wave_pattern[position / 2];
-    // If position is even, use high nibble, otherwise use low nibble
-    u8 wave_nibble = (position % 2 == 0) ? (wave_byte >> 4) : (wave_byte & 0x0F);
+    u8 wave_nibble = nibble(position);
 
     // Aplica o nível de saída (shift right)
     switch (output_level) {
@@ -290,9 +429,26 @@ float WaveChannel::get_sample() const {
 }
 
 
+void WaveChannel::save_state(ChannelState& state) const {
+    SoundChannel::save_state(state);
+    state.wave_pattern = wave_pattern;
+    state.position = position;
+    state.output_level = output_level;
+    state.frequency = frequency;
+}
+
+void WaveChannel::load_state(const ChannelState& state) {
+    SoundChannel::load_state(state);
+    wave_pattern = state.wave_pattern;
+    position = state.position;
+    output_level = state.output_level;
+    frequency = state.frequency;
+}
+
 void WaveChannel::set_enable_register(u8 value) {
-    // Bit 7: DAC power
-    enabled = check_bit(value, 7);
+    // Bit 7: DAC power. Ligar não toca nada até o trigger; desligar para o canal
+    dac_enabled = check_bit(value, 7);
+    if (!dac_enabled) { enabled = false; }
 }
 
 void WaveChannel::set_length_register(u8 value) {
@@ -314,12 +470,10 @@ void WaveChannel::set_frequency_hi_register(u8 value) {
 
     // Reinicia o canal se o bit 7 estiver definido
     if (check_bit(value, 7)) {
-        enabled = true; // Needs DAC enable too (NR30)
+        // Com o DAC (NR30) desligado o trigger não liga o canal
+        enabled = dac_enabled;
         // Reinicia o timer
-        uint freq_val = frequency;
-        if (freq_val > 2047) freq_val = 2047;
-        timer = (2048 - freq_val) * 2;
-        if (timer == 0) timer = 8192 * 2; // Handle frequency 2048 case?
+        timer = timer_period();
         // Reinicia a posição
         position = 0;
         // Reinicia o contador de comprimento se necessário
@@ -355,35 +509,35 @@ NoiseChannel::NoiseChannel() {
 void NoiseChannel::tick(uint cycles) {
     if (!enabled) return;
 
-    // Decrementa o timer
-    if (timer > cycles) {
-        timer -= cycles;
-    } else {
-         // Calculate divisor based on NR43
-        static const int divisors[] = {8, 16, 32, 48, 64, 80, 96, 112};
-        int divisor = divisors[dividing_ratio & 0x07];
-        int clock_shift = shift_clock_frequency & 0x0F;
-
-        // Recalcula o timer baseado na frequência
-        uint new_timer_period = divisor << clock_shift;
-        if (new_timer_period == 0) new_timer_period = 8; // Avoid zero period? Check HW
-        timer = new_timer_period;
-
+    // O timer vai de uma vez; o LFSR é deslocado uma vez por período
+    for (uint steps = run_timer(cycles, timer_period()); steps > 0; steps--) {
         // Calcula o próximo valor do LFSR
         // XOR bit 0 and bit 1
         bool xor_result = ((lfsr & 0x1) ^ ((lfsr >> 1) & 0x1)) != 0;
-        // Shift LFSR right
-        lfsr >>= 1;
-        // Set bit 14 to the XOR result
-        lfsr = bitwise::set_bit_to(lfsr, 14, xor_result);
+        // Shift LFSR right and set bit 14 to the XOR result. Feito à mão:
+        // bitwise::set_bit_to só trabalha com bytes
+        uint feedback = xor_result ? 1 : 0;
+        lfsr = (lfsr >> 1) | (feedback << 14);
 
         // Se estiver no modo de 7 bits (width mode = 1), também define o bit 6
         if (counter_step_width_mode) {
-            lfsr = bitwise::set_bit_to(lfsr, 6, xor_result);
+            lfsr = (lfsr & ~(1u << 6)) | (feedback << 6);
         }
     }
-    // TODO: Implementar lógica de envelope
-    // TODO: Implementar lógica de contador de comprimento (length counter)
+}
+
+auto NoiseChannel::timer_period() const -> uint {
+    return NOISE_DIVISORS[dividing_ratio & 0x07] << (shift_clock_frequency & 0x0F);
+}
+
+auto NoiseChannel::cycles_until_change() const -> uint {
+    if (!enabled || volume == 0) return NO_EVENT;
+
+    return timer;
+}
+
+void NoiseChannel::clock_envelope() {
+    step_envelope(volume, envelope_timer, envelope_sweep_pace, envelope_increase);
 }
 
 
@@ -395,6 +549,30 @@ float NoiseChannel::get_sample() const {
     return high ? (float)volume / 15.0f : -((float)volume / 15.0f);
 }
 
+void NoiseChannel::save_state(ChannelState& state) const {
+    SoundChannel::save_state(state);
+    state.envelope_initial_volume = envelope_initial_volume;
+    state.envelope_increase = envelope_increase;
+    state.envelope_sweep_pace = envelope_sweep_pace;
+    state.envelope_timer = envelope_timer;
+    state.shift_clock_frequency = shift_clock_frequency;
+    state.counter_step_width_mode = counter_step_width_mode;
+    state.dividing_ratio = dividing_ratio;
+    state.lfsr = lfsr;
+}
+
+void NoiseChannel::load_state(const ChannelState& state) {
+    SoundChannel::load_state(state);
+    envelope_initial_volume = state.envelope_initial_volume;
+    envelope_increase = state.envelope_increase;
+    envelope_sweep_pace = state.envelope_sweep_pace;
+    envelope_timer = state.envelope_timer;
+    shift_clock_frequency = state.shift_clock_frequency;
+    counter_step_width_mode = state.counter_step_width_mode;
+    dividing_ratio = state.dividing_ratio;
+    lfsr = state.lfsr;
+}
+
 void NoiseChannel::set_length_register(u8 value) {
     // Only bits 0-5 are used for length
     length_counter = 64 - (value & 0x3F);
@@ -405,9 +583,9 @@ void NoiseChannel::set_volume_envelope_register(u8 value) {
     envelope_increase = check_bit(value, 3);
     envelope_sweep_pace = value & 0x07;
 
-    // Atualiza o volume atual
-    volume = envelope_initial_volume;
-    // TODO: Initialize envelope timer based on sweep_pace
+    // O volume só é recarregado no trigger; desligar o DAC desliga o canal
+    dac_enabled = envelope_dac_on(value);
+    if (!dac_enabled) { enabled = false; }
 }
 
 void NoiseChannel::set_polynomial_register(u8 value) {
@@ -419,22 +597,19 @@ void NoiseChannel::set_polynomial_register(u8 value) {
 void NoiseChannel::set_counter_register(u8 value) {
     // Reinicia o canal se o bit 7 estiver definido
     if (check_bit(value, 7)) {
-        enabled = true; // Enable channel
+        // Com o DAC desligado o trigger não liga o canal
+        enabled = dac_enabled;
         // Reinicia o LFSR
         lfsr = 0x7FFF;
-         // Recalcula o timer baseado na frequência
-        static const int divisors[] = {8, 16, 32, 48, 64, 80, 96, 112};
-        int divisor = divisors[dividing_ratio & 0x07];
-        int clock_shift = shift_clock_frequency & 0x0F;
-        uint new_timer_period = divisor << clock_shift;
-        if (new_timer_period == 0) new_timer_period = 8; // Avoid zero period?
-        timer = new_timer_period;
+        // Recalcula o timer baseado na frequência
+        timer = timer_period();
         // Reinicia o contador de comprimento se necessário
         if (length_counter == 0) {
             length_counter = 64;
         }
         // Reset envelope
         volume = envelope_initial_volume;
+        envelope_timer = envelope_sweep_pace;
     }
 
     // Habilita o contador de comprimento se o bit 6 estiver definido
@@ -446,62 +621,220 @@ void NoiseChannel::set_counter_register(u8 value) {
 Audio::Audio(Gameboy& inGb, Options& inOptions) :
     gb(inGb),
     options(inOptions),
-    channel1(std::make_unique<ToneSweepChannel>()),
-    channel2(std::make_unique<ToneChannel>()),
-    channel3(std::make_unique<WaveChannel>()),
-    channel4(std::make_unique<NoiseChannel>())
+    channels({ &channel1, &channel2, &channel3, &channel4 }),
+    left_synth(inOptions.audio_sample_rate, SAMPLES_PER_BLOCK),
+    right_synth(inOptions.audio_sample_rate, SAMPLES_PER_BLOCK),
+    held_left_synth(inOptions.audio_sample_rate, SAMPLES_PER_BLOCK),
+    held_right_synth(inOptions.audio_sample_rate, SAMPLES_PER_BLOCK)
 {
-    // Inicializa os buffers de áudio
-    left_buffer.reserve(2048); // Increase buffer capacity slightly
-    right_buffer.reserve(2048);
+    // Reserva espaço para o callback uma vez só: mixar nunca aloca
+    left_buffer.reserve(SAMPLES_PER_CALLBACK + SAMPLES_PER_BLOCK);
+    right_buffer.reserve(SAMPLES_PER_CALLBACK + SAMPLES_PER_BLOCK);
+    // Um frame tem até 4 blocos a 48 kHz
+    captured_samples.reserve(4 * SAMPLES_PER_BLOCK * 2);
+
+    update_gains();
 }
 
 void Audio::tick(uint cycles) {
-    // TODO: Implement Frame Sequencer to clock length, envelope, sweep units
-    // Frame sequencer runs at 512 Hz. Clocks length, envelope, sweep on specific steps.
-
-    // For now, just tick the timer/frequency part of each channel
-    channel1->tick(cycles);
-    channel2->tick(cycles);
-    channel3->tick(cycles);
-    channel4->tick(cycles);
-
-    // Incrementa o contador de amostras based on main GB clock cycles
-    sample_counter += cycles;
-
-    // Generate a new sample when enough *main clock* cycles have passed
-    // Adjust CYCLES_PER_SAMPLE based on your main clock rate (CLOCK_RATE in definitions.h)
-    // CYCLES_PER_SAMPLE = CLOCK_RATE / SAMPLE_RATE;
-    // Example: 4194304 / 44100 = ~95.1
-    static constexpr uint CYCLES_PER_SAMPLE = CLOCK_RATE / 44100; // Target 44100 Hz
-
-    while (sample_counter >= CYCLES_PER_SAMPLE) {
-        sample_counter -= CYCLES_PER_SAMPLE;
-
-        // Mistura as amostras de todos os canais
-        mix_samples();
-
-        // Envia as amostras para o callback de áudio se houver amostras suficientes
-        // Should be triggered more often, maybe smaller threshold like 512 or 1024
-        if (left_buffer.size() >= 1024) {
-            if (audio_callback) {
-                 // Copy buffers before calling callback to avoid deadlocks if callback modifies them
-                 // Although our current SDL callback doesn't modify, it's safer
-                 std::vector<float> left_copy = left_buffer;
-                 std::vector<float> right_copy = right_buffer;
-                 audio_callback(left_copy, right_copy);
+    // Nada aqui anda clock a clock: o lote só é dividido num passo do frame
+    // sequencer, quando um bloco fica pronto, ou onde o nível de algum canal
+    // muda, e os timers dos canais saltam direto para lá
+    bool synthesizing = !options.mute_audio;
+
+    while (cycles > 0) {
+        uint step = std::min(cycles, clocks_until_sequencer());
+        if (synthesizing) {
+            if (changes_stale) { update_changes(true); }
+            step = std::min(step, clocks_until_block());
+            for (uint change : clocks_until_change) { step = std::min(step, change); }
+        }
+        cycles -= step;
+
+        // Called through the concrete (final) types, so these aren't virtual.
+        // Sem síntese a forma de onda não importa, só os status do NR52
+        if (synthesizing) {
+            channel1.tick(step);
+            channel2.tick(step);
+            channel3.tick(step);
+            channel4.tick(step);
+
+            for (uint& change : clocks_until_change) {
+                if (change != NO_EVENT) { change -= step; }
             }
-            // Clear the *internal* buffers after sending
-            left_buffer.clear();
-            right_buffer.clear();
         }
+        clock_time += step;
+
+        if (clock_time >= next_sequencer_at) { clock_frame_sequencer(); }
+
+        if (synthesizing) {
+            update_changes(changes_stale);
+            update_levels();
+            if (left_synth.samples_ready(clock_time) >= SAMPLES_PER_BLOCK) { finish_block(); }
+        }
+    }
+}
+
+void Audio::update_changes(bool all) {
+    // Só os canais que acabaram de mudar precisam de conta nova, a não ser
+    // que algo de fora (registrador, sequencer, estado carregado) mexeu neles
+    if (all || clocks_until_change[0] == 0) { clocks_until_change[0] = channel1.cycles_until_change(); }
+    if (all || clocks_until_change[1] == 0) { clocks_until_change[1] = channel2.cycles_until_change(); }
+    if (all || clocks_until_change[2] == 0) { clocks_until_change[2] = channel3.cycles_until_change(); }
+    if (all || clocks_until_change[3] == 0) { clocks_until_change[3] = channel4.cycles_until_change(); }
+    changes_stale = false;
+}
+
+auto Audio::cycles_until_next_event() const -> uint {
+    // Nothing here raises interrupts, so audio only needs to catch up for
+    // a frame sequencer step, when a block is due to be mixed into the
+    // ring, or when the CPU touches an APU register (see MMU::sync_io)
+    if (options.mute_audio) { return clocks_until_sequencer(); }
+
+    return std::min(clocks_until_sequencer(), clocks_until_block());
+}
+
+auto Audio::clocks_until_sequencer() const -> uint {
+    return static_cast<uint>(next_sequencer_at - clock_time);
+}
+
+void Audio::clock_frame_sequencer() {
+    next_sequencer_at += FRAME_SEQUENCER_PERIOD;
+    changes_stale = true;
+
+    // Com o APU desligado (NR52) o sequencer fica parado
+    if (!check_bit(nr52.value(), 7)) { return; }
+
+    u8 step = sequencer_step;
+    sequencer_step = static_cast<u8>((sequencer_step + 1) % 8);
+
+    // Comprimento nos passos pares (256 Hz), sweep no 2 e no 6 (128 Hz),
+    // envelope no 7 (64 Hz)
+    if (step % 2 == 0) {
+        for (SoundChannel* channel : channels) { channel->clock_length(); }
     }
+    if (step == 2 || step == 6) { channel1.clock_sweep(); }
+    if (step == 7) {
+        channel1.clock_envelope();
+        channel2.clock_envelope();
+        channel4.clock_envelope();
+    }
+}
+
+void Audio::reset_frame_sequencer() {
+    // O bit do DIV que move o sequencer cai ao ser zerado: se estava em 1,
+    // na segunda metade do período, isso conta como um passo
+    if (clocks_until_sequencer() <= FRAME_SEQUENCER_PERIOD / 2) { clock_frame_sequencer(); }
+    next_sequencer_at = clock_time + FRAME_SEQUENCER_PERIOD;
+
+    if (!options.mute_audio) { update_levels(); }
+}
+
+auto Audio::clocks_until_block() const -> uint {
+    return static_cast<uint>(left_synth.clock_for_samples(SAMPLES_PER_BLOCK) - clock_time);
 }
 
 void Audio::register_audio_callback(const audio_callback_t& callback) {
     audio_callback = callback;
 }
 
+auto Audio::output() -> AudioRing& { return ring; }
+
+void Audio::register_stats_callback(const audio_stats_callback_t& callback) {
+    stats_callback = callback;
+}
+
+void Audio::begin_capture() {
+    captured_samples.clear();
+    capturing = true;
+}
+
+void Audio::end_capture() {
+    capturing = false;
+}
+
+auto Audio::captured() const -> const std::vector<float>& { return captured_samples; }
+
+void Audio::hold_output() {
+    // Atribuição por cópia: os buffers guardados reaproveitam a memória
+    holding = true;
+    held_clock_time = clock_time;
+    held_left_synth = left_synth;
+    held_right_synth = right_synth;
+    held_left_level = left_level;
+    held_right_level = right_level;
+}
+
+void Audio::release_output() {
+    holding = false;
+    clock_time = held_clock_time;
+    left_synth = held_left_synth;
+    right_synth = held_right_synth;
+    left_level = held_left_level;
+    right_level = held_right_level;
+}
+
+void Audio::restart_output() {
+    float left = 0.0f;
+    float right = 0.0f;
+    for (uint channel = 0; channel < 4; channel++) {
+        left += left_level[channel];
+        right += right_level[channel];
+    }
+    left_synth.restart(clock_time, options.audio_sample_rate, left);
+    right_synth.restart(clock_time, options.audio_sample_rate, right);
+
+    // Os níveis de antes seguem valendo; calado, eles pararam de ser
+    // atualizados, e o que mudou desde então entra agora como degrau
+    changes_stale = true;
+    if (!options.mute_audio) { update_levels(); }
+}
+
+namespace {
+struct AudioState {
+    std::array<ChannelState, 4> channels;
+    // Clocks até o próximo passo do frame sequencer
+    u32 sequencer_clocks;
+    u8 nr50;
+    u8 nr51;
+    u8 nr52;
+    u8 sequencer_step;
+};
+} // namespace
+
+void Audio::save_state(StateWriter& writer) const {
+    AudioState state = {};
+    for (uint channel = 0; channel < 4; channel++) {
+        channels[channel]->save_state(state.channels[channel]);
+    }
+    state.nr50 = nr50.value();
+    state.nr51 = nr51.value();
+    state.nr52 = nr52.value();
+    state.sequencer_clocks = clocks_until_sequencer();
+    state.sequencer_step = sequencer_step;
+
+    writer.write(StateSection::Audio, state);
+}
+
+void Audio::load_state(StateReader& reader) {
+    AudioState state;
+    reader.read(StateSection::Audio, state);
+
+    for (uint channel = 0; channel < 4; channel++) {
+        channels[channel]->load_state(state.channels[channel]);
+    }
+    nr50.set(state.nr50);
+    nr51.set(state.nr51);
+    nr52.set(state.nr52);
+    next_sequencer_at = clock_time + state.sequencer_clocks;
+    sequencer_step = state.sequencer_step;
+
+    // Os níveis novos entram como um degrau no relógio atual
+    changes_stale = true;
+    update_gains();
+    if (!options.mute_audio) { update_levels(); }
+}
+
 u8 Audio::read_register(u16 address) const {
      // Check if APU is powered off via NR52
     // Reading registers might return specific values when APU is off
@@ -521,7 +854,7 @@ u8 Audio::read_register(u16 address) const {
         switch (address) {
             case 0xFF10: return 0x80; // NR10 - Sweep (read mask unknown, often returns high bits)
             case 0xFF11: return 0x3F; // NR11 - Length/Duty (only duty readable? mask 0xC0?)
-            case 0xFF12: return channel1->get_volume() << 4; // NR12 - Vol/Env (readable?)
+            case 0xFF12: return channel1.get_volume() << 4; // NR12 - Vol/Env (readable?)
             case 0xFF13: return 0xFF; // NR13 - Frequency Lo (write-only)
             case 0xFF14: return 0xBF; // NR14 - Frequency Hi (only length enable readable? mask 0x40?)
             default: return 0xFF;
@@ -533,7 +866,7 @@ u8 Audio::read_register(u16 address) const {
         // Placeholder read values
         switch (address) {
             case 0xFF16: return 0x3F; // NR21 - Length/Duty (only duty readable? mask 0xC0?)
-            case 0xFF17: return channel2->get_volume() << 4; // NR22 - Volume Envelope (readable?)
+            case 0xFF17: return channel2.get_volume() << 4; // NR22 - Volume Envelope (readable?)
             case 0xFF18: return 0xFF; // NR23 - Frequency Lo (write-only)
             case 0xFF19: return 0xBF; // NR24 - Frequency Hi (only length enable readable? mask 0x40?)
             default: return 0xFF;
@@ -544,7 +877,7 @@ u8 Audio::read_register(u16 address) const {
     if (address >= 0xFF1A && address <= 0xFF1E) {
         // Placeholder read values
         switch (address) {
-            case 0xFF1A: return channel3->is_enabled() ? 0xFF : 0x7F; // NR30 - Enable (mask 0x80?)
+            case 0xFF1A: return channel3.dac_on() ? 0xFF : 0x7F; // NR30 - DAC power, bit 7 only
             case 0xFF1B: return 0xFF; // NR31 - Length (write-only?)
             case 0xFF1C: return 0x9F; // NR32 - Output Level (mask 0x60?)
             case 0xFF1D: return 0xFF; // NR33 - Frequency Lo (write-only)
@@ -558,7 +891,7 @@ u8 Audio::read_register(u16 address) const {
         // Placeholder read values
         switch (address) {
             case 0xFF20: return 0xFF; // NR41 - Length (write-only?)
-            case 0xFF21: return channel4->get_volume() << 4; // NR42 - Volume Envelope (readable?)
+            case 0xFF21: return channel4.get_volume() << 4; // NR42 - Volume Envelope (readable?)
             case 0xFF22: return 0x00; // NR43 - Polynomial Counter (readable?)
             case 0xFF23: return 0xBF; // NR44 - Counter (only length enable readable? mask 0x40?)
             default: return 0xFF;
@@ -575,10 +908,10 @@ u8 Audio::read_register(u16 address) const {
                 u8 value = (nr52.value() & 0x80) | 0x70; // Bit 7 readable, bits 4-6 unused, usually read 1
 
                 // Bits 0-3: Status of channels (1 if active)
-                if (channel1->is_enabled()) value |= 0x01;
-                if (channel2->is_enabled()) value |= 0x02;
-                if (channel3->is_enabled()) value |= 0x04; // Needs DAC enable too
-                if (channel4->is_enabled()) value |= 0x08;
+                if (channel1.is_enabled()) value |= 0x01;
+                if (channel2.is_enabled()) value |= 0x02;
+                if (channel3.is_enabled()) value |= 0x04; // Needs DAC enable too
+                if (channel4.is_enabled()) value |= 0x08;
 
                 return value;
             }
@@ -590,7 +923,7 @@ u8 Audio::read_register(u16 address) const {
     if (address >= 0xFF30 && address <= 0xFF3F) {
         // Reading wave RAM might be tricky if channel 3 is active
         // For now, just return the value. Hardware might return 0xFF sometimes.
-        return channel3->get_wave_pattern(address - 0xFF30);
+        return channel3.get_wave_pattern(address - 0xFF30);
     }
 
     log_warn("Unmapped audio read: 0x%04X", address);
@@ -599,6 +932,14 @@ u8 Audio::read_register(u16 address) const {
 
 
 void Audio::write_register(u16 address, u8 value) {
+    write_register_value(address, value);
+    changes_stale = true;
+
+    // A escrita pode mudar o nível de qualquer canal (volume, trigger, wave RAM)
+    if (!options.mute_audio) { update_levels(); }
+}
+
+void Audio::write_register_value(u16 address, u8 value) {
     // std::cout << "[DEBUG] Entered Audio::write_register, address=0x" << std::hex << address << ", value=0x" << (int)value << std::dec << std::endl;
     if (address >= 0xFF10 && address <= 0xFF3F) {
         // std::cout << "[APU] Write " << apu_reg_name(address)
@@ -668,7 +1009,7 @@ void Audio::write_register(u16 address, u8 value) {
     if (!audio_enabled && address != 0xFF26) {
         // Still allow writing to Wave RAM even if APU is off
         if (address >= 0xFF30 && address <= 0xFF3F) {
-             channel3->set_wave_pattern(address - 0xFF30, value);
+             channel3.set_wave_pattern(address - 0xFF30, value);
         }
         // Otherwise, ignore writes to other APU registers
         return;
@@ -677,11 +1018,11 @@ void Audio::write_register(u16 address, u8 value) {
     // Channel 1: Tone & Sweep (0xFF10-0xFF14)
     if (address >= 0xFF10 && address <= 0xFF14) {
         switch (address) {
-            case 0xFF10: channel1->set_sweep_register(value); break;
-            case 0xFF11: channel1->set_length_duty_register(value); break;
-            case 0xFF12: channel1->set_volume_envelope_register(value); break;
-            case 0xFF13: channel1->set_frequency_lo_register(value); break;
-            case 0xFF14: channel1->set_frequency_hi_register(value); break;
+            case 0xFF10: channel1.set_sweep_register(value); break;
+            case 0xFF11: channel1.set_length_duty_register(value); break;
+            case 0xFF12: channel1.set_volume_envelope_register(value); break;
+            case 0xFF13: channel1.set_frequency_lo_register(value); break;
+            case 0xFF14: channel1.set_frequency_hi_register(value); break;
         }
         return;
     }
@@ -690,10 +1031,10 @@ void Audio::write_register(u16 address, u8 value) {
     if (address >= 0xFF16 && address <= 0xFF19) {
         switch (address) {
             // 0xFF15 is unused
-            case 0xFF16: channel2->set_length_duty_register(value); break;
-            case 0xFF17: channel2->set_volume_envelope_register(value); break;
-            case 0xFF18: channel2->set_frequency_lo_register(value); break;
-            case 0xFF19: channel2->set_frequency_hi_register(value); break;
+            case 0xFF16: channel2.set_length_duty_register(value); break;
+            case 0xFF17: channel2.set_volume_envelope_register(value); break;
+            case 0xFF18: channel2.set_frequency_lo_register(value); break;
+            case 0xFF19: channel2.set_frequency_hi_register(value); break;
         }
         return;
     }
@@ -701,11 +1042,11 @@ void Audio::write_register(u16 address, u8 value) {
     // Channel 3: Wave Output (0xFF1A-0xFF1E)
     if (address >= 0xFF1A && address <= 0xFF1E) {
         switch (address) {
-            case 0xFF1A: channel3->set_enable_register(value); break;
-            case 0xFF1B: channel3->set_length_register(value); break;
-            case 0xFF1C: channel3->set_output_level_register(value); break;
-            case 0xFF1D: channel3->set_frequency_lo_register(value); break;
-            case 0xFF1E: channel3->set_frequency_hi_register(value); break;
+            case 0xFF1A: channel3.set_enable_register(value); break;
+            case 0xFF1B: channel3.set_length_register(value); break;
+            case 0xFF1C: channel3.set_output_level_register(value); break;
+            case 0xFF1D: channel3.set_frequency_lo_register(value); break;
+            case 0xFF1E: channel3.set_frequency_hi_register(value); break;
              // 0xFF1F is unused
         }
         return;
@@ -715,10 +1056,10 @@ void Audio::write_register(u16 address, u8 value) {
     if (address >= 0xFF20 && address <= 0xFF23) {
          // 0xFF1F is unused
         switch (address) {
-            case 0xFF20: channel4->set_length_register(value); break;
-            case 0xFF21: channel4->set_volume_envelope_register(value); break;
-            case 0xFF22: channel4->set_polynomial_register(value); break;
-            case 0xFF23: channel4->set_counter_register(value); break;
+            case 0xFF20: channel4.set_length_register(value); break;
+            case 0xFF21: channel4.set_volume_envelope_register(value); break;
+            case 0xFF22: channel4.set_polynomial_register(value); break;
+            case 0xFF23: channel4.set_counter_register(value); break;
         }
         return;
     }
@@ -737,6 +1078,9 @@ void Audio::write_register(u16 address, u8 value) {
 
                 bool now_enabled = check_bit(nr52.value(), 7);
 
+                // Ligado de novo, o frame sequencer recomeça do passo 0
+                if (!was_enabled && now_enabled) { sequencer_step = 0; }
+
                 // If the audio was just disabled, reset most APU state.
                 if (was_enabled && !now_enabled) {
                     // Reset all registers except NR52 itself (according to pandocs)
@@ -750,15 +1094,17 @@ void Audio::write_register(u16 address, u8 value) {
                          }
                     }
                     // Maybe disable channels explicitly too
-                    channel1->set_enabled(false);
-                    channel2->set_enabled(false);
-                    channel3->set_enabled(false); // This might just disable DAC
-                    channel4->set_enabled(false);
+                    channel1.set_enabled(false);
+                    channel2.set_enabled(false);
+                    channel3.set_enabled(false); // This might just disable DAC
+                    channel4.set_enabled(false);
                     // Reset internal state like timers, envelopes etc. (Needs implementation in channel classes)
                 }
                 break;
             }
         }
+
+        update_gains();
         return;
     }
 
@@ -766,7 +1112,7 @@ void Audio::write_register(u16 address, u8 value) {
     // (Handled even if APU is off)
     if (address >= 0xFF30 && address <= 0xFF3F) {
         // Writing to Wave RAM while Channel 3 is active might have timing issues/artefacts.
-        channel3->set_wave_pattern(address - 0xFF30, value);
+        channel3.set_wave_pattern(address - 0xFF30, value);
         return;
     }
 
@@ -776,90 +1122,115 @@ void Audio::write_register(u16 address, u8 value) {
 }
 
 
-void Audio::mix_samples() {
-    // std::cout << "[DEBUG] Entered Audio::mix_samples" << std::endl;
-    // Verifica se o áudio está habilitado via NR52 bit 7
-    bool audio_enabled = check_bit(nr52.value(), 7);
-    if (!audio_enabled) {
-        // If APU is off, output silence
-        left_buffer.push_back(0.0f);
-        right_buffer.push_back(0.0f);
-        return;
+void Audio::update_gains() {
+    // Ganho de cada canal em cada lado, a partir do NR50/NR51. Se o APU
+    // estiver desligado (NR52 bit 7), tudo sai em silêncio
+    left_gain.fill(0.0f);
+    right_gain.fill(0.0f);
+
+    if (!check_bit(nr52.value(), 7)) { return; }
+
+    // Get master volume levels (0-7); direct scaling 0-7 for now.
+    // The channel samples are ~[-1.0, 1.0], so the sum is also divided
+    // by the number of channels to avoid clipping
+    float left_vol = static_cast<float>((nr50.value() >> 4) & 0x7) / 7.0f / 4.0f;
+    float right_vol = static_cast<float>(nr50.value() & 0x7) / 7.0f / 4.0f;
+
+    for (uint channel = 0; channel < 4; channel++) {
+        // NR51: bits 4-7 route CH1-4 to the left, bits 0-3 to the right
+        left_gain[channel] = check_bit(nr51.value(), static_cast<u8>(channel + 4)) ? left_vol : 0.0f;
+        right_gain[channel] = check_bit(nr51.value(), static_cast<u8>(channel)) ? right_vol : 0.0f;
     }
+}
 
-    // Obtém as amostras de cada canal
-    float sample1 = channel1->get_sample();
-    float sample2 = channel2->get_sample();
-    float sample3 = channel3->get_sample();
-    float sample4 = channel4->get_sample();
-
-    // Get master volume levels (0-7, add 1 to get 1-8 range?) - Pandocs says 0-7 directly scales
-    u8 left_vol = (nr50.value() >> 4) & 0x7;
-    u8 right_vol = nr50.value() & 0x7;
-
-    // Calculate final left sample based on NR51 panning and master volume
-    float left_final = 0.0f;
-    if (check_bit(nr51.value(), 7)) left_final += sample4; // CH4 left
-    if (check_bit(nr51.value(), 6)) left_final += sample3; // CH3 left
-    if (check_bit(nr51.value(), 5)) left_final += sample2; // CH2 left
-    if (check_bit(nr51.value(), 4)) left_final += sample1; // CH1 left
-    // Scale by master volume (0-7 means multiply by 0/8 to 7/8?) -> No, Pandocs says adds 1. So 1-8 range?
-    // Let's try direct scaling 0-7 first.
-    left_final *= (float)(left_vol) / 7.0f; // Scale by master volume (0.0 to 1.0)
-
-    // Calculate final right sample based on NR51 panning and master volume
-    float right_final = 0.0f;
-    if (check_bit(nr51.value(), 3)) right_final += sample4; // CH4 right
-    if (check_bit(nr51.value(), 2)) right_final += sample3; // CH3 right
-    if (check_bit(nr51.value(), 1)) right_final += sample2; // CH2 right
-    if (check_bit(nr51.value(), 0)) right_final += sample1; // CH1 right
-    right_final *= (float)(right_vol) / 7.0f; // Scale by master volume
-
-    // The samples from get_sample() are already ~[-1.0, 1.0].
-    // Mixing involves summing, so we need to scale down to avoid clipping.
-    // Dividing by 4 (number of channels) is a simple approach.
-    left_final /= 4.0f;
-    right_final /= 4.0f;
-
-    // Clamp the final samples to [-1.0, 1.0] just in case
-    left_final = std::max(-1.0f, std::min(1.0f, left_final));
-    right_final = std::max(-1.0f, std::min(1.0f, right_final));
-
-    // Adiciona as amostras aos buffers internos da classe Audio
-    left_buffer.push_back(left_final);
-    right_buffer.push_back(right_final);
-
-    if (!left_buffer.empty()) {
-        float min = left_buffer[0];
-        float max = left_buffer[0];
-        float sum = 0.0f;
-        for (float v : left_buffer) {
-            if (v < min) min = v;
-            if (v > max) max = v;
-            sum += v;
+void Audio::update_levels() {
+    // Só as mudanças de nível vão para os buffers, no clock em que acontecem
+    const std::array<float, 4> samples = {
+        channel1.get_sample(),
+        channel2.get_sample(),
+        channel3.get_sample(),
+        channel4.get_sample(),
+    };
+
+    for (uint channel = 0; channel < 4; channel++) {
+        float sample = samples[channel];
+
+        float left = sample * left_gain[channel];
+        if (left != left_level[channel]) {
+            left_synth.add_delta(clock_time, left - left_level[channel]);
+            left_level[channel] = left;
         }
-        // std::cout << "[APU] Left buffer: min=" << min
-        //   << ", max=" << max
-        //   << ", mean=" << (sum / left_buffer.size())
-        //   << std::endl;
-    }
-
-    if (!right_buffer.empty()) {
-        float min = right_buffer[0];
-        float max = right_buffer[0];
-        float sum = 0.0f;
-        for (float v : right_buffer) {
-            if (v < min) min = v;
-            if (v > max) max = v;
-            sum += v;
+
+        float right = sample * right_gain[channel];
+        if (right != right_level[channel]) {
+            right_synth.add_delta(clock_time, right - right_level[channel]);
+            right_level[channel] = right;
         }
-        // std::cout << "[APU] Right buffer: min=" << min
-        //   << ", max=" << max
-        //   << ", mean=" << (sum / right_buffer.size())
-        //   << std::endl;
     }
 }
 
+void Audio::finish_block() {
+    const uint frames = SAMPLES_PER_BLOCK;
+
+    left_synth.read_samples(&mixed_block[0], frames, 2);
+    right_synth.read_samples(&mixed_block[1], frames, 2);
+
+    // Mixado adiantado, para ser desfeito
+    if (holding) { return; }
+
+    // Clamp the final samples to [-1.0, 1.0]; the filter can overshoot a little
+    for (float& sample : mixed_block) {
+        sample = std::max(-1.0f, std::min(1.0f, sample));
+    }
+
+    if (capturing) {
+        captured_samples.insert(captured_samples.end(), mixed_block.begin(), mixed_block.end());
+    } else {
+        ring.push(mixed_block.data(), frames);
+    }
+
+    if (stats_callback) { stats_callback(block_stats(frames)); }
+
+    if (audio_callback) {
+        // Os vetores têm capacidade reservada, então isto não aloca
+        for (uint i = 0; i < frames; i++) {
+            left_buffer.push_back(mixed_block[i * 2]);
+            right_buffer.push_back(mixed_block[i * 2 + 1]);
+        }
+
+        if (left_buffer.size() >= SAMPLES_PER_CALLBACK) {
+            audio_callback(left_buffer, right_buffer);
+            left_buffer.clear();
+            right_buffer.clear();
+        }
+    }
+}
+
+auto Audio::block_stats(uint frames) const -> AudioBlockStats {
+    AudioBlockStats stats;
+    stats.frames = frames;
+    stats.min_left = stats.max_left = mixed_block[0];
+    stats.min_right = stats.max_right = mixed_block[1];
+
+    float sum_left = 0.0f;
+    float sum_right = 0.0f;
+    for (uint i = 0; i < frames; i++) {
+        float left = mixed_block[i * 2];
+        float right = mixed_block[i * 2 + 1];
+
+        stats.min_left = std::min(stats.min_left, left);
+        stats.max_left = std::max(stats.max_left, left);
+        stats.min_right = std::min(stats.min_right, right);
+        stats.max_right = std::max(stats.max_right, right);
+        sum_left += left;
+        sum_right += right;
+    }
+
+    stats.mean_left = sum_left / static_cast<float>(frames);
+    stats.mean_right = sum_right / static_cast<float>(frames);
+    return stats;
+}
+
 
 void Audio::update_channel_control() {
     // This function seems redundant now as the status bits are updated
@@ -870,10 +1241,10 @@ void Audio::update_channel_control() {
     // u8 value = nr52.value() & 0x80; // Mantém apenas o bit 7 (master enable)
     // value |= 0x70; // Set unused bits high
 
-    // if (channel1->is_enabled()) value |= 0x01;
-    // if (channel2->is_enabled()) value |= 0x02;
-    // if (channel3->is_enabled()) value |= 0x04; // Needs DAC check too
-    // if (channel4->is_enabled()) value |= 0x08;
+    // if (channel1.is_enabled()) value |= 0x01;
+    // if (channel2.is_enabled()) value |= 0x02;
+    // if (channel3.is_enabled()) value |= 0x04; // Needs DAC check too
+    // if (channel4.is_enabled()) value |= 0x08;
 
     // nr52.set(value);
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include "../definitions.h"
 #include "../register.h"
 #include "../options.h"
+#include "audio_ring.h"
+#include "band_limited_buffer.h"
 
 #include <vector>
 #include <array>
@@ -10,10 +12,25 @@
 #include <functional>
 
 class Gameboy;
+class StateWriter;
+class StateReader;
 
 // Callback para enviar amostras de áudio para o sistema de saída
 using audio_callback_t = std::function<void(const std::vector<float>&, const std::vector<float>&)>;
 
+// Estatísticas de um bloco mixado, para instrumentação (opcional)
+struct AudioBlockStats {
+    uint frames = 0;
+    float min_left = 0.0f;
+    float max_left = 0.0f;
+    float mean_left = 0.0f;
+    float min_right = 0.0f;
+    float max_right = 0.0f;
+    float mean_right = 0.0f;
+};
+
+using audio_stats_callback_t = std::function<void(const AudioBlockStats&)>;
+
 // Enumeração para os canais de áudio
 enum class AudioChannel {
     CHANNEL1, // Tone & Sweep
@@ -22,6 +39,37 @@ enum class AudioChannel {
     CHANNEL4  // Noise
 };
 
+// Estado salvo de um canal: um só formato para os quatro, cada canal usa
+// os campos que tem. Sem padding, para ser copiado com memcpy
+struct ChannelState {
+    u32 length_counter;
+    u32 timer;
+    u32 frequency;
+    u32 shadow_frequency;
+    u32 lfsr;
+    std::array<u8, 16> wave_pattern;
+    u8 volume;
+    bool enabled;
+    bool dac_enabled;
+    bool length_enabled;
+    u8 sweep_time;
+    bool sweep_decrease;
+    u8 sweep_shift;
+    u8 sweep_timer;
+    bool sweep_enabled;
+    u8 duty_pattern;
+    u8 position; // duty_position nos canais de tom
+    u8 envelope_initial_volume;
+    bool envelope_increase;
+    u8 envelope_sweep_pace;
+    u8 envelope_timer;
+    u8 shift_clock_frequency;
+    bool counter_step_width_mode;
+    u8 dividing_ratio;
+    u8 output_level;
+    u8 unused;
+};
+
 // Classe base para todos os canais de áudio
 class SoundChannel {
 public:
@@ -30,27 +78,48 @@ public:
     
     virtual void tick(uint cycles) = 0;
     virtual float get_sample() const = 0;
-    
+
+    // Passo de comprimento do frame sequencer: desliga o canal ao zerar
+    void clock_length();
+
     bool is_enabled() const { return enabled; }
     void set_enabled(bool value) { enabled = value; }
+    bool dac_on() const { return dac_enabled; }
     
     void set_volume(u8 vol) { volume = vol; }
     u8 get_volume() const { return volume; }
+
+    virtual void save_state(ChannelState& state) const;
+    virtual void load_state(const ChannelState& state);
     
 protected:
+    // Avança o timer de uma vez, sem decrementar clock a clock: devolve
+    // quantos períodos terminaram, recarregando com 'period' a cada um
+    auto run_timer(uint cycles, uint period) -> uint;
+
     bool enabled = false;
+    bool dac_enabled = false;
     u8 volume = 0;
     uint length_counter = 0;
     bool length_enabled = false;
+    uint timer = 0;
 };
 
 // Canal 1: Tone & Sweep
-class ToneSweepChannel : public SoundChannel {
+class ToneSweepChannel final : public SoundChannel {
 public:
     ToneSweepChannel();
     
     void tick(uint cycles) override;
     float get_sample() const override;
+
+    // Clocks até o nível de saída mudar (NO_EVENT se não for mudar)
+    auto cycles_until_change() const -> uint;
+    void clock_envelope();
+    void clock_sweep();
+
+    void save_state(ChannelState& state) const override;
+    void load_state(const ChannelState& state) override;
     
     void set_sweep_register(u8 value);
     void set_length_duty_register(u8 value);
@@ -62,6 +131,10 @@ private:
     u8 sweep_time = 0;
     bool sweep_decrease = false;
     u8 sweep_shift = 0;
+    u8 sweep_timer = 0;
+    bool sweep_enabled = false;
+    // Cópia da frequência com que o sweep calcula
+    uint shadow_frequency = 0;
     
     u8 duty_pattern = 0;
     u8 duty_position = 0;
@@ -69,20 +142,28 @@ private:
     u8 envelope_initial_volume = 0;
     bool envelope_increase = false;
     u8 envelope_sweep_pace = 0;
+    u8 envelope_timer = 0;
     
     uint frequency = 0;
-    uint timer = 0;
     
-    void update_frequency();
+    auto timer_period() const -> uint;
+    // Próxima frequência do sweep; desliga o canal se passar de 2047
+    auto sweep_frequency() -> uint;
 };
 
 // Canal 2: Tone
-class ToneChannel : public SoundChannel {
+class ToneChannel final : public SoundChannel {
 public:
     ToneChannel();
     
     void tick(uint cycles) override;
     float get_sample() const override;
+
+    auto cycles_until_change() const -> uint;
+    void clock_envelope();
+
+    void save_state(ChannelState& state) const override;
+    void load_state(const ChannelState& state) override;
     
     void set_length_duty_register(u8 value);
     void set_volume_envelope_register(u8 value);
@@ -96,18 +177,25 @@ private:
     u8 envelope_initial_volume = 0;
     bool envelope_increase = false;
     u8 envelope_sweep_pace = 0;
+    u8 envelope_timer = 0;
     
     uint frequency = 0;
-    uint timer = 0;
+
+    auto timer_period() const -> uint;
 };
 
 // Canal 3: Wave Output
-class WaveChannel : public SoundChannel {
+class WaveChannel final : public SoundChannel {
 public:
     WaveChannel();
     
     void tick(uint cycles) override;
     float get_sample() const override;
+
+    auto cycles_until_change() const -> uint;
+
+    void save_state(ChannelState& state) const override;
+    void load_state(const ChannelState& state) override;
     
     void set_enable_register(u8 value);
     void set_length_register(u8 value);
@@ -124,16 +212,25 @@ private:
     u8 output_level = 0;
     
     uint frequency = 0;
-    uint timer = 0;
+
+    auto timer_period() const -> uint;
+    auto nibble(u8 at) const -> u8;
 };
 
 // Canal 4: Noise
-class NoiseChannel : public SoundChannel {
+class NoiseChannel final : public SoundChannel {
 public:
     NoiseChannel();
     
     void tick(uint cycles) override;
     float get_sample() const override;
+
+    // O LFSR não tem forma fechada: muda a cada período, se estiver audível
+    auto cycles_until_change() const -> uint;
+    void clock_envelope();
+
+    void save_state(ChannelState& state) const override;
+    void load_state(const ChannelState& state) override;
     
     void set_length_register(u8 value);
     void set_volume_envelope_register(u8 value);
@@ -144,13 +241,15 @@ private:
     u8 envelope_initial_volume = 0;
     bool envelope_increase = false;
     u8 envelope_sweep_pace = 0;
+    u8 envelope_timer = 0;
     
     u8 shift_clock_frequency = 0;
     bool counter_step_width_mode = false;
     u8 dividing_ratio = 0;
     
-    uint timer = 0;
     uint lfsr = 0; // Linear Feedback Shift Register
+
+    auto timer_period() const -> uint;
 };
 
 // Classe principal de áudio
@@ -159,8 +258,42 @@ public:
     Audio(Gameboy& inGb, Options& inOptions);
     
     void tick(uint cycles);
+    auto cycles_until_next_event() const -> uint;
     void register_audio_callback(const audio_callback_t& callback);
-    
+
+    // Saída principal: o frontend consome as amostras direto do anel
+    auto output() -> AudioRing&;
+
+    // Chamado a cada bloco mixado; as estatísticas só são calculadas se houver callback
+    void register_stats_callback(const audio_stats_callback_t& callback);
+
+    // Modo passo a passo (Gameboy::run_frame): enquanto captura, os blocos
+    // mixados vão para captured() em vez do anel. begin_capture() descarta
+    // o que foi capturado antes
+    void begin_capture();
+    void end_capture();
+    auto captured() const -> const std::vector<float>&;
+    
+    // Run-ahead (Options::run_ahead_frames): entre hold_output() e
+    // release_output() nada do que é mixado sai, e release_output() devolve
+    // a síntese a onde estava, para a saída real seguir sem emenda
+    void hold_output();
+    void release_output();
+
+    // Depois de mudar Options::mute_audio ou audio_sample_rate: a síntese
+    // recomeça no clock atual, na taxa nova e sem degrau no nível. Chamado
+    // com o áudio em dia; quem chama reagenda o evento
+    void restart_output();
+
+    // Escrever no DIV zera o frame sequencer junto, que conta a partir
+    // dele. Chamado com o áudio em dia; quem chama reagenda o evento
+    void reset_frame_sequencer();
+
+    // Estado dos canais e do controle. O relógio e os buffers de síntese
+    // não entram: a saída continua contínua depois de carregar um estado
+    void save_state(StateWriter& writer) const;
+    void load_state(StateReader& reader);
+
     // Registradores de controle
     u8 read_register(u16 address) const;
     void write_register(u16 address, u8 value);
@@ -174,19 +307,76 @@ private:
     Gameboy& gb;
     Options& options;
     
-    std::unique_ptr<ToneSweepChannel> channel1;
-    std::unique_ptr<ToneChannel> channel2;
-    std::unique_ptr<WaveChannel> channel3;
-    std::unique_ptr<NoiseChannel> channel4;
-    
-    uint sample_counter = 0;
-    static constexpr uint CYCLES_PER_SAMPLE = 95; // ~44100Hz com clock de 4.19MHz
+    // Membros diretos: nada do APU fica fora da instância
+    ToneSweepChannel channel1;
+    ToneChannel channel2;
+    WaveChannel channel3;
+    NoiseChannel channel4;
     
+    // Os canais em ordem
+    std::array<SoundChannel*, 4> channels = {};
+
+    // Clocks até o nível de cada canal mudar, contados para baixo a cada
+    // lote. 'changes_stale' pede a conta de novo para todos
+    std::array<uint, 4> clocks_until_change = {};
+    bool changes_stale = true;
+
+    static constexpr uint SAMPLES_PER_CALLBACK = 1024;
+    // Amostras mixadas e entregues ao anel de cada vez (~6ms a 44.1kHz)
+    static constexpr uint SAMPLES_PER_BLOCK = 256;
+
+    // Relógio absoluto do APU, em clocks do Gameboy
+    u64 clock_time = 0;
+
+    // Frame sequencer a 512 Hz: o próximo passo (0-7) e quando ele cai
+    static constexpr uint FRAME_SEQUENCER_PERIOD = CLOCK_RATE / 512;
+    u8 sequencer_step = 0;
+    u64 next_sequencer_at = FRAME_SEQUENCER_PERIOD;
+
+    // Síntese band-limited: cada lado recebe só as mudanças de nível
+    BandLimitedBuffer left_synth;
+    BandLimitedBuffer right_synth;
+
+    // Ganho de cada canal em cada lado (NR50/NR51/NR52)
+    std::array<float, 4> left_gain = {};
+    std::array<float, 4> right_gain = {};
+
+    // Último nível de cada canal entregue aos buffers
+    std::array<float, 4> left_level = {};
+    std::array<float, 4> right_level = {};
+
+    // O bloco mixado, intercalado (esquerdo, direito)
+    std::array<float, SAMPLES_PER_BLOCK * 2> mixed_block = {};
+
+    AudioRing ring;
+
+    // A síntese guardada por hold_output()
+    bool holding = false;
+    u64 held_clock_time = 0;
+    BandLimitedBuffer held_left_synth;
+    BandLimitedBuffer held_right_synth;
+    std::array<float, 4> held_left_level = {};
+    std::array<float, 4> held_right_level = {};
+
+    // Blocos capturados, intercalados como mixed_block
+    std::vector<float> captured_samples;
+    bool capturing = false;
+
+    // Only filled when a callback is registered
     std::vector<float> left_buffer;
     std::vector<float> right_buffer;
     
     audio_callback_t audio_callback;
-    
-    void mix_samples();
+    audio_stats_callback_t stats_callback;
+    
+    auto clocks_until_block() const -> uint;
+    auto clocks_until_sequencer() const -> uint;
+    void clock_frame_sequencer();
+    void update_changes(bool all);
+    void write_register_value(u16 address, u8 value);
+    void update_gains();
+    void update_levels();
+    void finish_block();
+    auto block_stats(uint frames) const -> AudioBlockStats;
     void update_channel_control();
 };
@@ -0,0 +1,69 @@
+#include "audio_ring.h"
+
+#include <algorithm>
+#include <cstring>
+
+static_assert((AudioRing::CAPACITY & (AudioRing::CAPACITY - 1)) == 0, "Ring capacity must be a power of two");
+
+AudioRing::AudioRing() :
+    samples(new float[CAPACITY * 2]),
+    write_position(0),
+    read_position(0),
+    overrun_frames(0),
+    underrun_frames(0)
+{
+}
+
+auto AudioRing::push(const float* interleaved, uint frames) -> uint {
+    u64 write = write_position.load(std::memory_order_relaxed);
+    u64 read = read_position.load(std::memory_order_acquire);
+
+    auto space = static_cast<uint>(CAPACITY - (write - read));
+    uint count = std::min(frames, space);
+
+    /* Copy in at most two runs, either side of the end of the storage */
+    auto start = static_cast<uint>(write & (CAPACITY - 1));
+    uint first = std::min(count, CAPACITY - start);
+    std::memcpy(&samples[start * 2], interleaved, first * 2 * sizeof(float));
+    std::memcpy(&samples[0], interleaved + first * 2, (count - first) * 2 * sizeof(float));
+
+    write_position.store(write + count, std::memory_order_release);
+
+    if (count < frames) {
+        overrun_frames.fetch_add(frames - count, std::memory_order_relaxed);
+    }
+
+    return count;
+}
+
+auto AudioRing::pop(float* interleaved, uint frames) -> uint {
+    u64 read = read_position.load(std::memory_order_relaxed);
+    u64 write = write_position.load(std::memory_order_acquire);
+
+    auto ready = static_cast<uint>(write - read);
+    uint count = std::min(frames, ready);
+
+    auto start = static_cast<uint>(read & (CAPACITY - 1));
+    uint first = std::min(count, CAPACITY - start);
+    std::memcpy(interleaved, &samples[start * 2], first * 2 * sizeof(float));
+    std::memcpy(interleaved + first * 2, &samples[0], (count - first) * 2 * sizeof(float));
+
+    read_position.store(read + count, std::memory_order_release);
+
+    if (count < frames) {
+        std::fill(interleaved + count * 2, interleaved + frames * 2, 0.0f);
+        underrun_frames.fetch_add(frames - count, std::memory_order_relaxed);
+    }
+
+    return count;
+}
+
+auto AudioRing::available() const -> uint {
+    u64 write = write_position.load(std::memory_order_acquire);
+    u64 read = read_position.load(std::memory_order_acquire);
+    return static_cast<uint>(write - read);
+}
+
+auto AudioRing::overruns() const -> u64 { return overrun_frames.load(std::memory_order_relaxed); }
+
+auto AudioRing::underruns() const -> u64 { return underrun_frames.load(std::memory_order_relaxed); }
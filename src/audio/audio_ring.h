@@ -0,0 +1,47 @@
+#pragma once
+
+#include "../definitions.h"
+
+#include <atomic>
+#include <memory>
+
+/* Fixed-capacity ring of interleaved stereo frames (left, right floats),
+ * used to hand samples from the emulator thread to an audio device
+ * callback without locking. Exactly one thread may push and one other
+ * thread may pop. */
+class AudioRing {
+public:
+    /* In frames. A power of two so positions can be masked; ~186ms at 44.1kHz */
+    static const uint CAPACITY = 8192;
+
+    AudioRing();
+
+    /* Producer side. Frames which don't fit are dropped and counted as an
+     * overrun. Returns the number of frames written */
+    auto push(const float* interleaved, uint frames) -> uint;
+
+    /* Consumer side. Frames which aren't available yet are filled with
+     * silence and counted as an underrun. Returns the number of frames
+     * actually read */
+    auto pop(float* interleaved, uint frames) -> uint;
+
+    /* Frames ready to be popped */
+    auto available() const -> uint;
+
+    /* Totals in frames since construction */
+    auto overruns() const -> u64;
+    auto underruns() const -> u64;
+
+private:
+    /* Only frames already pushed are read, so it isn't cleared, and its
+     * memory isn't touched by an instance whose audio is never pulled */
+    std::unique_ptr<float[]> samples;
+
+    /* Frame counts which only ever increase; each is written by one side.
+     * Kept on separate cache lines so the two threads don't contend */
+    alignas(64) std::atomic<u64> write_position;
+    alignas(64) std::atomic<u64> read_position;
+
+    alignas(64) std::atomic<u64> overrun_frames;
+    std::atomic<u64> underrun_frames;
+};
@@ -0,0 +1,90 @@
+#include "band_limited_buffer.h"
+
+#include <algorithm>
+#include <cmath>
+
+BandLimitedBuffer::BandLimitedBuffer(uint _sample_rate, uint max_samples) :
+    sample_rate(_sample_rate),
+    buffer(max_samples + KERNEL_WIDTH, 0.0f)
+{
+}
+
+auto BandLimitedBuffer::kernels() -> const std::array<Kernel, KERNEL_PHASES>& {
+    static const std::array<Kernel, KERNEL_PHASES> table = [] {
+        std::array<Kernel, KERNEL_PHASES> result = {};
+
+        /* Low-pass a little under Nyquist, with a Blackman window */
+        const double cutoff = 0.45;
+        const double pi = 3.14159265358979323846;
+        const double half_width = KERNEL_WIDTH / 2.0;
+
+        for (uint phase = 0; phase < KERNEL_PHASES; phase++) {
+            double offset = static_cast<double>(phase) / KERNEL_PHASES;
+            double sum = 0.0;
+
+            for (uint tap = 0; tap < KERNEL_WIDTH; tap++) {
+                /* Centred between taps 7 and 8, shifted by the phase */
+                double t = static_cast<double>(tap) - (half_width - 1) - offset;
+                double x = 2.0 * pi * cutoff * t;
+                double sinc = t == 0.0 ? 1.0 : std::sin(x) / x;
+                double window = 0.42 + 0.5 * std::cos(pi * t / half_width)
+                                     + 0.08 * std::cos(2.0 * pi * t / half_width);
+
+                result[phase][tap] = static_cast<float>(sinc * window);
+                sum += sinc * window;
+            }
+
+            /* Each kernel sums to one, so a delta becomes a step of exactly 'delta' */
+            for (float& value : result[phase]) { value = static_cast<float>(value / sum); }
+        }
+
+        return result;
+    }();
+
+    return table;
+}
+
+auto BandLimitedBuffer::sample_position(u64 clock_time) const -> u64 {
+    return clock_time * sample_rate / CLOCK_RATE;
+}
+
+void BandLimitedBuffer::add_delta(u64 clock_time, float delta) {
+    u64 scaled = clock_time * sample_rate;
+    auto index = static_cast<uint>(scaled / CLOCK_RATE - samples_read);
+    auto phase = static_cast<uint>((scaled % CLOCK_RATE) * KERNEL_PHASES / CLOCK_RATE);
+
+    const Kernel& kernel = kernels()[phase];
+    float* out = &buffer[index];
+    for (uint tap = 0; tap < KERNEL_WIDTH; tap++) {
+        out[tap] += delta * kernel[tap];
+    }
+}
+
+auto BandLimitedBuffer::samples_ready(u64 clock_time) const -> uint {
+    return static_cast<uint>(sample_position(clock_time) - samples_read);
+}
+
+auto BandLimitedBuffer::clock_for_samples(uint samples) const -> u64 {
+    u64 target = samples_read + samples;
+    return (target * CLOCK_RATE + sample_rate - 1) / sample_rate;
+}
+
+void BandLimitedBuffer::read_samples(float* out, uint count, uint stride) {
+    for (uint i = 0; i < count; i++) {
+        accumulator += buffer[i];
+        out[i * stride] = accumulator;
+    }
+
+    /* Keep the kernel tails which spill past the samples just read */
+    std::copy(buffer.begin() + count, buffer.end(), buffer.begin());
+    std::fill(buffer.end() - count, buffer.end(), 0.0f);
+
+    samples_read += count;
+}
+
+void BandLimitedBuffer::restart(u64 clock_time, uint _sample_rate, float level) {
+    sample_rate = _sample_rate;
+    samples_read = sample_position(clock_time);
+    accumulator = level;
+    std::fill(buffer.begin(), buffer.end(), 0.0f);
+}
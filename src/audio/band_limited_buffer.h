@@ -0,0 +1,58 @@
+#pragma once
+
+#include "../definitions.h"
+
+#include <array>
+#include <vector>
+
+/* Band-limited synthesis of a step waveform (BLEP-style).
+ *
+ * Instead of point-sampling the channels at each output sample, the APU
+ * reports every change in output level with add_delta(), timestamped in
+ * Gameboy clocks. Each change is spread over a few output samples with a
+ * windowed-sinc kernel picked by its sub-sample phase, and the output is
+ * the running sum of those deltas. Sample positions come from exact
+ * integer clock * rate arithmetic, so the output rate never drifts. */
+class BandLimitedBuffer {
+public:
+    /* Output samples each delta is spread across */
+    static const uint KERNEL_WIDTH = 16;
+    /* Sub-sample positions the kernel is precomputed for */
+    static const uint KERNEL_PHASES = 32;
+
+    BandLimitedBuffer(uint sample_rate, uint max_samples);
+
+    /* Add a step of 'delta' at an absolute clock time. The time may not be
+     * earlier than the start of the unread samples, and at most
+     * max_samples past it */
+    void add_delta(u64 clock_time, float delta);
+
+    /* Number of samples which are complete at a clock time: later deltas
+     * can no longer affect them */
+    auto samples_ready(u64 clock_time) const -> uint;
+
+    /* The first clock time at which 'samples' samples are complete */
+    auto clock_for_samples(uint samples) const -> u64;
+
+    /* Integrate and remove 'count' complete samples, writing them 'stride'
+     * floats apart */
+    void read_samples(float* out, uint count, uint stride);
+
+    /* Drop the unread samples and start again at a clock time, holding
+     * 'level', at a (possibly new) sample rate */
+    void restart(u64 clock_time, uint sample_rate, float level);
+
+private:
+    using Kernel = std::array<float, KERNEL_WIDTH>;
+    static auto kernels() -> const std::array<Kernel, KERNEL_PHASES>&;
+
+    auto sample_position(u64 clock_time) const -> u64;
+
+    u64 sample_rate;
+
+    /* Absolute index of buffer[0] */
+    u64 samples_read = 0;
+    float accumulator = 0.0f;
+
+    std::vector<float> buffer;
+};
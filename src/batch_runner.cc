@@ -0,0 +1,241 @@
+#include "batch_runner.h"
+
+#include "gameboy.h"
+#include "util/log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+BatchRunner::BatchRunner(const BatchConfig& in_config) :
+    config(in_config),
+    remaining(0)
+{
+    if (config.threads == 0) { config.threads = std::max(1u, std::thread::hardware_concurrency()); }
+    if (config.frames_per_quantum == 0) { config.frames_per_quantum = 1; }
+}
+
+BatchRunner::~BatchRunner() = default;
+
+auto BatchRunner::make_session(const std::string& name, const Options& options, std::vector<uint> checkpoints)
+    -> std::unique_ptr<Session> {
+    auto session = std::make_unique<Session>();
+    session->options = options;
+    session->checkpoints = std::move(checkpoints);
+    std::sort(session->checkpoints.begin(), session->checkpoints.end());
+    session->result.name = name;
+
+    /* Batch sessions are paced by their workers and never block */
+    session->options.speed_mode = SpeedMode::Unthrottled;
+    session->options.debugger = false;
+    session->options.print_serial = false;
+
+    return session;
+}
+
+void BatchRunner::add_session(const std::string& name, std::shared_ptr<const RomImage> rom, const Options& options,
+                              std::vector<uint> checkpoints) {
+    auto session = make_session(name, options, std::move(checkpoints));
+    session->rom = std::move(rom);
+    sessions.push_back(std::move(session));
+}
+
+void BatchRunner::add_session(const std::string& name, std::unique_ptr<Gameboy> gameboy,
+                              std::vector<uint> checkpoints) {
+    auto session = make_session(name, gameboy->get_options(), std::move(checkpoints));
+    session->first_frame = gameboy->frame_count();
+
+    /* Taken up as its next frame starts */
+    gameboy->configure(session->options);
+    gameboy->set_speed(SpeedMode::Unthrottled);
+
+    session->gameboy = std::move(gameboy);
+    sessions.push_back(std::move(session));
+}
+
+auto BatchRunner::run() -> std::vector<BatchResult> {
+    uint threads = std::min(config.threads, std::max(1u, static_cast<uint>(sessions.size())));
+
+    queues.clear();
+    for (uint i = 0; i < threads; i++) { queues.push_back(std::make_unique<WorkQueue>()); }
+
+    /* Deal the sessions out round robin; stealing evens out the rest */
+    for (uint i = 0; i < sessions.size(); i++) {
+        queues[i % threads]->sessions.push_back(i);
+    }
+    remaining = static_cast<uint>(sessions.size());
+
+    std::vector<std::thread> workers;
+    for (uint i = 0; i < threads; i++) {
+        workers.emplace_back([this, i]() { worker(i); });
+    }
+    for (auto& thread : workers) { thread.join(); }
+
+    std::vector<BatchResult> results;
+    for (auto& session : sessions) {
+        results.push_back(session->result);
+        session->gameboy.reset();
+    }
+    return results;
+}
+
+void BatchRunner::worker(const uint index) {
+    while (remaining > 0) {
+        uint session_index;
+        if (!next_task(index, session_index)) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        if (run_quantum(*sessions[session_index])) {
+            remaining--;
+        } else {
+            std::lock_guard<std::mutex> lock(queues[index]->mutex);
+            queues[index]->sessions.push_back(session_index);
+        }
+    }
+}
+
+auto BatchRunner::next_task(const uint index, uint& session) -> bool {
+    auto now = std::chrono::steady_clock::now();
+
+    {
+        WorkQueue& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        auto found = std::find_if(own.sessions.begin(), own.sessions.end(),
+                                  [&](uint candidate) { return ready(candidate, now); });
+        if (found != own.sessions.end()) {
+            session = *found;
+            own.sessions.erase(found);
+            return true;
+        }
+    }
+
+    for (uint offset = 1; offset < queues.size(); offset++) {
+        WorkQueue& victim = *queues[(index + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        auto found = std::find_if(victim.sessions.rbegin(), victim.sessions.rend(),
+                                  [&](uint candidate) { return ready(candidate, now); });
+        if (found != victim.sessions.rend()) {
+            session = *found;
+            victim.sessions.erase(std::next(found).base());
+            return true;
+        }
+    }
+
+    return false;
+}
+
+auto BatchRunner::ready(const uint session, const std::chrono::steady_clock::time_point now) const -> bool {
+    return sessions[session]->not_before <= now;
+}
+
+auto BatchRunner::run_quantum(Session& session) -> bool {
+    BatchResult& result = session.result;
+
+    if (!session.started && !start_session(session)) { return true; }
+
+    Gameboy& gameboy = *session.gameboy;
+    auto start = std::chrono::steady_clock::now();
+
+    /* Sessions with exit_on_infinite_jr set also end when they hit one */
+    const FrameBuffer* frame = nullptr;
+
+    /* A throttled frame ends the quantum, and the session waits out its
+     * length in real time before running again */
+    uint throttled_cycles = 0;
+
+    uint frames = std::min(config.frames_per_quantum, config.max_frames - result.frames);
+    for (uint i = 0; i < frames && !result.stopped && throttled_cycles == 0; i++) {
+        StepResult step = gameboy.run_frame();
+        result.cycles += step.cycles;
+        result.stopped = step.stopped;
+        if (step.throttled) { throttled_cycles = step.cycles; }
+        if (step.frames == 0) { continue; }
+
+        result.frames += step.frames;
+        if (step.frame == nullptr) { continue; }
+        frame = step.frame;
+
+        std::vector<uint>& checkpoints = session.checkpoints;
+        while (session.next_checkpoint < checkpoints.size()
+               && checkpoints[session.next_checkpoint] <= result.frames) {
+            if (checkpoints[session.next_checkpoint] == result.frames) {
+                result.checkpoint_hashes.push_back({ result.frames, hash_frame(*frame) });
+            }
+            session.next_checkpoint++;
+        }
+    }
+
+    if (frame != nullptr) { result.frame_hash = hash_frame(*frame); }
+    result.matched = find_stop_string(result.serial_output);
+    /* A fatal error only ends the session it happened in */
+    result.error = gameboy.error();
+
+    result.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    auto length = std::chrono::duration<double>(static_cast<double>(throttled_cycles) / CLOCK_RATE);
+    session.not_before = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(length);
+
+    bool checkpoints_done = session.next_checkpoint >= session.checkpoints.size();
+    bool finished = result.stopped
+        || (!result.matched.empty() && checkpoints_done)
+        || result.frames >= config.max_frames;
+    if (finished) { session.gameboy.reset(); }
+
+    return finished;
+}
+
+auto BatchRunner::start_session(Session& session) -> bool {
+    BatchResult& result = session.result;
+    session.started = true;
+
+    /* Built on the first worker to pick the session up, so cartridge
+     * parsing is spread across the pool too */
+    if (!session.gameboy) {
+        try {
+            session.gameboy = std::make_unique<Gameboy>(session.rom, session.options);
+        } catch (const FatalError& error) {
+            result.error = error.what();
+            return false;
+        }
+    }
+
+    session.gameboy->register_serial_callback([&result](u8 byte) {
+        result.serial_output.push_back(static_cast<char>(byte));
+    });
+
+    /* Checkpoints are drawn even when frames are being skipped */
+    if (session.options.frame_skip > 0 && !session.checkpoints.empty()) {
+        const std::vector<uint>& checkpoints = session.checkpoints;
+        uint interval = session.options.frame_skip + 1;
+        u64 first_frame = session.first_frame;
+        session.gameboy->set_frame_filter([&checkpoints, interval, first_frame](u64 frame) {
+            return frame % interval == 0
+                || std::binary_search(checkpoints.begin(), checkpoints.end(),
+                                      static_cast<uint>(frame + 1 - first_frame));
+        });
+    }
+
+    return true;
+}
+
+auto BatchRunner::find_stop_string(const std::string& output) const -> std::string {
+    for (const std::string& stop : config.stop_strings) {
+        if (output.find(stop) != std::string::npos) { return stop; }
+    }
+    return "";
+}
+
+auto BatchRunner::hash_frame(const FrameBuffer& frame) -> u64 {
+    const u8* row = frame.front();
+
+    u64 hash = 14695981039346656037ull;
+    for (uint y = 0; y < frame.height(); y++) {
+        for (uint x = 0; x < frame.width() * frame.bytes_per_pixel(); x++) {
+            hash = (hash ^ row[x]) * 1099511628211ull;
+        }
+        row += frame.pitch();
+    }
+    return hash;
+}
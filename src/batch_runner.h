@@ -0,0 +1,134 @@
+#pragma once
+
+#include "definitions.h"
+#include "options.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Gameboy;
+class FrameBuffer;
+class RomImage;
+
+struct BatchConfig {
+    /* Worker threads; 0 uses one per hardware thread */
+    uint threads = 0;
+
+    /* Frames a session runs before its worker picks the next task */
+    uint frames_per_quantum = 60;
+
+    /* Sessions stop after this many frames at the latest */
+    uint max_frames = 60 * 60;
+
+    /* A session also stops once its serial output contains one of these */
+    std::vector<std::string> stop_strings;
+};
+
+struct FrameHash {
+    uint frame;
+    u64 hash;
+};
+
+struct BatchResult {
+    std::string name;
+
+    /* Empty if the session ran into max_frames */
+    std::string matched;
+
+    uint frames = 0;
+
+    /* FNV-1a of the last frame drawn, in the session's pixel format */
+    u64 frame_hash = 0;
+
+    /* The same hash for each checkpoint frame the session reached */
+    std::vector<FrameHash> checkpoint_hashes;
+
+    /* The session stopped itself: exit_on_infinite_jr or a fatal error */
+    bool stopped = false;
+
+    u64 cycles = 0;
+
+    /* Host time spent running the session, over all of its quanta */
+    double seconds = 0.0;
+
+    std::string serial_output;
+
+    /* Set if the session stopped on a fatal error */
+    std::string error;
+};
+
+/*
+ * Runs many independent Gameboy sessions on a pool of worker threads.
+ *
+ * Every worker has its own queue of sessions. A worker runs the session at
+ * the front of its queue for one quantum and, unless it has finished, puts
+ * it back at the end; a worker with an empty queue steals from the back of
+ * someone else's. Sessions never run on two threads at once, and nothing is
+ * shared between them besides the queues. A session the watchdog throttles
+ * is passed over until its last quantum would have ended in real time, so
+ * its worker gets on with the others meanwhile.
+ */
+class BatchRunner {
+public:
+    explicit BatchRunner(const BatchConfig& config);
+    ~BatchRunner();
+
+    /* A session isn't stopped by one of the stop strings before it has
+     * reached all of its checkpoint frames */
+    void add_session(const std::string& name, std::shared_ptr<const RomImage> rom, const Options& options,
+                     std::vector<uint> checkpoints = {});
+
+    /* A session carrying on with an instance made elsewhere, e.g. one of
+     * several forked from the same point (see Gameboy::fork), so they all
+     * run across the pool. Frames and checkpoints count from where it is
+     * now. It must not have the debugger on */
+    void add_session(const std::string& name, std::unique_ptr<Gameboy> gameboy, std::vector<uint> checkpoints = {});
+
+    /* Runs every session to completion, returning results in the order the
+     * sessions were added */
+    auto run() -> std::vector<BatchResult>;
+
+private:
+    struct Session {
+        std::shared_ptr<const RomImage> rom;
+        Options options;
+        std::vector<uint> checkpoints;
+        uint next_checkpoint = 0;
+        std::unique_ptr<Gameboy> gameboy;
+        /* The instance's frame count when the session started */
+        u64 first_frame = 0;
+        bool started = false;
+        /* Not run again before then, while throttled */
+        std::chrono::steady_clock::time_point not_before;
+        BatchResult result;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<uint> sessions;
+    };
+
+    static auto make_session(const std::string& name, const Options& options, std::vector<uint> checkpoints)
+        -> std::unique_ptr<Session>;
+
+    void worker(uint index);
+    /* Builds the session's instance if it has none yet, and hooks it up */
+    auto start_session(Session& session) -> bool;
+    auto next_task(uint index, uint& session) -> bool;
+    auto ready(uint session, std::chrono::steady_clock::time_point now) const -> bool;
+    auto run_quantum(Session& session) -> bool;
+    auto find_stop_string(const std::string& output) const -> std::string;
+
+    static auto hash_frame(const FrameBuffer& frame) -> u64;
+
+    BatchConfig config;
+
+    std::vector<std::unique_ptr<Session>> sessions;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::atomic<uint> remaining;
+};
@@ -0,0 +1,187 @@
+#include "battery_writer.h"
+#include "cartridge/cartridge.h"
+#include "util/log.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+const uint SAVE_PAGE_SIZE = 0x100;
+
+/* Onto the disk itself. On macOS fsync only gets as far as the drive's
+ * cache, and fdatasync doesn't exist */
+auto sync_file(const int file) -> bool {
+#if defined(__APPLE__)
+    return fcntl(file, F_FULLFSYNC) != -1 || fsync(file) == 0;
+#else
+    return fdatasync(file) == 0;
+#endif
+}
+} // namespace
+
+BatteryWriter::BatteryWriter(const std::string& in_filename, const std::vector<u8>& ram) :
+    filename(in_filename),
+    image(ram),
+    dirty_pages((ram.size() + SAVE_PAGE_SIZE - 1) / SAVE_PAGE_SIZE, 0)
+{
+    file = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (file == -1) {
+        fatal_error("Cannot write to file: %s", filename.c_str());
+    }
+
+    /* A new or mismatched file gets all of it, as soon as possible */
+    struct stat info = {};
+    if (fstat(file, &info) != 0 || static_cast<size_t>(info.st_size) != image.size()) {
+        if (ftruncate(file, static_cast<off_t>(image.size())) != 0) {
+            log_warn("Cannot resize save file %s: %s", filename.c_str(), strerror(errno));
+        }
+        mark_changed(0, static_cast<uint>(image.size()));
+        first_change = last_change - MAX_DELAY;
+    }
+
+    thread = std::thread([this]() { run(); });
+}
+
+BatteryWriter::~BatteryWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+
+    close(file);
+}
+
+void BatteryWriter::submit(const RamChanges& changes) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        const u8* bytes = changes.bytes.data();
+        for (const RamChanges::Range& range : changes.ranges) {
+            if (range.offset + range.size > image.size()) { break; }
+
+            /* Pages reported changed may hold what they did, e.g. after
+             * a state load put them back */
+            if (std::memcmp(&image[range.offset], bytes, range.size) != 0) {
+                std::memcpy(&image[range.offset], bytes, range.size);
+                mark_changed(range.offset, range.size);
+            }
+            bytes += range.size;
+        }
+    }
+    wake.notify_one();
+}
+
+auto BatteryWriter::finish(const std::vector<u8>& ram) -> bool {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (ram.size() == image.size()) {
+        for (uint offset = 0; offset < ram.size(); offset += SAVE_PAGE_SIZE) {
+            uint size = std::min(SAVE_PAGE_SIZE, static_cast<uint>(ram.size()) - offset);
+            if (std::memcmp(&image[offset], &ram[offset], size) == 0) { continue; }
+
+            std::memcpy(&image[offset], &ram[offset], size);
+            mark_changed(offset, size);
+        }
+    }
+
+    /* Written here rather than by the thread, so it's done on return */
+    return write_pending(lock);
+}
+
+auto BatteryWriter::writes() const -> uint {
+    std::lock_guard<std::mutex> lock(mutex);
+    return writes_done;
+}
+
+void BatteryWriter::mark_changed(const uint offset, const uint size) {
+    auto now = std::chrono::steady_clock::now();
+    if (!pending) { first_change = now; }
+
+    pending = true;
+    last_change = now;
+
+    for (uint page = offset / SAVE_PAGE_SIZE; page * SAVE_PAGE_SIZE < offset + size; page++) {
+        dirty_pages[page] = 1;
+    }
+}
+
+void BatteryWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        if (!pending) {
+            if (stopping) { return; }
+
+            wake.wait(lock);
+            continue;
+        }
+
+        auto due = std::min(last_change + QUIET_TIME, first_change + MAX_DELAY);
+        if (!stopping && std::chrono::steady_clock::now() < due) {
+            wake.wait_until(lock, due);
+            continue;
+        }
+
+        /* Retrying straight away while stopping would never end, and
+         * keep the destructor waiting, so that was the last chance */
+        if (!write_pending(lock) && stopping) {
+            log_error("Save file %s is missing the latest changes", filename.c_str());
+            std::fill(dirty_pages.begin(), dirty_pages.end(), 0);
+            pending = false;
+            return;
+        }
+    }
+}
+
+auto BatteryWriter::write_pending(std::unique_lock<std::mutex>& lock) -> bool {
+    if (!pending) { return true; }
+
+    /* One write at a time, so an older copy of a page can't land after a
+     * newer one. Taken without holding the lock, which comes second */
+    lock.unlock();
+    std::lock_guard<std::mutex> file_lock(file_mutex);
+    lock.lock();
+
+    /* Copied out so the emulation thread isn't held up while writing */
+    std::vector<std::pair<uint, std::vector<u8>>> runs;
+    for (uint page = 0; page < dirty_pages.size(); page++) {
+        if (!dirty_pages[page]) { continue; }
+
+        uint start = page;
+        while (page < dirty_pages.size() && dirty_pages[page]) { dirty_pages[page++] = 0; }
+
+        uint offset = start * SAVE_PAGE_SIZE;
+        uint end = std::min(page * SAVE_PAGE_SIZE, static_cast<uint>(image.size()));
+        runs.emplace_back(offset, std::vector<u8>(image.begin() + offset, image.begin() + end));
+    }
+    pending = false;
+
+    lock.unlock();
+
+    bool failed = false;
+    for (const auto& run : runs) {
+        ssize_t written = pwrite(file, run.second.data(), run.second.size(), static_cast<off_t>(run.first));
+        failed |= written != static_cast<ssize_t>(run.second.size());
+    }
+    failed |= !sync_file(file);
+
+    if (failed) {
+        log_warn("Cannot write to save file %s: %s", filename.c_str(), strerror(errno));
+    }
+
+    lock.lock();
+    writes_done++;
+
+    /* Tried again once it's been quiet for a while */
+    if (failed) {
+        for (const auto& run : runs) { mark_changed(run.first, static_cast<uint>(run.second.size())); }
+    }
+    return !failed;
+}
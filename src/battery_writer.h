@@ -0,0 +1,76 @@
+#pragma once
+
+#include "definitions.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct RamChanges;
+
+/*
+ * Keeps a battery save file up to date from a background thread.
+ *
+ * The emulation thread hands over each frame's RAM changes (see
+ * Gameboy::register_battery_callback), which only get copied into a
+ * shadow of the RAM. The writer waits until the game has stopped writing
+ * for a moment, or until changes have been waiting for a while, then
+ * writes just the pages which changed in place in the file and syncs it.
+ * A crash loses at most the last few seconds.
+ */
+class BatteryWriter : Noncopyable {
+public:
+    /* Writes after this long without changes... */
+    static constexpr std::chrono::milliseconds QUIET_TIME {500};
+    /* ...or at the latest this long after the first unwritten change */
+    static constexpr std::chrono::milliseconds MAX_DELAY {5000};
+
+    /* 'ram' is what the file should hold (see Gameboy::get_battery_data). If the file
+     * doesn't match its size, it's written whole straight away. Throws
+     * FatalError if the file can't be opened */
+    BatteryWriter(const std::string& filename, const std::vector<u8>& ram);
+
+    /* Writes whatever is still pending. If that fails it's tried only
+     * once more, and the changes are dropped with an error logged */
+    ~BatteryWriter();
+
+    /* Cheap enough to be called from the emulation thread */
+    void submit(const RamChanges& changes);
+
+    /* Writes the final RAM, e.g. once the emulator has stopped, and waits
+     * until it's in the file. Returns false if it couldn't be written */
+    auto finish(const std::vector<u8>& ram) -> bool;
+
+    /* Writes done so far, for diagnostics */
+    auto writes() const -> uint;
+
+private:
+    void run();
+    /* False if something couldn't be written, which is then pending again */
+    auto write_pending(std::unique_lock<std::mutex>& lock) -> bool;
+    void mark_changed(uint offset, uint size);
+
+    int file = -1;
+    std::string filename;
+
+    /* Held while writing to the file, before 'mutex' if both are */
+    std::mutex file_mutex;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+
+    /* What the file should hold, and which pages of it it doesn't yet */
+    std::vector<u8> image;
+    std::vector<u8> dirty_pages;
+    bool pending = false;
+    std::chrono::steady_clock::time_point first_change;
+    std::chrono::steady_clock::time_point last_change;
+
+    bool stopping = false;
+    uint writes_done = 0;
+
+    std::thread thread;
+};
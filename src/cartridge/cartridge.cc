@@ -4,37 +4,82 @@
 
 #include "../util/files.h"
 #include "../util/log.h"
+#include "../save_state.h"
+#include "../scheduler.h"
 
-auto get_cartridge(const std::vector<u8>& rom_data, const std::vector<u8>& ram_data)
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+namespace {
+const uint RAM_PAGE_SIZE = 0x100;
+const uint ROM_BANK_SIZE = 0x4000;
+const uint RAM_BANK_SIZE = 0x2000;
+const uint MBC2_RAM_SIZE = 0x200;
+
+/* The clock footer saved after MBC3 RAM, with a 64-bit timestamp or, as
+ * some older emulators write it, a 32-bit one */
+const uint RTC_FOOTER_SIZE = 48;
+const uint RTC_FOOTER_SIZE_32 = 44;
+
+const uint RTC_DAYS = 512;
+
+void put_u32(std::vector<u8>& out, u32 value) {
+    for (uint i = 0; i < 4; i++) { out.push_back(static_cast<u8>(value >> (8 * i))); }
+}
+
+auto get_u32(const u8* in) -> u32 {
+    return static_cast<u32>(in[0]) | static_cast<u32>(in[1]) << 8 | static_cast<u32>(in[2]) << 16 |
+           static_cast<u32>(in[3]) << 24;
+}
+} // namespace
+
+auto get_cartridge(std::shared_ptr<const RomImage> rom_data, const std::vector<u8>& ram_data)
     -> std::shared_ptr<Cartridge> {
-    std::unique_ptr<CartridgeInfo> info = get_info(rom_data);
+    /* Shares the header the image parsed, and its reference count */
+    std::shared_ptr<const CartridgeInfo> info(rom_data, &rom_data->info());
+
+    log_info("Title:\t\t %s (version %d)", info->title.c_str(), info->version);
+    log_info("Cartridge:\t\t %s", describe(info->type).c_str());
+    log_info("Rom Size:\t\t %s", describe(info->rom_size).c_str());
+    log_info("Ram Size:\t\t %s", describe(info->ram_size).c_str());
+    log_info("CGB:\t\t %s", info->supports_cgb ? "yes" : "no");
+    log_info("");
 
     switch (info->type) {
         case CartridgeType::ROMOnly:
-            return std::make_shared<NoMBC>(rom_data, ram_data, std::move(info));
+            return std::make_shared<NoMBC>(rom_data, ram_data, info);
         case CartridgeType::MBC1:
-            return std::make_shared<MBC1>(rom_data, ram_data, std::move(info));
+            return std::make_shared<MBC1>(rom_data, ram_data, info);
         case CartridgeType::MBC2:
-            fatal_error("MBC2 is unimplemented");
+            return std::make_shared<MBC2>(rom_data, ram_data, info);
         case CartridgeType::MBC3:
-            return std::make_shared<MBC3>(rom_data, ram_data, std::move(info));
+            return std::make_shared<MBC3>(rom_data, ram_data, info);
         case CartridgeType::MBC4:
             fatal_error("MBC4 is unimplemented");
         case CartridgeType::MBC5:
-            fatal_error("MBC5 is unimplemented");
+            return std::make_shared<MBC5>(rom_data, ram_data, info);
         case CartridgeType::Unknown:
             fatal_error("Unknown cartridge type");
     }
 }
 
-Cartridge::Cartridge(std::vector<u8> rom_data, const std::vector<u8>& ram_data,
-                     std::unique_ptr<CartridgeInfo> in_cartridge_info)
+Cartridge::Cartridge(std::shared_ptr<const RomImage> rom_data, const std::vector<u8>& ram_data,
+                     std::shared_ptr<const CartridgeInfo> in_cartridge_info)
     : rom(std::move(rom_data)), cartridge_info(std::move(in_cartridge_info)) {
-    auto ram_size_for_cartridge = get_actual_ram_size(cartridge_info->ram_size);
+    /* MBC2 has its RAM built in, so the header says there is none */
+    auto ram_size_for_cartridge = cartridge_info->type == CartridgeType::MBC2
+        ? MBC2_RAM_SIZE
+        : get_actual_ram_size(cartridge_info->ram_size);
 
     if (!ram_data.empty()) {
-        if (ram_data.size() != ram_size_for_cartridge) { fatal_error("Invalid or corrupted RAM file. Read %d bytes, expected %d", ram_data.size(), ram_size_for_cartridge); }
-        ram = ram_data;
+        /* MBC3's clock, if it has one, follows the RAM (see MBC3::battery_footer) */
+        size_t footer_size = ram_data.size() - std::min<size_t>(ram_data.size(), ram_size_for_cartridge);
+        bool valid_footer = footer_size == 0 ||
+            (cartridge_info->has_rtc && (footer_size == RTC_FOOTER_SIZE || footer_size == RTC_FOOTER_SIZE_32));
+
+        if (ram_data.size() < ram_size_for_cartridge || !valid_footer) { fatal_error("Invalid or corrupted RAM file. Read %d bytes, expected %d", ram_data.size(), ram_size_for_cartridge); }
+        ram.assign(ram_data.begin(), ram_data.begin() + ram_size_for_cartridge);
     } else {
         ram = std::vector<u8>(ram_size_for_cartridge, 0);
     }
@@ -42,25 +87,292 @@ Cartridge::Cartridge(std::vector<u8> rom_data, const std::vector<u8>& ram_data,
 
 auto Cartridge::get_cartridge_ram() const -> const std::vector<u8>& { return ram; }
 
-NoMBC::NoMBC(std::vector<u8> rom_data, const std::vector<u8>& ram_data,
-             std::unique_ptr<CartridgeInfo> in_cartridge_info)
-    : Cartridge(std::move(rom_data), ram_data, std::move(in_cartridge_info)) {}
+auto Cartridge::battery_data() const -> std::vector<u8> {
+    std::vector<u8> data(ram);
+    std::vector<u8> footer = battery_footer();
+    data.insert(data.end(), footer.begin(), footer.end());
+    return data;
+}
+
+auto Cartridge::battery_footer() const -> std::vector<u8> { return {}; }
+
+void Cartridge::attach_clock(const Scheduler& scheduler) { clock = &scheduler; }
+
+void Cartridge::track_ram_writes() {
+    if (tracking_ram) { return; }
+
+    tracking_ram = true;
+    ram_dirty.assign((ram.size() + RAM_PAGE_SIZE - 1) / RAM_PAGE_SIZE, 0);
+    bank_switched();
+}
+
+auto Cartridge::collect_ram_changes(RamChanges& changes) -> bool {
+    changes.ranges.clear();
+    changes.bytes.clear();
+
+    for (uint page = 0; page < ram_dirty.size(); page++) {
+        if (!ram_dirty[page]) { continue; }
+        ram_dirty[page] = 0;
+
+        uint offset = page * RAM_PAGE_SIZE;
+        uint size = std::min(RAM_PAGE_SIZE, static_cast<uint>(ram.size()) - offset);
+
+        /* Neighbouring pages make one range */
+        if (!changes.ranges.empty() && changes.ranges.back().offset + changes.ranges.back().size == offset) {
+            changes.ranges.back().size += size;
+        } else {
+            changes.ranges.push_back({ offset, size });
+        }
+        changes.bytes.insert(changes.bytes.end(), ram.begin() + offset, ram.begin() + offset + size);
+    }
+
+    if (changes.empty() && !footer_dirty) { return false; }
+    footer_dirty = false;
+
+    std::vector<u8> footer = battery_footer();
+    if (!footer.empty()) {
+        changes.ranges.push_back({ static_cast<uint>(ram.size()), static_cast<uint>(footer.size()) });
+        changes.bytes.insert(changes.bytes.end(), footer.begin(), footer.end());
+    }
+    if (changes.empty()) { return false; }
+
+    /* Unmaps the pages again, for their next write to be seen */
+    bank_switched();
+    return true;
+}
+
+void Cartridge::ram_written(const uint offset) {
+    if (!tracking_ram) { return; }
+
+    u8& dirty = ram_dirty[offset / RAM_PAGE_SIZE];
+    if (dirty) { return; }
+
+    /* Can be mapped for writes now */
+    dirty = 1;
+    bank_switched();
+}
+
+auto Cartridge::rom_checksum() const -> u32 {
+    if (rom->size() <= header::global_checksum + 1) { return 0; }
+
+    return static_cast<u32>((*rom)[header::header_checksum] << 16)
+         | static_cast<u32>((*rom)[header::global_checksum] << 8)
+         | (*rom)[header::global_checksum + 1];
+}
+
+void Cartridge::save_state(StateWriter& writer) const {
+    save_mbc_state(writer);
+    writer.write_bytes(StateSection::CartridgeRam, ram.data(), static_cast<uint>(ram.size()));
+}
+
+void Cartridge::load_state(StateReader& reader) {
+    load_mbc_state(reader);
+
+    /* Only the pages which differ count as changed, so restoring run-ahead's
+     * snapshot every frame doesn't have the whole save rewritten */
+    const u8* saved = reader.read_view(StateSection::CartridgeRam, static_cast<uint>(ram.size()));
+    for (uint offset = 0; offset < ram.size(); offset += RAM_PAGE_SIZE) {
+        uint size = std::min(RAM_PAGE_SIZE, static_cast<uint>(ram.size()) - offset);
+        if (std::memcmp(&ram[offset], saved + offset, size) == 0) { continue; }
+
+        std::memcpy(&ram[offset], saved + offset, size);
+        if (tracking_ram) { ram_dirty[offset / RAM_PAGE_SIZE] = 1; }
+    }
+    bank_switched();
+}
+
+void Cartridge::save_mbc_state(StateWriter& writer) const {
+    unused(writer);
+}
+
+void Cartridge::load_mbc_state(StateReader& reader) {
+    unused(reader);
+}
+
+auto Cartridge::read_page(const u8 page) -> const u8* {
+    unused(page);
+    return nullptr;
+}
+
+auto Cartridge::write_page(const u8 page) -> u8* {
+    unused(page);
+    return nullptr;
+}
+
+void Cartridge::register_bank_switch_callback(const bank_switch_callback_t& callback) {
+    bank_switch_callback = callback;
+}
+
+void Cartridge::bank_switched() {
+    if (bank_switch_callback) { bank_switch_callback(); }
+}
+
+auto Cartridge::rom_page(const uint offset) const -> const u8* {
+    if (offset + 0x100 > rom->size()) { return nullptr; }
+    return rom->data() + offset;
+}
+
+void Cartridge::select_rom_bank(const uint bank) {
+    auto banks = static_cast<uint>(rom->size() / ROM_BANK_SIZE);
+    if (banks == 0) {
+        rom_bank_base = nullptr;
+        return;
+    }
+
+    rom_bank_base = rom->data() + (bank % banks) * ROM_BANK_SIZE;
+}
+
+void Cartridge::select_ram_bank(const uint bank) {
+    if (ram.empty()) {
+        ram_bank_base = nullptr;
+        ram_bank_size = 0;
+        return;
+    }
+
+    auto banks = std::max(1u, static_cast<uint>(ram.size() / RAM_BANK_SIZE));
+    uint offset = (bank % banks) * RAM_BANK_SIZE;
+    ram_bank_base = ram.data() + offset;
+    ram_bank_size = std::min(RAM_BANK_SIZE, static_cast<uint>(ram.size()) - offset);
+}
+
+auto Cartridge::rom_bank_page(const u8 page) const -> const u8* {
+    if (rom_bank_base == nullptr) { return nullptr; }
+    return rom_bank_base + (page - 0x40) * 0x100;
+}
+
+auto Cartridge::ram_bank_page(const u8 page) -> u8* {
+    uint offset = (page - 0xA0) * 0x100;
+    if (ram_bank_base == nullptr || offset + 0x100 > ram_bank_size) { return nullptr; }
+    return ram_bank_base + offset;
+}
+
+auto Cartridge::writable_ram_bank_page(const u8 page) -> u8* {
+    u8* data = ram_bank_page(page);
+    if (data == nullptr || !tracking_ram) { return data; }
+
+    return ram_dirty[static_cast<uint>(data - ram.data()) / RAM_PAGE_SIZE] ? data : nullptr;
+}
+
+auto Cartridge::read_rom(const Address& address) const -> u8 {
+    if (address.value() < ROM_BANK_SIZE) {
+        return address.value() < rom->size() ? (*rom)[address.value()] : 0xFF;
+    }
+
+    if (rom_bank_base == nullptr) { return 0xFF; }
+    return rom_bank_base[address.value() - ROM_BANK_SIZE];
+}
+
+auto Cartridge::read_ram(const Address& address) const -> u8 {
+    uint offset = address.value() - 0xA000;
+    if (offset >= ram_bank_size) { return 0xFF; }
+    return ram_bank_base[offset];
+}
+
+void Cartridge::write_ram(const Address& address, const u8 value) {
+    uint offset = address.value() - 0xA000;
+    if (offset >= ram_bank_size) { return; }
+    ram_bank_base[offset] = value;
+    ram_written(static_cast<uint>(ram_bank_base - ram.data()) + offset);
+}
+
+NoMBC::NoMBC(std::shared_ptr<const RomImage> rom_data, const std::vector<u8>& ram_data,
+             std::shared_ptr<const CartridgeInfo> in_cartridge_info)
+    : Cartridge(std::move(rom_data), ram_data, std::move(in_cartridge_info)) {
+    select_rom_bank(1);
+}
 
 void NoMBC::write(const Address& address, u8 value) {
     log_warn("Attempting to write to cartridge ROM without an MBC");
 }
 
 auto NoMBC::read(const Address& address) const -> u8 {
-    /* TODO: check this address is in sensible bounds */
-    return rom.at(address.value());
+    if (address.in_range(0x0000, 0x7FFF)) { return read_rom(address); }
+    return 0xFF;
 }
 
-MBC1::MBC1(std::vector<u8> rom_data, const std::vector<u8>& ram_data,
-           std::unique_ptr<CartridgeInfo> in_cartridge_info)
+auto NoMBC::read_page(const u8 page) -> const u8* {
+    if (page <= 0x3F) { return rom_page(page * 0x100); }
+    if (page <= 0x7F) { return rom_bank_page(page); }
+    return nullptr;
+}
+
+MBC1::MBC1(std::shared_ptr<const RomImage> rom_data, const std::vector<u8>& ram_data,
+           std::shared_ptr<const CartridgeInfo> in_cartridge_info)
     : Cartridge(std::move(rom_data), ram_data, std::move(in_cartridge_info)) {
     unused(rom_banking_mode);
 
     rom_bank.set(0x1);
+    update_banks();
+}
+
+namespace {
+struct MBC1State {
+    u16 rom_bank;
+    u16 ram_bank;
+    bool ram_enabled;
+    bool rom_banking_mode;
+};
+
+struct MBC2State {
+    u16 rom_bank;
+    bool ram_enabled;
+    u8 unused;
+};
+
+struct MBC3State {
+    u64 rtc_synced_at;
+    u64 rtc_subsecond;
+    u16 rom_bank;
+    u16 ram_bank;
+    u16 rtc_days;
+    u16 latched_days;
+    bool ram_enabled;
+    bool ram_over_rtc;
+    bool rom_banking_mode;
+    u8 rtc_register;
+    u8 rtc_seconds;
+    u8 rtc_minutes;
+    u8 rtc_hours;
+    /* Bit 6 halted, bit 7 day carry, as in the DH register */
+    u8 rtc_flags;
+    u8 latched_seconds;
+    u8 latched_minutes;
+    u8 latched_hours;
+    u8 latched_flags;
+    u8 last_latch_write;
+    u8 unused[3];
+};
+
+struct MBC5State {
+    u16 rom_bank;
+    u16 ram_bank;
+    bool ram_enabled;
+    u8 unused;
+};
+} // namespace
+
+void MBC1::save_mbc_state(StateWriter& writer) const {
+    MBC1State state = {};
+    state.rom_bank = rom_bank.value();
+    state.ram_bank = ram_bank.value();
+    state.ram_enabled = ram_enabled;
+    state.rom_banking_mode = rom_banking_mode;
+    writer.write(StateSection::Cartridge, state);
+}
+
+void MBC1::load_mbc_state(StateReader& reader) {
+    MBC1State state;
+    reader.read(StateSection::Cartridge, state);
+    rom_bank.set(state.rom_bank);
+    ram_bank.set(state.ram_bank);
+    ram_enabled = state.ram_enabled;
+    rom_banking_mode = state.rom_banking_mode;
+    update_banks();
+}
+
+void MBC1::update_banks() {
+    select_rom_bank(rom_bank.value());
+    select_ram_bank(ram_bank.value());
 }
 
 void MBC1::write(const Address& address, u8 value) {
@@ -69,14 +381,18 @@ void MBC1::write(const Address& address, u8 value) {
     }
 
     if (address.in_range(0x2000, 0x3FFF)) {
-        if (value == 0x0) { rom_bank.set(0x1); }
-
-        if (value == 0x20) { rom_bank.set(0x21); return; }
-        if (value == 0x40) { rom_bank.set(0x41); return; }
-        if (value == 0x60) { rom_bank.set(0x61); return; }
-
-        u16 rom_bank_bits = value & 0x1F;
-        rom_bank.set(rom_bank_bits);
+        if (value == 0x0) {
+            rom_bank.set(0x1);
+        } else if (value == 0x20) {
+            rom_bank.set(0x21);
+        } else if (value == 0x40) {
+            rom_bank.set(0x41);
+        } else if (value == 0x60) {
+            rom_bank.set(0x61);
+        } else {
+            u16 rom_bank_bits = value & 0x1F;
+            rom_bank.set(rom_bank_bits);
+        }
     }
 
     if (address.in_range(0x4000, 0x5FFF)) {
@@ -87,43 +403,181 @@ void MBC1::write(const Address& address, u8 value) {
         log_unimplemented("Unimplemented: Selecting ROM/RAM Mode");
     }
 
+    if (address.in_range(0x0000, 0x7FFF)) {
+        update_banks();
+        bank_switched();
+        return;
+    }
+
     if (address.in_range(0xA000, 0xBFFF)) {
         if (!ram_enabled) { return; }
-
-        auto offset_into_ram = 0x2000 * ram_bank.value();
-        auto address_in_ram = (address - 0xA000) + offset_into_ram;
-        ram.at(address_in_ram.value()) = value;
+        write_ram(address, value);
     }
 }
 
 auto MBC1::read(const Address& address) const -> u8 {
+    if (address.in_range(0x0000, 0x7FFF)) { return read_rom(address); }
+    if (address.in_range(0xA000, 0xBFFF)) { return read_ram(address); }
+
+    fatal_error("Attempted to read from unmapped MBC1 address 0x%x", address.value());
+}
+
+auto MBC1::read_page(const u8 page) -> const u8* {
+    if (page <= 0x3F) { return rom_page(page * 0x100); }
+    if (page <= 0x7F) { return rom_bank_page(page); }
+    if (page >= 0xA0 && page <= 0xBF) { return ram_bank_page(page); }
+
+    return nullptr;
+}
+
+auto MBC1::write_page(const u8 page) -> u8* {
+    if (!ram_enabled) { return nullptr; }
+    if (page >= 0xA0 && page <= 0xBF) { return writable_ram_bank_page(page); }
+
+    return nullptr;
+}
+
+MBC2::MBC2(std::shared_ptr<const RomImage> rom_data, const std::vector<u8>& ram_data,
+           std::shared_ptr<const CartridgeInfo> in_cartridge_info)
+    : Cartridge(std::move(rom_data), ram_data, std::move(in_cartridge_info)) {
+    /* Only the low half of each byte exists; the rest reads as set. Keeping
+     * it set in memory lets RAM reads go through the page table */
+    for (u8& cell : ram) { cell |= 0xF0; }
+
+    rom_bank.set(0x1);
+    select_rom_bank(rom_bank.value());
+}
+
+void MBC2::save_mbc_state(StateWriter& writer) const {
+    MBC2State state = {};
+    state.rom_bank = rom_bank.value();
+    state.ram_enabled = ram_enabled;
+    writer.write(StateSection::Cartridge, state);
+}
+
+void MBC2::load_mbc_state(StateReader& reader) {
+    MBC2State state;
+    reader.read(StateSection::Cartridge, state);
+    rom_bank.set(state.rom_bank);
+    ram_enabled = state.ram_enabled;
+    select_rom_bank(rom_bank.value());
+}
+
+void MBC2::write(const Address& address, u8 value) {
+    /* Bit 8 of the address picks between the two registers */
     if (address.in_range(0x0000, 0x3FFF)) {
-        return rom.at(address.value());
+        if ((address.value() & 0x100) == 0) {
+            ram_enabled = (value & 0x0F) == 0x0A;
+        } else {
+            u16 rom_bank_bits = value & 0x0F;
+            rom_bank.set(rom_bank_bits == 0 ? 0x1 : rom_bank_bits);
+            select_rom_bank(rom_bank.value());
+        }
     }
 
-    if (address.in_range(0x4000, 0x7FFF)) {
-        u16 address_into_bank = address.value() - 0x4000;
-        uint bank_offset = 0x4000 * rom_bank.value();
+    if (address.in_range(0x0000, 0x7FFF)) {
+        bank_switched();
+        return;
+    }
 
-        uint address_in_rom = bank_offset + address_into_bank;
-        return rom.at(address_in_rom);
+    /* The 512 cells repeat through the whole RAM area */
+    if (address.in_range(0xA000, 0xBFFF)) {
+        if (!ram_enabled) { return; }
+        uint offset = (address.value() - 0xA000) & (MBC2_RAM_SIZE - 1);
+        ram[offset] = value | 0xF0;
+        ram_written(offset);
     }
+}
+
+auto MBC2::read(const Address& address) const -> u8 {
+    if (address.in_range(0x0000, 0x7FFF)) { return read_rom(address); }
 
     if (address.in_range(0xA000, 0xBFFF)) {
-        auto offset_into_ram = 0x2000 * ram_bank.value();
-        auto address_in_ram = (address - 0xA000) + offset_into_ram;
-        return ram.at(address_in_ram.value());
+        if (!ram_enabled) { return 0xFF; }
+        return ram[(address.value() - 0xA000) & (MBC2_RAM_SIZE - 1)];
     }
 
-    fatal_error("Attempted to read from unmapped MBC1 address 0x%x", address.value());
+    fatal_error("Attempted to read from unmapped MBC2 address 0x%x", address.value());
 }
 
-MBC3::MBC3(std::vector<u8> rom_data, const std::vector<u8>& ram_data,
-           std::unique_ptr<CartridgeInfo> in_cartridge_info)
+auto MBC2::read_page(const u8 page) -> const u8* {
+    if (page <= 0x3F) { return rom_page(page * 0x100); }
+    if (page <= 0x7F) { return rom_bank_page(page); }
+
+    /* Writes always take the slow path, which masks them to 4 bits */
+    if (page >= 0xA0 && page <= 0xBF && ram_enabled) {
+        return ram.data() + (((page - 0xA0) * 0x100) & (MBC2_RAM_SIZE - 1));
+    }
+
+    return nullptr;
+}
+
+MBC3::MBC3(std::shared_ptr<const RomImage> rom_data, const std::vector<u8>& ram_data,
+           std::shared_ptr<const CartridgeInfo> in_cartridge_info)
     : Cartridge(std::move(rom_data), ram_data, std::move(in_cartridge_info)) {
     unused(rom_banking_mode);
 
     rom_bank.set(0x1);
+    update_banks();
+
+    if (ram_data.size() > ram.size()) { load_rtc_footer(ram_data); }
+}
+
+void MBC3::save_mbc_state(StateWriter& writer) const {
+    MBC3State state = {};
+    state.rtc_synced_at = rtc_synced_at;
+    state.rtc_subsecond = rtc_subsecond;
+    state.rom_bank = rom_bank.value();
+    state.ram_bank = ram_bank.value();
+    state.rtc_days = static_cast<u16>(rtc.days);
+    state.latched_days = static_cast<u16>(latched_rtc.days);
+    state.ram_enabled = ram_enabled;
+    state.ram_over_rtc = ram_over_rtc;
+    state.rom_banking_mode = rom_banking_mode;
+    state.rtc_register = rtc_register;
+    state.rtc_seconds = static_cast<u8>(rtc.seconds);
+    state.rtc_minutes = static_cast<u8>(rtc.minutes);
+    state.rtc_hours = static_cast<u8>(rtc.hours);
+    state.rtc_flags = rtc.read(0x0C) & 0xC0;
+    state.latched_seconds = static_cast<u8>(latched_rtc.seconds);
+    state.latched_minutes = static_cast<u8>(latched_rtc.minutes);
+    state.latched_hours = static_cast<u8>(latched_rtc.hours);
+    state.latched_flags = latched_rtc.read(0x0C) & 0xC0;
+    state.last_latch_write = last_latch_write;
+    writer.write(StateSection::Cartridge, state);
+}
+
+void MBC3::load_mbc_state(StateReader& reader) {
+    MBC3State state;
+    reader.read(StateSection::Cartridge, state);
+    rom_bank.set(state.rom_bank);
+    ram_bank.set(state.ram_bank);
+    ram_enabled = state.ram_enabled;
+    ram_over_rtc = state.ram_over_rtc;
+    rom_banking_mode = state.rom_banking_mode;
+    rtc_register = state.rtc_register;
+    last_latch_write = state.last_latch_write;
+
+    rtc_synced_at = state.rtc_synced_at;
+    rtc_subsecond = state.rtc_subsecond;
+    auto load_time = [](RtcTime& time, u8 seconds, u8 minutes, u8 hours, u16 days, u8 flags) {
+        time.seconds = seconds;
+        time.minutes = minutes;
+        time.hours = hours;
+        time.days = days % RTC_DAYS;
+        time.halted = (flags & 0x40) != 0;
+        time.day_carry = (flags & 0x80) != 0;
+    };
+    load_time(rtc, state.rtc_seconds, state.rtc_minutes, state.rtc_hours, state.rtc_days, state.rtc_flags);
+    load_time(latched_rtc, state.latched_seconds, state.latched_minutes, state.latched_hours,
+              state.latched_days, state.latched_flags);
+
+    update_banks();
+}
+
+void MBC3::update_banks() {
+    select_rom_bank(rom_bank.value());
+    select_ram_bank(ram_bank.value());
 }
 
 void MBC3::write(const Address& address, u8 value) {
@@ -138,10 +592,8 @@ void MBC3::write(const Address& address, u8 value) {
     }
 
     if (address.in_range(0x2000, 0x3FFF)) {
-        if (value == 0x0) { rom_bank.set(0x1); }
-
         u16 rom_bank_bits = value & 0x7F;
-        rom_bank.set(rom_bank_bits);
+        rom_bank.set(rom_bank_bits == 0 ? 0x1 : rom_bank_bits);
     }
 
     if (address.in_range(0x4000, 0x5FFF)) {
@@ -152,43 +604,247 @@ void MBC3::write(const Address& address, u8 value) {
 
         if (value >= 0x08 && value <= 0xC) {
             ram_over_rtc = false;
-            log_unimplemented("Using RTC registers of MBC3 cartridge");
+            rtc_register = value;
         }
     }
 
     if (address.in_range(0x6000, 0x7FFF)) {
-        log_unimplemented("Unimplemented: Latch clock data");
+        if (last_latch_write == 0x00 && value == 0x01) {
+            latched_rtc = current_rtc();
+            footer_written();
+        }
+        last_latch_write = value;
+    }
+
+    if (address.in_range(0x0000, 0x7FFF)) {
+        update_banks();
+        bank_switched();
+        return;
     }
 
     if (address.in_range(0xA000, 0xBFFF)) {
         if (!ram_enabled) { return; }
 
         if (ram_over_rtc) {
-            auto offset_into_ram = 0x2000 * ram_bank.value();
-            auto address_in_ram = (address - 0xA000) + offset_into_ram;
-            ram.at(address_in_ram.value()) = value;
+            write_ram(address, value);
+            return;
         }
+
+        sync_rtc();
+        /* Writing the seconds also restarts the second in progress */
+        if (rtc_register == 0x08) { rtc_subsecond = 0; }
+        rtc.write(rtc_register, value);
+        footer_written();
     }
 }
 
 auto MBC3::read(const Address& address) const -> u8 {
-    if (address.in_range(0x0000, 0x3FFF)) {
-        return rom.at(address.value());
+    if (address.in_range(0x0000, 0x7FFF)) { return read_rom(address); }
+
+    if (address.in_range(0xA000, 0xBFFF)) {
+        if (ram_over_rtc) { return read_ram(address); }
+
+        /* The clock registers only ever show the time last latched */
+        return ram_enabled ? latched_rtc.read(rtc_register) : 0xFF;
     }
 
-    if (address.in_range(0x4000, 0x7FFF)) {
-        u16 address_into_bank = address.value() - 0x4000;
-        uint bank_offset = 0x4000 * rom_bank.value();
+    fatal_error("Attempted to read from unmapped MBC3 address 0x%x", address.value());
+}
+
+auto MBC3::read_page(const u8 page) -> const u8* {
+    if (page <= 0x3F) { return rom_page(page * 0x100); }
+    if (page <= 0x7F) { return rom_bank_page(page); }
+    if (page >= 0xA0 && page <= 0xBF && ram_over_rtc) { return ram_bank_page(page); }
+
+    return nullptr;
+}
+
+auto MBC3::write_page(const u8 page) -> u8* {
+    if (!ram_enabled || !ram_over_rtc) { return nullptr; }
+    if (page >= 0xA0 && page <= 0xBF) { return writable_ram_bank_page(page); }
 
-        uint address_in_rom = bank_offset + address_into_bank;
-        return rom.at(address_in_rom);
+    return nullptr;
+}
+
+auto MBC3::current_rtc(u64* subsecond) const -> RtcTime {
+    RtcTime time = rtc;
+    u64 clocks = rtc_subsecond;
+
+    if (!time.halted && clock != nullptr) {
+        clocks += clock->now() - rtc_synced_at;
+        time.advance(clocks / CLOCK_RATE);
+        clocks %= CLOCK_RATE;
+    }
+
+    if (subsecond != nullptr) { *subsecond = clocks; }
+    return time;
+}
+
+void MBC3::sync_rtc() {
+    rtc = current_rtc(&rtc_subsecond);
+    rtc_synced_at = clock != nullptr ? clock->now() : 0;
+}
+
+auto MBC3::battery_footer() const -> std::vector<u8> {
+    if (!cartridge_info->has_rtc) { return {}; }
+
+    std::vector<u8> footer;
+    footer.reserve(RTC_FOOTER_SIZE);
+
+    const RtcTime now = current_rtc();
+    for (const RtcTime* time : { &now, &latched_rtc }) {
+        for (u8 rtc_register = 0x08; rtc_register <= 0x0C; rtc_register++) {
+            put_u32(footer, time->read(rtc_register));
+        }
+    }
+
+    auto timestamp = static_cast<u64>(std::time(nullptr));
+    put_u32(footer, static_cast<u32>(timestamp));
+    put_u32(footer, static_cast<u32>(timestamp >> 32));
+    return footer;
+}
+
+void MBC3::load_rtc_footer(const std::vector<u8>& ram_data) {
+    const u8* footer = ram_data.data() + ram.size();
+
+    for (uint i = 0; i < 5; i++) {
+        auto rtc_register = static_cast<u8>(0x08 + i);
+        rtc.write(rtc_register, static_cast<u8>(get_u32(footer + i * 4)));
+        latched_rtc.write(rtc_register, static_cast<u8>(get_u32(footer + 20 + i * 4)));
+    }
+
+    /* The clock kept running while the emulator wasn't */
+    u64 saved_at = get_u32(footer + 40);
+    if (ram_data.size() - ram.size() == RTC_FOOTER_SIZE) { saved_at |= static_cast<u64>(get_u32(footer + 44)) << 32; }
+
+    auto now = static_cast<u64>(std::time(nullptr));
+    if (!rtc.halted && saved_at != 0 && now > saved_at) { rtc.advance(now - saved_at); }
+}
+
+void MBC3::RtcTime::advance(const u64 elapsed_seconds) {
+    /* Values out of range, which only a game writing them can cause, are
+     * carried as if they were in range */
+    u64 total_seconds = seconds + elapsed_seconds;
+    seconds = static_cast<uint>(total_seconds % 60);
+
+    u64 total_minutes = minutes + total_seconds / 60;
+    minutes = static_cast<uint>(total_minutes % 60);
+
+    u64 total_hours = hours + total_minutes / 60;
+    hours = static_cast<uint>(total_hours % 24);
+
+    u64 total_days = days + total_hours / 24;
+    if (total_days >= RTC_DAYS) { day_carry = true; }
+    days = static_cast<uint>(total_days % RTC_DAYS);
+}
+
+auto MBC3::RtcTime::read(const u8 rtc_register) const -> u8 {
+    switch (rtc_register) {
+        case 0x08: return static_cast<u8>(seconds);
+        case 0x09: return static_cast<u8>(minutes);
+        case 0x0A: return static_cast<u8>(hours);
+        case 0x0B: return static_cast<u8>(days & 0xFF);
+        case 0x0C: return static_cast<u8>((days >> 8) | (halted ? 0x40 : 0) | (day_carry ? 0x80 : 0));
+        default: return 0xFF;
+    }
+}
+
+void MBC3::RtcTime::write(const u8 rtc_register, const u8 value) {
+    switch (rtc_register) {
+        case 0x08: seconds = value & 0x3F; break;
+        case 0x09: minutes = value & 0x3F; break;
+        case 0x0A: hours = value & 0x1F; break;
+        case 0x0B: days = (days & 0x100) | value; break;
+        case 0x0C:
+            days = (days & 0xFF) | (value & 0x01) << 8;
+            halted = (value & 0x40) != 0;
+            day_carry = (value & 0x80) != 0;
+            break;
+        default: break;
+    }
+}
+
+MBC5::MBC5(std::shared_ptr<const RomImage> rom_data, const std::vector<u8>& ram_data,
+           std::shared_ptr<const CartridgeInfo> in_cartridge_info)
+    : Cartridge(std::move(rom_data), ram_data, std::move(in_cartridge_info)) {
+    rom_bank.set(0x1);
+    update_banks();
+}
+
+void MBC5::save_mbc_state(StateWriter& writer) const {
+    MBC5State state = {};
+    state.rom_bank = rom_bank.value();
+    state.ram_bank = ram_bank.value();
+    state.ram_enabled = ram_enabled;
+    writer.write(StateSection::Cartridge, state);
+}
+
+void MBC5::load_mbc_state(StateReader& reader) {
+    MBC5State state;
+    reader.read(StateSection::Cartridge, state);
+    rom_bank.set(state.rom_bank);
+    ram_bank.set(state.ram_bank);
+    ram_enabled = state.ram_enabled;
+    update_banks();
+}
+
+void MBC5::update_banks() {
+    select_rom_bank(rom_bank.value());
+    select_ram_bank(ram_bank.value());
+}
+
+void MBC5::write(const Address& address, u8 value) {
+    if (address.in_range(0x0000, 0x1FFF)) {
+        ram_enabled = (value & 0x0F) == 0x0A;
+    }
+
+    /* Unlike the older MBCs, bank 0 can be mapped at 0x4000 too */
+    if (address.in_range(0x2000, 0x2FFF)) {
+        rom_bank.set(static_cast<u16>((rom_bank.value() & 0x100) | value));
+    }
+
+    if (address.in_range(0x3000, 0x3FFF)) {
+        rom_bank.set(static_cast<u16>((rom_bank.value() & 0xFF) | ((value & 0x1) << 8)));
+    }
+
+    if (address.in_range(0x4000, 0x5FFF)) {
+        ram_bank.set(value & 0x0F);
+    }
+
+    if (address.in_range(0x0000, 0x7FFF)) {
+        update_banks();
+        bank_switched();
+        return;
     }
 
     if (address.in_range(0xA000, 0xBFFF)) {
-        auto offset_into_ram = 0x2000 * ram_bank.value();
-        auto address_in_ram = (address - 0xA000) + offset_into_ram;
-        return ram.at(address_in_ram.value());
+        if (!ram_enabled) { return; }
+        write_ram(address, value);
     }
+}
 
-    fatal_error("Attempted to read from unmapped MBC1 address 0x%x", address.value());
+auto MBC5::read(const Address& address) const -> u8 {
+    if (address.in_range(0x0000, 0x7FFF)) { return read_rom(address); }
+
+    if (address.in_range(0xA000, 0xBFFF)) {
+        if (!ram_enabled) { return 0xFF; }
+        return read_ram(address);
+    }
+
+    fatal_error("Attempted to read from unmapped MBC5 address 0x%x", address.value());
+}
+
+auto MBC5::read_page(const u8 page) -> const u8* {
+    if (page <= 0x3F) { return rom_page(page * 0x100); }
+    if (page <= 0x7F) { return rom_bank_page(page); }
+    if (page >= 0xA0 && page <= 0xBF && ram_enabled) { return ram_bank_page(page); }
+
+    return nullptr;
+}
+
+auto MBC5::write_page(const u8 page) -> u8* {
+    if (!ram_enabled) { return nullptr; }
+    if (page >= 0xA0 && page <= 0xBF) { return writable_ram_bank_page(page); }
+
+    return nullptr;
 }
@@ -1,52 +1,183 @@
 #pragma once
 
 #include "cartridge_info.h"
+#include "rom_image.h"
 #include "../address.h"
 #include "../register.h"
 
 #include <string>
 #include <vector>
 #include <memory>
+#include <functional>
+
+class StateWriter;
+class StateReader;
+class Scheduler;
+
+using bank_switch_callback_t = std::function<void()>;
+
+/* Cartridge RAM written since it was last collected, as runs of whole
+ * 256-byte pages */
+struct RamChanges {
+    struct Range {
+        uint offset;
+        uint size;
+    };
+
+    std::vector<Range> ranges;
+
+    /* The contents of every range, one after the other */
+    std::vector<u8> bytes;
+
+    auto empty() const -> bool { return ranges.empty(); }
+};
 
 class Cartridge {
 public:
-    Cartridge(std::vector<u8> rom_data, const std::vector<u8>& ram_data,
-              std::unique_ptr<CartridgeInfo> cartridge_info);
+    Cartridge(std::shared_ptr<const RomImage> rom_data, const std::vector<u8>& ram_data,
+              std::shared_ptr<const CartridgeInfo> cartridge_info);
     virtual ~Cartridge() = default;
 
     virtual auto read(const Address& address) const -> u8 = 0;
     virtual void write(const Address& address, u8 value) = 0;
 
+    /* Direct pointers to the 256-byte page of ROM (pages 0x00-0x7F) or RAM
+     * (pages 0xA0-0xBF) currently visible at the given page of the address
+     * space. nullptr means the page has to go through read()/write(). */
+    virtual auto read_page(u8 page) -> const u8*;
+    virtual auto write_page(u8 page) -> u8*;
+
+    /* Called whenever the pages returned above may have changed */
+    void register_bank_switch_callback(const bank_switch_callback_t& callback);
+
     auto get_cartridge_ram() const -> const std::vector<u8>&;
 
+    /* What goes in the save file: the RAM, then anything else the
+     * cartridge keeps powered by its battery (see battery_footer) */
+    auto battery_data() const -> std::vector<u8>;
+
+    /* Cartridges which keep time read it from the emulated clock */
+    void attach_clock(const Scheduler& scheduler);
+
+    /* Starts keeping track of which pages of RAM are written. A page which
+     * hasn't been written since it was last collected isn't handed out by
+     * write_page(), so the first write to it comes through write() and
+     * marks it; after that it's mapped again until the next collection */
+    void track_ram_writes();
+
+    /* Replaces 'changes' with the pages written since the last call, and
+     * starts watching them again, plus the battery footer if any RAM or
+     * the footer itself was written. Offsets are into battery_data(). Returns false if there
+     * were no changes */
+    auto collect_ram_changes(RamChanges& changes) -> bool;
+
+    /* Identifies the ROM a save state belongs to */
+    auto rom_checksum() const -> u32;
+
+    auto info() const -> const CartridgeInfo& { return *cartridge_info; }
+
+    /* The ROM, shared with every instance running it */
+    auto rom_image() const -> const std::shared_ptr<const RomImage>& { return rom; }
+
+    /* Cartridge RAM plus the MBC's bank registers. Loading remaps the pages */
+    void save_state(StateWriter& writer) const;
+    void load_state(StateReader& reader);
+
 protected:
-    std::vector<u8> rom;
+    /* Saved after the RAM in the save file; empty unless overridden */
+    virtual auto battery_footer() const -> std::vector<u8>;
+
+    /* The MBC's own registers, as a single section */
+    virtual void save_mbc_state(StateWriter& writer) const;
+    virtual void load_mbc_state(StateReader& reader);
+
+    void bank_switched();
+
+    /* Point the switchable windows at a bank: 0x4000-0x7FFF for ROM,
+     * 0xA000-0xBFFF for RAM. Bank numbers wrap around the banks the
+     * cartridge actually has, as the unconnected address lines would */
+    void select_rom_bank(uint bank);
+    void select_ram_bank(uint bank);
+
+    /* Pages of fixed bank 0, of the selected ROM bank (0x40-0x7F) and of
+     * the selected RAM bank (0xA0-0xBF), or nullptr if nothing backs them */
+    auto rom_page(uint offset) const -> const u8*;
+    auto rom_bank_page(u8 page) const -> const u8*;
+    auto ram_bank_page(u8 page) -> u8*;
+    /* The same page for write_page(): nullptr while it's being watched */
+    auto writable_ram_bank_page(u8 page) -> u8*;
+
+    /* Every write to RAM outside of the mapped pages goes through here */
+    void ram_written(uint offset);
+
+    /* Has the next collect_ram_changes() hand out the battery footer, even
+     * if no RAM was written */
+    void footer_written() { footer_dirty = true; }
+
+    /* Reads and writes through the selected banks. Addresses nothing backs
+     * read as 0xFF and ignore writes */
+    auto read_rom(const Address& address) const -> u8;
+    auto read_ram(const Address& address) const -> u8;
+    void write_ram(const Address& address, u8 value);
+
+    std::shared_ptr<const RomImage> rom;
     std::vector<u8> ram;
 
-    std::unique_ptr<CartridgeInfo> cartridge_info;
+    /* Host memory behind the selected banks, only recomputed when a bank
+     * register changes */
+    const u8* rom_bank_base = nullptr;
+    u8* ram_bank_base = nullptr;
+    /* Bytes of the RAM window that are backed: less than 0x2000 for 2KB RAM */
+    uint ram_bank_size = 0;
+
+    /* Owned by the ROM image, like the ROM itself shared with every
+     * instance running it */
+    std::shared_ptr<const CartridgeInfo> cartridge_info;
+
+    /* Null until attached */
+    const Scheduler* clock = nullptr;
+
+private:
+    bank_switch_callback_t bank_switch_callback;
+
+    /* One byte per 256-byte page of RAM, set once it's been written */
+    bool tracking_ram = false;
+    std::vector<u8> ram_dirty;
+    bool footer_dirty = false;
 };
 
-auto get_cartridge(const std::vector<u8>& rom_data, const std::vector<u8>& ram_data = {})
+auto get_cartridge(std::shared_ptr<const RomImage> rom_data, const std::vector<u8>& ram_data = {})
     -> std::shared_ptr<Cartridge>;
 
 class NoMBC : public Cartridge {
 public:
-    NoMBC(std::vector<u8> rom_data, const std::vector<u8>& ram_data,
-          std::unique_ptr<CartridgeInfo> cartridge_info);
+    NoMBC(std::shared_ptr<const RomImage> rom_data, const std::vector<u8>& ram_data,
+          std::shared_ptr<const CartridgeInfo> cartridge_info);
 
     auto read(const Address& address) const -> u8 override;
     void write(const Address& address, u8 value) override;
+
+    auto read_page(u8 page) -> const u8* override;
 };
 
 class MBC1 : public Cartridge {
 public:
-    MBC1(std::vector<u8> rom_data, const std::vector<u8>& ram_data,
-         std::unique_ptr<CartridgeInfo> cartridge_info);
+    MBC1(std::shared_ptr<const RomImage> rom_data, const std::vector<u8>& ram_data,
+         std::shared_ptr<const CartridgeInfo> cartridge_info);
 
     auto read(const Address& address) const -> u8 override;
     void write(const Address& address, u8 value) override;
 
+    auto read_page(u8 page) -> const u8* override;
+    auto write_page(u8 page) -> u8* override;
+
+protected:
+    void save_mbc_state(StateWriter& writer) const override;
+    void load_mbc_state(StateReader& reader) override;
+
 private:
+    void update_banks();
+
     WordRegister rom_bank;
     WordRegister ram_bank;
     bool ram_enabled = false;
@@ -57,15 +188,80 @@ private:
     bool rom_banking_mode = true;
 };
 
+/* Up to 256KB of ROM, and 512 half-bytes of RAM inside the MBC itself */
+class MBC2 : public Cartridge {
+public:
+    MBC2(std::shared_ptr<const RomImage> rom_data, const std::vector<u8>& ram_data,
+         std::shared_ptr<const CartridgeInfo> cartridge_info);
+
+    auto read(const Address& address) const -> u8 override;
+    void write(const Address& address, u8 value) override;
+
+    auto read_page(u8 page) -> const u8* override;
+
+protected:
+    void save_mbc_state(StateWriter& writer) const override;
+    void load_mbc_state(StateReader& reader) override;
+
+private:
+    WordRegister rom_bank;
+    bool ram_enabled = false;
+};
+
+/* Up to 2MB of ROM, 32KB of RAM and, on some, a real-time clock */
 class MBC3 : public Cartridge {
 public:
-    MBC3(std::vector<u8> rom_data, const std::vector<u8>& ram_data,
-         std::unique_ptr<CartridgeInfo> cartridge_info);
+    MBC3(std::shared_ptr<const RomImage> rom_data, const std::vector<u8>& ram_data,
+         std::shared_ptr<const CartridgeInfo> cartridge_info);
 
     auto read(const Address& address) const -> u8 override;
     void write(const Address& address, u8 value) override;
 
+    auto read_page(u8 page) -> const u8* override;
+    auto write_page(u8 page) -> u8* override;
+
+protected:
+    /* The clock in the layout most emulators share: the five registers,
+     * the five latched registers, then the host time it was saved at */
+    auto battery_footer() const -> std::vector<u8> override;
+
+    void save_mbc_state(StateWriter& writer) const override;
+    void load_mbc_state(StateReader& reader) override;
+
 private:
+    struct RtcTime {
+        uint seconds = 0;
+        uint minutes = 0;
+        uint hours = 0;
+        /* 9 bits, with the carry set when they overflow */
+        uint days = 0;
+        bool halted = false;
+        bool day_carry = false;
+
+        void advance(u64 elapsed_seconds);
+        auto read(u8 rtc_register) const -> u8;
+        void write(u8 rtc_register, u8 value);
+    };
+
+    void update_banks();
+
+    /* The clock is never ticked: its time is worked out from the emulated
+     * clocks which have passed since it was last brought up to date */
+    auto current_rtc(u64* subsecond = nullptr) const -> RtcTime;
+    void sync_rtc();
+    void load_rtc_footer(const std::vector<u8>& ram_data);
+
+    RtcTime rtc;
+    RtcTime latched_rtc;
+    /* When 'rtc' was last brought up to date, and the clocks towards its
+     * next second it had then */
+    u64 rtc_synced_at = 0;
+    u64 rtc_subsecond = 0;
+    /* 0x08-0x0C while a clock register is mapped instead of RAM */
+    u8 rtc_register = 0x08;
+    /* Latching takes a write of 0 and then of 1 */
+    u8 last_latch_write = 0xFF;
+
     WordRegister rom_bank;
     WordRegister ram_bank;
     bool ram_enabled = false;
@@ -76,3 +272,27 @@ private:
     // be used as upper two bits of the ROM Bank, or as RAM Bank Number.
     bool rom_banking_mode = true;
 };
+
+/* Up to 8MB of ROM (a 9-bit bank number) and 128KB of RAM */
+class MBC5 : public Cartridge {
+public:
+    MBC5(std::shared_ptr<const RomImage> rom_data, const std::vector<u8>& ram_data,
+         std::shared_ptr<const CartridgeInfo> cartridge_info);
+
+    auto read(const Address& address) const -> u8 override;
+    void write(const Address& address, u8 value) override;
+
+    auto read_page(u8 page) -> const u8* override;
+    auto write_page(u8 page) -> u8* override;
+
+protected:
+    void save_mbc_state(StateWriter& writer) const override;
+    void load_mbc_state(StateReader& reader) override;
+
+private:
+    void update_banks();
+
+    WordRegister rom_bank;
+    WordRegister ram_bank;
+    bool ram_enabled = false;
+};
@@ -1,8 +1,16 @@
 #include "cartridge_info.h"
+#include "rom_image.h"
 
+#include "../boot.h"
 #include "../util/log.h"
 
-auto get_info(std::vector<u8> rom) -> std::unique_ptr<CartridgeInfo> {
+#include <algorithm>
+
+auto get_info(const RomImage& rom) -> std::unique_ptr<CartridgeInfo> {
+    if (rom.size() <= header::global_checksum + 1) {
+        fatal_error("ROM is too small to hold a cartridge header: %zu bytes", rom.size());
+    }
+
     std::unique_ptr<CartridgeInfo> info = std::make_unique<CartridgeInfo>();
 
     u8 type_code = rom[header::cartridge_type];
@@ -11,20 +19,50 @@ auto get_info(std::vector<u8> rom) -> std::unique_ptr<CartridgeInfo> {
     u8 ram_size_code = rom[header::ram_size];
 
     info->type = get_type(type_code);
+    info->has_rtc = type_code == 0x0F || type_code == 0x10;
     info->version = version_code;
     info->rom_size = get_rom_size(rom_size_code);
     info->ram_size = get_ram_size(ram_size_code);
     info->title = get_title(rom);
 
-    log_info("Title:\t\t %s (version %d)", info->title.c_str(), info->version);
-    log_info("Cartridge:\t\t %s", describe(info->type).c_str());
-    log_info("Rom Size:\t\t %s", describe(info->rom_size).c_str());
-    log_info("Ram Size:\t\t %s", describe(info->ram_size).c_str());
-    log_info("");
+    info->header_checksum = rom[header::header_checksum];
+    info->global_checksum = static_cast<u16>(rom[header::global_checksum] << 8 | rom[header::global_checksum + 1]);
+    info->header_checksum_valid = compute_header_checksum(rom.data()) == info->header_checksum;
+    info->logo_valid = has_nintendo_logo(rom.data());
+
+    if (!is_cartridge_header(rom.data())) {
+        fatal_error("Not a Gameboy ROM: its header checksum and logo are both wrong");
+    }
+    if (!info->header_checksum_valid) {
+        log_warn("The ROM's header checksum is wrong: it may be damaged, and a real Gameboy "
+                 "wouldn't start it");
+    }
+
+    /* 0x80 marks a CGB-enhanced game, 0xC0 one which only runs on a CGB */
+    info->supports_cgb = (rom[header::cgb_flag] & 0x80) != 0;
+    info->supports_sgb = rom[header::sgb_flag] == 0x03;
 
     return info;
 }
 
+auto compute_header_checksum(const u8* rom) -> u8 {
+    u8 checksum = 0;
+    for (int address = header::title; address < header::header_checksum; address++) {
+        checksum = static_cast<u8>(checksum - rom[address] - 1);
+    }
+    return checksum;
+}
+
+auto has_nintendo_logo(const u8* rom) -> bool {
+    /* Where the boot ROM keeps its copy */
+    const u8* logo = &bootDMG[0xA8];
+    return std::equal(logo, logo + 48, rom + header::logo);
+}
+
+auto is_cartridge_header(const u8* rom) -> bool {
+    return compute_header_checksum(rom) == rom[header::header_checksum] || has_nintendo_logo(rom);
+}
+
 auto get_type(u8 type) -> CartridgeType {
     switch (type) {
         case 0x00:
@@ -124,6 +162,8 @@ auto get_rom_size(u8 size_code) -> ROMSize {
             return ROMSize::MB2;
         case 0x07:
             return ROMSize::MB4;
+        case 0x08:
+            return ROMSize::MB8;
         case 0x52:
             return ROMSize::MB1p1;
         case 0x53:
@@ -154,6 +194,8 @@ auto describe(ROMSize size) -> std::string {
             return "2MB (128 banks)";
         case ROMSize::MB4:
             return "4MB (256 banks)";
+        case ROMSize::MB8:
+            return "8MB (512 banks)";
         case ROMSize::MB1p1:
             return "1.1MB (72 banks)";
         case ROMSize::MB1p2:
@@ -240,12 +282,13 @@ auto describe(Destination destination) -> std::string {
     }
 }
 
-auto get_title(std::vector<u8>& rom) -> std::string {
-    char name[TITLE_LENGTH] = {0};
+auto get_title(const RomImage& rom) -> std::string {
+    /* Padded with zeroes, but a title using all of the space has none */
+    std::string name;
 
-    for (u8 i = 0; i < TITLE_LENGTH; i++) {
-        name[i] = static_cast<char>(rom[header::title + i]);
+    for (u8 i = 0; i < TITLE_LENGTH && rom[header::title + i] != 0; i++) {
+        name.push_back(static_cast<char>(rom[header::title + i]));
     }
 
-    return std::string(name);
+    return name;
 }
@@ -6,6 +6,8 @@
 #include <vector>
 #include <memory>
 
+class RomImage;
+
 const int TITLE_LENGTH = 11;
 
 namespace header {
@@ -39,7 +41,7 @@ enum class CartridgeType {
 extern auto get_type(u8 type) -> CartridgeType;
 extern auto describe(CartridgeType type) -> std::string;
 
-extern auto get_title(std::vector<u8>& rom) -> std::string;
+extern auto get_title(const RomImage& rom) -> std::string;
 
 extern auto get_license(u16 old_license, u16 new_license) -> std::string;
 
@@ -52,6 +54,7 @@ enum class ROMSize {
     MB1,
     MB2,
     MB4,
+    MB8,
     MB1p1,
     MB1p2,
     MB1p5,
@@ -95,9 +98,30 @@ public:
 
     u16 header_checksum;
     u16 global_checksum;
+    /* The stored header checksum matches the bytes it covers, and the logo
+     * is the one the boot ROM compares it with. A real boot ROM won't start
+     * a cartridge which fails either; only failing both makes it refused */
+    bool header_checksum_valid;
+    bool logo_valid;
 
     bool supports_cgb;
     bool supports_sgb;
+
+    /* MBC3 with a real-time clock, whose state goes in the save file too */
+    bool has_rtc;
 };
 
-extern auto get_info(std::vector<u8> rom) -> std::unique_ptr<CartridgeInfo>;
+/* The checksum over the header (0x134-0x14C) stored at header_checksum.
+ * The ROM must have at least that much of it */
+extern auto compute_header_checksum(const u8* rom) -> u8;
+
+/* The logo at header::logo is the one the boot ROM has */
+extern auto has_nintendo_logo(const u8* rom) -> bool;
+
+/* Whether the header could be a Gameboy cartridge's: its checksum or its
+ * logo is right. A wrong checksum alone, as on some patched and homebrew
+ * ROMs, is only warned about */
+extern auto is_cartridge_header(const u8* rom) -> bool;
+
+/* Parses the header. Prefer RomImage::info(), which only does so once */
+extern auto get_info(const RomImage& rom) -> std::unique_ptr<CartridgeInfo>;
@@ -0,0 +1,452 @@
+#include "rom_archive.h"
+#include "cartridge_info.h"
+
+#include "../util/log.h"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstring>
+#include <memory>
+
+#ifdef GBEMU_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef GBEMU_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+/* Up to and including the global checksum */
+const size_t HEADER_END = header::global_checksum + 2;
+
+/* Grown by when the container doesn't say how much is coming */
+const size_t GROWTH_STEP = 0x40000;
+
+auto read_u32(const u8* data) -> u32 {
+    return static_cast<u32>(data[0]) | static_cast<u32>(data[1]) << 8
+         | static_cast<u32>(data[2]) << 16 | static_cast<u32>(data[3]) << 24;
+}
+
+auto lowercase(std::string text) -> std::string {
+    for (char& c : text) { c = static_cast<char>(std::tolower(static_cast<unsigned char>(c))); }
+    return text;
+}
+
+auto has_suffix(const std::string& text, const std::string& suffix) -> bool {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+auto ends_with_rom_extension(const std::string& name) -> bool {
+    std::string lower = lowercase(name);
+    return has_suffix(lower, ".gb") || has_suffix(lower, ".gbc") || has_suffix(lower, ".cgb");
+}
+
+/*
+ * The buffer being unpacked into, which becomes the ROM's. The decoders
+ * write straight into whatever room is left at its end.
+ */
+class Output {
+public:
+    Output(const std::string& in_name, bool in_rom, size_t expected_size) :
+        name(in_name),
+        rom(in_rom)
+    {
+        bytes.resize(std::min(std::max(expected_size, HEADER_END), MAX_UNPACKED_SIZE));
+    }
+
+    /* Where the next bytes go, with at least one byte of room */
+    auto space() -> u8* {
+        if (length == bytes.size()) {
+            if (bytes.size() >= MAX_UNPACKED_SIZE) {
+                fatal_error("%s unpacks to more than %zu bytes, too much for a ROM", name.c_str(), MAX_UNPACKED_SIZE);
+            }
+            bytes.resize(std::min(bytes.size() + GROWTH_STEP, MAX_UNPACKED_SIZE));
+        }
+        return bytes.data() + length;
+    }
+
+    auto room() const -> size_t { return bytes.size() - length; }
+
+    /* After each run a decoder puts out */
+    void wrote(size_t count) {
+        length += count;
+
+        if (rom && !header_checked && length >= HEADER_END) {
+            header_checked = true;
+            /* As for an unpacked ROM, but before unpacking all of one which isn't */
+            if (!is_cartridge_header(bytes.data())) {
+                fatal_error("%s is damaged or doesn't hold a Gameboy ROM: its header checksum and "
+                            "logo are both wrong", name.c_str());
+            }
+        }
+    }
+
+    auto data() const -> const u8* { return bytes.data(); }
+    auto size() const -> size_t { return length; }
+
+    auto finish() -> std::vector<u8> {
+        if (rom && !header_checked) {
+            fatal_error("%s unpacks to %zu bytes, too few to hold a cartridge header", name.c_str(), length);
+        }
+
+        /* Only copies if the container's size was off */
+        bytes.resize(length);
+        bytes.shrink_to_fit();
+        return std::move(bytes);
+    }
+
+private:
+    const std::string& name;
+    bool rom;
+    std::vector<u8> bytes;
+    size_t length = 0;
+    bool header_checked = false;
+};
+
+#ifdef GBEMU_HAVE_ZLIB
+
+auto read_u16(const u8* data) -> uint { return static_cast<uint>(data[0] | data[1] << 8); }
+
+/* A zlib stream which is always ended, whichever way unpacking stops */
+class InflateStream {
+public:
+    /* Negative window bits for raw deflate, plus 16 for a gzip wrapper */
+    InflateStream(int window_bits, const std::string& name) {
+        if (inflateInit2(&stream, window_bits) != Z_OK) {
+            fatal_error("Cannot start unpacking %s", name.c_str());
+        }
+    }
+    ~InflateStream() { inflateEnd(&stream); }
+
+    InflateStream(const InflateStream&) = delete;
+    auto operator=(const InflateStream&) -> InflateStream& = delete;
+
+    z_stream stream = {};
+};
+
+/* Runs the stream to its end. With 'members', gzip members one after the
+ * other (as from 'cat a.gz b.gz') make up a single file */
+void inflate_all(InflateStream& inflater, const u8* data, size_t size, bool members, Output& output,
+                 const std::string& name) {
+    if (size > UINT_MAX) { fatal_error("%s is too big to unpack", name.c_str()); }
+
+    z_stream& stream = inflater.stream;
+    stream.next_in = const_cast<Bytef*>(data);
+    stream.avail_in = static_cast<uInt>(size);
+
+    while (true) {
+        u8* space = output.space();
+        auto room = static_cast<uInt>(std::min<size_t>(output.room(), UINT_MAX));
+        stream.next_out = space;
+        stream.avail_out = room;
+
+        int result = inflate(&stream, Z_NO_FLUSH);
+        output.wrote(room - stream.avail_out);
+
+        if (result == Z_STREAM_END) {
+            if (!members || stream.avail_in == 0) { return; }
+            inflateReset(&stream);
+            continue;
+        }
+        /* There was room to put out more, so it ran out of input */
+        if (result == Z_BUF_ERROR) { fatal_error("%s is cut short", name.c_str()); }
+        if (result != Z_OK) {
+            fatal_error("%s is damaged: %s", name.c_str(), stream.msg != nullptr ? stream.msg : "not deflate data");
+        }
+    }
+}
+
+void unpack_gzip(const u8* data, size_t size, Output& output, const std::string& name) {
+    InflateStream inflater(16 + MAX_WBITS, name);
+    inflate_all(inflater, data, size, true, output, name);
+}
+
+/* From the zip format's APPNOTE: the end of central directory record, the
+ * central directory's entries and each file's local header */
+const u32 ZIP_END_SIGNATURE = 0x06054B50;
+const u32 ZIP_ENTRY_SIGNATURE = 0x02014B50;
+const u32 ZIP_LOCAL_SIGNATURE = 0x04034B50;
+const size_t ZIP_END_SIZE = 22;
+const size_t ZIP_ENTRY_SIZE = 46;
+const size_t ZIP_LOCAL_SIZE = 30;
+
+struct ZipEntry {
+    std::string name;
+    uint flags;
+    uint method;
+    u32 crc;
+    u32 packed_size;
+    u32 size;
+    u32 local_header;
+};
+
+/* The central directory, found from the record at the end of the file,
+ * which may be followed by a comment of up to 64KB */
+auto read_zip_directory(const u8* data, size_t size, const std::string& name) -> std::vector<ZipEntry> {
+    if (size < ZIP_END_SIZE) { fatal_error("%s is cut short", name.c_str()); }
+
+    size_t end = size - ZIP_END_SIZE;
+    size_t lowest = size > ZIP_END_SIZE + 0xFFFF ? size - ZIP_END_SIZE - 0xFFFF : 0;
+    while (read_u32(data + end) != ZIP_END_SIGNATURE) {
+        if (end == lowest) { fatal_error("%s is damaged: it has no zip directory", name.c_str()); }
+        end--;
+    }
+
+    uint count = read_u16(data + end + 10);
+    u32 directory = read_u32(data + end + 16);
+
+    std::vector<ZipEntry> entries;
+    size_t position = directory;
+    for (uint i = 0; i < count; i++) {
+        if (position + ZIP_ENTRY_SIZE > size || read_u32(data + position) != ZIP_ENTRY_SIGNATURE) {
+            fatal_error("%s is damaged: its zip directory is cut short", name.c_str());
+        }
+
+        const u8* entry = data + position;
+        uint name_length = read_u16(entry + 28);
+        uint extra_length = read_u16(entry + 30);
+        uint comment_length = read_u16(entry + 32);
+        if (position + ZIP_ENTRY_SIZE + name_length > size) {
+            fatal_error("%s is damaged: its zip directory is cut short", name.c_str());
+        }
+
+        ZipEntry parsed;
+        parsed.name.assign(reinterpret_cast<const char*>(entry + ZIP_ENTRY_SIZE), name_length);
+        parsed.flags = read_u16(entry + 8);
+        parsed.method = read_u16(entry + 10);
+        parsed.crc = read_u32(entry + 16);
+        parsed.packed_size = read_u32(entry + 20);
+        parsed.size = read_u32(entry + 24);
+        parsed.local_header = read_u32(entry + 42);
+        entries.push_back(parsed);
+
+        position += ZIP_ENTRY_SIZE + name_length + extra_length + comment_length;
+    }
+
+    return entries;
+}
+
+void unpack_zip_entry(const u8* data, size_t size, const ZipEntry& entry, Output& output, const std::string& name) {
+    /* Bit 0 marks an encrypted entry */
+    if ((entry.flags & 0x1) != 0) { fatal_error("%s: %s is encrypted", name.c_str(), entry.name.c_str()); }
+    if (entry.packed_size == 0xFFFFFFFF || entry.local_header == 0xFFFFFFFF) {
+        fatal_error("%s: %s is in the zip64 format, which isn't supported", name.c_str(), entry.name.c_str());
+    }
+
+    /* The local header's name and extra field can differ from the directory's */
+    size_t local = entry.local_header;
+    if (local + ZIP_LOCAL_SIZE > size || read_u32(data + local) != ZIP_LOCAL_SIGNATURE) {
+        fatal_error("%s is damaged: %s can't be found", name.c_str(), entry.name.c_str());
+    }
+    size_t start = local + ZIP_LOCAL_SIZE + read_u16(data + local + 26) + read_u16(data + local + 28);
+    if (start > size || entry.packed_size > size - start) {
+        fatal_error("%s is cut short", name.c_str());
+    }
+    const u8* packed = data + start;
+
+    switch (entry.method) {
+        case 0: {
+            /* Stored as it is, copied over in runs so the header is checked first */
+            size_t copied = 0;
+            while (copied < entry.packed_size) {
+                u8* space = output.space();
+                size_t run = std::min<size_t>(output.room(), entry.packed_size - copied);
+                std::memcpy(space, packed + copied, run);
+                output.wrote(run);
+                copied += run;
+            }
+            break;
+        }
+        case 8: {
+            InflateStream inflater(-MAX_WBITS, name);
+            inflate_all(inflater, packed, entry.packed_size, false, output, name);
+            break;
+        }
+        default:
+            fatal_error("%s: %s is packed with method %u, which isn't supported (only deflate is)",
+                        name.c_str(), entry.name.c_str(), entry.method);
+    }
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    size_t checked = 0;
+    while (checked < output.size()) {
+        auto run = static_cast<uInt>(std::min<size_t>(output.size() - checked, UINT_MAX));
+        crc = crc32(crc, output.data() + checked, run);
+        checked += run;
+    }
+    if (crc != entry.crc || output.size() != entry.size) {
+        fatal_error("%s is damaged: %s doesn't match its checksum", name.c_str(), entry.name.c_str());
+    }
+}
+
+/* A ROM is looked for by its name first, for zips which hold a readme too */
+auto choose_zip_entry(const std::vector<ZipEntry>& entries, bool rom) -> const ZipEntry* {
+    const ZipEntry* first = nullptr;
+    for (const ZipEntry& entry : entries) {
+        /* Directories */
+        if (!entry.name.empty() && entry.name.back() == '/') { continue; }
+
+        if (!rom || ends_with_rom_extension(entry.name)) { return &entry; }
+        if (first == nullptr) { first = &entry; }
+    }
+    return first;
+}
+
+#endif
+
+#ifdef GBEMU_HAVE_ZSTD
+
+void unpack_zstd(const u8* data, size_t size, Output& output, const std::string& name) {
+    std::unique_ptr<ZSTD_DStream, size_t (*)(ZSTD_DStream*)> stream(ZSTD_createDStream(), ZSTD_freeDStream);
+    if (!stream || ZSTD_isError(ZSTD_initDStream(stream.get()))) {
+        fatal_error("Cannot start unpacking %s", name.c_str());
+    }
+
+    /* Frames one after the other make up a single file */
+    ZSTD_inBuffer input = { data, size, 0 };
+    while (true) {
+        ZSTD_outBuffer out = { output.space(), output.room(), 0 };
+        size_t result = ZSTD_decompressStream(stream.get(), &out, &input);
+        output.wrote(out.pos);
+
+        if (ZSTD_isError(result)) { fatal_error("%s is damaged: %s", name.c_str(), ZSTD_getErrorName(result)); }
+        if (input.pos < input.size) { continue; }
+
+        /* Everything is in; a frame is only done once it's all out */
+        if (result == 0) { return; }
+        if (out.pos < out.size) { fatal_error("%s is cut short", name.c_str()); }
+    }
+}
+
+#endif
+
+auto expected_size(Container container, const u8* data, size_t size) -> size_t {
+    switch (container) {
+        case Container::Gzip:
+            /* The size mod 2^32 ends the last member, which is usually the only one */
+            return size >= 4 ? read_u32(data + size - 4) : 0;
+        case Container::Zstd: {
+#ifdef GBEMU_HAVE_ZSTD
+            unsigned long long content = ZSTD_getFrameContentSize(data, size);
+            if (content != ZSTD_CONTENTSIZE_UNKNOWN && content != ZSTD_CONTENTSIZE_ERROR) {
+                return static_cast<size_t>(std::min<unsigned long long>(content, MAX_UNPACKED_SIZE));
+            }
+#endif
+            return 0;
+        }
+        case Container::Zip:
+        case Container::None:
+            return 0;
+    }
+    return 0;
+}
+
+auto unpack(Container container, const u8* data, size_t size, const std::string& name, bool rom)
+    -> std::vector<u8> {
+    if (!container_supported(container)) {
+        fatal_error("%s is packed with %s, which this build can't read", name.c_str(), describe(container));
+    }
+
+#ifdef GBEMU_HAVE_ZLIB
+    if (container == Container::Zip) {
+        std::vector<ZipEntry> entries = read_zip_directory(data, size, name);
+        const ZipEntry* entry = choose_zip_entry(entries, rom);
+        if (entry == nullptr) { fatal_error("%s is an empty zip", name.c_str()); }
+
+        Output output(name, rom, entry->size);
+        unpack_zip_entry(data, size, *entry, output, name);
+        return output.finish();
+    }
+#endif
+
+    Output output(name, rom, expected_size(container, data, size));
+    switch (container) {
+#ifdef GBEMU_HAVE_ZLIB
+        case Container::Gzip: unpack_gzip(data, size, output, name); break;
+#endif
+#ifdef GBEMU_HAVE_ZSTD
+        case Container::Zstd: unpack_zstd(data, size, output, name); break;
+#endif
+        default: break;
+    }
+    return output.finish();
+}
+
+} // namespace
+
+auto detect_container(const u8* data, const size_t size) -> Container {
+    if (size >= 2 && data[0] == 0x1F && data[1] == 0x8B) { return Container::Gzip; }
+    if (size >= 4 && read_u32(data) == 0xFD2FB528) { return Container::Zstd; }
+    /* A local file header, or the end record alone in an empty zip */
+    if (size >= 4 && (read_u32(data) == 0x04034B50 || read_u32(data) == 0x06054B50)) { return Container::Zip; }
+    return Container::None;
+}
+
+auto describe(const Container container) -> const char* {
+    switch (container) {
+        case Container::None: return "nothing";
+        case Container::Gzip: return "gzip";
+        case Container::Zip: return "zip";
+        case Container::Zstd: return "zstd";
+    }
+    return "an unknown container";
+}
+
+auto container_supported(const Container container) -> bool {
+    switch (container) {
+        case Container::None: return true;
+#ifdef GBEMU_HAVE_ZLIB
+        case Container::Gzip: return true;
+        case Container::Zip: return true;
+#endif
+#ifdef GBEMU_HAVE_ZSTD
+        case Container::Zstd: return true;
+#endif
+        default: return false;
+    }
+}
+
+auto unpack_rom(const u8* data, const size_t size, const std::string& name) -> std::vector<u8> {
+    Container container = detect_container(data, size);
+    if (container == Container::None) { return std::vector<u8>(data, data + size); }
+
+    return unpack(container, data, size, name, true);
+}
+
+auto unpack_save(std::vector<u8> data, const std::string& name) -> std::vector<u8> {
+    Container container = detect_container(data.data(), data.size());
+    if (container == Container::None) { return data; }
+
+    std::string lower = lowercase(name);
+    bool named_packed = has_suffix(lower, ".gz") || has_suffix(lower, ".zst") || has_suffix(lower, ".zip");
+    if (named_packed) { return unpack(container, data.data(), data.size(), name, false); }
+
+    /* Cartridge RAM holds whatever the game left in it, so it can start
+     * like a container by chance. Unless the name says it's packed, it
+     * only is if it unpacks, and no error is shown otherwise */
+    Logger quiet;
+    quiet.set_sink([](LogLevel, const std::string&) {});
+    try {
+        LogScope log_scope(quiet);
+        return unpack(container, data.data(), data.size(), name, false);
+    } catch (const FatalError&) {
+        log_debug("%s starts like %s but isn't packed; loaded as it is", name.c_str(), describe(container));
+        return data;
+    }
+}
+
+auto is_rom_file_name(const std::string& name) -> bool {
+    std::string lower = lowercase(name);
+    if (has_suffix(lower, ".zip")) { return true; }
+
+    for (const char* packed : { ".gz", ".zst" }) {
+        if (has_suffix(lower, packed)) {
+            lower.erase(lower.size() - std::strlen(packed));
+            break;
+        }
+    }
+    return ends_with_rom_extension(lower);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "../definitions.h"
+
+#include <string>
+#include <vector>
+
+/*
+ * ROMs and save files packed in a zip, gzip or zstd container, unpacked
+ * straight from the packed bytes (e.g. a mapped file) into the buffer the
+ * ROM is then kept in, with no temporary file in between.
+ *
+ * Which containers can be read depends on the libraries found at build
+ * time: zip and gzip need zlib, zstd needs libzstd. Anything else is taken
+ * to be unpacked already.
+ */
+enum class Container {
+    None,
+    Gzip,
+    Zip,
+    Zstd,
+};
+
+/* ROMs are 8MB at the most, so nothing unpacks to more than this */
+const size_t MAX_UNPACKED_SIZE = 0x800000;
+
+/* By the magic number at the start */
+auto detect_container(const u8* data, size_t size) -> Container;
+auto describe(Container container) -> const char*;
+
+/* Whether this build can unpack it */
+auto container_supported(Container container) -> bool;
+
+/* Unpacks a ROM; from a zip, the first .gb, .gbc or .cgb in it, or else its
+ * first file. The container's own record of the size, where it has one,
+ * sizes the buffer up front. The cartridge header's checksum (see
+ * CartridgeInfo) is checked as soon as the header is out, so a damaged
+ * archive or one holding something else is caught before the rest is
+ * unpacked, and the container's own checksum once it all is. 'name' is for
+ * messages. Throws FatalError for any of that, or a container this build
+ * can't read */
+auto unpack_rom(const u8* data, size_t size, const std::string& name) -> std::vector<u8>;
+
+/* The same for a save file, with no header to check. Anything which isn't
+ * in a container is returned as it is. So is a save which only looks like
+ * one, unless 'name' ends with .gz, .zst or .zip, when failing to unpack
+ * it throws as for a ROM */
+auto unpack_save(std::vector<u8> data, const std::string& name) -> std::vector<u8>;
+
+/* Ends with .gb, .gbc or .cgb, optionally followed by .gz or .zst, or with
+ * .zip, ignoring case; for frontends looking through directories */
+auto is_rom_file_name(const std::string& name) -> bool;
@@ -0,0 +1,151 @@
+#include "rom_image.h"
+#include "cartridge_info.h"
+#include "rom_archive.h"
+
+#include "../util/log.h"
+
+#include <map>
+#include <tuple>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+auto open_file(const std::string& filename, struct stat& info) -> int {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fatal_error("Cannot read from file: %s", filename.c_str());
+    }
+
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size <= 0) {
+        close(fd);
+        fatal_error("Cannot read from file: %s", filename.c_str());
+    }
+
+    return fd;
+}
+
+auto map_open_file(int fd, const struct stat& info, const std::string& filename) -> std::shared_ptr<const RomImage> {
+    auto size = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+
+    /* The mapping keeps the file referenced on its own */
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        fatal_error("Cannot map file: %s", filename.c_str());
+    }
+
+    return std::make_shared<const RomImage>(static_cast<const u8*>(mapping), size);
+}
+
+/* Tells a file apart however it's named, and tells it apart from itself
+ * once it's been changed, even within the same second */
+struct FileIdentity {
+    dev_t device;
+    ino_t inode;
+    off_t size;
+    time_t modified;
+    long modified_ns;
+
+    auto operator<(const FileIdentity& other) const -> bool {
+        return std::tie(device, inode, size, modified, modified_ns)
+             < std::tie(other.device, other.inode, other.size, other.modified, other.modified_ns);
+    }
+};
+
+auto identify(const struct stat& info) -> FileIdentity {
+#if defined(__APPLE__)
+    const struct timespec& modified = info.st_mtimespec;
+#else
+    const struct timespec& modified = info.st_mtim;
+#endif
+    return { info.st_dev, info.st_ino, info.st_size, modified.tv_sec, modified.tv_nsec };
+}
+
+std::mutex unpacked_mutex;
+std::map<FileIdentity, std::weak_ptr<const RomImage>> unpacked_images;
+
+auto find_unpacked(const FileIdentity& identity) -> std::shared_ptr<const RomImage> {
+    auto found = unpacked_images.find(identity);
+    return found == unpacked_images.end() ? nullptr : found->second.lock();
+}
+
+} // namespace
+
+auto RomImage::map_file(const std::string& filename) -> std::shared_ptr<const RomImage> {
+    struct stat info = {};
+    int fd = open_file(filename, info);
+    return map_open_file(fd, info, filename);
+}
+
+auto RomImage::load_file(const std::string& filename) -> std::shared_ptr<const RomImage> {
+    struct stat info = {};
+    int fd = open_file(filename, info);
+    FileIdentity identity = identify(info);
+
+    {
+        std::lock_guard<std::mutex> lock(unpacked_mutex);
+        if (auto image = find_unpacked(identity)) {
+            close(fd);
+            return image;
+        }
+    }
+
+    std::shared_ptr<const RomImage> mapped = map_open_file(fd, info, filename);
+    Container container = detect_container(mapped->data(), mapped->size());
+    if (container == Container::None) { return mapped; }
+
+    /* Unpacked outside the lock; whichever thread finishes first wins */
+    auto image = from_bytes(unpack_rom(mapped->data(), mapped->size(), filename));
+    log_debug("Unpacked %s from %s: %zu bytes", filename.c_str(), describe(container), image->size());
+
+    std::lock_guard<std::mutex> lock(unpacked_mutex);
+    if (auto existing = find_unpacked(identity)) { return existing; }
+
+    for (auto entry = unpacked_images.begin(); entry != unpacked_images.end();) {
+        entry = entry->second.expired() ? unpacked_images.erase(entry) : std::next(entry);
+    }
+    unpacked_images[identity] = image;
+    return image;
+}
+
+auto RomImage::from_bytes(std::vector<u8> bytes) -> std::shared_ptr<const RomImage> {
+    return std::make_shared<const RomImage>(std::move(bytes));
+}
+
+RomImage::RomImage(const u8* mapping, const size_t size) :
+    rom_data(mapping),
+    rom_size(size),
+    mapped(true)
+{
+}
+
+RomImage::RomImage(std::vector<u8> in_bytes) :
+    rom_data(nullptr),
+    rom_size(in_bytes.size()),
+    mapped(false),
+    bytes(std::move(in_bytes))
+{
+    rom_data = bytes.data();
+}
+
+RomImage::~RomImage() {
+    if (mapped) { munmap(const_cast<u8*>(rom_data), rom_size); }
+}
+
+auto RomImage::at(const size_t offset) const -> u8 {
+    if (offset >= rom_size) {
+        fatal_error("Attempted to read past the end of the ROM: 0x%zx", offset);
+    }
+
+    return rom_data[offset];
+}
+
+auto RomImage::info() const -> const CartridgeInfo& {
+    std::call_once(info_parsed, [this]() { header_info = get_info(*this); });
+    return *header_info;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../definitions.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Read-only cartridge ROM contents.
+ *
+ * A file is mapped rather than read: loading takes the same time whatever
+ * the ROM's size, pages only come in as they're touched, and every instance
+ * (or process) running the same file shares them. Cartridges hold the image
+ * through a shared_ptr, so it can also be handed to several Gameboys: all
+ * that's per instance is the banking state and cartridge RAM.
+ */
+class CartridgeInfo;
+
+class RomImage : Noncopyable {
+public:
+    /* Throws FatalError if the file can't be opened or mapped */
+    static auto map_file(const std::string& filename) -> std::shared_ptr<const RomImage>;
+
+    /* Like map_file, but a file packed in a zip, gzip or zstd container
+     * (see rom_archive.h) is unpacked into memory. An unpacked image is
+     * kept for as long as anything uses it, and opening the same file,
+     * unchanged, meanwhile shares it rather than unpacking it again. Safe
+     * from any thread. Throws FatalError as unpack_rom() does, too */
+    static auto load_file(const std::string& filename) -> std::shared_ptr<const RomImage>;
+
+    /* For ROMs which are already in memory */
+    static auto from_bytes(std::vector<u8> bytes) -> std::shared_ptr<const RomImage>;
+
+    /* Takes over a read-only mapping of 'size' bytes */
+    RomImage(const u8* mapping, size_t size);
+    explicit RomImage(std::vector<u8> bytes);
+    ~RomImage();
+
+    auto data() const -> const u8* { return rom_data; }
+    auto size() const -> size_t { return rom_size; }
+
+    auto operator[](size_t offset) const -> u8 { return rom_data[offset]; }
+
+    /* Bounds-checked; reading past the end is a fatal error */
+    auto at(size_t offset) const -> u8;
+
+    /* The cartridge header, parsed the first time it's asked for and then
+     * shared by everything using the image. Safe from any thread. Throws
+     * FatalError if the ROM is too small to have one */
+    auto info() const -> const CartridgeInfo&;
+
+private:
+    const u8* rom_data;
+    size_t rom_size;
+    bool mapped;
+
+    /* Unused for mapped files */
+    std::vector<u8> bytes;
+
+    mutable std::once_flag info_parsed;
+    mutable std::unique_ptr<CartridgeInfo> header_info;
+};
@@ -0,0 +1,37 @@
+#include "command_line.h"
+
+#include "cartridge/rom_archive.h"
+#include "util/log.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+
+auto flag_value(const std::string& arg, const std::string& flag, const int minimum) -> uint {
+    int value = std::atoi(arg.c_str() + flag.size());
+    if (value < minimum) { fatal_error("Invalid value for %s%s", flag.c_str(), arg.c_str() + flag.size()); }
+    return static_cast<uint>(value);
+}
+
+auto collect_roms(const std::vector<std::string>& paths) -> std::vector<std::string> {
+    namespace fs = std::filesystem;
+
+    std::vector<std::string> roms;
+    for (const std::string& path : paths) {
+        if (!fs::is_directory(path)) {
+            roms.push_back(path);
+            continue;
+        }
+
+        std::vector<std::string> found;
+        for (const auto& entry : fs::directory_iterator(path)) {
+            if (entry.is_regular_file() && is_rom_file_name(entry.path().filename().string())) {
+                found.push_back(entry.path().string());
+            }
+        }
+        std::sort(found.begin(), found.end());
+        roms.insert(roms.end(), found.begin(), found.end());
+    }
+
+    return roms;
+}
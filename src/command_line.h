@@ -0,0 +1,20 @@
+#pragma once
+
+#include "definitions.h"
+
+#include <string>
+#include <vector>
+
+/*
+ * What the command-line tools (gbemu-regress, gbemu-bench, gbemu-batch,
+ * gbemu-stream) take besides the emulator's own options, for which see
+ * config.h.
+ */
+
+/* The number in a --name=N flag, given the "--name=" it starts with.
+ * Throws FatalError if it's less than 'minimum' */
+auto flag_value(const std::string& arg, const std::string& flag, int minimum = 1) -> uint;
+
+/* ROM files named directly, plus every ROM file in named directories,
+ * packed ones included (see is_rom_file_name), each directory's in order */
+auto collect_roms(const std::vector<std::string>& paths) -> std::vector<std::string>;
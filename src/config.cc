@@ -0,0 +1,253 @@
+#include "config.h"
+
+#include "profiler.h"
+#include "util/log.h"
+
+#include <cstdlib>
+#include <fstream>
+
+namespace {
+
+struct OptionSpec {
+    const char* name;
+    /* Takes no value as a flag: --name is "true", --no-name "false" */
+    bool is_switch;
+    /* See is_runtime_option */
+    bool runtime;
+    void (*set)(Options& options, const std::string& name, const std::string& value);
+};
+
+auto parse_switch(const std::string& name, const std::string& value) -> bool {
+    if (value == "true" || value == "on" || value == "1") { return true; }
+    if (value == "false" || value == "off" || value == "0") { return false; }
+    fatal_error("Invalid %s (true or false): %s", name.c_str(), value.c_str());
+}
+
+auto parse_uint(const std::string& name, const std::string& value) -> uint {
+    char* end = nullptr;
+    unsigned long number = std::strtoul(value.c_str(), &end, 10);
+    if (value.empty() || value[0] == '-' || *end != '\0' || number > 0xFFFF) {
+        fatal_error("Invalid %s: %s", name.c_str(), value.c_str());
+    }
+    return static_cast<uint>(number);
+}
+
+auto parse_file_name(const std::string& name, const std::string& value) -> std::string {
+    if (value.empty()) { fatal_error("Missing file name for %s", name.c_str()); }
+    return value;
+}
+
+void set_speed(Options& options, const std::string& name, const std::string& value) {
+    if (value == "normal") {
+        options.speed_mode = SpeedMode::Normal;
+        options.speed_multiplier = 1;
+    } else if (value == "unthrottled") {
+        options.speed_mode = SpeedMode::Unthrottled;
+    } else {
+        uint multiplier = parse_uint(name, value);
+        if (multiplier < 1) { fatal_error("Invalid speed multiplier: %s", value.c_str()); }
+
+        options.speed_mode = multiplier == 1 ? SpeedMode::Normal : SpeedMode::FastForward;
+        options.speed_multiplier = multiplier;
+    }
+}
+
+void set_frame_skip(Options& options, const std::string& name, const std::string& value) {
+    if (value == "auto") {
+        options.frame_skip = DEFAULT_ADAPTIVE_FRAME_SKIP;
+        options.adaptive_frame_skip = true;
+    } else {
+        options.frame_skip = parse_uint(name, value);
+        options.adaptive_frame_skip = false;
+    }
+}
+
+void set_sample_rate(Options& options, const std::string& name, const std::string& value) {
+    uint rate = parse_uint(name, value);
+    if (rate != 22050 && rate != 44100 && rate != 48000) {
+        fatal_error("Invalid sample rate (22050, 44100 or 48000): %s", value.c_str());
+    }
+    options.audio_sample_rate = rate;
+}
+
+void set_log_level(Options& options, const std::string& /*name*/, const std::string& value) {
+    if (value == "trace") { options.log_level = LogLevel::Trace; }
+    else if (value == "debug") { options.log_level = LogLevel::Debug; }
+    else if (value == "info") { options.log_level = LogLevel::Info; }
+    else if (value == "warning") { options.log_level = LogLevel::Warning; }
+    else if (value == "error") { options.log_level = LogLevel::Error; }
+    else { fatal_error("Invalid log level (trace, debug, info, warning or error): %s", value.c_str()); }
+}
+
+void set_renderer(Options& options, const std::string& /*name*/, const std::string& value) {
+    if (value == "inline") { options.threaded_video = false; }
+    else if (value == "threaded") { options.threaded_video = true; }
+    else { fatal_error("Invalid renderer (inline or threaded): %s", value.c_str()); }
+}
+
+void set_ppu_timing(Options& options, const std::string& /*name*/, const std::string& value) {
+    if (value == "fast") { options.ppu_timing = PpuTiming::Fast; }
+    else if (value == "accurate") { options.ppu_timing = PpuTiming::Accurate; }
+    else { fatal_error("Invalid PPU timing (fast or accurate): %s", value.c_str()); }
+}
+
+void set_watchdog_action(Options& options, const std::string& /*name*/, const std::string& value) {
+    if (value == "report") { options.watchdog_action = WatchdogAction::Report; }
+    else if (value == "throttle") { options.watchdog_action = WatchdogAction::Throttle; }
+    else if (value == "stop") { options.watchdog_action = WatchdogAction::Stop; }
+    else { fatal_error("Invalid watchdog action (report, throttle or stop): %s", value.c_str()); }
+}
+
+void set_palette(Options& options, const std::string& /*name*/, const std::string& value) {
+    /* Four RRGGBB colours, lightest first, separated by commas */
+    std::array<u32, 4> palette = {};
+    const char* colors = value.c_str();
+    for (uint i = 0; i < palette.size(); i++) {
+        char* end = nullptr;
+        palette[i] = static_cast<u32>(std::strtoul(colors, &end, 16));
+        bool last = i == palette.size() - 1;
+        if (end - colors != 6 || *end != (last ? '\0' : ',')) {
+            fatal_error("Invalid palette, e.g. E0F8D0,88C070,346856,081820: %s", value.c_str());
+        }
+        colors = end + 1;
+    }
+    options.dmg_palette = palette;
+}
+
+const OptionSpec OPTIONS[] = {
+    {"debug", true, false, [](Options& o, const std::string& n, const std::string& v) { o.debugger = parse_switch(n, v); }},
+    {"trace", true, false, [](Options& o, const std::string& n, const std::string& v) { o.trace = parse_switch(n, v); }},
+    {"silent", true, true, [](Options& o, const std::string& n, const std::string& v) { o.disable_logs = parse_switch(n, v); }},
+    {"headless", true, false, [](Options& o, const std::string& n, const std::string& v) { o.headless = parse_switch(n, v); }},
+    {"whole-framebuffer", true, false,
+     [](Options& o, const std::string& n, const std::string& v) { o.show_full_framebuffer = parse_switch(n, v); }},
+    {"exit-on-infinite-jr", true, false,
+     [](Options& o, const std::string& n, const std::string& v) { o.exit_on_infinite_jr = parse_switch(n, v); }},
+    {"print-serial-output", true, true,
+     [](Options& o, const std::string& n, const std::string& v) { o.print_serial = parse_switch(n, v); }},
+    {"block-cache", true, false, [](Options& o, const std::string& n, const std::string& v) { o.block_cache = parse_switch(n, v); }},
+    {"skip-idle-loops", true, true,
+     [](Options& o, const std::string& n, const std::string& v) { o.skip_idle_loops = parse_switch(n, v); }},
+    {"mute-audio", true, true, [](Options& o, const std::string& n, const std::string& v) { o.mute_audio = parse_switch(n, v); }},
+    {"profile", true, false,
+     [](Options& o, const std::string& n, const std::string& v) {
+         o.print_profile = parse_switch(n, v);
+         if (o.print_profile && !Profiler::compiled_in) {
+             fatal_error("--profile needs a build configured with -DGBEMU_PROFILER=ON");
+         }
+     }},
+    {"dmg", true, false, [](Options& o, const std::string& n, const std::string& v) { o.force_dmg = parse_switch(n, v); }},
+    /* Older spellings of speed=unthrottled and renderer=threaded */
+    {"unthrottled", true, true,
+     [](Options& o, const std::string& n, const std::string& v) { set_speed(o, n, parse_switch(n, v) ? "unthrottled" : "normal"); }},
+    {"threaded-video", true, true,
+     [](Options& o, const std::string& n, const std::string& v) { o.threaded_video = parse_switch(n, v); }},
+    {"trace-file", false, false,
+     [](Options& o, const std::string& n, const std::string& v) { o.trace_file = parse_file_name(n, v); }},
+    {"record-movie", false, false,
+     [](Options& o, const std::string& n, const std::string& v) { o.record_movie = parse_file_name(n, v); }},
+    {"play-movie", false, false,
+     [](Options& o, const std::string& n, const std::string& v) { o.play_movie = parse_file_name(n, v); }},
+    {"speed", false, true, set_speed},
+    {"frame-skip", false, true, set_frame_skip},
+    {"run-ahead", false, true, [](Options& o, const std::string& n, const std::string& v) { o.run_ahead_frames = parse_uint(n, v); }},
+    {"sample-rate", false, true, set_sample_rate},
+    {"log-level", false, true, set_log_level},
+    {"renderer", false, true, set_renderer},
+    {"ppu-timing", false, true, set_ppu_timing},
+    {"watchdog", false, true,
+     [](Options& o, const std::string& n, const std::string& v) { o.watchdog_seconds = parse_uint(n, v); }},
+    {"watchdog-action", false, true, set_watchdog_action},
+    {"palette", false, false, set_palette},
+    {"rewind-window", false, false,
+     [](Options& o, const std::string& n, const std::string& v) { o.rewind_window = parse_uint(n, v); }},
+    {"rewind-interval", false, false,
+     [](Options& o, const std::string& n, const std::string& v) { o.rewind_interval = parse_uint(n, v); }},
+};
+
+auto find_option(const std::string& name) -> const OptionSpec* {
+    for (const OptionSpec& spec : OPTIONS) {
+        if (name == spec.name) { return &spec; }
+    }
+    return nullptr;
+}
+
+auto trim(const std::string& text) -> std::string {
+    size_t start = text.find_first_not_of(" \t\r");
+    if (start == std::string::npos) { return {}; }
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(start, end - start + 1);
+}
+
+} // namespace
+
+void set_option(Options& options, const std::string& name, const std::string& value) {
+    const OptionSpec* spec = find_option(name);
+    if (spec == nullptr) { fatal_error("Unknown option: %s", name.c_str()); }
+
+    spec->set(options, name, value);
+}
+
+void apply_flag(Options& options, const std::string& flag) {
+    if (flag.compare(0, 2, "--") != 0) { fatal_error("Unknown flag: %s", flag.c_str()); }
+
+    size_t equals = flag.find('=');
+    std::string name = flag.substr(2, equals == std::string::npos ? std::string::npos : equals - 2);
+
+    if (equals != std::string::npos) {
+        std::string value = flag.substr(equals + 1);
+        if (name == "config") { load_config_file(options, value); return; }
+        if (find_option(name) == nullptr) { fatal_error("Unknown flag: %s", flag.c_str()); }
+
+        set_option(options, name, value);
+        return;
+    }
+
+    const OptionSpec* spec = find_option(name);
+    if (spec != nullptr && spec->is_switch) { spec->set(options, name, "true"); return; }
+
+    if (name.compare(0, 3, "no-") == 0) {
+        spec = find_option(name.substr(3));
+        if (spec != nullptr && spec->is_switch) { spec->set(options, spec->name, "false"); return; }
+    }
+
+    if (find_option(name) != nullptr) { fatal_error("Missing value: %s", flag.c_str()); }
+    fatal_error("Unknown flag: %s", flag.c_str());
+}
+
+void load_config_file(Options& options, const std::string& path) {
+    std::ifstream file(path);
+    if (!file) { fatal_error("Cannot open config file %s", path.c_str()); }
+
+    std::string line;
+    uint line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) { continue; }
+
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            fatal_error("%s:%u: expected name = value", path.c_str(), line_number);
+        }
+
+        try {
+            set_option(options, trim(line.substr(0, equals)), trim(line.substr(equals + 1)));
+        } catch (const FatalError& error) {
+            /* Already logged; only the line is added */
+            throw FatalError(path + ":" + std::to_string(line_number) + ": " + error.what());
+        }
+    }
+}
+
+auto is_runtime_option(const std::string& name) -> bool {
+    const OptionSpec* spec = find_option(name);
+    return spec != nullptr && spec->runtime;
+}
+
+auto option_names() -> std::vector<std::string> {
+    std::vector<std::string> names;
+    for (const OptionSpec& spec : OPTIONS) { names.emplace_back(spec.name); }
+    return names;
+}
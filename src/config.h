@@ -0,0 +1,38 @@
+#pragma once
+
+#include "options.h"
+
+#include <string>
+#include <vector>
+
+/*
+ * Options by name, so every frontend takes the same ones the same way: as
+ * --name=value flags, from a config file, or through Gameboy::configure
+ * while running. Switches take true/false (or on/off, 1/0), and as flags
+ * are given as --name, or --no-name to turn them off.
+ *
+ * A config file has one "name = value" per line; blank lines and anything
+ * after a '#' are ignored. For example:
+ *
+ *     speed = 2
+ *     frame-skip = auto
+ *     log-level = warning
+ *     renderer = threaded
+ */
+
+/* Throws FatalError for an unknown name or a value it can't take */
+void set_option(Options& options, const std::string& name, const std::string& value);
+
+/* A command-line flag, as above. --config=FILE reads a config file in its
+ * place, so flags after it override the file */
+void apply_flag(Options& options, const std::string& flag);
+
+/* Throws FatalError, naming the line, for the first one which is wrong */
+void load_config_file(Options& options, const std::string& path);
+
+/* Whether Gameboy::configure changes the option on a running instance.
+ * The rest are only read when an instance is made */
+auto is_runtime_option(const std::string& name) -> bool;
+
+/* Every name set_option takes, for usage messages */
+auto option_names() -> std::vector<std::string>;
@@ -0,0 +1,150 @@
+#include "block_cache.h"
+
+#include "instructions.h"
+#include "../mmu.h"
+
+/* Anything which can move the program counter somewhere other than the
+ * next instruction, or stop the CPU, ends a block */
+static auto ends_block(const u8 opcode) -> bool {
+    return instructions[opcode].flow != Flow::Next;
+}
+
+BlockCache::BlockCache(MMU& inMmu) : mmu(inMmu) {}
+
+auto BlockCache::lookup(const u16 pc) -> const DecodedInstruction* {
+    auto page_index = static_cast<u8>(pc >> 8);
+    const u8* page = mmu.page_memory(page_index);
+
+    if (current_block == nullptr || pc != next_pc || page != current_page) {
+        current_block = nullptr;
+
+        if (page == nullptr || !is_cacheable(page_index)) { return nullptr; }
+
+        PageBlocks& blocks = blocks_for(page_index, page);
+        auto& block = blocks.blocks[pc & 0xFF];
+        if (!block) {
+            block = decode(page, pc & 0xFF);
+            mark_decoded(blocks, *block);
+            mmu.protect_code_page(page_index);
+        }
+
+        /* Instructions straddling a page boundary are never cached */
+        if (block->instructions.empty()) { return nullptr; }
+
+        current_block = block.get();
+        current_page = page;
+        next_index = 0;
+    }
+
+    return advance_cursor(pc);
+}
+
+auto BlockCache::next_in_block(const u16 pc) -> const DecodedInstruction* {
+    if (current_block == nullptr || pc != next_pc) { return nullptr; }
+    if (mmu.page_memory(static_cast<u8>(pc >> 8)) != current_page) { return nullptr; }
+
+    return advance_cursor(pc);
+}
+
+auto BlockCache::advance_cursor(const u16 pc) -> const DecodedInstruction* {
+    const DecodedInstruction* instruction = &current_block->instructions[next_index++];
+
+    if (next_index < current_block->instructions.size()) {
+        next_pc = static_cast<u16>((pc & 0xFF00) | current_block->instructions[next_index].offset);
+    } else {
+        current_block = nullptr;
+    }
+
+    return instruction;
+}
+
+auto BlockCache::invalidate(const u8* page, const u8 offset) -> bool {
+    auto found = pages.find(page);
+    if (found == pages.end()) { return false; }
+
+    PageBlocks& blocks = *found->second;
+
+    /* Data sharing a page with code doesn't need to throw the code away */
+    if (!blocks.decoded_bytes.test(offset)) { return true; }
+
+    blocks.decoded_bytes.reset();
+
+    bool anything_cached = false;
+    for (auto& block : blocks.blocks) {
+        if (!block) { continue; }
+
+        if (block->start <= offset && offset < block->end) {
+            if (block.get() == current_block) { current_block = nullptr; }
+            block.reset();
+        } else {
+            mark_decoded(blocks, *block);
+            anything_cached = true;
+        }
+    }
+
+    if (anything_cached) { return true; }
+
+    for (auto& slot : slots) {
+        if (slot.memory == page) { slot = PageSlot(); }
+    }
+
+    pages.erase(found);
+    return false;
+}
+
+auto BlockCache::is_cacheable(const u8 page) -> bool {
+    /* Cartridge RAM can be remapped under a block, VRAM writes go through
+     * Video so that its tile cache sees them, and the 0xFE/0xFF pages are
+     * never directly mapped */
+    return page <= 0x7F || (page >= 0xC0 && page <= 0xFD);
+}
+
+auto BlockCache::blocks_for(const u8 page_index, const u8* page) -> PageBlocks& {
+    PageSlot& slot = slots[page_index];
+    if (slot.memory == page) { return *slot.blocks; }
+
+    auto& blocks = pages[page];
+    if (!blocks) { blocks = std::make_unique<PageBlocks>(); }
+
+    slot.memory = page;
+    slot.blocks = blocks.get();
+    return *blocks;
+}
+
+auto BlockCache::decode(const u8* page, const u8 start) -> std::unique_ptr<CodeBlock> {
+    auto block = std::make_unique<CodeBlock>();
+    block->start = start;
+
+    uint offset = start;
+    while (offset < 0x100) {
+        u8 opcode = page[offset];
+        uint length = instructions[opcode].length;
+
+        if (offset + length > 0x100) { break; }
+
+        if (opcode == 0xCB) {
+            u8 cb_opcode = page[offset + 1];
+            const auto& entry = CPU::opcode_cb_table[cb_opcode];
+            block->instructions.push_back({ entry.handler, static_cast<u8>(offset), 2, cb_opcode, entry.cycles, entry.cycles_branched });
+        } else {
+            const auto& entry = CPU::opcode_table[opcode];
+            block->instructions.push_back({ entry.handler, static_cast<u8>(offset), 1, opcode, entry.cycles, entry.cycles_branched });
+        }
+
+        offset += length;
+        block->end = offset;
+
+        if (ends_block(opcode)) { break; }
+    }
+
+    /* An empty block still depends on its opcode's length */
+    if (block->instructions.empty()) { block->end = block->start + 1; }
+
+    return block;
+}
+
+void BlockCache::mark_decoded(PageBlocks& blocks, const CodeBlock& block) {
+    for (uint byte = block.start; byte < block.end; byte++) {
+        blocks.decoded_bytes.set(byte);
+    }
+}
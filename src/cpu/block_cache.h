@@ -0,0 +1,91 @@
+#pragma once
+
+#include "cpu.h"
+
+#include <array>
+#include <bitset>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class MMU;
+
+/* A pre-decoded instruction. The handler still fetches its own operands
+ * through the MMU, so only the opcode fetch and dispatch are skipped */
+struct DecodedInstruction {
+    CPU::opcode_handler_t handler;
+    u8 offset; /* Position of the opcode within its page */
+    u8 length; /* Opcode bytes to skip: 2 for CB-prefixed instructions */
+    u8 opcode;
+    u8 cycles;
+    u8 cycles_branched;
+};
+
+/* A straight-line run of instructions, ending at the first control
+ * transfer or at the end of the page it starts in */
+struct CodeBlock {
+    std::vector<DecodedInstruction> instructions;
+    uint start = 0;
+    uint end = 0; /* One past the last byte decoded */
+};
+
+/*
+ * Caches decoded blocks keyed by the host memory they were decoded from,
+ * which tells ROM banks apart without any knowledge of the MBC. Blocks are
+ * walked one instruction at a time so interrupts, the scheduler and the
+ * debugger still run between every instruction.
+ *
+ * Only ROM, VRAM and work RAM are cached. RAM pages holding cached code are
+ * write-protected in the MMU's page table, and a write to a byte which was
+ * decoded throws away the blocks covering it.
+ */
+class BlockCache {
+public:
+    explicit BlockCache(MMU& inMmu);
+
+    /* The decoded instruction at pc, or nullptr if it has to be executed
+     * through the normal fetch/decode path */
+    auto lookup(u16 pc) -> const DecodedInstruction*;
+
+    /* Like lookup, but only continues the block currently being executed */
+    auto next_in_block(u16 pc) -> const DecodedInstruction*;
+
+    /* Called for writes to protected pages. Returns false once nothing is
+     * cached for the page any more, so it can be unprotected */
+    auto invalidate(const u8* page, u8 offset) -> bool;
+
+    /* Stops next_in_block() continuing the current block */
+    void leave_block() { current_block = nullptr; }
+
+private:
+    struct PageBlocks {
+        std::array<std::unique_ptr<CodeBlock>, 0x100> blocks;
+        std::bitset<0x100> decoded_bytes;
+    };
+
+    /* Last page table entry seen at each page of the address space, which
+     * saves hashing the host pointer at every block boundary */
+    struct PageSlot {
+        const u8* memory = nullptr;
+        PageBlocks* blocks = nullptr;
+    };
+
+    static auto is_cacheable(u8 page) -> bool;
+
+    auto advance_cursor(u16 pc) -> const DecodedInstruction*;
+
+    auto blocks_for(u8 page_index, const u8* page) -> PageBlocks&;
+    static auto decode(const u8* page, u8 offset) -> std::unique_ptr<CodeBlock>;
+    static void mark_decoded(PageBlocks& blocks, const CodeBlock& block);
+
+    MMU& mmu;
+
+    std::unordered_map<const u8*, std::unique_ptr<PageBlocks>> pages;
+    std::array<PageSlot, 0x100> slots;
+
+    /* Cursor into the block currently being executed */
+    const CodeBlock* current_block = nullptr;
+    const u8* current_page = nullptr;
+    uint next_index = 0;
+    u16 next_pc = 0;
+};
@@ -1,10 +1,12 @@
 #include "cpu.h"
 
+#include "block_cache.h"
 #include "../gameboy.h"
 #include "opcode_cycles.h"
-#include "opcode_names.h"
 #include "../util/bitwise.h"
 #include "../util/log.h"
+#include "../save_state.h"
+#include "../trace.h"
 
 using bitwise::compose_bytes;
 
@@ -16,13 +18,23 @@ CPU::CPU(Gameboy& inGb, Options& inOptions) :
     de(d, e),
     hl(h, l)
 {
+    block_cache = std::make_unique<BlockCache>(inGb.mmu);
 }
 
+CPU::~CPU() = default;
+
 auto CPU::tick() -> Cycles {
+    idle_loop_cycles = 0;
     handle_interrupts();
 
     if (halted) { return 1; }
 
+    if (options.block_cache) {
+        if (const DecodedInstruction* decoded = block_cache->lookup(pc.value())) {
+            return execute_decoded(*decoded);
+        }
+    }
+
     u16 opcode_pc = pc.value();
     auto opcode = get_byte_from_pc();
     auto cycles = execute_opcode(opcode, opcode_pc);
@@ -34,12 +46,164 @@ auto CPU::execute_opcode(const u8 opcode, u16 opcode_pc) -> Cycles {
 
     if (opcode == 0xCB) {
         u8 cb_opcode = get_byte_from_pc();
+        profile_cb_opcode(gb.profiler, cb_opcode);
         return execute_cb_opcode(cb_opcode, opcode_pc);
     }
 
+    profile_opcode(gb.profiler, opcode);
     return execute_normal_opcode(opcode, opcode_pc);
 }
 
+auto CPU::tick_block() -> Cycles {
+    if (!options.block_cache || halted || idle_loop_cycles != 0) { return 0; }
+    if ((interrupt_flag.value() & interrupt_enabled.value()) != 0) { return 0; }
+
+    const DecodedInstruction* decoded = block_cache->next_in_block(pc.value());
+    if (decoded == nullptr) { return 0; }
+
+    return execute_decoded(*decoded);
+}
+
+/* Takes a copy, as the instruction may overwrite its own block */
+auto CPU::execute_decoded(const DecodedInstruction instruction) -> Cycles {
+    u16 opcode_pc = pc.value();
+    pc.set(static_cast<u16>(opcode_pc + instruction.length));
+    branch_taken = false;
+
+    if (instruction.length == 2) {
+        profile_cb_opcode(gb.profiler, instruction.opcode);
+        if (tracer != nullptr) { trace(opcode_pc, instruction.opcode, 0xCB); }
+    } else {
+        profile_opcode(gb.profiler, instruction.opcode);
+        if (tracer != nullptr) { trace(opcode_pc, instruction.opcode, 0); }
+    }
+
+    (this->*instruction.handler)();
+
+    return !branch_taken
+        ? instruction.cycles
+        : instruction.cycles_branched;
+}
+
+namespace {
+struct CPUState {
+    u16 pc;
+    u16 sp;
+    u8 a, f, b, c, d, e, h, l;
+    u8 interrupt_flag;
+    u8 interrupt_enabled;
+    bool interrupts_enabled;
+    bool halted;
+};
+} // namespace
+
+void CPU::save_state(StateWriter& writer) const {
+    CPUState state = {};
+    state.pc = pc.value();
+    state.sp = sp.value();
+    state.a = a.value();
+    state.f = f.value();
+    state.b = b.value();
+    state.c = c.value();
+    state.d = d.value();
+    state.e = e.value();
+    state.h = h.value();
+    state.l = l.value();
+    state.interrupt_flag = interrupt_flag.value();
+    state.interrupt_enabled = interrupt_enabled.value();
+    state.interrupts_enabled = interrupts_enabled;
+    state.halted = halted;
+
+    writer.write(StateSection::CPU, state);
+}
+
+void CPU::load_state(StateReader& reader) {
+    CPUState state;
+    reader.read(StateSection::CPU, state);
+
+    pc.set(state.pc);
+    sp.set(state.sp);
+    a.set(state.a);
+    f.set(state.f);
+    b.set(state.b);
+    c.set(state.c);
+    d.set(state.d);
+    e.set(state.e);
+    h.set(state.h);
+    l.set(state.l);
+    interrupt_flag.set(state.interrupt_flag);
+    interrupt_enabled.set(state.interrupt_enabled);
+    interrupts_enabled = state.interrupts_enabled;
+    halted = state.halted;
+
+    /* Decoded code stays cached: the MMU drops whatever the state changes
+     * as it loads work RAM, and ROM can't change. Only the block being run
+     * is left, as execution carries on somewhere else */
+    block_cache->leave_block();
+}
+
+void CPU::trace(const u16 opcode_pc, const u8 opcode, const u8 prefix) {
+    TraceRecord record = {};
+    record.cycle = gb.scheduler.now();
+    record.pc = opcode_pc;
+    record.af = af.value();
+    record.bc = bc.value();
+    record.de = de.value();
+    record.hl = hl.value();
+    record.sp = sp.value();
+    record.opcode = opcode;
+    record.prefix = prefix;
+    tracer->record(record);
+}
+
+/* ldh a,(n) of LY, STAT or IF; cp n or and n; then a conditional jr back to
+ * the ldh. The registers it reads only change at some component's event,
+ * and every iteration leaves the CPU as the last one did. Not looked for
+ * while tracing, as the skipped iterations would be missing from the trace */
+void CPU::check_idle_loop(const u16 loop_start) {
+    if (!options.skip_idle_loops || tracer != nullptr) { return; }
+
+    /* Only loops in directly mapped memory: reading registers to look
+     * could change them, or stop at a watchpoint */
+    u8 code[6];
+    if (gb.mmu.peek(loop_start, code, sizeof(code)) < sizeof(code)) { return; }
+
+    bool polls_register = code[0] == 0xF0 && (code[1] == 0x44 || code[1] == 0x41 || code[1] == 0x0F);
+    bool tests_value = code[2] == 0xFE || code[2] == 0xE6;
+    bool branches_back = (code[4] == 0x20 || code[4] == 0x28 || code[4] == 0x30 || code[4] == 0x38) && code[5] == 0xFA;
+    if (!polls_register || !tests_value || !branches_back) { return; }
+
+    idle_loop_cycles = opcode_cycles[code[0]] + opcode_cycles[code[2]] + opcode_cycles_branched[code[4]];
+}
+
+auto CPU::is_locked() const -> bool {
+    bool none_enabled = (interrupt_enabled.value() & 0x1F) == 0;
+    if (halted) { return none_enabled; }
+    if (interrupts_enabled && !none_enabled) { return false; }
+
+    /* Only code in directly mapped memory, whole within its page, so
+     * looking doesn't touch any registers */
+    u16 address = pc.value();
+    const u8* page = gb.mmu.page_memory(static_cast<u8>(address >> 8));
+    if (page == nullptr || (address & 0xFF) > 0xFD) { return false; }
+
+    const u8* code = page + (address & 0xFF);
+    bool jr_to_itself = code[0] == 0x18 && code[1] == 0xFE;
+    bool jp_to_itself = code[0] == 0xC3 && compose_bytes(code[2], code[1]) == address;
+    return jr_to_itself || jp_to_itself;
+}
+
+void CPU::set_cgb_boot_registers() {
+    af.set(0x1180);
+    bc.set(0x0000);
+    de.set(0xFF56);
+    hl.set(0x000D);
+}
+
+auto CPU::invalidate_code(const u8* page, const u8 offset) -> bool {
+    return block_cache->invalidate(page, offset);
+}
+
 void CPU::handle_interrupts() {
     u8 fired_interrupts = interrupt_flag.value() & interrupt_enabled.value();
     if (!fired_interrupts) { return; }
@@ -53,7 +217,7 @@ void CPU::handle_interrupts() {
         return;
     }
 
-    stack_push(pc);
+    stack_push(pc.value());
 
     bool handled_interrupt = false;
 
@@ -132,27 +296,84 @@ auto CPU::is_condition(Condition condition) -> bool {
     return should_branch;
 }
 
-void CPU::stack_push(const WordValue& reg) {
+void CPU::stack_push(const u16 value) {
     sp.decrement();
-    gb.mmu.write(Address(sp), reg.high());
+    gb.mmu.write(Address(sp), static_cast<u8>(value >> 8));
     sp.decrement();
-    gb.mmu.write(Address(sp), reg.low());
+    gb.mmu.write(Address(sp), static_cast<u8>(value));
 }
 
-void CPU::stack_pop(WordValue& reg) {
+auto CPU::stack_pop() -> u16 {
     u8 low_byte = gb.mmu.read(Address(sp));
     sp.increment();
     u8 high_byte = gb.mmu.read(Address(sp));
     sp.increment();
 
-    u16 value = compose_bytes(high_byte, low_byte);
-    reg.set(value);
+    return compose_bytes(high_byte, low_byte);
 }
 
 /* clang-format off */
 auto CPU::execute_normal_opcode(const u8 opcode, u16 opcode_pc) -> Cycles {
-    log_trace("0x%04X: %s (0x%x)", opcode_pc, opcode_names[opcode].c_str(), opcode);
+    if (tracer != nullptr) { trace(opcode_pc, opcode, 0); }
+
+#if defined(GBEMU_CPU_DISPATCH_TABLE)
+    const OpcodeEntry& entry = opcode_table[opcode];
+    (this->*entry.handler)();
 
+    return !branch_taken
+        ? entry.cycles
+        : entry.cycles_branched;
+#elif defined(GBEMU_CPU_DISPATCH_GOTO)
+    /* Labels as values are a GCC/Clang extension */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wgnu-label-as-value"
+    static const void* const labels[256] = {
+        &&op_00, &&op_01, &&op_02, &&op_03, &&op_04, &&op_05, &&op_06, &&op_07, &&op_08, &&op_09, &&op_0A, &&op_0B, &&op_0C, &&op_0D, &&op_0E, &&op_0F,
+        &&op_10, &&op_11, &&op_12, &&op_13, &&op_14, &&op_15, &&op_16, &&op_17, &&op_18, &&op_19, &&op_1A, &&op_1B, &&op_1C, &&op_1D, &&op_1E, &&op_1F,
+        &&op_20, &&op_21, &&op_22, &&op_23, &&op_24, &&op_25, &&op_26, &&op_27, &&op_28, &&op_29, &&op_2A, &&op_2B, &&op_2C, &&op_2D, &&op_2E, &&op_2F,
+        &&op_30, &&op_31, &&op_32, &&op_33, &&op_34, &&op_35, &&op_36, &&op_37, &&op_38, &&op_39, &&op_3A, &&op_3B, &&op_3C, &&op_3D, &&op_3E, &&op_3F,
+        &&op_40, &&op_41, &&op_42, &&op_43, &&op_44, &&op_45, &&op_46, &&op_47, &&op_48, &&op_49, &&op_4A, &&op_4B, &&op_4C, &&op_4D, &&op_4E, &&op_4F,
+        &&op_50, &&op_51, &&op_52, &&op_53, &&op_54, &&op_55, &&op_56, &&op_57, &&op_58, &&op_59, &&op_5A, &&op_5B, &&op_5C, &&op_5D, &&op_5E, &&op_5F,
+        &&op_60, &&op_61, &&op_62, &&op_63, &&op_64, &&op_65, &&op_66, &&op_67, &&op_68, &&op_69, &&op_6A, &&op_6B, &&op_6C, &&op_6D, &&op_6E, &&op_6F,
+        &&op_70, &&op_71, &&op_72, &&op_73, &&op_74, &&op_75, &&op_76, &&op_77, &&op_78, &&op_79, &&op_7A, &&op_7B, &&op_7C, &&op_7D, &&op_7E, &&op_7F,
+        &&op_80, &&op_81, &&op_82, &&op_83, &&op_84, &&op_85, &&op_86, &&op_87, &&op_88, &&op_89, &&op_8A, &&op_8B, &&op_8C, &&op_8D, &&op_8E, &&op_8F,
+        &&op_90, &&op_91, &&op_92, &&op_93, &&op_94, &&op_95, &&op_96, &&op_97, &&op_98, &&op_99, &&op_9A, &&op_9B, &&op_9C, &&op_9D, &&op_9E, &&op_9F,
+        &&op_A0, &&op_A1, &&op_A2, &&op_A3, &&op_A4, &&op_A5, &&op_A6, &&op_A7, &&op_A8, &&op_A9, &&op_AA, &&op_AB, &&op_AC, &&op_AD, &&op_AE, &&op_AF,
+        &&op_B0, &&op_B1, &&op_B2, &&op_B3, &&op_B4, &&op_B5, &&op_B6, &&op_B7, &&op_B8, &&op_B9, &&op_BA, &&op_BB, &&op_BC, &&op_BD, &&op_BE, &&op_BF,
+        &&op_C0, &&op_C1, &&op_C2, &&op_C3, &&op_C4, &&op_C5, &&op_C6, &&op_C7, &&op_C8, &&op_C9, &&op_CA, &&op_CB, &&op_CC, &&op_CD, &&op_CE, &&op_CF,
+        &&op_D0, &&op_D1, &&op_D2, &&op_D3, &&op_D4, &&op_D5, &&op_D6, &&op_D7, &&op_D8, &&op_D9, &&op_DA, &&op_DB, &&op_DC, &&op_DD, &&op_DE, &&op_DF,
+        &&op_E0, &&op_E1, &&op_E2, &&op_E3, &&op_E4, &&op_E5, &&op_E6, &&op_E7, &&op_E8, &&op_E9, &&op_EA, &&op_EB, &&op_EC, &&op_ED, &&op_EE, &&op_EF,
+        &&op_F0, &&op_F1, &&op_F2, &&op_F3, &&op_F4, &&op_F5, &&op_F6, &&op_F7, &&op_F8, &&op_F9, &&op_FA, &&op_FB, &&op_FC, &&op_FD, &&op_FE, &&op_FF
+    };
+
+    goto *labels[opcode];
+
+    op_00: opcode_00(); goto done; op_01: opcode_01(); goto done; op_02: opcode_02(); goto done; op_03: opcode_03(); goto done; op_04: opcode_04(); goto done; op_05: opcode_05(); goto done; op_06: opcode_06(); goto done; op_07: opcode_07(); goto done; op_08: opcode_08(); goto done; op_09: opcode_09(); goto done; op_0A: opcode_0A(); goto done; op_0B: opcode_0B(); goto done; op_0C: opcode_0C(); goto done; op_0D: opcode_0D(); goto done; op_0E: opcode_0E(); goto done; op_0F: opcode_0F(); goto done;
+    op_10: opcode_10(); goto done; op_11: opcode_11(); goto done; op_12: opcode_12(); goto done; op_13: opcode_13(); goto done; op_14: opcode_14(); goto done; op_15: opcode_15(); goto done; op_16: opcode_16(); goto done; op_17: opcode_17(); goto done; op_18: opcode_18(); goto done; op_19: opcode_19(); goto done; op_1A: opcode_1A(); goto done; op_1B: opcode_1B(); goto done; op_1C: opcode_1C(); goto done; op_1D: opcode_1D(); goto done; op_1E: opcode_1E(); goto done; op_1F: opcode_1F(); goto done;
+    op_20: opcode_20(); goto done; op_21: opcode_21(); goto done; op_22: opcode_22(); goto done; op_23: opcode_23(); goto done; op_24: opcode_24(); goto done; op_25: opcode_25(); goto done; op_26: opcode_26(); goto done; op_27: opcode_27(); goto done; op_28: opcode_28(); goto done; op_29: opcode_29(); goto done; op_2A: opcode_2A(); goto done; op_2B: opcode_2B(); goto done; op_2C: opcode_2C(); goto done; op_2D: opcode_2D(); goto done; op_2E: opcode_2E(); goto done; op_2F: opcode_2F(); goto done;
+    op_30: opcode_30(); goto done; op_31: opcode_31(); goto done; op_32: opcode_32(); goto done; op_33: opcode_33(); goto done; op_34: opcode_34(); goto done; op_35: opcode_35(); goto done; op_36: opcode_36(); goto done; op_37: opcode_37(); goto done; op_38: opcode_38(); goto done; op_39: opcode_39(); goto done; op_3A: opcode_3A(); goto done; op_3B: opcode_3B(); goto done; op_3C: opcode_3C(); goto done; op_3D: opcode_3D(); goto done; op_3E: opcode_3E(); goto done; op_3F: opcode_3F(); goto done;
+    op_40: opcode_40(); goto done; op_41: opcode_41(); goto done; op_42: opcode_42(); goto done; op_43: opcode_43(); goto done; op_44: opcode_44(); goto done; op_45: opcode_45(); goto done; op_46: opcode_46(); goto done; op_47: opcode_47(); goto done; op_48: opcode_48(); goto done; op_49: opcode_49(); goto done; op_4A: opcode_4A(); goto done; op_4B: opcode_4B(); goto done; op_4C: opcode_4C(); goto done; op_4D: opcode_4D(); goto done; op_4E: opcode_4E(); goto done; op_4F: opcode_4F(); goto done;
+    op_50: opcode_50(); goto done; op_51: opcode_51(); goto done; op_52: opcode_52(); goto done; op_53: opcode_53(); goto done; op_54: opcode_54(); goto done; op_55: opcode_55(); goto done; op_56: opcode_56(); goto done; op_57: opcode_57(); goto done; op_58: opcode_58(); goto done; op_59: opcode_59(); goto done; op_5A: opcode_5A(); goto done; op_5B: opcode_5B(); goto done; op_5C: opcode_5C(); goto done; op_5D: opcode_5D(); goto done; op_5E: opcode_5E(); goto done; op_5F: opcode_5F(); goto done;
+    op_60: opcode_60(); goto done; op_61: opcode_61(); goto done; op_62: opcode_62(); goto done; op_63: opcode_63(); goto done; op_64: opcode_64(); goto done; op_65: opcode_65(); goto done; op_66: opcode_66(); goto done; op_67: opcode_67(); goto done; op_68: opcode_68(); goto done; op_69: opcode_69(); goto done; op_6A: opcode_6A(); goto done; op_6B: opcode_6B(); goto done; op_6C: opcode_6C(); goto done; op_6D: opcode_6D(); goto done; op_6E: opcode_6E(); goto done; op_6F: opcode_6F(); goto done;
+    op_70: opcode_70(); goto done; op_71: opcode_71(); goto done; op_72: opcode_72(); goto done; op_73: opcode_73(); goto done; op_74: opcode_74(); goto done; op_75: opcode_75(); goto done; op_76: opcode_76(); goto done; op_77: opcode_77(); goto done; op_78: opcode_78(); goto done; op_79: opcode_79(); goto done; op_7A: opcode_7A(); goto done; op_7B: opcode_7B(); goto done; op_7C: opcode_7C(); goto done; op_7D: opcode_7D(); goto done; op_7E: opcode_7E(); goto done; op_7F: opcode_7F(); goto done;
+    op_80: opcode_80(); goto done; op_81: opcode_81(); goto done; op_82: opcode_82(); goto done; op_83: opcode_83(); goto done; op_84: opcode_84(); goto done; op_85: opcode_85(); goto done; op_86: opcode_86(); goto done; op_87: opcode_87(); goto done; op_88: opcode_88(); goto done; op_89: opcode_89(); goto done; op_8A: opcode_8A(); goto done; op_8B: opcode_8B(); goto done; op_8C: opcode_8C(); goto done; op_8D: opcode_8D(); goto done; op_8E: opcode_8E(); goto done; op_8F: opcode_8F(); goto done;
+    op_90: opcode_90(); goto done; op_91: opcode_91(); goto done; op_92: opcode_92(); goto done; op_93: opcode_93(); goto done; op_94: opcode_94(); goto done; op_95: opcode_95(); goto done; op_96: opcode_96(); goto done; op_97: opcode_97(); goto done; op_98: opcode_98(); goto done; op_99: opcode_99(); goto done; op_9A: opcode_9A(); goto done; op_9B: opcode_9B(); goto done; op_9C: opcode_9C(); goto done; op_9D: opcode_9D(); goto done; op_9E: opcode_9E(); goto done; op_9F: opcode_9F(); goto done;
+    op_A0: opcode_A0(); goto done; op_A1: opcode_A1(); goto done; op_A2: opcode_A2(); goto done; op_A3: opcode_A3(); goto done; op_A4: opcode_A4(); goto done; op_A5: opcode_A5(); goto done; op_A6: opcode_A6(); goto done; op_A7: opcode_A7(); goto done; op_A8: opcode_A8(); goto done; op_A9: opcode_A9(); goto done; op_AA: opcode_AA(); goto done; op_AB: opcode_AB(); goto done; op_AC: opcode_AC(); goto done; op_AD: opcode_AD(); goto done; op_AE: opcode_AE(); goto done; op_AF: opcode_AF(); goto done;
+    op_B0: opcode_B0(); goto done; op_B1: opcode_B1(); goto done; op_B2: opcode_B2(); goto done; op_B3: opcode_B3(); goto done; op_B4: opcode_B4(); goto done; op_B5: opcode_B5(); goto done; op_B6: opcode_B6(); goto done; op_B7: opcode_B7(); goto done; op_B8: opcode_B8(); goto done; op_B9: opcode_B9(); goto done; op_BA: opcode_BA(); goto done; op_BB: opcode_BB(); goto done; op_BC: opcode_BC(); goto done; op_BD: opcode_BD(); goto done; op_BE: opcode_BE(); goto done; op_BF: opcode_BF(); goto done;
+    op_C0: opcode_C0(); goto done; op_C1: opcode_C1(); goto done; op_C2: opcode_C2(); goto done; op_C3: opcode_C3(); goto done; op_C4: opcode_C4(); goto done; op_C5: opcode_C5(); goto done; op_C6: opcode_C6(); goto done; op_C7: opcode_C7(); goto done; op_C8: opcode_C8(); goto done; op_C9: opcode_C9(); goto done; op_CA: opcode_CA(); goto done; op_CB: opcode_CB(); goto done; op_CC: opcode_CC(); goto done; op_CD: opcode_CD(); goto done; op_CE: opcode_CE(); goto done; op_CF: opcode_CF(); goto done;
+    op_D0: opcode_D0(); goto done; op_D1: opcode_D1(); goto done; op_D2: opcode_D2(); goto done; op_D3: opcode_D3(); goto done; op_D4: opcode_D4(); goto done; op_D5: opcode_D5(); goto done; op_D6: opcode_D6(); goto done; op_D7: opcode_D7(); goto done; op_D8: opcode_D8(); goto done; op_D9: opcode_D9(); goto done; op_DA: opcode_DA(); goto done; op_DB: opcode_DB(); goto done; op_DC: opcode_DC(); goto done; op_DD: opcode_DD(); goto done; op_DE: opcode_DE(); goto done; op_DF: opcode_DF(); goto done;
+    op_E0: opcode_E0(); goto done; op_E1: opcode_E1(); goto done; op_E2: opcode_E2(); goto done; op_E3: opcode_E3(); goto done; op_E4: opcode_E4(); goto done; op_E5: opcode_E5(); goto done; op_E6: opcode_E6(); goto done; op_E7: opcode_E7(); goto done; op_E8: opcode_E8(); goto done; op_E9: opcode_E9(); goto done; op_EA: opcode_EA(); goto done; op_EB: opcode_EB(); goto done; op_EC: opcode_EC(); goto done; op_ED: opcode_ED(); goto done; op_EE: opcode_EE(); goto done; op_EF: opcode_EF(); goto done;
+    op_F0: opcode_F0(); goto done; op_F1: opcode_F1(); goto done; op_F2: opcode_F2(); goto done; op_F3: opcode_F3(); goto done; op_F4: opcode_F4(); goto done; op_F5: opcode_F5(); goto done; op_F6: opcode_F6(); goto done; op_F7: opcode_F7(); goto done; op_F8: opcode_F8(); goto done; op_F9: opcode_F9(); goto done; op_FA: opcode_FA(); goto done; op_FB: opcode_FB(); goto done; op_FC: opcode_FC(); goto done; op_FD: opcode_FD(); goto done; op_FE: opcode_FE(); goto done; op_FF: opcode_FF(); goto done;
+
+done:
+#pragma clang diagnostic pop
+#pragma GCC diagnostic pop
+    return !branch_taken
+        ? opcode_table[opcode].cycles
+        : opcode_table[opcode].cycles_branched;
+#else
     switch (opcode) {
         case 0x00: opcode_00(); break; case 0x01: opcode_01(); break; case 0x02: opcode_02(); break; case 0x03: opcode_03(); break; case 0x04: opcode_04(); break; case 0x05: opcode_05(); break; case 0x06: opcode_06(); break; case 0x07: opcode_07(); break; case 0x08: opcode_08(); break; case 0x09: opcode_09(); break; case 0x0A: opcode_0A(); break; case 0x0B: opcode_0B(); break; case 0x0C: opcode_0C(); break; case 0x0D: opcode_0D(); break; case 0x0E: opcode_0E(); break; case 0x0F: opcode_0F(); break;
         case 0x10: opcode_10(); break; case 0x11: opcode_11(); break; case 0x12: opcode_12(); break; case 0x13: opcode_13(); break; case 0x14: opcode_14(); break; case 0x15: opcode_15(); break; case 0x16: opcode_16(); break; case 0x17: opcode_17(); break; case 0x18: opcode_18(); break; case 0x19: opcode_19(); break; case 0x1A: opcode_1A(); break; case 0x1B: opcode_1B(); break; case 0x1C: opcode_1C(); break; case 0x1D: opcode_1D(); break; case 0x1E: opcode_1E(); break; case 0x1F: opcode_1F(); break;
@@ -171,15 +392,69 @@ auto CPU::execute_normal_opcode(const u8 opcode, u16 opcode_pc) -> Cycles {
         case 0xE0: opcode_E0(); break; case 0xE1: opcode_E1(); break; case 0xE2: opcode_E2(); break; case 0xE3: opcode_E3(); break; case 0xE4: opcode_E4(); break; case 0xE5: opcode_E5(); break; case 0xE6: opcode_E6(); break; case 0xE7: opcode_E7(); break; case 0xE8: opcode_E8(); break; case 0xE9: opcode_E9(); break; case 0xEA: opcode_EA(); break; case 0xEB: opcode_EB(); break; case 0xEC: opcode_EC(); break; case 0xED: opcode_ED(); break; case 0xEE: opcode_EE(); break; case 0xEF: opcode_EF(); break;
         case 0xF0: opcode_F0(); break; case 0xF1: opcode_F1(); break; case 0xF2: opcode_F2(); break; case 0xF3: opcode_F3(); break; case 0xF4: opcode_F4(); break; case 0xF5: opcode_F5(); break; case 0xF6: opcode_F6(); break; case 0xF7: opcode_F7(); break; case 0xF8: opcode_F8(); break; case 0xF9: opcode_F9(); break; case 0xFA: opcode_FA(); break; case 0xFB: opcode_FB(); break; case 0xFC: opcode_FC(); break; case 0xFD: opcode_FD(); break; case 0xFE: opcode_FE(); break; case 0xFF: opcode_FF(); break;
     }
-
     return !branch_taken
         ? opcode_cycles[opcode]
         : opcode_cycles_branched[opcode];
+#endif
 }
 
 auto CPU::execute_cb_opcode(const u8 opcode, u16 opcode_pc) -> Cycles {
-    log_trace("0x%04X: %s (CB 0x%x)", opcode_pc, opcode_cb_names[opcode].c_str(), opcode);
-
+    if (tracer != nullptr) { trace(opcode_pc, opcode, 0xCB); }
+
+#if defined(GBEMU_CPU_DISPATCH_TABLE)
+    const OpcodeEntry& entry = opcode_cb_table[opcode];
+    (this->*entry.handler)();
+
+    return entry.cycles;
+#elif defined(GBEMU_CPU_DISPATCH_GOTO)
+    /* Labels as values are a GCC/Clang extension */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wgnu-label-as-value"
+    static const void* const labels[256] = {
+        &&cb_00, &&cb_01, &&cb_02, &&cb_03, &&cb_04, &&cb_05, &&cb_06, &&cb_07, &&cb_08, &&cb_09, &&cb_0A, &&cb_0B, &&cb_0C, &&cb_0D, &&cb_0E, &&cb_0F,
+        &&cb_10, &&cb_11, &&cb_12, &&cb_13, &&cb_14, &&cb_15, &&cb_16, &&cb_17, &&cb_18, &&cb_19, &&cb_1A, &&cb_1B, &&cb_1C, &&cb_1D, &&cb_1E, &&cb_1F,
+        &&cb_20, &&cb_21, &&cb_22, &&cb_23, &&cb_24, &&cb_25, &&cb_26, &&cb_27, &&cb_28, &&cb_29, &&cb_2A, &&cb_2B, &&cb_2C, &&cb_2D, &&cb_2E, &&cb_2F,
+        &&cb_30, &&cb_31, &&cb_32, &&cb_33, &&cb_34, &&cb_35, &&cb_36, &&cb_37, &&cb_38, &&cb_39, &&cb_3A, &&cb_3B, &&cb_3C, &&cb_3D, &&cb_3E, &&cb_3F,
+        &&cb_40, &&cb_41, &&cb_42, &&cb_43, &&cb_44, &&cb_45, &&cb_46, &&cb_47, &&cb_48, &&cb_49, &&cb_4A, &&cb_4B, &&cb_4C, &&cb_4D, &&cb_4E, &&cb_4F,
+        &&cb_50, &&cb_51, &&cb_52, &&cb_53, &&cb_54, &&cb_55, &&cb_56, &&cb_57, &&cb_58, &&cb_59, &&cb_5A, &&cb_5B, &&cb_5C, &&cb_5D, &&cb_5E, &&cb_5F,
+        &&cb_60, &&cb_61, &&cb_62, &&cb_63, &&cb_64, &&cb_65, &&cb_66, &&cb_67, &&cb_68, &&cb_69, &&cb_6A, &&cb_6B, &&cb_6C, &&cb_6D, &&cb_6E, &&cb_6F,
+        &&cb_70, &&cb_71, &&cb_72, &&cb_73, &&cb_74, &&cb_75, &&cb_76, &&cb_77, &&cb_78, &&cb_79, &&cb_7A, &&cb_7B, &&cb_7C, &&cb_7D, &&cb_7E, &&cb_7F,
+        &&cb_80, &&cb_81, &&cb_82, &&cb_83, &&cb_84, &&cb_85, &&cb_86, &&cb_87, &&cb_88, &&cb_89, &&cb_8A, &&cb_8B, &&cb_8C, &&cb_8D, &&cb_8E, &&cb_8F,
+        &&cb_90, &&cb_91, &&cb_92, &&cb_93, &&cb_94, &&cb_95, &&cb_96, &&cb_97, &&cb_98, &&cb_99, &&cb_9A, &&cb_9B, &&cb_9C, &&cb_9D, &&cb_9E, &&cb_9F,
+        &&cb_A0, &&cb_A1, &&cb_A2, &&cb_A3, &&cb_A4, &&cb_A5, &&cb_A6, &&cb_A7, &&cb_A8, &&cb_A9, &&cb_AA, &&cb_AB, &&cb_AC, &&cb_AD, &&cb_AE, &&cb_AF,
+        &&cb_B0, &&cb_B1, &&cb_B2, &&cb_B3, &&cb_B4, &&cb_B5, &&cb_B6, &&cb_B7, &&cb_B8, &&cb_B9, &&cb_BA, &&cb_BB, &&cb_BC, &&cb_BD, &&cb_BE, &&cb_BF,
+        &&cb_C0, &&cb_C1, &&cb_C2, &&cb_C3, &&cb_C4, &&cb_C5, &&cb_C6, &&cb_C7, &&cb_C8, &&cb_C9, &&cb_CA, &&cb_CB, &&cb_CC, &&cb_CD, &&cb_CE, &&cb_CF,
+        &&cb_D0, &&cb_D1, &&cb_D2, &&cb_D3, &&cb_D4, &&cb_D5, &&cb_D6, &&cb_D7, &&cb_D8, &&cb_D9, &&cb_DA, &&cb_DB, &&cb_DC, &&cb_DD, &&cb_DE, &&cb_DF,
+        &&cb_E0, &&cb_E1, &&cb_E2, &&cb_E3, &&cb_E4, &&cb_E5, &&cb_E6, &&cb_E7, &&cb_E8, &&cb_E9, &&cb_EA, &&cb_EB, &&cb_EC, &&cb_ED, &&cb_EE, &&cb_EF,
+        &&cb_F0, &&cb_F1, &&cb_F2, &&cb_F3, &&cb_F4, &&cb_F5, &&cb_F6, &&cb_F7, &&cb_F8, &&cb_F9, &&cb_FA, &&cb_FB, &&cb_FC, &&cb_FD, &&cb_FE, &&cb_FF
+    };
+
+    goto *labels[opcode];
+
+    cb_00: opcode_CB_00(); goto done; cb_01: opcode_CB_01(); goto done; cb_02: opcode_CB_02(); goto done; cb_03: opcode_CB_03(); goto done; cb_04: opcode_CB_04(); goto done; cb_05: opcode_CB_05(); goto done; cb_06: opcode_CB_06(); goto done; cb_07: opcode_CB_07(); goto done; cb_08: opcode_CB_08(); goto done; cb_09: opcode_CB_09(); goto done; cb_0A: opcode_CB_0A(); goto done; cb_0B: opcode_CB_0B(); goto done; cb_0C: opcode_CB_0C(); goto done; cb_0D: opcode_CB_0D(); goto done; cb_0E: opcode_CB_0E(); goto done; cb_0F: opcode_CB_0F(); goto done;
+    cb_10: opcode_CB_10(); goto done; cb_11: opcode_CB_11(); goto done; cb_12: opcode_CB_12(); goto done; cb_13: opcode_CB_13(); goto done; cb_14: opcode_CB_14(); goto done; cb_15: opcode_CB_15(); goto done; cb_16: opcode_CB_16(); goto done; cb_17: opcode_CB_17(); goto done; cb_18: opcode_CB_18(); goto done; cb_19: opcode_CB_19(); goto done; cb_1A: opcode_CB_1A(); goto done; cb_1B: opcode_CB_1B(); goto done; cb_1C: opcode_CB_1C(); goto done; cb_1D: opcode_CB_1D(); goto done; cb_1E: opcode_CB_1E(); goto done; cb_1F: opcode_CB_1F(); goto done;
+    cb_20: opcode_CB_20(); goto done; cb_21: opcode_CB_21(); goto done; cb_22: opcode_CB_22(); goto done; cb_23: opcode_CB_23(); goto done; cb_24: opcode_CB_24(); goto done; cb_25: opcode_CB_25(); goto done; cb_26: opcode_CB_26(); goto done; cb_27: opcode_CB_27(); goto done; cb_28: opcode_CB_28(); goto done; cb_29: opcode_CB_29(); goto done; cb_2A: opcode_CB_2A(); goto done; cb_2B: opcode_CB_2B(); goto done; cb_2C: opcode_CB_2C(); goto done; cb_2D: opcode_CB_2D(); goto done; cb_2E: opcode_CB_2E(); goto done; cb_2F: opcode_CB_2F(); goto done;
+    cb_30: opcode_CB_30(); goto done; cb_31: opcode_CB_31(); goto done; cb_32: opcode_CB_32(); goto done; cb_33: opcode_CB_33(); goto done; cb_34: opcode_CB_34(); goto done; cb_35: opcode_CB_35(); goto done; cb_36: opcode_CB_36(); goto done; cb_37: opcode_CB_37(); goto done; cb_38: opcode_CB_38(); goto done; cb_39: opcode_CB_39(); goto done; cb_3A: opcode_CB_3A(); goto done; cb_3B: opcode_CB_3B(); goto done; cb_3C: opcode_CB_3C(); goto done; cb_3D: opcode_CB_3D(); goto done; cb_3E: opcode_CB_3E(); goto done; cb_3F: opcode_CB_3F(); goto done;
+    cb_40: opcode_CB_40(); goto done; cb_41: opcode_CB_41(); goto done; cb_42: opcode_CB_42(); goto done; cb_43: opcode_CB_43(); goto done; cb_44: opcode_CB_44(); goto done; cb_45: opcode_CB_45(); goto done; cb_46: opcode_CB_46(); goto done; cb_47: opcode_CB_47(); goto done; cb_48: opcode_CB_48(); goto done; cb_49: opcode_CB_49(); goto done; cb_4A: opcode_CB_4A(); goto done; cb_4B: opcode_CB_4B(); goto done; cb_4C: opcode_CB_4C(); goto done; cb_4D: opcode_CB_4D(); goto done; cb_4E: opcode_CB_4E(); goto done; cb_4F: opcode_CB_4F(); goto done;
+    cb_50: opcode_CB_50(); goto done; cb_51: opcode_CB_51(); goto done; cb_52: opcode_CB_52(); goto done; cb_53: opcode_CB_53(); goto done; cb_54: opcode_CB_54(); goto done; cb_55: opcode_CB_55(); goto done; cb_56: opcode_CB_56(); goto done; cb_57: opcode_CB_57(); goto done; cb_58: opcode_CB_58(); goto done; cb_59: opcode_CB_59(); goto done; cb_5A: opcode_CB_5A(); goto done; cb_5B: opcode_CB_5B(); goto done; cb_5C: opcode_CB_5C(); goto done; cb_5D: opcode_CB_5D(); goto done; cb_5E: opcode_CB_5E(); goto done; cb_5F: opcode_CB_5F(); goto done;
+    cb_60: opcode_CB_60(); goto done; cb_61: opcode_CB_61(); goto done; cb_62: opcode_CB_62(); goto done; cb_63: opcode_CB_63(); goto done; cb_64: opcode_CB_64(); goto done; cb_65: opcode_CB_65(); goto done; cb_66: opcode_CB_66(); goto done; cb_67: opcode_CB_67(); goto done; cb_68: opcode_CB_68(); goto done; cb_69: opcode_CB_69(); goto done; cb_6A: opcode_CB_6A(); goto done; cb_6B: opcode_CB_6B(); goto done; cb_6C: opcode_CB_6C(); goto done; cb_6D: opcode_CB_6D(); goto done; cb_6E: opcode_CB_6E(); goto done; cb_6F: opcode_CB_6F(); goto done;
+    cb_70: opcode_CB_70(); goto done; cb_71: opcode_CB_71(); goto done; cb_72: opcode_CB_72(); goto done; cb_73: opcode_CB_73(); goto done; cb_74: opcode_CB_74(); goto done; cb_75: opcode_CB_75(); goto done; cb_76: opcode_CB_76(); goto done; cb_77: opcode_CB_77(); goto done; cb_78: opcode_CB_78(); goto done; cb_79: opcode_CB_79(); goto done; cb_7A: opcode_CB_7A(); goto done; cb_7B: opcode_CB_7B(); goto done; cb_7C: opcode_CB_7C(); goto done; cb_7D: opcode_CB_7D(); goto done; cb_7E: opcode_CB_7E(); goto done; cb_7F: opcode_CB_7F(); goto done;
+    cb_80: opcode_CB_80(); goto done; cb_81: opcode_CB_81(); goto done; cb_82: opcode_CB_82(); goto done; cb_83: opcode_CB_83(); goto done; cb_84: opcode_CB_84(); goto done; cb_85: opcode_CB_85(); goto done; cb_86: opcode_CB_86(); goto done; cb_87: opcode_CB_87(); goto done; cb_88: opcode_CB_88(); goto done; cb_89: opcode_CB_89(); goto done; cb_8A: opcode_CB_8A(); goto done; cb_8B: opcode_CB_8B(); goto done; cb_8C: opcode_CB_8C(); goto done; cb_8D: opcode_CB_8D(); goto done; cb_8E: opcode_CB_8E(); goto done; cb_8F: opcode_CB_8F(); goto done;
+    cb_90: opcode_CB_90(); goto done; cb_91: opcode_CB_91(); goto done; cb_92: opcode_CB_92(); goto done; cb_93: opcode_CB_93(); goto done; cb_94: opcode_CB_94(); goto done; cb_95: opcode_CB_95(); goto done; cb_96: opcode_CB_96(); goto done; cb_97: opcode_CB_97(); goto done; cb_98: opcode_CB_98(); goto done; cb_99: opcode_CB_99(); goto done; cb_9A: opcode_CB_9A(); goto done; cb_9B: opcode_CB_9B(); goto done; cb_9C: opcode_CB_9C(); goto done; cb_9D: opcode_CB_9D(); goto done; cb_9E: opcode_CB_9E(); goto done; cb_9F: opcode_CB_9F(); goto done;
+    cb_A0: opcode_CB_A0(); goto done; cb_A1: opcode_CB_A1(); goto done; cb_A2: opcode_CB_A2(); goto done; cb_A3: opcode_CB_A3(); goto done; cb_A4: opcode_CB_A4(); goto done; cb_A5: opcode_CB_A5(); goto done; cb_A6: opcode_CB_A6(); goto done; cb_A7: opcode_CB_A7(); goto done; cb_A8: opcode_CB_A8(); goto done; cb_A9: opcode_CB_A9(); goto done; cb_AA: opcode_CB_AA(); goto done; cb_AB: opcode_CB_AB(); goto done; cb_AC: opcode_CB_AC(); goto done; cb_AD: opcode_CB_AD(); goto done; cb_AE: opcode_CB_AE(); goto done; cb_AF: opcode_CB_AF(); goto done;
+    cb_B0: opcode_CB_B0(); goto done; cb_B1: opcode_CB_B1(); goto done; cb_B2: opcode_CB_B2(); goto done; cb_B3: opcode_CB_B3(); goto done; cb_B4: opcode_CB_B4(); goto done; cb_B5: opcode_CB_B5(); goto done; cb_B6: opcode_CB_B6(); goto done; cb_B7: opcode_CB_B7(); goto done; cb_B8: opcode_CB_B8(); goto done; cb_B9: opcode_CB_B9(); goto done; cb_BA: opcode_CB_BA(); goto done; cb_BB: opcode_CB_BB(); goto done; cb_BC: opcode_CB_BC(); goto done; cb_BD: opcode_CB_BD(); goto done; cb_BE: opcode_CB_BE(); goto done; cb_BF: opcode_CB_BF(); goto done;
+    cb_C0: opcode_CB_C0(); goto done; cb_C1: opcode_CB_C1(); goto done; cb_C2: opcode_CB_C2(); goto done; cb_C3: opcode_CB_C3(); goto done; cb_C4: opcode_CB_C4(); goto done; cb_C5: opcode_CB_C5(); goto done; cb_C6: opcode_CB_C6(); goto done; cb_C7: opcode_CB_C7(); goto done; cb_C8: opcode_CB_C8(); goto done; cb_C9: opcode_CB_C9(); goto done; cb_CA: opcode_CB_CA(); goto done; cb_CB: opcode_CB_CB(); goto done; cb_CC: opcode_CB_CC(); goto done; cb_CD: opcode_CB_CD(); goto done; cb_CE: opcode_CB_CE(); goto done; cb_CF: opcode_CB_CF(); goto done;
+    cb_D0: opcode_CB_D0(); goto done; cb_D1: opcode_CB_D1(); goto done; cb_D2: opcode_CB_D2(); goto done; cb_D3: opcode_CB_D3(); goto done; cb_D4: opcode_CB_D4(); goto done; cb_D5: opcode_CB_D5(); goto done; cb_D6: opcode_CB_D6(); goto done; cb_D7: opcode_CB_D7(); goto done; cb_D8: opcode_CB_D8(); goto done; cb_D9: opcode_CB_D9(); goto done; cb_DA: opcode_CB_DA(); goto done; cb_DB: opcode_CB_DB(); goto done; cb_DC: opcode_CB_DC(); goto done; cb_DD: opcode_CB_DD(); goto done; cb_DE: opcode_CB_DE(); goto done; cb_DF: opcode_CB_DF(); goto done;
+    cb_E0: opcode_CB_E0(); goto done; cb_E1: opcode_CB_E1(); goto done; cb_E2: opcode_CB_E2(); goto done; cb_E3: opcode_CB_E3(); goto done; cb_E4: opcode_CB_E4(); goto done; cb_E5: opcode_CB_E5(); goto done; cb_E6: opcode_CB_E6(); goto done; cb_E7: opcode_CB_E7(); goto done; cb_E8: opcode_CB_E8(); goto done; cb_E9: opcode_CB_E9(); goto done; cb_EA: opcode_CB_EA(); goto done; cb_EB: opcode_CB_EB(); goto done; cb_EC: opcode_CB_EC(); goto done; cb_ED: opcode_CB_ED(); goto done; cb_EE: opcode_CB_EE(); goto done; cb_EF: opcode_CB_EF(); goto done;
+    cb_F0: opcode_CB_F0(); goto done; cb_F1: opcode_CB_F1(); goto done; cb_F2: opcode_CB_F2(); goto done; cb_F3: opcode_CB_F3(); goto done; cb_F4: opcode_CB_F4(); goto done; cb_F5: opcode_CB_F5(); goto done; cb_F6: opcode_CB_F6(); goto done; cb_F7: opcode_CB_F7(); goto done; cb_F8: opcode_CB_F8(); goto done; cb_F9: opcode_CB_F9(); goto done; cb_FA: opcode_CB_FA(); goto done; cb_FB: opcode_CB_FB(); goto done; cb_FC: opcode_CB_FC(); goto done; cb_FD: opcode_CB_FD(); goto done; cb_FE: opcode_CB_FE(); goto done; cb_FF: opcode_CB_FF(); goto done;
+
+done:
+#pragma clang diagnostic pop
+#pragma GCC diagnostic pop
+    return opcode_cb_table[opcode].cycles;
+#else
     switch (opcode) {
         case 0x00: opcode_CB_00(); break; case 0x01: opcode_CB_01(); break; case 0x02: opcode_CB_02(); break; case 0x03: opcode_CB_03(); break; case 0x04: opcode_CB_04(); break; case 0x05: opcode_CB_05(); break; case 0x06: opcode_CB_06(); break; case 0x07: opcode_CB_07(); break; case 0x08: opcode_CB_08(); break; case 0x09: opcode_CB_09(); break; case 0x0A: opcode_CB_0A(); break; case 0x0B: opcode_CB_0B(); break; case 0x0C: opcode_CB_0C(); break; case 0x0D: opcode_CB_0D(); break; case 0x0E: opcode_CB_0E(); break; case 0x0F: opcode_CB_0F(); break;
         case 0x10: opcode_CB_10(); break; case 0x11: opcode_CB_11(); break; case 0x12: opcode_CB_12(); break; case 0x13: opcode_CB_13(); break; case 0x14: opcode_CB_14(); break; case 0x15: opcode_CB_15(); break; case 0x16: opcode_CB_16(); break; case 0x17: opcode_CB_17(); break; case 0x18: opcode_CB_18(); break; case 0x19: opcode_CB_19(); break; case 0x1A: opcode_CB_1A(); break; case 0x1B: opcode_CB_1B(); break; case 0x1C: opcode_CB_1C(); break; case 0x1D: opcode_CB_1D(); break; case 0x1E: opcode_CB_1E(); break; case 0x1F: opcode_CB_1F(); break;
@@ -198,6 +473,6 @@ auto CPU::execute_cb_opcode(const u8 opcode, u16 opcode_pc) -> Cycles {
         case 0xE0: opcode_CB_E0(); break; case 0xE1: opcode_CB_E1(); break; case 0xE2: opcode_CB_E2(); break; case 0xE3: opcode_CB_E3(); break; case 0xE4: opcode_CB_E4(); break; case 0xE5: opcode_CB_E5(); break; case 0xE6: opcode_CB_E6(); break; case 0xE7: opcode_CB_E7(); break; case 0xE8: opcode_CB_E8(); break; case 0xE9: opcode_CB_E9(); break; case 0xEA: opcode_CB_EA(); break; case 0xEB: opcode_CB_EB(); break; case 0xEC: opcode_CB_EC(); break; case 0xED: opcode_CB_ED(); break; case 0xEE: opcode_CB_EE(); break; case 0xEF: opcode_CB_EF(); break;
         case 0xF0: opcode_CB_F0(); break; case 0xF1: opcode_CB_F1(); break; case 0xF2: opcode_CB_F2(); break; case 0xF3: opcode_CB_F3(); break; case 0xF4: opcode_CB_F4(); break; case 0xF5: opcode_CB_F5(); break; case 0xF6: opcode_CB_F6(); break; case 0xF7: opcode_CB_F7(); break; case 0xF8: opcode_CB_F8(); break; case 0xF9: opcode_CB_F9(); break; case 0xFA: opcode_CB_FA(); break; case 0xFB: opcode_CB_FB(); break; case 0xFC: opcode_CB_FC(); break; case 0xFD: opcode_CB_FD(); break; case 0xFE: opcode_CB_FE(); break; case 0xFF: opcode_CB_FF(); break;
     }
-
     return opcode_cycles_cb[opcode];
+#endif
 }
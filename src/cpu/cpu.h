@@ -4,7 +4,15 @@
 #include "../register.h"
 #include "../options.h"
 
+#include <array>
+#include <memory>
+
 class Gameboy;
+class Tracer;
+class BlockCache;
+class StateWriter;
+class StateReader;
+struct DecodedInstruction;
 
 enum class Condition {
     NZ,
@@ -36,11 +44,54 @@ const u16 joypad = 0x60;
 class CPU {
 public:
     CPU(Gameboy& inGb, Options& inOptions);
+    ~CPU();
 
     auto tick() -> Cycles;
 
+    /* Executes the next instruction of the current cached block, as long as
+     * no interrupt is waiting to be serviced. Returns 0 cycles if the CPU has
+     * to go back through tick() instead */
+    auto tick_block() -> Cycles;
+
+    /* Drops decoded blocks for a page of host memory if a write at offset
+     * modified one. Returns whether anything is still cached for the page */
+    auto invalidate_code(const u8* page, u8 offset) -> bool;
+
     auto execute_opcode(u8 opcode, u16 opcode_pc) -> Cycles;
 
+    auto program_counter() const -> u16 { return pc.value(); }
+
+    /* Halted, or (with Options::skip_idle_loops) just round a loop which
+     * does nothing but poll LY, STAT or IF, and no interrupt is waiting.
+     * Then nothing changes for the CPU before some other component's next
+     * event, so the clock can jump towards it (see Gameboy::skip_idle) */
+    auto is_idle() const -> bool {
+        return (halted || idle_loop_cycles != 0)
+            && (interrupt_flag.value() & interrupt_enabled.value()) == 0;
+    }
+
+    auto is_halted() const -> bool { return halted; }
+
+    /* Stuck for good: halted with no interrupt enabled, or at a JR or JP
+     * to itself with none which could be taken. For the watchdog */
+    auto is_locked() const -> bool;
+
+    /* Cycles one iteration of the idle loop takes, if the CPU is in one */
+    auto idle_loop_length() const -> uint { return idle_loop_cycles; }
+
+    /* The CGB boot ROM leaves A at 0x11, which is how games tell they are
+     * running on one. Only the DMG boot ROM is built in, so the MMU calls
+     * this as it hands over a CGB cartridge to finish in the same state */
+    void set_cgb_boot_registers();
+
+    /* Every instruction executed from now on is recorded, until set back to null */
+    void set_tracer(Tracer* inTracer) { tracer = inTracer; }
+
+    /* Registers and interrupt state. Loading also throws away every
+     * decoded block, as memory has changed underneath them */
+    void save_state(StateWriter& writer) const;
+    void load_state(StateReader& reader);
+
     auto execute_normal_opcode(u8 opcode, u16 opcode_pc) -> Cycles;
     auto execute_cb_opcode(u8 opcode, u16 opcode_pc) -> Cycles;
 
@@ -48,34 +99,54 @@ public:
     ByteRegister interrupt_enabled;
 
 private:
+    void trace(u16 opcode_pc, u8 opcode, u8 prefix);
+    Tracer* tracer = nullptr;
+
     void handle_interrupts();
     auto handle_interrupt(u8 interrupt_bit, u16 interrupt_vector, u8 fired_interrupts) -> bool;
 
+    auto execute_decoded(DecodedInstruction instruction) -> Cycles;
+
     Gameboy& gb;
     Options& options;
 
+    std::unique_ptr<BlockCache> block_cache;
+
     bool interrupts_enabled = false;
     bool halted = false;
 
     bool branch_taken = false;
 
-    /* Basic registers */
-    ByteRegister a, b, c, d, e, h, l;
+    /* Set by a JR which closes an idle loop to the cycles one iteration
+     * takes, until the next call to tick() */
+    uint idle_loop_cycles = 0;
+    void check_idle_loop(u16 loop_start);
 
-    /* 'Group' registers for operations which use two registers as a word */
-    RegisterPair af;
-    RegisterPair bc;
-    RegisterPair de;
-    RegisterPair hl;
-
-    /*
-     * Flags set dependant on the result of the last operation
+    /* Register file. The byte and word registers are plain values with no
+     * vtable, declared together so they are packed into a few bytes of the
+     * CPU object; the pairs below are views over the byte registers.
+     *
+     * 'f' holds the flags set dependant on the result of the last operation
      *  0x80 - produced 0
      *  0x40 - was a subtraction
      *  0x20 - lower half of the byte overflowed 15
      *  0x10 - overflowed 255 or underflowed 0 for additions/subtractions
      */
+    ByteRegister a;
     FlagRegister f;
+    ByteRegister b, c, d, e, h, l;
+
+    /* Program counter */
+    WordRegister pc;
+
+    /* Stack pointer */
+    WordRegister sp;
+
+    /* 'Group' registers for operations which use two registers as a word */
+    RegisterPair af;
+    RegisterPair bc;
+    RegisterPair de;
+    RegisterPair hl;
 
     void set_flag_zero(bool set);
     void set_flag_subtract(bool set);
@@ -87,18 +158,12 @@ private:
      * count to be used */
     auto is_condition(Condition condition) -> bool;
 
-    /* Program counter */
-    WordRegister pc;
-
-    /* Stack pointer */
-    WordRegister sp;
-
     auto get_byte_from_pc() -> u8;
     auto get_signed_byte_from_pc() -> s8;
     auto get_word_from_pc() -> u16;
 
-    void stack_push(const WordValue& reg);
-    void stack_pop(WordValue& reg);
+    void stack_push(u16 value);
+    auto stack_pop() -> u16;
 
     /* Opcode Helper Functions */
 
@@ -380,5 +445,25 @@ private:
     void opcode_CB_F0(); void opcode_CB_F1(); void opcode_CB_F2(); void opcode_CB_F3(); void opcode_CB_F4(); void opcode_CB_F5(); void opcode_CB_F6(); void opcode_CB_F7(); void opcode_CB_F8(); void opcode_CB_F9(); void opcode_CB_FA(); void opcode_CB_FB(); void opcode_CB_FC(); void opcode_CB_FD(); void opcode_CB_FE(); void opcode_CB_FF();
     /* clang-format on */
 
+    using opcode_handler_t = void (CPU::*)();
+
+    struct OpcodeEntry {
+        opcode_handler_t handler;
+        u8 cycles;
+        u8 cycles_branched;
+    };
+
+    using OpcodeTable = std::array<OpcodeEntry, 256>;
+
+    /* Built at compile time in opcode_table.cc */
+    static constexpr auto build_opcode_table(const std::array<opcode_handler_t, 256>& handlers,
+                                             const std::array<u8, 256>& cycles,
+                                             const std::array<u8, 256>& cycles_branched) -> OpcodeTable;
+
+    static const OpcodeTable opcode_table;
+    static const OpcodeTable opcode_cb_table;
+
     friend class Debugger;
+    friend class BlockCache;
+    friend struct DecodedInstruction;
 };
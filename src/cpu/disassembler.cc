@@ -0,0 +1,106 @@
+#include "disassembler.h"
+
+namespace {
+
+const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+auto write_hex(char* out, const uint value, const uint digits) -> char* {
+    *out++ = '0';
+    *out++ = 'x';
+    for (uint digit = digits; digit > 0; digit--) {
+        *out++ = HEX_DIGITS[(value >> ((digit - 1) * 4)) & 0xF];
+    }
+    return out;
+}
+
+auto write_decimal(char* out, uint value) -> char* {
+    char digits[3];
+    uint count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    while (count > 0) { *out++ = digits[--count]; }
+    return out;
+}
+
+auto write_operand(char* out, const InstructionInfo& info, const u8* operand, const u16 address) -> char* {
+    switch (info.operand) {
+        case Operand::None:
+            return out;
+
+        case Operand::Immediate8:
+            return write_hex(out, operand[0], 2);
+
+        case Operand::Immediate16:
+            return write_hex(out, static_cast<uint>(operand[0] | (operand[1] << 8)), 4);
+
+        case Operand::Relative8: {
+            auto target = static_cast<u16>(address + info.length + static_cast<s8>(operand[0]));
+            return write_hex(out, target, 4);
+        }
+
+        case Operand::Signed8: {
+            int offset = static_cast<s8>(operand[0]);
+            if (offset < 0) {
+                /* "SP+e" becomes "SP-3" rather than "SP+-3" */
+                if (out[-1] == '+') { out--; }
+                *out++ = '-';
+            }
+            return write_decimal(out, static_cast<uint>(offset < 0 ? -offset : offset));
+        }
+    }
+
+    return out;
+}
+
+} // namespace
+
+auto disassemble(const u8* code, const size_t size, const u16 address) -> DisassembledInstruction {
+    DisassembledInstruction result = {};
+    result.address = address;
+
+    const InstructionInfo* info = size > 0 ? &instructions[code[0]] : nullptr;
+    if (info != nullptr && code[0] == 0xCB) { info = size > 1 ? &cb_instructions[code[1]] : nullptr; }
+
+    if (info == nullptr || info->length > size) {
+        result.length = 1;
+        char* out = result.text;
+        *out++ = 'D';
+        *out++ = 'B';
+        *out++ = ' ';
+        write_hex(out, size > 0 ? code[0] : 0, 2);
+        return result;
+    }
+
+    result.length = info->length;
+    result.info = info;
+
+    /* Operand placeholders are the only lowercase letters in a mnemonic,
+     * apart from the unused opcodes' which have no operand */
+    char* out = result.text;
+    for (const char* in = info->mnemonic; *in != '\0'; in++) {
+        if (info->operand != Operand::None && (*in == 'n' || *in == 'e')) {
+            out = write_operand(out, *info, code + 1, address);
+            if (in[1] == 'n') { in++; }
+        } else {
+            *out++ = *in;
+        }
+    }
+
+    return result;
+}
+
+auto disassemble_range(const u8* code, const size_t size, const u16 address) -> std::vector<DisassembledInstruction> {
+    std::vector<DisassembledInstruction> listing;
+    listing.reserve(size / 2);
+
+    size_t offset = 0;
+    while (offset < size) {
+        listing.push_back(disassemble(code + offset, size - offset, static_cast<u16>(address + offset)));
+        offset += listing.back().length;
+    }
+
+    return listing;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "instructions.h"
+
+#include <cstddef>
+#include <vector>
+
+/* One instruction, with its operand written into the mnemonic */
+struct DisassembledInstruction {
+    u16 address;
+    u8 length;
+    /* nullptr for a byte shown as data, when the instruction it starts
+     * would run past the end of the code given */
+    const InstructionInfo* info;
+    /* e.g. "LD (0xFF00+0x44),A", or "JR NZ,0x0150" with the jump target */
+    char text[24];
+};
+
+/* The instruction at the start of code, which is at address. Nothing past
+ * code + size is read. Only formats into the result, so it is cheap enough
+ * to run over whole ROM banks */
+auto disassemble(const u8* code, size_t size, u16 address) -> DisassembledInstruction;
+
+/* Every instruction from the start of code on, one after the other */
+auto disassemble_range(const u8* code, size_t size, u16 address) -> std::vector<DisassembledInstruction>;
@@ -0,0 +1,629 @@
+#pragma once
+
+#include "../definitions.h"
+
+#include <array>
+
+/*
+ * Everything known about each instruction ahead of execution, in one place:
+ * the cycle tables, the opcode names, the dispatch tables, the block cache
+ * and the disassembler are all derived from these two tables.
+ */
+
+/* The bytes following the opcode, and where the mnemonic shows them */
+enum class Operand : u8 {
+    None,
+    Immediate8,  /* "n" */
+    Immediate16, /* "nn", little-endian */
+    Relative8,   /* "e", a signed jump from the next instruction */
+    Signed8,     /* "e", a signed offset added to SP */
+};
+
+/* Where the CPU goes after the instruction */
+enum class Flow : u8 {
+    Next,
+    Jump,   /* JR, JP: conditional ones may fall through */
+    Call,   /* CALL, RST */
+    Return, /* RET, RETI */
+    Stop,   /* STOP, HALT and the unused opcodes, which lock the CPU up */
+};
+
+struct InstructionInfo {
+    const char* mnemonic;
+    Operand operand;
+    /* In bytes, including the opcode (and the 0xCB prefix). STOP is 1 as
+     * this CPU does not consume its padding byte */
+    u8 length;
+    /* In M-cycles, without and with a conditional branch taken. The 0xCB
+     * prefix has none of its own: the CB instruction's include it */
+    u8 cycles;
+    u8 cycles_branched;
+    Flow flow;
+    /* Z, N, H and C in order: the letter if the flag follows the result,
+     * '0' or '1' if it is forced, '-' if it is left alone */
+    const char* flags;
+};
+
+using InstructionTable = std::array<InstructionInfo, 256>;
+
+/* clang-format off */
+constexpr InstructionTable instructions = {{
+    /* 00 */ { "NOP",             Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 01 */ { "LD BC,nn",        Operand::Immediate16, 3, 3, 3, Flow::Next,   "----" },
+    /* 02 */ { "LD (BC),A",       Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 03 */ { "INC BC",          Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 04 */ { "INC B",           Operand::None,        1, 1, 1, Flow::Next,   "Z0H-" },
+    /* 05 */ { "DEC B",           Operand::None,        1, 1, 1, Flow::Next,   "Z1H-" },
+    /* 06 */ { "LD B,n",          Operand::Immediate8,  2, 2, 2, Flow::Next,   "----" },
+    /* 07 */ { "RLCA",            Operand::None,        1, 1, 1, Flow::Next,   "000C" },
+    /* 08 */ { "LD (nn),SP",      Operand::Immediate16, 3, 5, 5, Flow::Next,   "----" },
+    /* 09 */ { "ADD HL,BC",       Operand::None,        1, 2, 2, Flow::Next,   "-0HC" },
+    /* 0A */ { "LD A,(BC)",       Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 0B */ { "DEC BC",          Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 0C */ { "INC C",           Operand::None,        1, 1, 1, Flow::Next,   "Z0H-" },
+    /* 0D */ { "DEC C",           Operand::None,        1, 1, 1, Flow::Next,   "Z1H-" },
+    /* 0E */ { "LD C,n",          Operand::Immediate8,  2, 2, 2, Flow::Next,   "----" },
+    /* 0F */ { "RRCA",            Operand::None,        1, 1, 1, Flow::Next,   "000C" },
+
+    /* 10 */ { "STOP",            Operand::None,        1, 1, 1, Flow::Stop,   "----" },
+    /* 11 */ { "LD DE,nn",        Operand::Immediate16, 3, 3, 3, Flow::Next,   "----" },
+    /* 12 */ { "LD (DE),A",       Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 13 */ { "INC DE",          Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 14 */ { "INC D",           Operand::None,        1, 1, 1, Flow::Next,   "Z0H-" },
+    /* 15 */ { "DEC D",           Operand::None,        1, 1, 1, Flow::Next,   "Z1H-" },
+    /* 16 */ { "LD D,n",          Operand::Immediate8,  2, 2, 2, Flow::Next,   "----" },
+    /* 17 */ { "RLA",             Operand::None,        1, 1, 1, Flow::Next,   "000C" },
+    /* 18 */ { "JR e",            Operand::Relative8,   2, 3, 3, Flow::Jump,   "----" },
+    /* 19 */ { "ADD HL,DE",       Operand::None,        1, 2, 2, Flow::Next,   "-0HC" },
+    /* 1A */ { "LD A,(DE)",       Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 1B */ { "DEC DE",          Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 1C */ { "INC E",           Operand::None,        1, 1, 1, Flow::Next,   "Z0H-" },
+    /* 1D */ { "DEC E",           Operand::None,        1, 1, 1, Flow::Next,   "Z1H-" },
+    /* 1E */ { "LD E,n",          Operand::Immediate8,  2, 2, 2, Flow::Next,   "----" },
+    /* 1F */ { "RRA",             Operand::None,        1, 1, 1, Flow::Next,   "000C" },
+
+    /* 20 */ { "JR NZ,e",         Operand::Relative8,   2, 2, 3, Flow::Jump,   "----" },
+    /* 21 */ { "LD HL,nn",        Operand::Immediate16, 3, 3, 3, Flow::Next,   "----" },
+    /* 22 */ { "LD (HL+),A",      Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 23 */ { "INC HL",          Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 24 */ { "INC H",           Operand::None,        1, 1, 1, Flow::Next,   "Z0H-" },
+    /* 25 */ { "DEC H",           Operand::None,        1, 1, 1, Flow::Next,   "Z1H-" },
+    /* 26 */ { "LD H,n",          Operand::Immediate8,  2, 2, 2, Flow::Next,   "----" },
+    /* 27 */ { "DAA",             Operand::None,        1, 1, 1, Flow::Next,   "Z-0C" },
+    /* 28 */ { "JR Z,e",          Operand::Relative8,   2, 2, 3, Flow::Jump,   "----" },
+    /* 29 */ { "ADD HL,HL",       Operand::None,        1, 2, 2, Flow::Next,   "-0HC" },
+    /* 2A */ { "LD A,(HL+)",      Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 2B */ { "DEC HL",          Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 2C */ { "INC L",           Operand::None,        1, 1, 1, Flow::Next,   "Z0H-" },
+    /* 2D */ { "DEC L",           Operand::None,        1, 1, 1, Flow::Next,   "Z1H-" },
+    /* 2E */ { "LD L,n",          Operand::Immediate8,  2, 2, 2, Flow::Next,   "----" },
+    /* 2F */ { "CPL",             Operand::None,        1, 1, 1, Flow::Next,   "-11-" },
+
+    /* 30 */ { "JR NC,e",         Operand::Relative8,   2, 2, 3, Flow::Jump,   "----" },
+    /* 31 */ { "LD SP,nn",        Operand::Immediate16, 3, 3, 3, Flow::Next,   "----" },
+    /* 32 */ { "LD (HL-),A",      Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 33 */ { "INC SP",          Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 34 */ { "INC (HL)",        Operand::None,        1, 3, 3, Flow::Next,   "Z0H-" },
+    /* 35 */ { "DEC (HL)",        Operand::None,        1, 3, 3, Flow::Next,   "Z1H-" },
+    /* 36 */ { "LD (HL),n",       Operand::Immediate8,  2, 3, 3, Flow::Next,   "----" },
+    /* 37 */ { "SCF",             Operand::None,        1, 1, 1, Flow::Next,   "-001" },
+    /* 38 */ { "JR C,e",          Operand::Relative8,   2, 2, 3, Flow::Jump,   "----" },
+    /* 39 */ { "ADD HL,SP",       Operand::None,        1, 2, 2, Flow::Next,   "-0HC" },
+    /* 3A */ { "LD A,(HL-)",      Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 3B */ { "DEC SP",          Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 3C */ { "INC A",           Operand::None,        1, 1, 1, Flow::Next,   "Z0H-" },
+    /* 3D */ { "DEC A",           Operand::None,        1, 1, 1, Flow::Next,   "Z1H-" },
+    /* 3E */ { "LD A,n",          Operand::Immediate8,  2, 2, 2, Flow::Next,   "----" },
+    /* 3F */ { "CCF",             Operand::None,        1, 1, 1, Flow::Next,   "-00C" },
+
+    /* 40 */ { "LD B,B",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 41 */ { "LD B,C",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 42 */ { "LD B,D",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 43 */ { "LD B,E",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 44 */ { "LD B,H",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 45 */ { "LD B,L",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 46 */ { "LD B,(HL)",       Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 47 */ { "LD B,A",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 48 */ { "LD C,B",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 49 */ { "LD C,C",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 4A */ { "LD C,D",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 4B */ { "LD C,E",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 4C */ { "LD C,H",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 4D */ { "LD C,L",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 4E */ { "LD C,(HL)",       Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 4F */ { "LD C,A",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+
+    /* 50 */ { "LD D,B",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 51 */ { "LD D,C",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 52 */ { "LD D,D",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 53 */ { "LD D,E",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 54 */ { "LD D,H",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 55 */ { "LD D,L",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 56 */ { "LD D,(HL)",       Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 57 */ { "LD D,A",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 58 */ { "LD E,B",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 59 */ { "LD E,C",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 5A */ { "LD E,D",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 5B */ { "LD E,E",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 5C */ { "LD E,H",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 5D */ { "LD E,L",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 5E */ { "LD E,(HL)",       Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 5F */ { "LD E,A",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+
+    /* 60 */ { "LD H,B",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 61 */ { "LD H,C",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 62 */ { "LD H,D",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 63 */ { "LD H,E",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 64 */ { "LD H,H",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 65 */ { "LD H,L",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 66 */ { "LD H,(HL)",       Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 67 */ { "LD H,A",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 68 */ { "LD L,B",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 69 */ { "LD L,C",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 6A */ { "LD L,D",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 6B */ { "LD L,E",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 6C */ { "LD L,H",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 6D */ { "LD L,L",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 6E */ { "LD L,(HL)",       Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 6F */ { "LD L,A",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+
+    /* 70 */ { "LD (HL),B",       Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 71 */ { "LD (HL),C",       Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 72 */ { "LD (HL),D",       Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 73 */ { "LD (HL),E",       Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 74 */ { "LD (HL),H",       Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 75 */ { "LD (HL),L",       Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 76 */ { "HALT",            Operand::None,        1, 1, 1, Flow::Stop,   "----" },
+    /* 77 */ { "LD (HL),A",       Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 78 */ { "LD A,B",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 79 */ { "LD A,C",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 7A */ { "LD A,D",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 7B */ { "LD A,E",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 7C */ { "LD A,H",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 7D */ { "LD A,L",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* 7E */ { "LD A,(HL)",       Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* 7F */ { "LD A,A",          Operand::None,        1, 1, 1, Flow::Next,   "----" },
+
+    /* 80 */ { "ADD A,B",         Operand::None,        1, 1, 1, Flow::Next,   "Z0HC" },
+    /* 81 */ { "ADD A,C",         Operand::None,        1, 1, 1, Flow::Next,   "Z0HC" },
+    /* 82 */ { "ADD A,D",         Operand::None,        1, 1, 1, Flow::Next,   "Z0HC" },
+    /* 83 */ { "ADD A,E",         Operand::None,        1, 1, 1, Flow::Next,   "Z0HC" },
+    /* 84 */ { "ADD A,H",         Operand::None,        1, 1, 1, Flow::Next,   "Z0HC" },
+    /* 85 */ { "ADD A,L",         Operand::None,        1, 1, 1, Flow::Next,   "Z0HC" },
+    /* 86 */ { "ADD A,(HL)",      Operand::None,        1, 2, 2, Flow::Next,   "Z0HC" },
+    /* 87 */ { "ADD A,A",         Operand::None,        1, 1, 1, Flow::Next,   "Z0HC" },
+    /* 88 */ { "ADC A,B",         Operand::None,        1, 1, 1, Flow::Next,   "Z0HC" },
+    /* 89 */ { "ADC A,C",         Operand::None,        1, 1, 1, Flow::Next,   "Z0HC" },
+    /* 8A */ { "ADC A,D",         Operand::None,        1, 1, 1, Flow::Next,   "Z0HC" },
+    /* 8B */ { "ADC A,E",         Operand::None,        1, 1, 1, Flow::Next,   "Z0HC" },
+    /* 8C */ { "ADC A,H",         Operand::None,        1, 1, 1, Flow::Next,   "Z0HC" },
+    /* 8D */ { "ADC A,L",         Operand::None,        1, 1, 1, Flow::Next,   "Z0HC" },
+    /* 8E */ { "ADC A,(HL)",      Operand::None,        1, 2, 2, Flow::Next,   "Z0HC" },
+    /* 8F */ { "ADC A,A",         Operand::None,        1, 1, 1, Flow::Next,   "Z0HC" },
+
+    /* 90 */ { "SUB B",           Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* 91 */ { "SUB C",           Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* 92 */ { "SUB D",           Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* 93 */ { "SUB E",           Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* 94 */ { "SUB H",           Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* 95 */ { "SUB L",           Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* 96 */ { "SUB (HL)",        Operand::None,        1, 2, 2, Flow::Next,   "Z1HC" },
+    /* 97 */ { "SUB A",           Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* 98 */ { "SBC A,B",         Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* 99 */ { "SBC A,C",         Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* 9A */ { "SBC A,D",         Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* 9B */ { "SBC A,E",         Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* 9C */ { "SBC A,H",         Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* 9D */ { "SBC A,L",         Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* 9E */ { "SBC A,(HL)",      Operand::None,        1, 2, 2, Flow::Next,   "Z1HC" },
+    /* 9F */ { "SBC A,A",         Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+
+    /* A0 */ { "AND B",           Operand::None,        1, 1, 1, Flow::Next,   "Z010" },
+    /* A1 */ { "AND C",           Operand::None,        1, 1, 1, Flow::Next,   "Z010" },
+    /* A2 */ { "AND D",           Operand::None,        1, 1, 1, Flow::Next,   "Z010" },
+    /* A3 */ { "AND E",           Operand::None,        1, 1, 1, Flow::Next,   "Z010" },
+    /* A4 */ { "AND H",           Operand::None,        1, 1, 1, Flow::Next,   "Z010" },
+    /* A5 */ { "AND L",           Operand::None,        1, 1, 1, Flow::Next,   "Z010" },
+    /* A6 */ { "AND (HL)",        Operand::None,        1, 2, 2, Flow::Next,   "Z010" },
+    /* A7 */ { "AND A",           Operand::None,        1, 1, 1, Flow::Next,   "Z010" },
+    /* A8 */ { "XOR B",           Operand::None,        1, 1, 1, Flow::Next,   "Z000" },
+    /* A9 */ { "XOR C",           Operand::None,        1, 1, 1, Flow::Next,   "Z000" },
+    /* AA */ { "XOR D",           Operand::None,        1, 1, 1, Flow::Next,   "Z000" },
+    /* AB */ { "XOR E",           Operand::None,        1, 1, 1, Flow::Next,   "Z000" },
+    /* AC */ { "XOR H",           Operand::None,        1, 1, 1, Flow::Next,   "Z000" },
+    /* AD */ { "XOR L",           Operand::None,        1, 1, 1, Flow::Next,   "Z000" },
+    /* AE */ { "XOR (HL)",        Operand::None,        1, 2, 2, Flow::Next,   "Z000" },
+    /* AF */ { "XOR A",           Operand::None,        1, 1, 1, Flow::Next,   "Z000" },
+
+    /* B0 */ { "OR B",            Operand::None,        1, 1, 1, Flow::Next,   "Z000" },
+    /* B1 */ { "OR C",            Operand::None,        1, 1, 1, Flow::Next,   "Z000" },
+    /* B2 */ { "OR D",            Operand::None,        1, 1, 1, Flow::Next,   "Z000" },
+    /* B3 */ { "OR E",            Operand::None,        1, 1, 1, Flow::Next,   "Z000" },
+    /* B4 */ { "OR H",            Operand::None,        1, 1, 1, Flow::Next,   "Z000" },
+    /* B5 */ { "OR L",            Operand::None,        1, 1, 1, Flow::Next,   "Z000" },
+    /* B6 */ { "OR (HL)",         Operand::None,        1, 2, 2, Flow::Next,   "Z000" },
+    /* B7 */ { "OR A",            Operand::None,        1, 1, 1, Flow::Next,   "Z000" },
+    /* B8 */ { "CP B",            Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* B9 */ { "CP C",            Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* BA */ { "CP D",            Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* BB */ { "CP E",            Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* BC */ { "CP H",            Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* BD */ { "CP L",            Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+    /* BE */ { "CP (HL)",         Operand::None,        1, 2, 2, Flow::Next,   "Z1HC" },
+    /* BF */ { "CP A",            Operand::None,        1, 1, 1, Flow::Next,   "Z1HC" },
+
+    /* C0 */ { "RET NZ",          Operand::None,        1, 2, 5, Flow::Return, "----" },
+    /* C1 */ { "POP BC",          Operand::None,        1, 3, 3, Flow::Next,   "----" },
+    /* C2 */ { "JP NZ,nn",        Operand::Immediate16, 3, 3, 4, Flow::Jump,   "----" },
+    /* C3 */ { "JP nn",           Operand::Immediate16, 3, 4, 4, Flow::Jump,   "----" },
+    /* C4 */ { "CALL NZ,nn",      Operand::Immediate16, 3, 3, 6, Flow::Call,   "----" },
+    /* C5 */ { "PUSH BC",         Operand::None,        1, 4, 4, Flow::Next,   "----" },
+    /* C6 */ { "ADD A,n",         Operand::Immediate8,  2, 2, 2, Flow::Next,   "Z0HC" },
+    /* C7 */ { "RST 0x00",        Operand::None,        1, 4, 4, Flow::Call,   "----" },
+    /* C8 */ { "RET Z",           Operand::None,        1, 2, 5, Flow::Return, "----" },
+    /* C9 */ { "RET",             Operand::None,        1, 4, 4, Flow::Return, "----" },
+    /* CA */ { "JP Z,nn",         Operand::Immediate16, 3, 3, 4, Flow::Jump,   "----" },
+    /* CB */ { "PREFIX CB",       Operand::None,        2, 0, 0, Flow::Next,   "----" },
+    /* CC */ { "CALL Z,nn",       Operand::Immediate16, 3, 3, 6, Flow::Call,   "----" },
+    /* CD */ { "CALL nn",         Operand::Immediate16, 3, 6, 6, Flow::Call,   "----" },
+    /* CE */ { "ADC A,n",         Operand::Immediate8,  2, 2, 2, Flow::Next,   "Z0HC" },
+    /* CF */ { "RST 0x08",        Operand::None,        1, 4, 4, Flow::Call,   "----" },
+
+    /* D0 */ { "RET NC",          Operand::None,        1, 2, 5, Flow::Return, "----" },
+    /* D1 */ { "POP DE",          Operand::None,        1, 3, 3, Flow::Next,   "----" },
+    /* D2 */ { "JP NC,nn",        Operand::Immediate16, 3, 3, 4, Flow::Jump,   "----" },
+    /* D3 */ { "unused opcode",   Operand::None,        1, 0, 0, Flow::Stop,   "----" },
+    /* D4 */ { "CALL NC,nn",      Operand::Immediate16, 3, 3, 6, Flow::Call,   "----" },
+    /* D5 */ { "PUSH DE",         Operand::None,        1, 4, 4, Flow::Next,   "----" },
+    /* D6 */ { "SUB n",           Operand::Immediate8,  2, 2, 2, Flow::Next,   "Z1HC" },
+    /* D7 */ { "RST 0x10",        Operand::None,        1, 4, 4, Flow::Call,   "----" },
+    /* D8 */ { "RET C",           Operand::None,        1, 2, 5, Flow::Return, "----" },
+    /* D9 */ { "RETI",            Operand::None,        1, 4, 4, Flow::Return, "----" },
+    /* DA */ { "JP C,nn",         Operand::Immediate16, 3, 3, 4, Flow::Jump,   "----" },
+    /* DB */ { "unused opcode",   Operand::None,        1, 0, 0, Flow::Stop,   "----" },
+    /* DC */ { "CALL C,nn",       Operand::Immediate16, 3, 3, 6, Flow::Call,   "----" },
+    /* DD */ { "unused opcode",   Operand::None,        1, 0, 0, Flow::Stop,   "----" },
+    /* DE */ { "SBC A,n",         Operand::Immediate8,  2, 2, 2, Flow::Next,   "Z1HC" },
+    /* DF */ { "RST 0x18",        Operand::None,        1, 4, 4, Flow::Call,   "----" },
+
+    /* E0 */ { "LD (0xFF00+n),A", Operand::Immediate8,  2, 3, 3, Flow::Next,   "----" },
+    /* E1 */ { "POP HL",          Operand::None,        1, 3, 3, Flow::Next,   "----" },
+    /* E2 */ { "LD (0xFF00+C),A", Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* E3 */ { "unused opcode",   Operand::None,        1, 0, 0, Flow::Stop,   "----" },
+    /* E4 */ { "unused opcode",   Operand::None,        1, 0, 0, Flow::Stop,   "----" },
+    /* E5 */ { "PUSH HL",         Operand::None,        1, 4, 4, Flow::Next,   "----" },
+    /* E6 */ { "AND n",           Operand::Immediate8,  2, 2, 2, Flow::Next,   "Z010" },
+    /* E7 */ { "RST 0x20",        Operand::None,        1, 4, 4, Flow::Call,   "----" },
+    /* E8 */ { "ADD SP,e",        Operand::Signed8,     2, 4, 4, Flow::Next,   "00HC" },
+    /* E9 */ { "JP (HL)",         Operand::None,        1, 1, 1, Flow::Jump,   "----" },
+    /* EA */ { "LD (nn),A",       Operand::Immediate16, 3, 4, 4, Flow::Next,   "----" },
+    /* EB */ { "unused opcode",   Operand::None,        1, 0, 0, Flow::Stop,   "----" },
+    /* EC */ { "unused opcode",   Operand::None,        1, 0, 0, Flow::Stop,   "----" },
+    /* ED */ { "unused opcode",   Operand::None,        1, 0, 0, Flow::Stop,   "----" },
+    /* EE */ { "XOR n",           Operand::Immediate8,  2, 2, 2, Flow::Next,   "Z000" },
+    /* EF */ { "RST 0x28",        Operand::None,        1, 4, 4, Flow::Call,   "----" },
+
+    /* F0 */ { "LD A,(0xFF00+n)", Operand::Immediate8,  2, 3, 3, Flow::Next,   "----" },
+    /* F1 */ { "POP AF",          Operand::None,        1, 3, 3, Flow::Next,   "ZNHC" },
+    /* F2 */ { "LD A,(0xFF00+C)", Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* F3 */ { "DI",              Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* F4 */ { "unused opcode",   Operand::None,        1, 0, 0, Flow::Stop,   "----" },
+    /* F5 */ { "PUSH AF",         Operand::None,        1, 4, 4, Flow::Next,   "----" },
+    /* F6 */ { "OR n",            Operand::Immediate8,  2, 2, 2, Flow::Next,   "Z000" },
+    /* F7 */ { "RST 0x30",        Operand::None,        1, 4, 4, Flow::Call,   "----" },
+    /* F8 */ { "LD HL,SP+e",      Operand::Signed8,     2, 3, 3, Flow::Next,   "00HC" },
+    /* F9 */ { "LD SP,HL",        Operand::None,        1, 2, 2, Flow::Next,   "----" },
+    /* FA */ { "LD A,(nn)",       Operand::Immediate16, 3, 4, 4, Flow::Next,   "----" },
+    /* FB */ { "EI",              Operand::None,        1, 1, 1, Flow::Next,   "----" },
+    /* FC */ { "unused opcode",   Operand::None,        1, 0, 0, Flow::Stop,   "----" },
+    /* FD */ { "unused opcode",   Operand::None,        1, 0, 0, Flow::Stop,   "----" },
+    /* FE */ { "CP n",            Operand::Immediate8,  2, 2, 2, Flow::Next,   "Z1HC" },
+    /* FF */ { "RST 0x38",        Operand::None,        1, 4, 4, Flow::Call,   "----" }
+}};
+
+constexpr InstructionTable cb_instructions = {{
+    /* 00 */ { "RLC B",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 01 */ { "RLC C",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 02 */ { "RLC D",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 03 */ { "RLC E",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 04 */ { "RLC H",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 05 */ { "RLC L",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 06 */ { "RLC (HL)",        Operand::None,        2, 4, 4, Flow::Next,   "Z00C" },
+    /* 07 */ { "RLC A",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 08 */ { "RRC B",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 09 */ { "RRC C",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 0A */ { "RRC D",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 0B */ { "RRC E",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 0C */ { "RRC H",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 0D */ { "RRC L",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 0E */ { "RRC (HL)",        Operand::None,        2, 4, 4, Flow::Next,   "Z00C" },
+    /* 0F */ { "RRC A",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+
+    /* 10 */ { "RL B",            Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 11 */ { "RL C",            Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 12 */ { "RL D",            Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 13 */ { "RL E",            Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 14 */ { "RL H",            Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 15 */ { "RL L",            Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 16 */ { "RL (HL)",         Operand::None,        2, 4, 4, Flow::Next,   "Z00C" },
+    /* 17 */ { "RL A",            Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 18 */ { "RR B",            Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 19 */ { "RR C",            Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 1A */ { "RR D",            Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 1B */ { "RR E",            Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 1C */ { "RR H",            Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 1D */ { "RR L",            Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 1E */ { "RR (HL)",         Operand::None,        2, 4, 4, Flow::Next,   "Z00C" },
+    /* 1F */ { "RR A",            Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+
+    /* 20 */ { "SLA B",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 21 */ { "SLA C",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 22 */ { "SLA D",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 23 */ { "SLA E",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 24 */ { "SLA H",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 25 */ { "SLA L",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 26 */ { "SLA (HL)",        Operand::None,        2, 4, 4, Flow::Next,   "Z00C" },
+    /* 27 */ { "SLA A",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 28 */ { "SRA B",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 29 */ { "SRA C",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 2A */ { "SRA D",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 2B */ { "SRA E",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 2C */ { "SRA H",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 2D */ { "SRA L",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 2E */ { "SRA (HL)",        Operand::None,        2, 4, 4, Flow::Next,   "Z00C" },
+    /* 2F */ { "SRA A",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+
+    /* 30 */ { "SWAP B",          Operand::None,        2, 2, 2, Flow::Next,   "Z000" },
+    /* 31 */ { "SWAP C",          Operand::None,        2, 2, 2, Flow::Next,   "Z000" },
+    /* 32 */ { "SWAP D",          Operand::None,        2, 2, 2, Flow::Next,   "Z000" },
+    /* 33 */ { "SWAP E",          Operand::None,        2, 2, 2, Flow::Next,   "Z000" },
+    /* 34 */ { "SWAP H",          Operand::None,        2, 2, 2, Flow::Next,   "Z000" },
+    /* 35 */ { "SWAP L",          Operand::None,        2, 2, 2, Flow::Next,   "Z000" },
+    /* 36 */ { "SWAP (HL)",       Operand::None,        2, 4, 4, Flow::Next,   "Z000" },
+    /* 37 */ { "SWAP A",          Operand::None,        2, 2, 2, Flow::Next,   "Z000" },
+    /* 38 */ { "SRL B",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 39 */ { "SRL C",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 3A */ { "SRL D",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 3B */ { "SRL E",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 3C */ { "SRL H",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 3D */ { "SRL L",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+    /* 3E */ { "SRL (HL)",        Operand::None,        2, 4, 4, Flow::Next,   "Z00C" },
+    /* 3F */ { "SRL A",           Operand::None,        2, 2, 2, Flow::Next,   "Z00C" },
+
+    /* 40 */ { "BIT 0,B",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 41 */ { "BIT 0,C",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 42 */ { "BIT 0,D",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 43 */ { "BIT 0,E",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 44 */ { "BIT 0,H",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 45 */ { "BIT 0,L",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 46 */ { "BIT 0,(HL)",      Operand::None,        2, 3, 3, Flow::Next,   "Z01-" },
+    /* 47 */ { "BIT 0,A",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 48 */ { "BIT 1,B",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 49 */ { "BIT 1,C",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 4A */ { "BIT 1,D",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 4B */ { "BIT 1,E",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 4C */ { "BIT 1,H",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 4D */ { "BIT 1,L",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 4E */ { "BIT 1,(HL)",      Operand::None,        2, 3, 3, Flow::Next,   "Z01-" },
+    /* 4F */ { "BIT 1,A",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+
+    /* 50 */ { "BIT 2,B",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 51 */ { "BIT 2,C",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 52 */ { "BIT 2,D",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 53 */ { "BIT 2,E",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 54 */ { "BIT 2,H",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 55 */ { "BIT 2,L",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 56 */ { "BIT 2,(HL)",      Operand::None,        2, 3, 3, Flow::Next,   "Z01-" },
+    /* 57 */ { "BIT 2,A",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 58 */ { "BIT 3,B",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 59 */ { "BIT 3,C",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 5A */ { "BIT 3,D",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 5B */ { "BIT 3,E",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 5C */ { "BIT 3,H",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 5D */ { "BIT 3,L",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 5E */ { "BIT 3,(HL)",      Operand::None,        2, 3, 3, Flow::Next,   "Z01-" },
+    /* 5F */ { "BIT 3,A",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+
+    /* 60 */ { "BIT 4,B",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 61 */ { "BIT 4,C",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 62 */ { "BIT 4,D",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 63 */ { "BIT 4,E",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 64 */ { "BIT 4,H",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 65 */ { "BIT 4,L",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 66 */ { "BIT 4,(HL)",      Operand::None,        2, 3, 3, Flow::Next,   "Z01-" },
+    /* 67 */ { "BIT 4,A",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 68 */ { "BIT 5,B",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 69 */ { "BIT 5,C",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 6A */ { "BIT 5,D",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 6B */ { "BIT 5,E",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 6C */ { "BIT 5,H",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 6D */ { "BIT 5,L",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 6E */ { "BIT 5,(HL)",      Operand::None,        2, 3, 3, Flow::Next,   "Z01-" },
+    /* 6F */ { "BIT 5,A",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+
+    /* 70 */ { "BIT 6,B",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 71 */ { "BIT 6,C",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 72 */ { "BIT 6,D",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 73 */ { "BIT 6,E",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 74 */ { "BIT 6,H",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 75 */ { "BIT 6,L",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 76 */ { "BIT 6,(HL)",      Operand::None,        2, 3, 3, Flow::Next,   "Z01-" },
+    /* 77 */ { "BIT 6,A",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 78 */ { "BIT 7,B",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 79 */ { "BIT 7,C",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 7A */ { "BIT 7,D",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 7B */ { "BIT 7,E",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 7C */ { "BIT 7,H",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 7D */ { "BIT 7,L",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+    /* 7E */ { "BIT 7,(HL)",      Operand::None,        2, 3, 3, Flow::Next,   "Z01-" },
+    /* 7F */ { "BIT 7,A",         Operand::None,        2, 2, 2, Flow::Next,   "Z01-" },
+
+    /* 80 */ { "RES 0,B",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 81 */ { "RES 0,C",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 82 */ { "RES 0,D",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 83 */ { "RES 0,E",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 84 */ { "RES 0,H",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 85 */ { "RES 0,L",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 86 */ { "RES 0,(HL)",      Operand::None,        2, 4, 4, Flow::Next,   "----" },
+    /* 87 */ { "RES 0,A",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 88 */ { "RES 1,B",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 89 */ { "RES 1,C",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 8A */ { "RES 1,D",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 8B */ { "RES 1,E",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 8C */ { "RES 1,H",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 8D */ { "RES 1,L",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 8E */ { "RES 1,(HL)",      Operand::None,        2, 4, 4, Flow::Next,   "----" },
+    /* 8F */ { "RES 1,A",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+
+    /* 90 */ { "RES 2,B",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 91 */ { "RES 2,C",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 92 */ { "RES 2,D",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 93 */ { "RES 2,E",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 94 */ { "RES 2,H",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 95 */ { "RES 2,L",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 96 */ { "RES 2,(HL)",      Operand::None,        2, 4, 4, Flow::Next,   "----" },
+    /* 97 */ { "RES 2,A",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 98 */ { "RES 3,B",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 99 */ { "RES 3,C",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 9A */ { "RES 3,D",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 9B */ { "RES 3,E",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 9C */ { "RES 3,H",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 9D */ { "RES 3,L",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* 9E */ { "RES 3,(HL)",      Operand::None,        2, 4, 4, Flow::Next,   "----" },
+    /* 9F */ { "RES 3,A",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+
+    /* A0 */ { "RES 4,B",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* A1 */ { "RES 4,C",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* A2 */ { "RES 4,D",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* A3 */ { "RES 4,E",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* A4 */ { "RES 4,H",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* A5 */ { "RES 4,L",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* A6 */ { "RES 4,(HL)",      Operand::None,        2, 4, 4, Flow::Next,   "----" },
+    /* A7 */ { "RES 4,A",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* A8 */ { "RES 5,B",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* A9 */ { "RES 5,C",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* AA */ { "RES 5,D",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* AB */ { "RES 5,E",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* AC */ { "RES 5,H",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* AD */ { "RES 5,L",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* AE */ { "RES 5,(HL)",      Operand::None,        2, 4, 4, Flow::Next,   "----" },
+    /* AF */ { "RES 5,A",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+
+    /* B0 */ { "RES 6,B",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* B1 */ { "RES 6,C",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* B2 */ { "RES 6,D",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* B3 */ { "RES 6,E",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* B4 */ { "RES 6,H",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* B5 */ { "RES 6,L",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* B6 */ { "RES 6,(HL)",      Operand::None,        2, 4, 4, Flow::Next,   "----" },
+    /* B7 */ { "RES 6,A",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* B8 */ { "RES 7,B",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* B9 */ { "RES 7,C",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* BA */ { "RES 7,D",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* BB */ { "RES 7,E",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* BC */ { "RES 7,H",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* BD */ { "RES 7,L",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* BE */ { "RES 7,(HL)",      Operand::None,        2, 4, 4, Flow::Next,   "----" },
+    /* BF */ { "RES 7,A",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+
+    /* C0 */ { "SET 0,B",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* C1 */ { "SET 0,C",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* C2 */ { "SET 0,D",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* C3 */ { "SET 0,E",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* C4 */ { "SET 0,H",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* C5 */ { "SET 0,L",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* C6 */ { "SET 0,(HL)",      Operand::None,        2, 4, 4, Flow::Next,   "----" },
+    /* C7 */ { "SET 0,A",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* C8 */ { "SET 1,B",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* C9 */ { "SET 1,C",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* CA */ { "SET 1,D",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* CB */ { "SET 1,E",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* CC */ { "SET 1,H",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* CD */ { "SET 1,L",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* CE */ { "SET 1,(HL)",      Operand::None,        2, 4, 4, Flow::Next,   "----" },
+    /* CF */ { "SET 1,A",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+
+    /* D0 */ { "SET 2,B",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* D1 */ { "SET 2,C",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* D2 */ { "SET 2,D",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* D3 */ { "SET 2,E",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* D4 */ { "SET 2,H",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* D5 */ { "SET 2,L",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* D6 */ { "SET 2,(HL)",      Operand::None,        2, 4, 4, Flow::Next,   "----" },
+    /* D7 */ { "SET 2,A",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* D8 */ { "SET 3,B",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* D9 */ { "SET 3,C",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* DA */ { "SET 3,D",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* DB */ { "SET 3,E",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* DC */ { "SET 3,H",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* DD */ { "SET 3,L",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* DE */ { "SET 3,(HL)",      Operand::None,        2, 4, 4, Flow::Next,   "----" },
+    /* DF */ { "SET 3,A",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+
+    /* E0 */ { "SET 4,B",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* E1 */ { "SET 4,C",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* E2 */ { "SET 4,D",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* E3 */ { "SET 4,E",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* E4 */ { "SET 4,H",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* E5 */ { "SET 4,L",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* E6 */ { "SET 4,(HL)",      Operand::None,        2, 4, 4, Flow::Next,   "----" },
+    /* E7 */ { "SET 4,A",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* E8 */ { "SET 5,B",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* E9 */ { "SET 5,C",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* EA */ { "SET 5,D",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* EB */ { "SET 5,E",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* EC */ { "SET 5,H",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* ED */ { "SET 5,L",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* EE */ { "SET 5,(HL)",      Operand::None,        2, 4, 4, Flow::Next,   "----" },
+    /* EF */ { "SET 5,A",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+
+    /* F0 */ { "SET 6,B",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* F1 */ { "SET 6,C",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* F2 */ { "SET 6,D",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* F3 */ { "SET 6,E",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* F4 */ { "SET 6,H",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* F5 */ { "SET 6,L",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* F6 */ { "SET 6,(HL)",      Operand::None,        2, 4, 4, Flow::Next,   "----" },
+    /* F7 */ { "SET 6,A",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* F8 */ { "SET 7,B",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* F9 */ { "SET 7,C",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* FA */ { "SET 7,D",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* FB */ { "SET 7,E",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* FC */ { "SET 7,H",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* FD */ { "SET 7,L",         Operand::None,        2, 2, 2, Flow::Next,   "----" },
+    /* FE */ { "SET 7,(HL)",      Operand::None,        2, 4, 4, Flow::Next,   "----" },
+    /* FF */ { "SET 7,A",         Operand::None,        2, 2, 2, Flow::Next,   "----" }
+}};
+/* clang-format on */
+
+/* One field of every instruction, e.g. the cycle count to dispatch with */
+constexpr auto instruction_field(const InstructionTable& table, u8 InstructionInfo::*field) -> std::array<u8, 256> {
+    std::array<u8, 256> values = {};
+    for (uint opcode = 0; opcode < 256; opcode++) { values[opcode] = table[opcode].*field; }
+    return values;
+}
+
+constexpr auto instruction_mnemonics(const InstructionTable& table) -> std::array<const char*, 256> {
+    std::array<const char*, 256> names = {};
+    for (uint opcode = 0; opcode < 256; opcode++) { names[opcode] = table[opcode].mnemonic; }
+    return names;
+}
+
+constexpr auto operand_length(const Operand operand) -> uint {
+    switch (operand) {
+        case Operand::None: return 0;
+        case Operand::Immediate16: return 2;
+        default: return 1;
+    }
+}
+
+constexpr auto lengths_match_operands() -> bool {
+    for (uint opcode = 0; opcode < 256; opcode++) {
+        const uint prefix = opcode == 0xCB ? 1 : 0;
+        if (instructions[opcode].length != 1 + prefix + operand_length(instructions[opcode].operand)) { return false; }
+        if (cb_instructions[opcode].length != 2 || cb_instructions[opcode].operand != Operand::None) { return false; }
+    }
+    return true;
+}
+
+static_assert(lengths_match_operands(), "An instruction's length disagrees with its operand");
@@ -0,0 +1,60 @@
+#include "cpu.h"
+
+#include "opcode_cycles.h"
+/* clang-format off */
+
+/**
+ * Dispatch tables pairing each opcode's handler with its cycle counts, so
+ * executing an instruction is a single indexed load and indirect call.
+ */
+
+constexpr auto CPU::build_opcode_table(const std::array<opcode_handler_t, 256>& handlers,
+                                       const std::array<u8, 256>& cycles,
+                                       const std::array<u8, 256>& cycles_branched) -> OpcodeTable {
+    OpcodeTable table = {};
+
+    for (uint opcode = 0; opcode < 256; opcode++) {
+        table[opcode] = { handlers[opcode], cycles[opcode], cycles_branched[opcode] };
+    }
+
+    return table;
+}
+
+const CPU::OpcodeTable CPU::opcode_table = CPU::build_opcode_table({
+    &CPU::opcode_00, &CPU::opcode_01, &CPU::opcode_02, &CPU::opcode_03, &CPU::opcode_04, &CPU::opcode_05, &CPU::opcode_06, &CPU::opcode_07, &CPU::opcode_08, &CPU::opcode_09, &CPU::opcode_0A, &CPU::opcode_0B, &CPU::opcode_0C, &CPU::opcode_0D, &CPU::opcode_0E, &CPU::opcode_0F,
+    &CPU::opcode_10, &CPU::opcode_11, &CPU::opcode_12, &CPU::opcode_13, &CPU::opcode_14, &CPU::opcode_15, &CPU::opcode_16, &CPU::opcode_17, &CPU::opcode_18, &CPU::opcode_19, &CPU::opcode_1A, &CPU::opcode_1B, &CPU::opcode_1C, &CPU::opcode_1D, &CPU::opcode_1E, &CPU::opcode_1F,
+    &CPU::opcode_20, &CPU::opcode_21, &CPU::opcode_22, &CPU::opcode_23, &CPU::opcode_24, &CPU::opcode_25, &CPU::opcode_26, &CPU::opcode_27, &CPU::opcode_28, &CPU::opcode_29, &CPU::opcode_2A, &CPU::opcode_2B, &CPU::opcode_2C, &CPU::opcode_2D, &CPU::opcode_2E, &CPU::opcode_2F,
+    &CPU::opcode_30, &CPU::opcode_31, &CPU::opcode_32, &CPU::opcode_33, &CPU::opcode_34, &CPU::opcode_35, &CPU::opcode_36, &CPU::opcode_37, &CPU::opcode_38, &CPU::opcode_39, &CPU::opcode_3A, &CPU::opcode_3B, &CPU::opcode_3C, &CPU::opcode_3D, &CPU::opcode_3E, &CPU::opcode_3F,
+    &CPU::opcode_40, &CPU::opcode_41, &CPU::opcode_42, &CPU::opcode_43, &CPU::opcode_44, &CPU::opcode_45, &CPU::opcode_46, &CPU::opcode_47, &CPU::opcode_48, &CPU::opcode_49, &CPU::opcode_4A, &CPU::opcode_4B, &CPU::opcode_4C, &CPU::opcode_4D, &CPU::opcode_4E, &CPU::opcode_4F,
+    &CPU::opcode_50, &CPU::opcode_51, &CPU::opcode_52, &CPU::opcode_53, &CPU::opcode_54, &CPU::opcode_55, &CPU::opcode_56, &CPU::opcode_57, &CPU::opcode_58, &CPU::opcode_59, &CPU::opcode_5A, &CPU::opcode_5B, &CPU::opcode_5C, &CPU::opcode_5D, &CPU::opcode_5E, &CPU::opcode_5F,
+    &CPU::opcode_60, &CPU::opcode_61, &CPU::opcode_62, &CPU::opcode_63, &CPU::opcode_64, &CPU::opcode_65, &CPU::opcode_66, &CPU::opcode_67, &CPU::opcode_68, &CPU::opcode_69, &CPU::opcode_6A, &CPU::opcode_6B, &CPU::opcode_6C, &CPU::opcode_6D, &CPU::opcode_6E, &CPU::opcode_6F,
+    &CPU::opcode_70, &CPU::opcode_71, &CPU::opcode_72, &CPU::opcode_73, &CPU::opcode_74, &CPU::opcode_75, &CPU::opcode_76, &CPU::opcode_77, &CPU::opcode_78, &CPU::opcode_79, &CPU::opcode_7A, &CPU::opcode_7B, &CPU::opcode_7C, &CPU::opcode_7D, &CPU::opcode_7E, &CPU::opcode_7F,
+    &CPU::opcode_80, &CPU::opcode_81, &CPU::opcode_82, &CPU::opcode_83, &CPU::opcode_84, &CPU::opcode_85, &CPU::opcode_86, &CPU::opcode_87, &CPU::opcode_88, &CPU::opcode_89, &CPU::opcode_8A, &CPU::opcode_8B, &CPU::opcode_8C, &CPU::opcode_8D, &CPU::opcode_8E, &CPU::opcode_8F,
+    &CPU::opcode_90, &CPU::opcode_91, &CPU::opcode_92, &CPU::opcode_93, &CPU::opcode_94, &CPU::opcode_95, &CPU::opcode_96, &CPU::opcode_97, &CPU::opcode_98, &CPU::opcode_99, &CPU::opcode_9A, &CPU::opcode_9B, &CPU::opcode_9C, &CPU::opcode_9D, &CPU::opcode_9E, &CPU::opcode_9F,
+    &CPU::opcode_A0, &CPU::opcode_A1, &CPU::opcode_A2, &CPU::opcode_A3, &CPU::opcode_A4, &CPU::opcode_A5, &CPU::opcode_A6, &CPU::opcode_A7, &CPU::opcode_A8, &CPU::opcode_A9, &CPU::opcode_AA, &CPU::opcode_AB, &CPU::opcode_AC, &CPU::opcode_AD, &CPU::opcode_AE, &CPU::opcode_AF,
+    &CPU::opcode_B0, &CPU::opcode_B1, &CPU::opcode_B2, &CPU::opcode_B3, &CPU::opcode_B4, &CPU::opcode_B5, &CPU::opcode_B6, &CPU::opcode_B7, &CPU::opcode_B8, &CPU::opcode_B9, &CPU::opcode_BA, &CPU::opcode_BB, &CPU::opcode_BC, &CPU::opcode_BD, &CPU::opcode_BE, &CPU::opcode_BF,
+    &CPU::opcode_C0, &CPU::opcode_C1, &CPU::opcode_C2, &CPU::opcode_C3, &CPU::opcode_C4, &CPU::opcode_C5, &CPU::opcode_C6, &CPU::opcode_C7, &CPU::opcode_C8, &CPU::opcode_C9, &CPU::opcode_CA, &CPU::opcode_CB, &CPU::opcode_CC, &CPU::opcode_CD, &CPU::opcode_CE, &CPU::opcode_CF,
+    &CPU::opcode_D0, &CPU::opcode_D1, &CPU::opcode_D2, &CPU::opcode_D3, &CPU::opcode_D4, &CPU::opcode_D5, &CPU::opcode_D6, &CPU::opcode_D7, &CPU::opcode_D8, &CPU::opcode_D9, &CPU::opcode_DA, &CPU::opcode_DB, &CPU::opcode_DC, &CPU::opcode_DD, &CPU::opcode_DE, &CPU::opcode_DF,
+    &CPU::opcode_E0, &CPU::opcode_E1, &CPU::opcode_E2, &CPU::opcode_E3, &CPU::opcode_E4, &CPU::opcode_E5, &CPU::opcode_E6, &CPU::opcode_E7, &CPU::opcode_E8, &CPU::opcode_E9, &CPU::opcode_EA, &CPU::opcode_EB, &CPU::opcode_EC, &CPU::opcode_ED, &CPU::opcode_EE, &CPU::opcode_EF,
+    &CPU::opcode_F0, &CPU::opcode_F1, &CPU::opcode_F2, &CPU::opcode_F3, &CPU::opcode_F4, &CPU::opcode_F5, &CPU::opcode_F6, &CPU::opcode_F7, &CPU::opcode_F8, &CPU::opcode_F9, &CPU::opcode_FA, &CPU::opcode_FB, &CPU::opcode_FC, &CPU::opcode_FD, &CPU::opcode_FE, &CPU::opcode_FF
+}, opcode_cycles, opcode_cycles_branched);
+
+/* CB-prefixed opcodes never branch */
+const CPU::OpcodeTable CPU::opcode_cb_table = CPU::build_opcode_table({
+    &CPU::opcode_CB_00, &CPU::opcode_CB_01, &CPU::opcode_CB_02, &CPU::opcode_CB_03, &CPU::opcode_CB_04, &CPU::opcode_CB_05, &CPU::opcode_CB_06, &CPU::opcode_CB_07, &CPU::opcode_CB_08, &CPU::opcode_CB_09, &CPU::opcode_CB_0A, &CPU::opcode_CB_0B, &CPU::opcode_CB_0C, &CPU::opcode_CB_0D, &CPU::opcode_CB_0E, &CPU::opcode_CB_0F,
+    &CPU::opcode_CB_10, &CPU::opcode_CB_11, &CPU::opcode_CB_12, &CPU::opcode_CB_13, &CPU::opcode_CB_14, &CPU::opcode_CB_15, &CPU::opcode_CB_16, &CPU::opcode_CB_17, &CPU::opcode_CB_18, &CPU::opcode_CB_19, &CPU::opcode_CB_1A, &CPU::opcode_CB_1B, &CPU::opcode_CB_1C, &CPU::opcode_CB_1D, &CPU::opcode_CB_1E, &CPU::opcode_CB_1F,
+    &CPU::opcode_CB_20, &CPU::opcode_CB_21, &CPU::opcode_CB_22, &CPU::opcode_CB_23, &CPU::opcode_CB_24, &CPU::opcode_CB_25, &CPU::opcode_CB_26, &CPU::opcode_CB_27, &CPU::opcode_CB_28, &CPU::opcode_CB_29, &CPU::opcode_CB_2A, &CPU::opcode_CB_2B, &CPU::opcode_CB_2C, &CPU::opcode_CB_2D, &CPU::opcode_CB_2E, &CPU::opcode_CB_2F,
+    &CPU::opcode_CB_30, &CPU::opcode_CB_31, &CPU::opcode_CB_32, &CPU::opcode_CB_33, &CPU::opcode_CB_34, &CPU::opcode_CB_35, &CPU::opcode_CB_36, &CPU::opcode_CB_37, &CPU::opcode_CB_38, &CPU::opcode_CB_39, &CPU::opcode_CB_3A, &CPU::opcode_CB_3B, &CPU::opcode_CB_3C, &CPU::opcode_CB_3D, &CPU::opcode_CB_3E, &CPU::opcode_CB_3F,
+    &CPU::opcode_CB_40, &CPU::opcode_CB_41, &CPU::opcode_CB_42, &CPU::opcode_CB_43, &CPU::opcode_CB_44, &CPU::opcode_CB_45, &CPU::opcode_CB_46, &CPU::opcode_CB_47, &CPU::opcode_CB_48, &CPU::opcode_CB_49, &CPU::opcode_CB_4A, &CPU::opcode_CB_4B, &CPU::opcode_CB_4C, &CPU::opcode_CB_4D, &CPU::opcode_CB_4E, &CPU::opcode_CB_4F,
+    &CPU::opcode_CB_50, &CPU::opcode_CB_51, &CPU::opcode_CB_52, &CPU::opcode_CB_53, &CPU::opcode_CB_54, &CPU::opcode_CB_55, &CPU::opcode_CB_56, &CPU::opcode_CB_57, &CPU::opcode_CB_58, &CPU::opcode_CB_59, &CPU::opcode_CB_5A, &CPU::opcode_CB_5B, &CPU::opcode_CB_5C, &CPU::opcode_CB_5D, &CPU::opcode_CB_5E, &CPU::opcode_CB_5F,
+    &CPU::opcode_CB_60, &CPU::opcode_CB_61, &CPU::opcode_CB_62, &CPU::opcode_CB_63, &CPU::opcode_CB_64, &CPU::opcode_CB_65, &CPU::opcode_CB_66, &CPU::opcode_CB_67, &CPU::opcode_CB_68, &CPU::opcode_CB_69, &CPU::opcode_CB_6A, &CPU::opcode_CB_6B, &CPU::opcode_CB_6C, &CPU::opcode_CB_6D, &CPU::opcode_CB_6E, &CPU::opcode_CB_6F,
+    &CPU::opcode_CB_70, &CPU::opcode_CB_71, &CPU::opcode_CB_72, &CPU::opcode_CB_73, &CPU::opcode_CB_74, &CPU::opcode_CB_75, &CPU::opcode_CB_76, &CPU::opcode_CB_77, &CPU::opcode_CB_78, &CPU::opcode_CB_79, &CPU::opcode_CB_7A, &CPU::opcode_CB_7B, &CPU::opcode_CB_7C, &CPU::opcode_CB_7D, &CPU::opcode_CB_7E, &CPU::opcode_CB_7F,
+    &CPU::opcode_CB_80, &CPU::opcode_CB_81, &CPU::opcode_CB_82, &CPU::opcode_CB_83, &CPU::opcode_CB_84, &CPU::opcode_CB_85, &CPU::opcode_CB_86, &CPU::opcode_CB_87, &CPU::opcode_CB_88, &CPU::opcode_CB_89, &CPU::opcode_CB_8A, &CPU::opcode_CB_8B, &CPU::opcode_CB_8C, &CPU::opcode_CB_8D, &CPU::opcode_CB_8E, &CPU::opcode_CB_8F,
+    &CPU::opcode_CB_90, &CPU::opcode_CB_91, &CPU::opcode_CB_92, &CPU::opcode_CB_93, &CPU::opcode_CB_94, &CPU::opcode_CB_95, &CPU::opcode_CB_96, &CPU::opcode_CB_97, &CPU::opcode_CB_98, &CPU::opcode_CB_99, &CPU::opcode_CB_9A, &CPU::opcode_CB_9B, &CPU::opcode_CB_9C, &CPU::opcode_CB_9D, &CPU::opcode_CB_9E, &CPU::opcode_CB_9F,
+    &CPU::opcode_CB_A0, &CPU::opcode_CB_A1, &CPU::opcode_CB_A2, &CPU::opcode_CB_A3, &CPU::opcode_CB_A4, &CPU::opcode_CB_A5, &CPU::opcode_CB_A6, &CPU::opcode_CB_A7, &CPU::opcode_CB_A8, &CPU::opcode_CB_A9, &CPU::opcode_CB_AA, &CPU::opcode_CB_AB, &CPU::opcode_CB_AC, &CPU::opcode_CB_AD, &CPU::opcode_CB_AE, &CPU::opcode_CB_AF,
+    &CPU::opcode_CB_B0, &CPU::opcode_CB_B1, &CPU::opcode_CB_B2, &CPU::opcode_CB_B3, &CPU::opcode_CB_B4, &CPU::opcode_CB_B5, &CPU::opcode_CB_B6, &CPU::opcode_CB_B7, &CPU::opcode_CB_B8, &CPU::opcode_CB_B9, &CPU::opcode_CB_BA, &CPU::opcode_CB_BB, &CPU::opcode_CB_BC, &CPU::opcode_CB_BD, &CPU::opcode_CB_BE, &CPU::opcode_CB_BF,
+    &CPU::opcode_CB_C0, &CPU::opcode_CB_C1, &CPU::opcode_CB_C2, &CPU::opcode_CB_C3, &CPU::opcode_CB_C4, &CPU::opcode_CB_C5, &CPU::opcode_CB_C6, &CPU::opcode_CB_C7, &CPU::opcode_CB_C8, &CPU::opcode_CB_C9, &CPU::opcode_CB_CA, &CPU::opcode_CB_CB, &CPU::opcode_CB_CC, &CPU::opcode_CB_CD, &CPU::opcode_CB_CE, &CPU::opcode_CB_CF,
+    &CPU::opcode_CB_D0, &CPU::opcode_CB_D1, &CPU::opcode_CB_D2, &CPU::opcode_CB_D3, &CPU::opcode_CB_D4, &CPU::opcode_CB_D5, &CPU::opcode_CB_D6, &CPU::opcode_CB_D7, &CPU::opcode_CB_D8, &CPU::opcode_CB_D9, &CPU::opcode_CB_DA, &CPU::opcode_CB_DB, &CPU::opcode_CB_DC, &CPU::opcode_CB_DD, &CPU::opcode_CB_DE, &CPU::opcode_CB_DF,
+    &CPU::opcode_CB_E0, &CPU::opcode_CB_E1, &CPU::opcode_CB_E2, &CPU::opcode_CB_E3, &CPU::opcode_CB_E4, &CPU::opcode_CB_E5, &CPU::opcode_CB_E6, &CPU::opcode_CB_E7, &CPU::opcode_CB_E8, &CPU::opcode_CB_E9, &CPU::opcode_CB_EA, &CPU::opcode_CB_EB, &CPU::opcode_CB_EC, &CPU::opcode_CB_ED, &CPU::opcode_CB_EE, &CPU::opcode_CB_EF,
+    &CPU::opcode_CB_F0, &CPU::opcode_CB_F1, &CPU::opcode_CB_F2, &CPU::opcode_CB_F3, &CPU::opcode_CB_F4, &CPU::opcode_CB_F5, &CPU::opcode_CB_F6, &CPU::opcode_CB_F7, &CPU::opcode_CB_F8, &CPU::opcode_CB_F9, &CPU::opcode_CB_FA, &CPU::opcode_CB_FB, &CPU::opcode_CB_FC, &CPU::opcode_CB_FD, &CPU::opcode_CB_FE, &CPU::opcode_CB_FF
+}, opcode_cycles_cb, opcode_cycles_cb);
@@ -144,7 +144,7 @@ void CPU::opcode_bit(const u8 bit, Address&& addr) {
 /* CALL */
 void CPU::opcode_call() {
     u16 address = get_word_from_pc();
-    stack_push(pc);
+    stack_push(pc.value());
     pc.set(address);
 }
 
@@ -327,12 +327,14 @@ void CPU::opcode_jp(const Address& addr) {
 void CPU::opcode_jr() {
     s8 offset = get_signed_byte_from_pc();
 
-    if (options.exit_on_infinite_jr && offset == -2) { exit(0); }
+    if (options.exit_on_infinite_jr && offset == -2) { gb.request_stop(); }
 
     u16 old_pc = pc.value();
 
     u16 new_pc = static_cast<u16>(old_pc + offset);
     pc.set(new_pc);
+
+    if (offset == -6) { check_idle_loop(new_pc); }
 }
 
 void CPU::opcode_jr(Condition condition) {
@@ -512,13 +514,13 @@ void CPU::opcode_or(const Address& addr) {
 
 /* POP */
 void CPU::opcode_pop(RegisterPair& reg) {
-    stack_pop(reg);
+    reg.set(stack_pop());
 }
 
 
 /* PUSH */
 void CPU::opcode_push(const RegisterPair& reg) {
-    stack_push(reg);
+    stack_push(reg.value());
 }
 
 
@@ -537,7 +539,7 @@ void CPU::opcode_res(const u8 bit, Address&& addr) {
 
 /* RET */
 void CPU::opcode_ret() {
-    stack_pop(pc);
+    pc.set(stack_pop());
 }
 
 void CPU::opcode_ret(Condition condition) {
@@ -683,7 +685,7 @@ void CPU::opcode_rrc(Address&& addr) {
 
 /* RST */
 void CPU::opcode_rst(const u8 offset) {
-    stack_push(pc);
+    stack_push(pc.value());
     pc.set(offset);
 }
 
@@ -817,6 +819,9 @@ void CPU::opcode_srl(Address&& addr) {
 /* STOP */
 void CPU::opcode_stop() {
     /* halted = true; */
+
+    /* On a CGB, STOP is also how a speed switch armed through KEY1 is made */
+    if (gb.cgb && gb.speed_switch_armed) { gb.switch_speed(); }
 }
 
 
@@ -2,6 +2,7 @@
 
 #include "gameboy.h"
 #include "cpu/cpu.h"
+#include "cpu/disassembler.h"
 #include "util/log.h"
 #include "util/string_utils.h"
 
@@ -20,30 +21,18 @@ void Debugger::set_enabled(bool _enabled) {
     enabled = _enabled;
 }
 
-void Debugger::cycle() {
-    if (!enabled) return;
-
-    steps++;
-
-    if (breakpoint_addr != 0 && !debugger_enabled) {
-        if (gameboy.cpu.pc.value() != breakpoint_addr) { return; }
-        debugger_enabled = true;
-    }
-
-    if (breakpoint_value_addr != 0 && !debugger_enabled) {
-        if (gameboy.mmu.read(breakpoint_value_addr) != breakpoint_value) { return; }
-        breakpoint_value_addr = 0;
-        breakpoint_value = 0;
-        debugger_enabled = true;
-    }
-
-    if (!debugger_enabled) { return; }
+void Debugger::prompt(const u16 pc) {
+    if (!stepping) { log_info("Stopped at 0x%04X", pc); }
+    stepping = true;
+    watch_hit = false;
 
     if (counter > 0) {
         counter--;
         return;
     }
 
+    print_instructions(pc, 1);
+
     while (enabled) {
         Command cmd = get_command();
 
@@ -62,15 +51,19 @@ auto Debugger::execute(const Command& command) -> bool {
             return command_step(command.args);
 
         case CommandType::Run:
-            debugger_enabled = false;
+            stepping = false;
             return true;
 
         case CommandType::BreakAddr: command_breakaddr(command.args); break;
         case CommandType::BreakValue: command_breakvalue(command.args); break;
+        case CommandType::Watch: command_watch(command.args); break;
+        case CommandType::Delete: command_delete(command.args); break;
+        case CommandType::Breakpoints: command_breakpoints(command.args); break;
         case CommandType::Registers: command_registers(command.args); break;
         case CommandType::Flags: command_flags(command.args); break;
         case CommandType::Memory: command_memory(command.args); break;
         case CommandType::MemoryCell: command_memory_cell(command.args); break;
+        case CommandType::Disassemble: command_disassemble(command.args); break;
         case CommandType::Steps: command_steps(command.args); break;
         case CommandType::Log: command_log(command.args); break;
         case CommandType::Exit: command_exit(command.args); break;
@@ -179,6 +172,50 @@ void Debugger::command_memory_cell(Args args) {
     printf("0x%02X\n", gameboy.mmu.read(memory_location));
 }
 
+void Debugger::command_disassemble(Args args) {
+    if (args.size() > 2) {
+        log_error("Invalid arguments to command");
+        return;
+    }
+
+    u16 address = gameboy.cpu.pc.value();
+    uint count = 10;
+    try {
+        if (!args.empty()) { address = static_cast<u16>(std::stoul(args[0], nullptr, 16)); }
+        if (args.size() == 2) { count = static_cast<uint>(std::stoul(args[1])); }
+    } catch (std::logic_error&) {
+        log_error("Invalid arguments to command");
+        return;
+    }
+
+    print_instructions(address, count);
+}
+
+void Debugger::print_instructions(u16 address, const uint count) {
+    const u16 pc = gameboy.cpu.pc.value();
+
+    for (uint i = 0; i < count; i++) {
+        /* Slow-path memory isn't read, as that could change registers or
+         * trip a watchpoint */
+        u8 code[3];
+        uint size = gameboy.mmu.peek(address, code, sizeof(code));
+        if (size == 0) {
+            printf("%s0x%04X | %-9s (not directly mapped)\n", address == pc ? "* " : "  ", address, "");
+            break;
+        }
+
+        DisassembledInstruction instruction = disassemble(code, size, address);
+
+        char bytes[12] = "";
+        for (uint byte = 0; byte < instruction.length; byte++) {
+            snprintf(bytes + byte * 3, sizeof(bytes) - byte * 3, "%02X ", code[byte]);
+        }
+
+        printf("%s0x%04X | %-9s %s\n", address == pc ? "* " : "  ", address, bytes, instruction.text);
+        address = static_cast<u16>(address + instruction.length);
+    }
+}
+
 void Debugger::command_breakaddr(Args args) {
     if (args.size() != 1) {
         log_error("Invalid arguments to command");
@@ -186,8 +223,8 @@ void Debugger::command_breakaddr(Args args) {
     }
 
     u16 addr = static_cast<u16>(std::stoul(args[0], nullptr, 16));
-    breakpoint_addr = addr;
-    log_info("Breakpoint set for address 0x%04X", breakpoint_addr);
+    breakpoints.set(addr);
+    log_info("Breakpoint set for address 0x%04X", addr);
 }
 
 void Debugger::command_breakvalue(Args args) {
@@ -198,9 +235,94 @@ void Debugger::command_breakvalue(Args args) {
 
     u16 addr = static_cast<u16>(std::stoul(args[0], nullptr, 16));
     u8 value = static_cast<u8>(std::stoul(args[1], nullptr, 16));
-    breakpoint_value_addr = addr;
-    breakpoint_value = value;
-    log_info("Breakpoint set for value 0x%02X at address 0x%04X", breakpoint_value, breakpoint_value_addr);
+    add_watchpoint({ addr, false, value, true });
+    log_info("Breakpoint set for value 0x%02X at address 0x%04X", value, addr);
+}
+
+void Debugger::command_watch(Args args) {
+    if (args.size() != 1) {
+        log_error("Invalid arguments to command");
+        return;
+    }
+
+    u16 addr = static_cast<u16>(std::stoul(args[0], nullptr, 16));
+    add_watchpoint({ addr, true, 0, false });
+    log_info("Watchpoint set for writes to address 0x%04X", addr);
+}
+
+void Debugger::command_delete(Args args) {
+    if (args.size() > 1) {
+        log_error("Invalid arguments to command");
+        return;
+    }
+
+    if (args.empty()) {
+        breakpoints.reset();
+        watchpoints.clear();
+        log_info("Deleted all breakpoints and watchpoints");
+    } else {
+        u16 addr = static_cast<u16>(std::stoul(args[0], nullptr, 16));
+        breakpoints.reset(addr);
+        watchpoints.erase(std::remove_if(watchpoints.begin(), watchpoints.end(),
+                                         [addr](const Watchpoint& watchpoint) { return watchpoint.address == addr; }),
+                          watchpoints.end());
+        log_info("Deleted breakpoints and watchpoints at address 0x%04X", addr);
+    }
+
+    update_watched_pages();
+}
+
+void Debugger::command_breakpoints(const Args& args) const {
+    unused(args);
+
+    for (uint addr = 0; addr < breakpoints.size(); addr++) {
+        if (breakpoints[addr]) { printf("break  0x%04X\n", addr); }
+    }
+
+    for (const Watchpoint& watchpoint : watchpoints) {
+        if (watchpoint.any_value) {
+            printf("watch  0x%04X\n", watchpoint.address);
+        } else {
+            printf("value  0x%04X = 0x%02X\n", watchpoint.address, watchpoint.value);
+        }
+    }
+}
+
+void Debugger::add_watchpoint(const Watchpoint& watchpoint) {
+    watchpoints.push_back(watchpoint);
+    update_watched_pages();
+}
+
+void Debugger::update_watched_pages() {
+    std::bitset<0x100> pages;
+    for (const Watchpoint& watchpoint : watchpoints) { pages.set(watchpoint.address >> 8); }
+
+    for (uint page = 0; page < pages.size(); page++) {
+        gameboy.mmu.watch_writes(static_cast<u8>(page), pages[page]);
+    }
+}
+
+void Debugger::memory_written(const u16 address, const u8 value) {
+    bool removed = false;
+
+    for (auto watchpoint = watchpoints.begin(); watchpoint != watchpoints.end();) {
+        if (watchpoint->address != address || (!watchpoint->any_value && watchpoint->value != value)) {
+            ++watchpoint;
+            continue;
+        }
+
+        log_info("Write of 0x%02X to watched address 0x%04X", value, address);
+        watch_hit = true;
+
+        if (watchpoint->once) {
+            watchpoint = watchpoints.erase(watchpoint);
+            removed = true;
+        } else {
+            ++watchpoint;
+        }
+    }
+
+    if (removed) { update_watched_pages(); }
 }
 
 void Debugger::command_steps(const Args& args) const {
@@ -239,7 +361,8 @@ void Debugger::command_exit(const Args& args) {
     unused(args);
 
     log_error("Exiting");
-    exit(1);
+    gameboy.request_stop();
+    enabled = false;
 }
 
 void Debugger::command_help(const Args& args) {
@@ -250,13 +373,17 @@ void Debugger::command_help(const Args& args) {
     printf("[s]tep $steps=1        Run $steps cycles\n");
     printf("[r]un                  Run until the next breakpoint\n");
     printf("breakaddr $addr        Set a breakpoint at $addr\n");
-    printf("breakvalue $addr #n    Set a breakpoint at $addr\n");
+    printf("breakvalue $addr #n    Break once #n is written to $addr\n");
+    printf("watch $addr            Break on every write to $addr\n");
+    printf("delete [$addr]         Delete the breakpoints at $addr, or all of them\n");
+    printf("breaks                 List breakpoints and watchpoints\n");
     printf("\n");
     printf("= Debug Information\n");
     printf("registers              Print a dump of the CPU registers\n");
     printf("flags                  Print a dump of the CPU flags\n");
     printf("[mem]ory $start $lines Print a dump of memory from $start to $end\n");
     printf("[addr]ess $addr        Print the value of the memory at $addr\n");
+    printf("[dis]asm $addr #n      Disassemble #n=10 instructions from $addr=PC\n");
     printf("\n");
     printf("= Other\n");
     printf("steps                  Print the number of steps so far\n");
@@ -299,11 +426,15 @@ auto Debugger::parse_command(std::string cmd) -> CommandType {
 
     if (cmd == "breakaddr") return CommandType::BreakAddr;
     if (cmd == "breakvalue") return CommandType::BreakValue;
+    if (cmd == "watch") return CommandType::Watch;
+    if (cmd == "delete") return CommandType::Delete;
+    if (cmd == "breaks" || cmd == "breakpoints") return CommandType::Breakpoints;
 
     if (cmd == "regs" || cmd == "registers") return CommandType::Registers;
     if (cmd == "flags") return CommandType::Flags;
     if (cmd == "memory" || cmd == "mem") return CommandType::Memory;
     if (cmd == "address" || cmd == "addr") return CommandType::MemoryCell;
+    if (cmd == "disasm" || cmd == "dis") return CommandType::Disassemble;
     if (cmd == "steps") return CommandType::Steps;
 
     if (cmd == "log") return CommandType::Log;
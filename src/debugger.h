@@ -3,6 +3,7 @@
 #include "definitions.h"
 #include "options.h"
 
+#include <bitset>
 #include <string>
 #include <vector>
 
@@ -17,11 +18,15 @@ enum class CommandType {
 
     BreakAddr,
     BreakValue,
+    Watch,
+    Delete,
+    Breakpoints,
 
     Registers,
     Flags,
     Memory,
     MemoryCell,
+    Disassemble,
     Steps,
 
     Log,
@@ -39,12 +44,33 @@ struct Command {
     Args args;
 };
 
+/* A break on CPU writes to an address, of a particular value or of any */
+struct Watchpoint {
+    u16 address;
+    bool any_value;
+    u8 value;
+    /* Removed once it has been hit (breakvalue) */
+    bool once;
+};
+
 class Debugger {
 public:
     Debugger(Gameboy& inGameboy, Options& inOptions);
 
     void set_enabled(bool enabled);
-    void cycle();
+    auto is_enabled() const -> bool { return enabled; }
+
+    /* Called before every instruction while enabled (the Gameboy runs a
+     * separate loop otherwise, which never calls in here). Only drops into
+     * the prompt when single stepping, at a breakpoint or after a watched
+     * write; the breakpoints are a bitmap, so checking them is one lookup */
+    void cycle(u16 pc) {
+        steps++;
+        if (stepping || watch_hit || breakpoints[pc]) { prompt(pc); }
+    }
+
+    /* Called by the MMU for writes to pages with a watchpoint in them */
+    void memory_written(u16 address, u8 value);
 
 private:
     Gameboy& gameboy;
@@ -52,6 +78,7 @@ private:
 
     Command last_command;
 
+    void prompt(u16 pc);
     auto get_command() -> Command;
 
     auto execute(const Command& command) -> bool;
@@ -63,14 +90,26 @@ private:
     void command_flags(const Args& args);
     void command_memory(Args args);
     void command_memory_cell(Args args);
+    void command_disassemble(Args args);
 
     void command_breakaddr(Args args);
     void command_breakvalue(Args args);
+    void command_watch(Args args);
+    void command_delete(Args args);
+    void command_breakpoints(const Args& args) const;
+
+    void add_watchpoint(const Watchpoint& watchpoint);
+
+    /* A listing from address on, marking the instruction at PC */
+    void print_instructions(u16 address, uint count);
+
+    /* Keeps the MMU's write hooks on exactly the pages with watchpoints */
+    void update_watched_pages();
 
     static void command_log(Args args);
 
     void command_steps(const Args& args) const;
-    static void command_exit(const Args& args);
+    void command_exit(const Args& args);
     static void command_help(const Args& args);
 
     auto parse(const std::string& input) -> Command;
@@ -81,8 +120,10 @@ private:
     int steps = 0;
     uint counter = 0;
 
-    u16 breakpoint_addr = 0;
-    u16 breakpoint_value_addr = 0;
-    u8 breakpoint_value = 0;
-    bool debugger_enabled = true;
+    std::bitset<0x10000> breakpoints;
+    std::vector<Watchpoint> watchpoints;
+    bool watch_hit = false;
+
+    /* Prompting before every instruction; starts out that way */
+    bool stepping = true;
 };
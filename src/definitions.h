@@ -2,11 +2,15 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <stdexcept>
+#include <string>
 
 using uint = unsigned int;
 
 using u8 = uint8_t;
 using u16 = uint16_t;
+using u32 = uint32_t;
+using u64 = uint64_t;
 using s8 = int8_t;
 using s16 = uint16_t;
 
@@ -22,10 +26,19 @@ struct Noncopyable {
 template <typename... T> void unused(T&&... unused_vars) {}
 #pragma clang diagnostic pop
 
+/* Thrown by fatal_error. The message is logged before throwing, so whoever
+ * catches it only has to decide what to do with the failed instance */
+class FatalError : public std::runtime_error {
+public:
+    explicit FatalError(const std::string& message) : std::runtime_error(message) {}
+};
+
+[[noreturn]] void throw_fatal_error(const char* fmt, ...);
+
 #define fatal_error(...) \
     log_error("Fatal error @ %s (line %d)", __PRETTY_FUNCTION__, __LINE__); \
     log_error(__VA_ARGS__); \
-    exit(1);
+    throw_fatal_error(__VA_ARGS__);
 
 
 const uint GAMEBOY_WIDTH = 160;
@@ -48,6 +61,16 @@ enum class Color {
     Black,
 };
 
+/* Native layouts a FrameBuffer can store its pixels in */
+enum class PixelFormat {
+    /* 32-bit 0xRRGGBBAA, in host byte order */
+    RGBA8888,
+    /* 16-bit 5:6:5 RGB, in host byte order */
+    RGB565,
+    /* One byte per pixel holding the Color (shade) index */
+    Index8,
+};
+
 struct Palette {
     Color color0 = Color::White;
     Color color1 = Color::LightGray;
@@ -1,32 +1,194 @@
 #include "gameboy.h"
+#include "save_state.h"
+
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
-Gameboy::Gameboy(const std::vector<u8>& cartridge_data, Options& options,
+namespace {
+auto log_level_for(const Options& options) -> LogLevel {
+    if (options.trace) { return LogLevel::Trace; }
+    return options.disable_logs ? LogLevel::Error : options.log_level;
+}
+} // namespace
+
+Gameboy::Gameboy(const std::vector<u8>& cartridge_data, const Options& inOptions,
+                 const std::vector<u8>& save_data)
+    : Gameboy(RomImage::from_bytes(cartridge_data), inOptions, save_data)
+{
+}
+
+Gameboy::Gameboy(std::shared_ptr<const RomImage> rom, const Options& inOptions,
                  const std::vector<u8>& save_data)
-    : cartridge(get_cartridge(cartridge_data, save_data)),
+    : options(inOptions),
+      options_pending(false),
+      logger(log_level_for(options)),
+      cartridge(load_cartridge(std::move(rom), save_data)),
+      cgb(cartridge->info().supports_cgb && !options.force_dmg),
       cpu(*this, options),
       video(*this, options),
       audio(*this, options),
       mmu(*this, options),
       timer(*this),
-      serial(options),
-      debugger(*this, options)
+      serial(*this, options),
+      debugger(*this, options),
+      watchdog(options),
+      held_buttons(0),
+      frame_skip(options.frame_skip),
+      adaptive_frame_skip(options.adaptive_frame_skip),
+      run_ahead_frames(options.run_ahead_frames),
+      stop_requested(false),
+      speed_mode(options.speed_mode),
+      speed_multiplier(options.speed_multiplier == 0 ? 1 : options.speed_multiplier)
 {
-    if (options.disable_logs) log_set_level(LogLevel::Error);
+    LogScope log_scope(logger);
 
-    log_set_level(options.trace
-        ? LogLevel::Trace
-        : LogLevel::Info
-    );
+    cartridge->attach_clock(scheduler);
+
+    sync(EventType::Video);
+    sync(EventType::Timer);
+    sync(EventType::Audio);
+    sync(EventType::Serial);
+    sync(EventType::Watchdog);
+
+    if (options.rewind_window > 0) {
+        rewind_interval = options.rewind_interval == 0 ? 1 : options.rewind_interval;
+        rewind_buffer = std::make_unique<RewindBuffer>(options.rewind_window / rewind_interval);
+    }
+}
+
+auto Gameboy::load_cartridge(std::shared_ptr<const RomImage> rom,
+                             const std::vector<u8>& save_data) -> std::shared_ptr<Cartridge> {
+    LogScope log_scope(logger);
+    return get_cartridge(std::move(rom), save_data);
 }
 
 void Gameboy::button_pressed(GbButton button) {
-    input.button_pressed(button);
+    held_buttons.fetch_or(button_bit(button));
 }
 
 void Gameboy::button_released(GbButton button) {
-    input.button_released(button);
+    held_buttons.fetch_and(static_cast<u8>(~button_bit(button)));
+}
+
+void Gameboy::start_movie_recording() {
+    LogScope log_scope(logger);
+    movie = std::make_unique<Movie>(cartridge->rom_checksum(), save_state());
+    recording_movie = true;
+}
+
+auto Gameboy::finish_movie_recording() -> std::vector<u8> {
+    if (!movie || !recording_movie) { return {}; }
+
+    std::vector<u8> data = movie->serialize();
+    movie.reset();
+    recording_movie = false;
+    return data;
+}
+
+auto Gameboy::play_movie(const std::vector<u8>& data) -> bool {
+    LogScope log_scope(logger);
+    std::unique_ptr<Movie> parsed = Movie::parse(data, cartridge->rom_checksum());
+    if (!parsed || !load_state(parsed->start_state())) { return false; }
+
+    movie = std::move(parsed);
+    recording_movie = false;
+    movie_frame = 0;
+    return true;
+}
+
+auto Gameboy::playing_movie() const -> bool { return movie && !recording_movie; }
+
+void Gameboy::register_serial_callback(const serial_callback_t& callback) {
+    serial.register_serial_callback(callback);
+}
+
+void Gameboy::register_battery_callback(const battery_callback_t& callback) {
+    battery_callback = callback;
+    if (battery_callback) { cartridge->track_ram_writes(); }
+}
+
+void Gameboy::set_log_sink(const log_sink_t& sink) {
+    logger.set_sink(sink);
+}
+
+auto Gameboy::failed() const -> bool { return !error_message.empty(); }
+
+auto Gameboy::error() const -> const std::string& { return error_message; }
+
+void Gameboy::request_stop() {
+    stop_requested = true;
+}
+
+auto Gameboy::profile() const -> const Profiler& { return profiler; }
+
+void Gameboy::reset_profile() { profiler.reset(); }
+
+void Gameboy::set_speed(SpeedMode mode, uint multiplier) {
+    speed_multiplier = multiplier == 0 ? 1 : multiplier;
+    speed_mode = mode;
+}
+
+void Gameboy::configure(const Options& next) {
+    std::lock_guard<std::mutex> lock(pending_options_mutex);
+    pending_options = next;
+    options_pending = true;
+}
+
+void Gameboy::apply_pending_options() {
+    Options next;
+    {
+        std::lock_guard<std::mutex> lock(pending_options_mutex);
+        next = pending_options;
+        options_pending = false;
+    }
+
+    /* Read where they're needed, without going through here */
+    options.print_serial = next.print_serial;
+    options.skip_idle_loops = next.skip_idle_loops;
+
+    options.disable_logs = next.disable_logs;
+    options.log_level = next.log_level;
+    logger.set_level(log_level_for(options));
+
+    options.speed_mode = next.speed_mode;
+    options.speed_multiplier = next.speed_multiplier;
+    set_speed(next.speed_mode, next.speed_multiplier);
+
+    options.frame_skip = frame_skip = next.frame_skip;
+    options.adaptive_frame_skip = adaptive_frame_skip = next.adaptive_frame_skip;
+    options.run_ahead_frames = run_ahead_frames = next.run_ahead_frames;
+
+    /* A stall already found is acted on again, the new way */
+    if (next.watchdog_seconds != options.watchdog_seconds || next.watchdog_action != options.watchdog_action) {
+        options.watchdog_seconds = next.watchdog_seconds;
+        options.watchdog_action = next.watchdog_action;
+        stall = StallReason::None;
+        throttled = false;
+        watchdog.set_throttled(false);
+        sync(EventType::Watchdog);
+    }
+
+    /* Audio made so far is mixed the old way, and the rest the new */
+    if (next.mute_audio != options.mute_audio || next.audio_sample_rate != options.audio_sample_rate) {
+        sync(EventType::Audio);
+        options.mute_audio = next.mute_audio;
+        options.audio_sample_rate = next.audio_sample_rate;
+        audio.restart_output();
+        sync(EventType::Audio);
+    }
+
+    options.ppu_timing = next.ppu_timing;
+    video.set_timing(options.ppu_timing);
+
+    if (next.threaded_video != options.threaded_video) {
+        options.threaded_video = next.threaded_video;
+        video.set_threaded(options.threaded_video, options.dmg_palette);
+    }
+}
+
+void Gameboy::set_frame_filter(const frame_filter_t& filter) {
+    frame_filter = filter;
 }
 
 void Gameboy::debug_toggle_background() {
@@ -46,6 +208,9 @@ void Gameboy::run(
     const vblank_callback_t& _vblank_callback,
     const audio_callback_t& _audio_callback
 ) {
+    if (failed()) { return; }
+
+    LogScope log_scope(logger);
     should_close_callback = _should_close_callback;
 
     video.register_vblank_callback(_vblank_callback);
@@ -55,47 +220,522 @@ void Gameboy::run(
         audio.register_audio_callback(_audio_callback);
     }
 
+    try {
+        run_frames();
+    } catch (const FatalError& error) {
+        /* Already logged where it was thrown */
+        error_message = error.what();
+    }
+
+    stop_requested = false;
+    debugger.set_enabled(false);
+}
+
+auto Gameboy::run_frame() -> StepResult {
+    return step(video.frame_count() + 1, NO_STOP);
+}
+
+auto Gameboy::run_cycles(const uint cycles) -> StepResult {
+    return step(NO_STOP, scheduler.now() + cycles);
+}
+
+auto Gameboy::step(const u64 frame_target, const u64 cycle_target) -> StepResult {
+    StepResult result;
+    if (failed()) {
+        result.stopped = true;
+        return result;
+    }
+
+    LogScope log_scope(logger);
+
+    u64 start = scheduler.now();
+    u64 start_frame = video.frame_count();
+    u64 start_drawn = video.drawn_frame_count();
+    audio.begin_capture();
+
+    try {
+        while (video.frame_count() < frame_target && scheduler.now() < cycle_target && !stop_requested) {
+            tick_any(cycle_target);
+        }
+    } catch (const FatalError& error) {
+        /* Already logged where it was thrown */
+        error_message = error.what();
+    }
+
+    audio.end_capture();
+
+    result.cycles = static_cast<uint>(scheduler.now() - start);
+    result.frames = static_cast<uint>(video.frame_count() - start_frame);
+    if (video.drawn_frame_count() != start_drawn) { result.frame = &video.frame_buffer(); }
+
+    const std::vector<float>& samples = audio.captured();
+    result.audio = samples.data();
+    result.audio_frames = static_cast<uint>(samples.size() / 2);
+
+    result.stopped = stop_requested || failed();
+    result.throttled = throttled;
+    stop_requested = false;
+
+    return result;
+}
+
+void Gameboy::run_frames() {
     // Timing constants
     constexpr double target_fps = 59.73;
-    constexpr double target_frame_time_ms = 1000.0 / target_fps; // ~16.74 ms
     constexpr uint32_t cycles_per_frame = 70224; // 4194304 Hz / 59.73 FPS
 
-    while (!should_close_callback()) {
+    while (!stop_requested && !should_close_callback()) {
         auto frame_start = std::chrono::high_resolution_clock::now();
 
         uint32_t cycles_this_frame = 0;
-        while (cycles_this_frame < cycles_per_frame && !should_close_callback()) {
+        while (cycles_this_frame < cycles_per_frame && !stop_requested && !should_close_callback()) {
             // tick() returns void, but we need to know cycles used per tick
             // So we must modify tick() to return the cycles used, or accumulate them here
             // For now, let's use the elapsed_cycles variable
             uint32_t cycles_before = elapsed_cycles;
-            tick();
+            tick_any();
             uint32_t cycles_after = elapsed_cycles;
             cycles_this_frame += (cycles_after - cycles_before);
         }
 
+        /* Unthrottled runs never sleep, so headless/batch jobs go as fast as the host allows */
+        if (speed_mode == SpeedMode::Unthrottled && !throttled) {
+            running_behind = false;
+            continue;
+        }
+
         // VBlank callback should be triggered by the video system, but we can ensure frame pacing here
         auto frame_end = std::chrono::high_resolution_clock::now();
+        double target_frame_time_ms = frame_time_ms(target_fps); // ~16.74 ms at 1x
         double elapsed_ms = std::chrono::duration<double, std::milli>(frame_end - frame_start).count();
+        running_behind = elapsed_ms > target_frame_time_ms;
         if (elapsed_ms < target_frame_time_ms) {
             std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(target_frame_time_ms - elapsed_ms));
         }
     }
+}
 
-    debugger.set_enabled(false);
+auto Gameboy::frame_time_ms(double target_fps) const -> double {
+    double multiplier = speed_mode == SpeedMode::FastForward && !throttled
+        ? static_cast<double>(speed_multiplier)
+        : 1.0;
+
+    return 1000.0 / (target_fps * multiplier);
+}
+
+void Gameboy::tick_any(const u64 stop_at) {
+    if (debugger.is_enabled()) {
+        tick<true>(stop_at);
+    } else {
+        tick<false>(stop_at);
+    }
 }
 
-void Gameboy::tick() {
-    debugger.cycle();
+template <bool debugging>
+void Gameboy::tick(const u64 stop_at) {
+    if (debugging) {
+        profile_scope(profiler, ProfiledComponent::Debugger);
+        debugger.cycle(cpu.program_counter());
+    }
+
+    {
+        profile_scope(profiler, ProfiledComponent::CPU);
+        u64 start = scheduler.now();
+
+        auto cycles = cpu.tick();
+        advance_cpu(cycles.cycles);
+
+        /* The rest of a cached block runs without going back through the
+         * debugger and interrupt checks, until something falls due or a
+         * run_cycles() budget runs out */
+        while (!debugging && scheduler.now() < std::min(scheduler.next_event(), stop_at)) {
+            auto block_cycles = cpu.tick_block();
+            if (block_cycles.cycles == 0) { break; }
+
+            advance_cpu(block_cycles.cycles);
+        }
+
+        /* The debugger gets to see every cycle */
+        if (!debugging && cpu.is_idle()) { skip_idle(stop_at); }
 
-    auto cycles = cpu.tick();
-    elapsed_cycles += cycles.cycles;
+        profile_cycles(profiler, ProfiledComponent::CPU, static_cast<uint>(scheduler.now() - start));
+        unused(start);
+    }
+
+    /* Other components only run when something they do is due, or when the
+     * CPU accesses their registers (see MMU::sync_io) */
+    if (scheduler.now() >= scheduler.next_event()) { run_due_events(); }
 
-    video.tick(cycles);
-    audio.tick(cycles.cycles);
-    timer.tick(cycles.cycles);
+    if (video.frame_count() != last_frame) { start_frame(); }
+}
+
+void Gameboy::skip_idle(const u64 stop_at) {
+    u64 until = std::min(scheduler.next_event(), stop_at);
+    if (scheduler.now() >= until) { return; }
+    uint idle = static_cast<uint>(until - scheduler.now());
+    if (double_speed) { idle *= 2; }
+
+    if (!cpu.is_halted()) {
+        /* An idle loop's last read was at the start of the iteration just
+         * finished; an event since then may change what the next one sees */
+        uint iteration = cpu.idle_loop_length();
+        if (last_events_at > scheduler.now() - iteration) { return; }
+
+        /* Whole iterations only, leaving the loop back at its start */
+        idle -= idle % iteration;
+    }
+
+    advance_cpu(idle);
+}
+
+void Gameboy::advance_cpu(uint cycles) {
+    if (double_speed) {
+        cycles += half_cycle;
+        half_cycle = cycles & 1;
+        cycles /= 2;
+    }
+
+    cycles += stalled_clocks;
+    stalled_clocks = 0;
+
+    elapsed_cycles += cycles;
+    scheduler.advance(cycles);
+}
+
+void Gameboy::switch_speed() {
+    /* The timer counts what it has so far at the old rate */
+    sync(EventType::Timer);
+    timer.change_speed();
+
+    double_speed = !double_speed;
+    speed_switch_armed = false;
+    half_cycle = 0;
+
+    sync(EventType::Timer);
+    log_debug("Switched to %s speed", double_speed ? "double" : "single");
+}
+
+void Gameboy::start_frame() {
+    last_frame = video.frame_count();
+
+    /* Frames run ahead only need the buttons; they are undone afterwards */
+    if (running_ahead) {
+        input.set_buttons(held_buttons);
+        return;
+    }
+
+    handle_stall(watchdog.frame_started(scheduler.now(), video.frame_count(), video.drawn_frame_count(),
+                                        video.lcd_enabled()));
+
+    if (options_pending) { apply_pending_options(); }
+
+    if (playing_movie()) {
+        input.set_buttons(movie->buttons(movie_frame++));
+        if (movie_frame >= movie->length()) { movie.reset(); }
+    } else {
+        u8 buttons = held_buttons;
+        input.set_buttons(buttons);
+        if (recording_movie) { movie->record(buttons); }
+    }
+
+    video.set_frame_drawn(should_draw_frame());
+
+    if (battery_callback && cartridge->collect_ram_changes(battery_changes)) { battery_callback(battery_changes); }
+
+    if (rewind_buffer) { capture_rewind_state(); }
+
+    if (run_ahead_frames > 0) { run_ahead(); }
+}
+
+void Gameboy::handle_stall(const StallReason next) {
+    if (next == stall) { return; }
+    stall = next;
+
+    if (stall == StallReason::None) {
+        log_info("Watchdog: running normally again");
+        throttled = false;
+        watchdog.set_throttled(false);
+        return;
+    }
+
+    log_warn("Watchdog: %s for %u s", stall_reason_name(stall), options.watchdog_seconds);
+
+    switch (options.watchdog_action) {
+        case WatchdogAction::Report:
+            break;
+        case WatchdogAction::Throttle:
+            throttled = true;
+            watchdog.set_throttled(true);
+            break;
+        case WatchdogAction::Stop:
+            error_message = std::string("Stopped by the watchdog: ") + stall_reason_name(stall);
+            request_stop();
+            break;
+    }
+}
+
+void Gameboy::run_ahead() {
+    /* The frames run ahead mustn't be seen: the debugger would stop in
+     * them, a movie already has its input, and a cable would pass on bytes
+     * which can't be taken back */
+    if (debugger.is_enabled() || playing_movie() || serial.linked()) { return; }
+
+    bool draw = video.frame_drawn();
+    u64 frames = video.frame_count();
+    run_ahead_state = save_state();
+
+    running_ahead = true;
+    audio.hold_output();
+    for (uint i = 1; i <= run_ahead_frames && !stop_requested; i++) {
+        video.set_frame_drawn(draw && i == run_ahead_frames);
+
+        u64 target = video.frame_count() + 1;
+        while (video.frame_count() < target && !stop_requested) { tick<false>(); }
+    }
+    audio.release_output();
+    running_ahead = false;
+
+    StateReader reader(run_ahead_state, cartridge->rom_checksum());
+    restore_state(reader);
+    video.set_frame_count(frames);
+    last_frame = frames;
+
+    /* The last frame run ahead is shown in place of this one */
+    video.set_frame_drawn(false);
+}
+
+auto Gameboy::should_draw_frame() -> bool {
+    if (frame_filter) { return frame_filter(video.frame_count()); }
+    if (frame_skip == 0) { return true; }
+
+    if (!adaptive_frame_skip) { return video.frame_count() % (frame_skip + 1) == 0; }
+
+    /* Some frames are drawn even while the host can't keep up */
+    if (running_behind && frames_skipped < frame_skip) {
+        frames_skipped++;
+        return false;
+    }
+    frames_skipped = 0;
+    return true;
+}
+
+void Gameboy::start_trace(const std::string& trace_file) {
+    if (tracer) { return; }
+
+    tracer = std::make_unique<Tracer>(trace_file.empty()
+        ? Tracer::text_sink(stdout)
+        : TraceFileWriter::sink(trace_file));
+    cpu.set_tracer(tracer.get());
+}
+
+void Gameboy::capture_rewind_state() {
+    if (last_frame % rewind_interval != 0) { return; }
+
+    rewind_buffer->push(save_state());
+    rewind_frame = last_frame;
+}
+
+auto Gameboy::rewind(const uint frames) -> uint {
+    LogScope log_scope(logger);
+    if (!rewind_buffer || rewind_buffer->size() == 0) { return 0; }
+
+    /* The newest snapshot is up to one interval old already */
+    u64 since_newest = video.frame_count() - rewind_frame;
+    uint steps = 1;
+    if (frames > since_newest) {
+        steps += static_cast<uint>((frames - since_newest + rewind_interval - 1) / rewind_interval);
+    }
+    steps = std::min(steps, rewind_buffer->size());
+
+    const std::vector<u8>& state = rewind_buffer->rewind(steps);
+    if (!load_state(state)) { return 0; }
+
+    auto rewound = static_cast<uint>(since_newest + (steps - 1) * rewind_interval);
+
+    /* Frames keep counting up, so the snapshot just restored stays the
+     * newest one and further rewinds continue from it */
+    rewind_frame = video.frame_count();
+    return rewound;
+}
+
+void Gameboy::run_due_events() {
+    last_events_at = scheduler.next_event();
+
+    if (scheduler.is_due(EventType::Video)) { sync(EventType::Video); }
+    if (scheduler.is_due(EventType::Timer)) { sync(EventType::Timer); }
+    if (scheduler.is_due(EventType::Audio)) { sync(EventType::Audio); }
+    if (scheduler.is_due(EventType::Serial)) { sync(EventType::Serial); }
+    if (scheduler.is_due(EventType::Watchdog)) { sync(EventType::Watchdog); }
+}
+
+void Gameboy::sync(const EventType component) {
+    uint cycles = scheduler.catch_up(component);
+
+    switch (component) {
+        case EventType::Video: {
+            profile_scope(profiler, ProfiledComponent::Video);
+            profile_cycles(profiler, ProfiledComponent::Video, cycles);
+            video.tick(cycles);
+            scheduler.schedule(component, video.cycles_until_next_event());
+            break;
+        }
+        case EventType::Timer: {
+            profile_scope(profiler, ProfiledComponent::Timer);
+            profile_cycles(profiler, ProfiledComponent::Timer, cycles);
+            timer.update();
+            scheduler.schedule(component, timer.cycles_until_next_event());
+            break;
+        }
+        case EventType::Audio: {
+            profile_scope(profiler, ProfiledComponent::Audio);
+            profile_cycles(profiler, ProfiledComponent::Audio, cycles);
+            audio.tick(cycles);
+            scheduler.schedule(component, audio.cycles_until_next_event());
+            break;
+        }
+        case EventType::Serial:
+            serial.update();
+            scheduler.schedule(component, serial.cycles_until_next_event());
+            break;
+        case EventType::Watchdog:
+            /* Frames run ahead are undone, so they aren't sampled */
+            if (options.watchdog_seconds > 0 && !running_ahead) {
+                handle_stall(watchdog.sample(scheduler.now(), cpu.program_counter(), cpu.is_locked()));
+            }
+            scheduler.schedule(component, watchdog.cycles_until_next_event());
+            break;
+    }
+}
+
+namespace {
+struct GameboyState {
+    u64 timestamp;
+    u32 elapsed_cycles;
+    u32 stalled_clocks;
+    u8 double_speed;
+    u8 speed_switch_armed;
+    u8 half_cycle;
+    u8 unused[5];
+};
+} // namespace
+
+auto Gameboy::save_state() -> std::vector<u8> {
+    LogScope log_scope(logger);
+    sync(EventType::Video);
+    sync(EventType::Timer);
+    sync(EventType::Audio);
+    sync(EventType::Serial);
+
+    StateWriter writer(cartridge->rom_checksum());
+
+    GameboyState state = {};
+    state.timestamp = scheduler.now();
+    state.elapsed_cycles = elapsed_cycles;
+    state.stalled_clocks = stalled_clocks;
+    state.double_speed = double_speed;
+    state.speed_switch_armed = speed_switch_armed;
+    state.half_cycle = static_cast<u8>(half_cycle);
+    writer.write(StateSection::Gameboy, state);
+
+    cpu.save_state(writer);
+    mmu.save_state(writer);
+    video.save_state(writer);
+    timer.save_state(writer);
+    audio.save_state(writer);
+    input.save_state(writer);
+    serial.save_state(writer);
+    cartridge->save_state(writer);
+
+    return std::move(writer.data());
+}
+
+auto Gameboy::load_state(const std::vector<u8>& state_data) -> bool {
+    LogScope log_scope(logger);
+    StateReader reader(state_data, cartridge->rom_checksum());
+    if (!reader.valid()) { return false; }
+
+    /* Every section has a fixed size for a given build and ROM, so comparing
+     * against a fresh snapshot catches anything which can't be loaded */
+    std::vector<u8> current = save_state();
+    if (!reader.same_layout(StateReader(current, cartridge->rom_checksum()))) {
+        log_error("Save state layout does not match this emulator or cartridge");
+        return false;
+    }
+
+    restore_state(reader);
+    return true;
+}
+
+void Gameboy::restore_state(StateReader& reader) {
+    GameboyState state;
+    reader.read(StateSection::Gameboy, state);
+    elapsed_cycles = state.elapsed_cycles;
+    stalled_clocks = state.stalled_clocks;
+    double_speed = state.double_speed != 0;
+    speed_switch_armed = state.speed_switch_armed != 0;
+    half_cycle = state.half_cycle;
+
+    cpu.load_state(reader);
+    mmu.load_state(reader);
+    video.load_state(reader);
+    timer.load_state(reader);
+    audio.load_state(reader);
+    input.load_state(reader);
+    serial.load_state(reader);
+    cartridge->load_state(reader);
+
+    scheduler.restore(state.timestamp);
+    sync(EventType::Video);
+    sync(EventType::Timer);
+    sync(EventType::Audio);
+    sync(EventType::Serial);
+
+    /* Only rescheduled: a sample here would count the same PC again on
+     * every run-ahead restore, and skew the hotspots */
+    scheduler.schedule(EventType::Watchdog, watchdog.cycles_until_next_event());
+}
+
+auto Gameboy::fork() -> std::unique_ptr<Gameboy> {
+    LogScope log_scope(logger);
+
+    /* Both would be left fighting over the terminal or the trace file */
+    Options fork_options = options;
+    fork_options.debugger = false;
+    fork_options.trace = false;
+    fork_options.trace_file.clear();
+
+    auto child = std::make_unique<Gameboy>(cartridge->rom_image(), fork_options);
+
+    /* Straight from one instance into the other: the snapshot is of the
+     * same ROM with the same options, so none of load_state()'s checks
+     * are needed */
+    std::vector<u8> state = save_state();
+    StateReader reader(state, cartridge->rom_checksum());
+    {
+        LogScope child_scope(child->logger);
+        child->restore_state(reader);
+    }
+
+    child->video.copy_frames(video);
+    child->last_frame = last_frame;
+    child->frames_skipped = frames_skipped;
+    child->held_buttons = held_buttons.load();
+    child->set_speed(speed_mode, speed_multiplier);
+    child->error_message = error_message;
+
+    return child;
 }
 
 auto Gameboy::get_cartridge_ram() const -> const std::vector<u8>& {
     return cartridge->get_cartridge_ram();
 }
+
+auto Gameboy::get_battery_data() const -> std::vector<u8> {
+    return cartridge->battery_data();
+}
+
+auto Gameboy::audio_output() -> AudioRing& { return audio.output(); }
+
+void Gameboy::register_audio_stats_callback(const audio_stats_callback_t& callback) {
+    audio.register_stats_callback(callback);
+}
@@ -1,23 +1,72 @@
 #pragma once
 
 #include "debugger.h"
+#include "guest_memory.h"
 #include "input.h"
 #include "cpu/cpu.h"
 #include "video/video.h"
 #include "audio/audio.h"
 #include "serial.h"
 #include "timer.h"
+#include "scheduler.h"
 #include "options.h"
+#include "profiler.h"
+#include "rewind.h"
+#include "movie.h"
+#include "trace_file.h"
+#include "watchdog.h"
 #include "util/log.h"
 
+#include <atomic>
 #include <memory>
 #include <functional>
+#include <mutex>
+#include <string>
 
 using should_close_callback_t = std::function<bool()>;
 
+/* Whether to draw a frame, by its number: frame n is the one which brings
+ * Video::frame_count() to n + 1 */
+using frame_filter_t = std::function<bool(u64 frame)>;
+
+/* Cartridge RAM written during the last frame (see register_battery_callback) */
+using battery_callback_t = std::function<void(const RamChanges&)>;
+
+/* What a call to run_frame() or run_cycles() produced. The frame and the
+ * samples stay valid until the next call */
+struct StepResult {
+    /* Clocks actually run; a step can end a little past its budget */
+    uint cycles = 0;
+
+    /* Frames completed during the step, drawn or skipped */
+    uint frames = 0;
+
+    /* The last frame drawn during the step, or null if none was */
+    const FrameBuffer* frame = nullptr;
+
+    /* Interleaved (left, right) samples mixed during the step */
+    const float* audio = nullptr;
+    uint audio_frames = 0;
+
+    /* The emulator asked to stop or hit a fatal error (see failed()) */
+    bool stopped = false;
+
+    /* The watchdog is throttling the instance (WatchdogAction::Throttle).
+     * Steps don't sleep, so whatever drives the instance holds it to real
+     * time, e.g. by not stepping it again before the step's cycles would
+     * have taken at CLOCK_RATE */
+    bool throttled = false;
+};
+
 class Gameboy {
 public:
-    Gameboy(const std::vector<u8>& cartridge_data, Options& options,
+    /* Throws FatalError if the cartridge can't be loaded. The options are
+     * copied; see configure() to change them afterwards */
+    Gameboy(std::shared_ptr<const RomImage> rom, const Options& options,
+            const std::vector<u8>& save_data = {});
+
+    /* Copies the ROM; prefer the RomImage constructor for ROMs from files */
+    Gameboy(const std::vector<u8>& cartridge_data, const Options& options,
             const std::vector<u8>& save_data = {});
 
     void run(
@@ -26,8 +75,21 @@ public:
         const audio_callback_t& _audio_callback = nullptr
     );
 
+    /* Non-blocking alternatives to run(), for frontends driving the
+     * emulator from their own loop: run_frame() returns once the next frame
+     * is complete, run_cycles() once at least 'cycles' clocks have passed.
+     * Neither paces itself, even throttled (see StepResult::throttled).
+     * Audio produced by a step is returned with it instead of going into
+     * audio_output(). Callbacks registered through run() still fire */
+    auto run_frame() -> StepResult;
+    auto run_cycles(uint cycles) -> StepResult;
+
+    /* Safe from any thread. The buttons held are only passed on to the
+     * game as each frame starts, so input is tied to the frame counter */
     void button_pressed(GbButton button);
     void button_released(GbButton button);
+    /* Holds exactly the buttons in the mask (see button_bit) */
+    void set_buttons(u8 mask) { held_buttons = mask; }
 
     void debug_toggle_background();
     void debug_toggle_sprites();
@@ -35,11 +97,191 @@ public:
 
     auto get_cartridge_ram() const -> const std::vector<u8>&;
 
+    /* Work RAM itself, all eight banks of it on a CGB, for tools watching
+     * a game. It stays at the same place for the instance's lifetime, but
+     * should only be touched between steps */
+    auto work_ram() -> std::array<u8, WORK_RAM_SIZE>& { return memory.work_ram; }
+
+    /* The frame buffer drawn into, whose front() is the latest frame */
+    auto frame_buffer() const -> const FrameBuffer& { return video.frame_buffer(); }
+    /* Frames completed since power-on, drawn or skipped */
+    auto frame_count() const -> u64 { return video.frame_count(); }
+
+    /* Running as a CGB, which is decided by the cartridge header */
+    auto cgb_mode() const -> bool { return cgb; }
+
+    /* The cartridge RAM plus, for cartridges with a clock, its state: what
+     * a save file should hold */
+    auto get_battery_data() const -> std::vector<u8>;
+
+    /* Snapshot of the whole machine (see save_state.h for the format).
+     * Saving first brings every component up to date */
+    auto save_state() -> std::vector<u8>;
+
+    /* Restores a snapshot made by save_state() for the same ROM. Returns
+     * false, leaving the machine untouched, if the blob doesn't match */
+    auto load_state(const std::vector<u8>& state) -> bool;
+
+    /* A second instance carrying on from exactly where this one is, e.g.
+     * for a search trying several inputs from the same point. The ROM and
+     * the cartridge header decoded from it are shared, and the rest of the
+     * machine copied, which takes microseconds. The copy has this
+     * instance's options, as changed so far, but no debugger or trace,
+     * and starts without its callbacks, frame filter, movie, rewind
+     * history or link cable. It is independent, so it can run on another
+     * thread (see BatchRunner). Must not be called while running (but can
+     * be from its callbacks) */
+    auto fork() -> std::unique_ptr<Gameboy>;
+
+    /* Steps back through the rewind history (see Options::rewind_window),
+     * to the snapshot at least 'frames' frames back or the oldest one kept.
+     * Returns the number of frames actually rewound. Must not be called
+     * while the emulator is running (including from its callbacks) */
+    auto rewind(uint frames) -> uint;
+
+    /* Input movies (see movie.h). Recording snapshots the machine, then
+     * keeps the buttons passed on at every frame until finished. Playing
+     * restores the snapshot and feeds the recorded buttons in place of
+     * button_pressed/button_released until the movie runs out. Neither
+     * may be started while running (but can be from its callbacks) */
+    void start_movie_recording();
+    auto finish_movie_recording() -> std::vector<u8>;
+    auto play_movie(const std::vector<u8>& movie) -> bool;
+    auto playing_movie() const -> bool;
+
+    /* Lock-free output for a frontend's audio thread to pull samples from */
+    auto audio_output() -> AudioRing&;
+
+    /* Opt-in per-block audio statistics, for debugging the mixer */
+    void register_audio_stats_callback(const audio_stats_callback_t& callback);
+
+    void register_serial_callback(const serial_callback_t& callback);
+
+    /* Turns on tracking of cartridge RAM writes. As each frame starts, the
+     * pages written during the one before are passed to the callback, on
+     * the emulation thread, so it should only take a copy (see
+     * BatteryWriter). Should be set before running */
+    void register_battery_callback(const battery_callback_t& callback);
+
+    /* Messages logged by this instance go to the sink instead of the
+     * console. Should be set before running */
+    void set_log_sink(const log_sink_t& sink);
+
+    /* Set once a fatal error stops the emulator. A failed instance won't
+     * run again; its state is whatever it was when the error happened */
+    auto failed() const -> bool;
+    auto error() const -> const std::string&;
+
+    /* What the built-in profiler has recorded so far (see profiler.h). All
+     * zero unless built with -DGBEMU_PROFILER=ON */
+    auto profile() const -> const Profiler&;
+    void reset_profile();
+
+    /* Frame pacing can be changed while running, e.g. for an interactive fast-forward key */
+    void set_speed(SpeedMode mode, uint multiplier = 1);
+
+    /* The options in effect, with any changes through configure() since
+     * taken up. Should only be read between steps */
+    auto get_options() const -> const Options& { return options; }
+
+    /* Takes the options which can be changed on a running instance (see
+     * is_runtime_option in config.h) from these, as the next frame
+     * starts; the others are ignored. Can be called from any thread */
+    void configure(const Options& options);
+
+    /* The instance's health metrics and whether the watchdog finds it
+     * stuck (see watchdog.h). Safe from any thread, while running too */
+    auto health() const -> HealthReport { return watchdog.report(); }
+
+    /* Draws only the frames the filter asks for, in place of the frame
+     * skipping set in the options; a null filter goes back to those. The
+     * filter is asked as each frame starts. Must not be changed while
+     * running (but can be from its callbacks) */
+    void set_frame_filter(const frame_filter_t& filter);
+
 private:
-    void tick();
+    /* Makes run() return once the current step is done; used for
+     * --exit-on-infinite-jr and the debugger's exit command */
+    void request_stop();
+
+    auto load_cartridge(std::shared_ptr<const RomImage> rom,
+                        const std::vector<u8>& save_data) -> std::shared_ptr<Cartridge>;
+
+    void run_frames();
+    auto step(u64 frame_target, u64 cycle_target) -> StepResult;
+
+    /* Moves the clock on by 'cycles' of the CPU's own, which in double
+     * speed mode take half as long, plus any the CPU was stalled for */
+    void advance_cpu(uint cycles);
+
+    /* Keeps the CPU off the bus for this many clocks from the end of the
+     * current instruction, e.g. for an HDMA transfer (see MMU) */
+    void stall_cpu(uint clocks) { stalled_clocks += clocks; }
+
+    /* STOP with a speed switch armed through KEY1: the CPU, and the timer
+     * and OAM DMA with it, toggle between single and double speed. Video
+     * and audio keep their rate */
+    void switch_speed();
+
+    /* Separate loops with and without the debugger, so that with it off
+     * nothing of it is left in the instruction path */
+    template <bool debugging>
+    void tick(u64 stop_at = NO_STOP);
+    void tick_any(u64 stop_at = NO_STOP);
+    void run_due_events();
+
+    /* Jumps the clock over a halted CPU or an idle loop, up to the next
+     * event (see CPU::is_idle) */
+    void skip_idle(u64 stop_at);
+
+    /* Brings a component up to the current time and reschedules its next event */
+    void sync(EventType component);
+    auto frame_time_ms(double target_fps) const -> double;
+
+    /* Latches the frame's input, decides whether to draw it, then snapshots
+     * it for rewinding and runs ahead of it */
+    void start_frame();
+    void apply_pending_options();
+    auto should_draw_frame() -> bool;
+    void capture_rewind_state();
+
+    /* Acts on what the watchdog finds, as Options::watchdog_action says */
+    void handle_stall(StallReason stall);
+
+    /* See Options::run_ahead_frames. Called between frames */
+    void run_ahead();
+
+    /* The sections of a snapshot already known to fit */
+    void restore_state(StateReader& reader);
+
+    /* For --trace, once the boot ROM hands over (see MMU). Binary, to the
+     * file if one is given, or text to stdout */
+    void start_trace(const std::string& trace_file);
+
+    /* The instance's own copy, which the components keep references to.
+     * Only changed between frames, on the emulation thread */
+    Options options;
+
+    /* Handed over by configure() for the next frame to take up */
+    std::mutex pending_options_mutex;
+    Options pending_options;
+    std::atomic<bool> options_pending;
+
+    /* Made current (see LogScope) whenever this instance is doing work, so
+     * log settings and sinks stay per instance. Declared ahead of the
+     * cartridge, for it to log through */
+    Logger logger;
+
+    Profiler profiler;
 
     std::shared_ptr<Cartridge> cartridge;
 
+    /* Set from the cartridge header for the components to see */
+    const bool cgb;
+
+    /* Ahead of the components, which keep references into it */
+    GuestMemory memory;
+
     CPU cpu;
     friend class CPU;
 
@@ -56,12 +298,70 @@ private:
     friend class Timer;
 
     Input input;
+
     Serial serial;
+    friend class Serial;
+    /* Step instances a little at a time and roll them back (see link.h) */
+    friend class LocalLink;
+    friend class RollbackLink;
 
     Debugger debugger;
     friend class Debugger;
 
+    Scheduler scheduler;
+
+    Watchdog watchdog;
+    /* The stall last acted on */
+    StallReason stall = StallReason::None;
+    bool throttled = false;
+    /* When the events run last fell due */
+    u64 last_events_at = 0;
+
+    /* KEY1. In double speed mode a CPU cycle is half a clock, so an odd
+     * one out is carried over to the next instruction */
+    bool double_speed = false;
+    bool speed_switch_armed = false;
+    uint half_cycle = 0;
+    uint stalled_clocks = 0;
+
+    std::unique_ptr<Tracer> tracer;
+
+    /* Held in the frontend, as opposed to passed on to Input */
+    std::atomic<u8> held_buttons;
+
+    std::unique_ptr<Movie> movie;
+    bool recording_movie = false;
+    uint movie_frame = 0;
+
+    std::unique_ptr<RewindBuffer> rewind_buffer;
+    uint rewind_interval = 0;
+    u64 last_frame = 0;
+    /* Frame count at which the newest snapshot in the rewind buffer was taken */
+    u64 rewind_frame = 0;
+
+    battery_callback_t battery_callback;
+    RamChanges battery_changes;
+
+    frame_filter_t frame_filter;
+    uint frame_skip;
+    bool adaptive_frame_skip;
+    /* Set by run() while it is falling behind its pacing */
+    bool running_behind = false;
+    uint frames_skipped = 0;
+
+    uint run_ahead_frames;
+    bool running_ahead = false;
+    std::vector<u8> run_ahead_state;
+
     uint elapsed_cycles = 0;
 
+    static constexpr u64 NO_STOP = ~0ull;
+
+    std::atomic<bool> stop_requested;
+    std::string error_message;
+
+    std::atomic<SpeedMode> speed_mode;
+    std::atomic<uint> speed_multiplier;
+
     should_close_callback_t should_close_callback;
 };
@@ -1,5 +1,7 @@
 #include "gameboy.h"
+#include "battery_writer.h"
 #include "input.h"
 #include "cartridge/cartridge.h"
+#include "cartridge/rom_archive.h"
 #include "util/log.h"
 #include "util/files.h"
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "definitions.h"
+
+#include <array>
+
+/* Keeps unrelated hot data off each other's cache lines */
+const uint CACHE_LINE_SIZE = 64;
+
+/* Eight banks of work RAM and two of VRAM, as on a CGB. A DMG only has the
+ * first two and the first one respectively */
+const uint WORK_RAM_SIZE = 0x8000;
+const uint WORK_RAM_BANK_SIZE = 0x1000;
+const uint VIDEO_RAM_SIZE = 0x4000;
+const uint VIDEO_RAM_BANK_SIZE = 0x2000;
+const uint OAM_RAM_SIZE = 0xA0;
+const uint HIGH_RAM_SIZE = 0x80;
+
+/*
+ * All of the memory the game itself can see, outside the cartridge.
+ *
+ * It's a plain member of Gameboy rather than a set of vectors owned by the
+ * MMU and Video, so an instance is one allocation, its RAM sits right next
+ * to the CPU and page tables that use it, and the MMU's page tables point
+ * into a single block. Each region starts on its own cache line.
+ */
+struct alignas(CACHE_LINE_SIZE) GuestMemory {
+    alignas(CACHE_LINE_SIZE) std::array<u8, WORK_RAM_SIZE> work_ram = {};
+    alignas(CACHE_LINE_SIZE) std::array<u8, VIDEO_RAM_SIZE> video_ram = {};
+    alignas(CACHE_LINE_SIZE) std::array<u8, OAM_RAM_SIZE> oam_ram = {};
+    alignas(CACHE_LINE_SIZE) std::array<u8, HIGH_RAM_SIZE> high_ram = {};
+};
@@ -1,24 +1,30 @@
 #include "input.h"
 
 #include "util/bitwise.h"
+#include "save_state.h"
 
-void Input::button_pressed(GbButton button) {
-    set_button(button, true);
+auto Input::buttons() const -> u8 {
+    u8 mask = 0;
+    if (up) { mask |= button_bit(GbButton::Up); }
+    if (down) { mask |= button_bit(GbButton::Down); }
+    if (left) { mask |= button_bit(GbButton::Left); }
+    if (right) { mask |= button_bit(GbButton::Right); }
+    if (a) { mask |= button_bit(GbButton::A); }
+    if (b) { mask |= button_bit(GbButton::B); }
+    if (select) { mask |= button_bit(GbButton::Select); }
+    if (start) { mask |= button_bit(GbButton::Start); }
+    return mask;
 }
 
-void Input::button_released(GbButton button) {
-    set_button(button, false);
-}
-
-void Input::set_button(GbButton button, bool set) {
-    if (button == GbButton::Up) { up = set; }
-    if (button == GbButton::Down) { down = set; }
-    if (button == GbButton::Left) { left = set; }
-    if (button == GbButton::Right) { right = set; }
-    if (button == GbButton::A) { a = set; }
-    if (button == GbButton::B) { b = set; }
-    if (button == GbButton::Select) { select = set; }
-    if (button == GbButton::Start) { start = set; }
+void Input::set_buttons(const u8 mask) {
+    up = (mask & button_bit(GbButton::Up)) != 0;
+    down = (mask & button_bit(GbButton::Down)) != 0;
+    left = (mask & button_bit(GbButton::Left)) != 0;
+    right = (mask & button_bit(GbButton::Right)) != 0;
+    a = (mask & button_bit(GbButton::A)) != 0;
+    b = (mask & button_bit(GbButton::B)) != 0;
+    select = (mask & button_bit(GbButton::Select)) != 0;
+    start = (mask & button_bit(GbButton::Start)) != 0;
 }
 
 void Input::write(u8 set) {
@@ -52,3 +58,43 @@ auto Input::get_input() const -> u8 {
 
     return buttons;
 }
+
+namespace {
+struct InputState {
+    bool up, down, left, right;
+    bool a, b, select, start;
+    bool button_switch;
+    bool direction_switch;
+};
+} // namespace
+
+void Input::save_state(StateWriter& writer) const {
+    InputState state = {};
+    state.up = up;
+    state.down = down;
+    state.left = left;
+    state.right = right;
+    state.a = a;
+    state.b = b;
+    state.select = select;
+    state.start = start;
+    state.button_switch = button_switch;
+    state.direction_switch = direction_switch;
+    writer.write(StateSection::Input, state);
+}
+
+void Input::load_state(StateReader& reader) {
+    InputState state;
+    reader.read(StateSection::Input, state);
+
+    up = state.up;
+    down = state.down;
+    left = state.left;
+    right = state.right;
+    a = state.a;
+    b = state.b;
+    select = state.select;
+    start = state.start;
+    button_switch = state.button_switch;
+    direction_switch = state.direction_switch;
+}
@@ -2,6 +2,9 @@
 
 #include "definitions.h"
 
+class StateWriter;
+class StateReader;
+
 enum class GbButton {
     Up,
     Down,
@@ -13,17 +16,24 @@ enum class GbButton {
     Start,
 };
 
+/* Bit n of a button mask is GbButton n */
+inline auto button_bit(GbButton button) -> u8 { return static_cast<u8>(1 << static_cast<uint>(button)); }
+
 class Input {
 public:
-    void button_pressed(GbButton button);
-    void button_released(GbButton button);
+    /* Every button at once, as a mask (see button_bit) */
+    auto buttons() const -> u8;
+    void set_buttons(u8 mask);
+
     void write(u8 set);
 
     auto get_input() const -> u8;
 
-private:
-    void set_button(GbButton button, bool set);
+    /* Held buttons are saved too, so runs forked from a state replay exactly */
+    void save_state(StateWriter& writer) const;
+    void load_state(StateReader& reader);
 
+private:
     bool up = false;
     bool down = false;
     bool left = false;
@@ -0,0 +1,309 @@
+#include "link.h"
+
+#include "util/log.h"
+
+#include <algorithm>
+
+namespace {
+
+/* Adds a step to a result gathered over several */
+void add_step(StepResult& total, const StepResult& step, std::vector<float>& audio) {
+    total.cycles += step.cycles;
+    total.frames += step.frames;
+    if (step.frame != nullptr) { total.frame = step.frame; }
+    audio.insert(audio.end(), step.audio, step.audio + step.audio_frames * 2);
+    total.stopped = total.stopped || step.stopped;
+}
+
+void finish_result(StepResult& result, const std::vector<float>& audio) {
+    result.audio = audio.data();
+    result.audio_frames = static_cast<uint>(audio.size() / 2);
+}
+
+} // namespace
+
+LocalLink::LocalLink(Gameboy& first, Gameboy& second, const bool lockstep)
+    : gameboys{&first, &second},
+      ends{End(*this, 0), End(*this, 1)},
+      start_times{first.scheduler.now(), second.scheduler.now()},
+      max_lead(lockstep ? 1
+               : first.cgb || second.cgb ? MIN_SERIAL_TRANSFER_CYCLES_CGB
+               : MIN_SERIAL_TRANSFER_CYCLES_DMG) {
+    first.serial.attach_link(&ends[0]);
+    second.serial.attach_link(&ends[1]);
+}
+
+LocalLink::~LocalLink() {
+    gameboys[0]->serial.attach_link(nullptr);
+    gameboys[1]->serial.attach_link(nullptr);
+}
+
+auto LocalLink::run_frame() -> const std::array<StepResult, 2>& {
+    begin_results();
+    run_until(gameboys[0]->frame_count() + 1, Gameboy::NO_STOP);
+    end_results();
+    return results;
+}
+
+auto LocalLink::run_cycles(const uint cycles) -> const std::array<StepResult, 2>& {
+    begin_results();
+    run_until(Gameboy::NO_STOP, time(0) + cycles);
+    end_results();
+    return results;
+}
+
+void LocalLink::run_until(const u64 frame_target, const u64 time_target) {
+    while (gameboys[0]->frame_count() < frame_target && time(0) < time_target) {
+        if (results[0].stopped || results[1].stopped) { return; }
+
+        /* The second instance can't start a transfer which finishes sooner
+         * than max_lead from now, but may have one finishing earlier */
+        u64 lead_to = std::min(time_target, time(1) + max_lead);
+        Serial& second_serial = gameboys[1]->serial;
+        if (second_serial.clocking()) {
+            lead_to = std::min(lead_to, second_serial.done_at() - start_times[1]);
+        }
+
+        run_side(0, frame_target, lead_to);
+        run_side(1, Gameboy::NO_STOP, time(0));
+    }
+}
+
+void LocalLink::run_side(const uint side, const u64 frame_target, const u64 until) {
+    Gameboy& gameboy = *gameboys[side];
+    if (time(side) >= until) { return; }
+
+    add_step(results[side], gameboy.step(frame_target, local_time(side, until)), audio[side]);
+}
+
+auto LocalLink::time(const uint side) const -> u64 {
+    return gameboys[side]->scheduler.now() - start_times[side];
+}
+
+auto LocalLink::local_time(const uint side, const u64 link_time) const -> u64 {
+    return link_time + start_times[side];
+}
+
+auto LocalLink::End::exchange(const u8 sent, const u64 time) -> u8 {
+    return link.exchange(side, sent, time);
+}
+
+auto LocalLink::exchange(const uint side, const u8 sent, const u64 local) -> u8 {
+    /* The other end is never ahead of a transfer this one finishes, bar
+     * the odd instruction, so bring it to the same moment first */
+    uint other = 1 - side;
+    u64 finished_at = local - start_times[side];
+    run_side(other, Gameboy::NO_STOP, finished_at);
+
+    return gameboys[other]->serial.clocked_externally(sent);
+}
+
+void LocalLink::begin_results() {
+    for (uint side = 0; side < 2; side++) {
+        results[side] = StepResult();
+        audio[side].clear();
+    }
+}
+
+void LocalLink::end_results() {
+    for (uint side = 0; side < 2; side++) { finish_result(results[side], audio[side]); }
+}
+
+RollbackLink::RollbackLink(Gameboy& inGameboy, LinkTransport& inTransport, const uint max_rollback_frames)
+    : gameboy(inGameboy),
+      transport(inTransport),
+      window(max_rollback_frames),
+      start_time(inGameboy.scheduler.now()) {
+    gameboy.serial.attach_link(this);
+}
+
+RollbackLink::~RollbackLink() { gameboy.serial.attach_link(nullptr); }
+
+auto RollbackLink::run_frame(const u8 buttons, const int timeout_ms) -> StepResult {
+    /* Half the window each way: the other end may be that far ahead when
+     * something this end clocks reaches it, and this end that far ahead
+     * again when the reply comes back */
+    u64 max_lead = std::max<u64>(window / 2, 1);
+    receive(0);
+    if (frames > remote_frames + max_lead) {
+        receive(timeout_ms);
+        if (frames > remote_frames + max_lead) { return StepResult(); }
+    }
+
+    if (rollback_time != NO_ROLLBACK) { replay(); }
+
+    take_snapshot(buttons);
+    gameboy.set_buttons(buttons);
+    StepResult result = run_current_frame();
+    if (result.frames != 0) { frames++; }
+
+    outgoing.frame = frames;
+    transport.send(outgoing);
+    outgoing.records.clear();
+
+    forget_before(snapshots.front().time);
+    return result;
+}
+
+void RollbackLink::receive(int timeout_ms) {
+    LinkBatch batch;
+    while (transport.receive(batch, timeout_ms)) {
+        remote_frames = std::max(remote_frames, batch.frame);
+        for (const LinkRecord& record : batch.records) { handle(record); }
+        timeout_ms = 0;
+    }
+}
+
+void RollbackLink::handle(const LinkRecord& record) {
+    /* What was guessed then has already been forgotten */
+    if (!snapshots.empty() && record.time < snapshots.front().time) {
+        log_warn("Link transfer arrived too late to roll back for; the two ends may disagree");
+        return;
+    }
+
+    switch (record.kind) {
+        case LinkRecordKind::Clocked: {
+            auto known = clocked_in.find(record.time);
+            if (known != clocked_in.end() && known->second == record.byte) { return; }
+
+            clocked_in[record.time] = record.byte;
+            roll_back_before(record.time);
+            return;
+        }
+
+        case LinkRecordKind::Cancelled:
+            if (clocked_in.erase(record.time) != 0) { roll_back_before(record.time); }
+            return;
+
+        case LinkRecordKind::Response: {
+            replies[record.time] = record.byte;
+            last_reply = record.byte;
+
+            auto guess = given.find(record.time);
+            if (guess != given.end() && guess->second != record.byte) { roll_back_before(record.time); }
+            return;
+        }
+    }
+}
+
+void RollbackLink::roll_back_before(const u64 time) {
+    /* Anything not yet run to is picked up as it's reached */
+    if (time > now()) { return; }
+
+    rollback_time = std::min(rollback_time, time);
+}
+
+auto RollbackLink::exchange(const u8 sent, const u64 scheduler_time) -> u8 {
+    u64 time = scheduler_time - start_time;
+
+    /* Clocked again after a rollback: only news if the byte changed */
+    auto previous = retracted.find(time);
+    bool already_sent = previous != retracted.end() && previous->second == sent;
+    if (previous != retracted.end()) { retracted.erase(previous); }
+    if (!already_sent) { outgoing.records.push_back({time, LinkRecordKind::Clocked, sent}); }
+    clocked_out[time] = sent;
+
+    auto reply = replies.find(time);
+    u8 received = reply != replies.end() ? reply->second : last_reply;
+    given[time] = received;
+    return received;
+}
+
+void RollbackLink::take_snapshot(const u8 buttons) {
+    snapshots.push_back({frames, now(), buttons, gameboy.save_state()});
+    while (snapshots.size() > window + 1) { snapshots.pop_front(); }
+}
+
+void RollbackLink::replay() {
+    u64 time = rollback_time;
+    rollback_time = NO_ROLLBACK;
+
+    /* The newest snapshot from before the moment in question */
+    auto from = std::find_if(snapshots.rbegin(), snapshots.rend(),
+                             [time](const Snapshot& snapshot) { return snapshot.time < time; });
+    if (from == snapshots.rend()) {
+        log_warn("Link transfer arrived too late to roll back for; the two ends may disagree");
+        from = std::prev(snapshots.rend());
+    }
+
+    u64 end_frame = frames;
+    std::vector<u8> buttons;
+    for (auto snapshot = from.base() - 1; snapshot != snapshots.end(); ++snapshot) {
+        buttons.push_back(snapshot->buttons);
+    }
+
+    Snapshot start = std::move(*from);
+    snapshots.erase(from.base() - 1, snapshots.end());
+
+    gameboy.load_state(start.state);
+    frames = start.frame;
+    applied_through = start.time;
+
+    for (auto sent = clocked_out.upper_bound(start.time); sent != clocked_out.end();) {
+        retracted[sent->first] = sent->second;
+        sent = clocked_out.erase(sent);
+    }
+    given.erase(given.upper_bound(start.time), given.end());
+
+    frame_filter_t filter = gameboy.frame_filter;
+    gameboy.set_frame_filter([](u64) { return false; });
+
+    for (u8 held : buttons) {
+        if (frames == end_frame) { break; }
+
+        take_snapshot(held);
+        gameboy.set_buttons(held);
+        StepResult result = run_current_frame();
+        if (result.stopped) { break; }
+
+        frames++;
+        replayed++;
+    }
+
+    /* The frame now starting was decided while replaying */
+    gameboy.set_frame_filter(filter);
+    gameboy.video.set_frame_drawn(gameboy.should_draw_frame());
+
+    for (const auto& [time_sent, byte] : retracted) {
+        outgoing.records.push_back({time_sent, LinkRecordKind::Cancelled, byte});
+    }
+    retracted.clear();
+}
+
+auto RollbackLink::run_current_frame() -> StepResult {
+    StepResult result;
+    audio.clear();
+    u64 frame_target = gameboy.frame_count() + 1;
+
+    while (true) {
+        auto next = clocked_in.upper_bound(applied_through);
+        u64 stop = next != clocked_in.end() ? start_time + next->first : Gameboy::NO_STOP;
+
+        add_step(result, gameboy.step(frame_target, stop), audio);
+        if (result.stopped) { break; }
+
+        if (next != clocked_in.end() && now() >= next->first) {
+            u8 reply = gameboy.serial.clocked_externally(next->second);
+            auto previous = replied.find(next->first);
+            if (previous == replied.end() || previous->second != reply) {
+                outgoing.records.push_back({next->first, LinkRecordKind::Response, reply});
+                replied[next->first] = reply;
+            }
+            applied_through = next->first;
+            continue;
+        }
+
+        if (gameboy.frame_count() >= frame_target) { break; }
+    }
+
+    finish_result(result, audio);
+    return result;
+}
+
+void RollbackLink::forget_before(const u64 time) {
+    for (std::map<u64, u8>* records : {&clocked_in, &replied, &clocked_out, &replies, &given}) {
+        records->erase(records->begin(), records->lower_bound(time));
+    }
+}
+
+auto RollbackLink::now() const -> u64 { return gameboy.scheduler.now() - start_time; }
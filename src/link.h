@@ -0,0 +1,210 @@
+#pragma once
+
+#include "definitions.h"
+#include "gameboy.h"
+#include "serial.h"
+
+#include <array>
+#include <deque>
+#include <map>
+#include <vector>
+
+/*
+ * Two instances in one process joined by a link cable, without running
+ * them cycle for cycle. Each runs on its own for as long as nothing it can
+ * see could come from the other: a transfer takes at least 1024 clocks
+ * between two DMGs (see MIN_SERIAL_TRANSFER_CYCLES_*), so neither is let
+ * further ahead than that, or than the other's transfer in flight. With a
+ * CGB on either end its fast clock can finish one in 16, so the lead is
+ * held to that and the two run in much finer lockstep. When a transfer
+ * finishes, the end which clocked it catches the other up to the same
+ * moment and the bytes are swapped, so the result is what cycle-accurate
+ * lockstep would give.
+ *
+ * Both instances must outlive the link, and are only to be run through it
+ * while it exists. Time is counted from when the link was made, so the two
+ * needn't have been powered on together.
+ */
+class LocalLink {
+public:
+    /* With lockstep set, neither is let more than a clock ahead of the
+     * other: slow, but a reference to check the result against */
+    LocalLink(Gameboy& first, Gameboy& second, bool lockstep = false);
+    ~LocalLink();
+
+    LocalLink(const LocalLink&) = delete;
+    auto operator=(const LocalLink&) -> LocalLink& = delete;
+
+    /* Runs until the first instance completes a frame, with the second
+     * kept alongside. One result per instance, valid until the next call,
+     * each gathered over however many steps that instance took */
+    auto run_frame() -> const std::array<StepResult, 2>&;
+    auto run_cycles(uint cycles) -> const std::array<StepResult, 2>&;
+
+private:
+    class End : public LinkCable {
+    public:
+        End(LocalLink& inLink, uint inSide) : link(inLink), side(inSide) {}
+        auto exchange(u8 sent, u64 time) -> u8 override;
+
+    private:
+        LocalLink& link;
+        uint side;
+    };
+
+    /* Runs the first instance to a frame or a time on the link's clock */
+    void run_until(u64 frame_target, u64 time_target);
+    void run_side(uint side, u64 frame_target, u64 until);
+
+    /* The link's clock starts at zero for both */
+    auto time(uint side) const -> u64;
+    auto local_time(uint side, u64 time) const -> u64;
+
+    auto exchange(uint side, u8 sent, u64 local_time) -> u8;
+
+    void begin_results();
+    void end_results();
+
+    std::array<Gameboy*, 2> gameboys;
+    std::array<End, 2> ends;
+    std::array<u64, 2> start_times;
+
+    /* How far the first instance may get ahead of the second, or the other
+     * way around; the shortest transfer either one can make */
+    u64 max_lead;
+
+    std::array<StepResult, 2> results;
+    std::array<std::vector<float>, 2> audio;
+};
+
+/* What crosses the network between two RollbackLinks */
+enum class LinkRecordKind : u8 {
+    /* The sender's transfer finished, shifting out 'byte' */
+    Clocked,
+    /* What the sender shifted out when clocked at 'time' */
+    Response,
+    /* A Clocked record for 'time' which a rollback undid */
+    Cancelled,
+};
+
+struct LinkRecord {
+    /* Clocks since the link was made, which both ends count alike */
+    u64 time;
+    LinkRecordKind kind;
+    u8 byte;
+};
+
+/* Everything one end produced over a frame. Sent every frame, even with
+ * no records, so 'frame' tells the other end how far along the sender is */
+struct LinkBatch {
+    u64 frame = 0;
+    std::vector<LinkRecord> records;
+};
+
+class LinkTransport {
+public:
+    virtual ~LinkTransport() = default;
+
+    virtual void send(const LinkBatch& batch) = 0;
+
+    /* Takes the next batch to arrive, waiting up to timeout_ms for one
+     * (not at all for 0). False if none came */
+    virtual auto receive(LinkBatch& batch, int timeout_ms) -> bool = 0;
+};
+
+/*
+ * One end of a link over a network, where waiting for the other side at
+ * every transfer would cost a round trip each time. Transfers go out in
+ * one batch per frame, and the local instance runs on without waiting,
+ * guessing that whatever it clocks gets the same reply as last time. Once
+ * the real reply, or a transfer clocked by the other end, arrives for a
+ * moment already run past, the instance goes back to its snapshot from
+ * before then and runs the frames since again, undrawn.
+ *
+ * Snapshots are kept for max_rollback_frames, which has to cover the round
+ * trip: a reply arriving later than that can't be rolled back for, and the
+ * ends drift apart. run_frame() also waits for the other end rather than
+ * get further ahead of it than half the window, so that a reply makes it
+ * back in time however the two ends' frames interleave. Both ends count
+ * time from when they were made, so they must be made at the same point
+ * of their games, e.g. at power-on or from the same save state.
+ */
+class RollbackLink : private LinkCable {
+public:
+    RollbackLink(Gameboy& inGameboy, LinkTransport& inTransport, uint max_rollback_frames = 8);
+    ~RollbackLink() override;
+
+    RollbackLink(const RollbackLink&) = delete;
+    auto operator=(const RollbackLink&) -> RollbackLink& = delete;
+
+    /* Runs a frame with the buttons held. If the other end has fallen too
+     * far behind, waits up to timeout_ms for it, then returns without
+     * running anything (frames is 0) for the caller to try again */
+    auto run_frame(u8 buttons, int timeout_ms = 16) -> StepResult;
+
+    /* Frames run since the link was made, and those the other end has
+     * reported running. Rolling back doesn't rewind Gameboy::frame_count(),
+     * so these are what to compare */
+    auto frame() const -> u64 { return frames; }
+
+    auto remote_frame() const -> u64 { return remote_frames; }
+
+    /* Frames run again after a misprediction, all told */
+    auto replayed_frames() const -> u64 { return replayed; }
+
+private:
+    struct Snapshot {
+        u64 frame;
+        u64 time;
+        /* Held as the frame ran, i.e. the input for the one after */
+        u8 buttons;
+        std::vector<u8> state;
+    };
+
+    auto exchange(u8 sent, u64 scheduler_time) -> u8 override;
+
+    void receive(int timeout_ms);
+    void handle(const LinkRecord& record);
+    void roll_back_before(u64 time);
+
+    void take_snapshot(u8 buttons);
+    void replay();
+    /* Runs the frame, applying transfers clocked from the other end */
+    auto run_current_frame() -> StepResult;
+    void forget_before(u64 time);
+
+    auto now() const -> u64;
+
+    Gameboy& gameboy;
+    LinkTransport& transport;
+    uint window;
+
+    u64 start_time;
+    u64 frames = 0;
+    u64 remote_frames = 0;
+
+    std::deque<Snapshot> snapshots;
+    /* Earliest moment already run past for which something new arrived */
+    u64 rollback_time = NO_ROLLBACK;
+
+    /* Transfers the other end clocked, and what this end replied */
+    std::map<u64, u8> clocked_in;
+    std::map<u64, u8> replied;
+    /* Incoming transfers up to here have been applied */
+    u64 applied_through = 0;
+
+    /* Transfers this end clocked: the byte sent, the reply if it has
+     * come, and what the instance was given, guessed or not */
+    std::map<u64, u8> clocked_out;
+    std::map<u64, u8> replies;
+    std::map<u64, u8> given;
+    /* Sent before a rollback and not yet clocked again since */
+    std::map<u64, u8> retracted;
+    u8 last_reply = 0xFF;
+
+    LinkBatch outgoing;
+    std::vector<float> audio;
+    u64 replayed = 0;
+
+    static constexpr u64 NO_ROLLBACK = ~0ull;
+};
@@ -0,0 +1,172 @@
+#include "link_socket.h"
+
+#include "util/log.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t BATCH_HEADER_SIZE = 12;
+const size_t RECORD_SIZE = 10;
+
+void put(std::vector<u8>& out, const u64 value, const uint bytes) {
+    for (uint i = 0; i < bytes; i++) { out.push_back(static_cast<u8>(value >> (8 * i))); }
+}
+
+auto get(const u8* in, const uint bytes) -> u64 {
+    u64 value = 0;
+    for (uint i = 0; i < bytes; i++) { value |= static_cast<u64>(in[i]) << (8 * i); }
+    return value;
+}
+
+void set_no_delay(const int socket_fd) {
+    int yes = 1;
+    setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+}
+
+} // namespace
+
+TcpLinkTransport::TcpLinkTransport(const int inSocket) : socket_fd(inSocket) { set_no_delay(socket_fd); }
+
+TcpLinkTransport::~TcpLinkTransport() { disconnect(); }
+
+auto TcpLinkTransport::listen(const u16 port) -> std::unique_ptr<TcpLinkTransport> {
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener == -1) { fatal_error("Cannot create socket: %s", strerror(errno)); }
+
+    int yes = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1
+        || ::listen(listener, 1) == -1) {
+        int error = errno;
+        close(listener);
+        fatal_error("Cannot listen on port %u: %s", port, strerror(error));
+    }
+
+    log_info("Waiting for the other end of the link on port %u", port);
+    int peer = accept(listener, nullptr, nullptr);
+    int error = errno;
+    close(listener);
+    if (peer == -1) { fatal_error("Cannot accept a link connection: %s", strerror(error)); }
+
+    return std::unique_ptr<TcpLinkTransport>(new TcpLinkTransport(peer));
+}
+
+auto TcpLinkTransport::connect(const std::string& host, const u16 port) -> std::unique_ptr<TcpLinkTransport> {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* addresses = nullptr;
+    std::string service = std::to_string(port);
+    int status = getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses);
+    if (status != 0) { fatal_error("Cannot resolve %s: %s", host.c_str(), gai_strerror(status)); }
+
+    int peer = -1;
+    for (addrinfo* address = addresses; address != nullptr && peer == -1; address = address->ai_next) {
+        peer = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (peer == -1) { continue; }
+
+        if (::connect(peer, address->ai_addr, address->ai_addrlen) == -1) {
+            close(peer);
+            peer = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+
+    if (peer == -1) { fatal_error("Cannot connect to %s:%u", host.c_str(), port); }
+
+    return std::unique_ptr<TcpLinkTransport>(new TcpLinkTransport(peer));
+}
+
+void TcpLinkTransport::send(const LinkBatch& batch) {
+    if (!connected()) { return; }
+
+    std::vector<u8> out;
+    out.reserve(BATCH_HEADER_SIZE + batch.records.size() * RECORD_SIZE);
+    put(out, batch.records.size(), 4);
+    put(out, batch.frame, 8);
+    for (const LinkRecord& record : batch.records) {
+        put(out, record.time, 8);
+        out.push_back(static_cast<u8>(record.kind));
+        out.push_back(record.byte);
+    }
+
+    size_t sent = 0;
+    while (sent < out.size()) {
+        ssize_t written = ::send(socket_fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+        if (written == -1 && errno == EINTR) { continue; }
+        if (written <= 0) {
+            log_warn("Link connection lost: %s", strerror(errno));
+            disconnect();
+            return;
+        }
+        sent += static_cast<size_t>(written);
+    }
+}
+
+auto TcpLinkTransport::receive(LinkBatch& batch, const int timeout_ms) -> bool {
+    if (take_batch(batch)) { return true; }
+
+    bool waited = false;
+    while (connected()) {
+        pollfd poll_fd = {socket_fd, POLLIN, 0};
+        int ready = poll(&poll_fd, 1, waited ? 0 : timeout_ms);
+        if (ready == -1 && errno == EINTR) { continue; }
+        if (ready <= 0) { return false; }
+        waited = true;
+
+        u8 chunk[4096];
+        ssize_t received = recv(socket_fd, chunk, sizeof(chunk), 0);
+        if (received == -1 && errno == EINTR) { continue; }
+        if (received <= 0) {
+            log_warn("Link connection closed by the other end");
+            disconnect();
+            return false;
+        }
+
+        input.insert(input.end(), chunk, chunk + received);
+        if (take_batch(batch)) { return true; }
+    }
+
+    return false;
+}
+
+auto TcpLinkTransport::take_batch(LinkBatch& batch) -> bool {
+    if (input.size() < BATCH_HEADER_SIZE) { return false; }
+
+    size_t count = static_cast<size_t>(get(input.data(), 4));
+    size_t size = BATCH_HEADER_SIZE + count * RECORD_SIZE;
+    if (input.size() < size) { return false; }
+
+    batch.frame = get(input.data() + 4, 8);
+    batch.records.clear();
+    for (size_t i = 0; i < count; i++) {
+        const u8* record = input.data() + BATCH_HEADER_SIZE + i * RECORD_SIZE;
+        batch.records.push_back({get(record, 8), static_cast<LinkRecordKind>(record[8]), record[9]});
+    }
+
+    input.erase(input.begin(), input.begin() + static_cast<std::ptrdiff_t>(size));
+    return true;
+}
+
+void TcpLinkTransport::disconnect() {
+    if (socket_fd == -1) { return; }
+
+    close(socket_fd);
+    socket_fd = -1;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "link.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * A LinkTransport over TCP, for RollbackLink. Nagle's algorithm is off, so
+ * each frame's batch goes out as soon as it's sent instead of waiting to be
+ * joined by the next. Each batch is its record count and frame (u32, u64),
+ * then ten bytes per record: time (u64), kind and byte, all little-endian.
+ */
+class TcpLinkTransport : public LinkTransport {
+public:
+    /* Waits for the other end to connect. Throws FatalError on failure */
+    static auto listen(u16 port) -> std::unique_ptr<TcpLinkTransport>;
+    static auto connect(const std::string& host, u16 port) -> std::unique_ptr<TcpLinkTransport>;
+
+    ~TcpLinkTransport() override;
+
+    TcpLinkTransport(const TcpLinkTransport&) = delete;
+    auto operator=(const TcpLinkTransport&) -> TcpLinkTransport& = delete;
+
+    void send(const LinkBatch& batch) override;
+    auto receive(LinkBatch& batch, int timeout_ms) -> bool override;
+
+    /* False once the other end has hung up, after which nothing more is
+     * sent or received */
+    auto connected() const -> bool { return socket_fd != -1; }
+
+private:
+    explicit TcpLinkTransport(int inSocket);
+
+    /* Takes a whole batch off the front of what's been read, if there is one */
+    auto take_batch(LinkBatch& batch) -> bool;
+    void disconnect();
+
+    int socket_fd;
+    std::vector<u8> input;
+};
@@ -6,19 +6,238 @@
 #include "timer.h"
 #include "util/log.h"
 #include "util/bitwise.h"
+#include "save_state.h"
 #include "cpu/cpu.h"
 #include "video/video.h"
 
+#include <algorithm>
+#include <cstring>
+
 MMU::MMU(Gameboy& inGb, Options& inOptions) :
     gb(inGb),
-    options(inOptions)
+    options(inOptions),
+    work_ram(inGb.memory.work_ram),
+    oam_ram(inGb.memory.oam_ram),
+    high_ram(inGb.memory.high_ram)
 {
-    work_ram = std::vector<u8>(0x8000);
-    oam_ram = std::vector<u8>(0xA0);
-    high_ram = std::vector<u8>(0x80);
+    map_pages();
+    gb.cartridge->register_bank_switch_callback([this]() { map_cartridge_pages(); });
+}
+
+void MMU::map_pages() {
+    read_pages.fill(nullptr);
+    write_pages.fill(nullptr);
+
+    map_cartridge_pages();
+    map_video_ram_pages();
+
+    /* Internal work RAM, and its mirror up to 0xFDFF. Pages holding
+     * decoded code stay write protected */
+    for (uint page = 0xC0; page <= 0xFD; page++) {
+        u8* memory = work_ram_page(page);
+        read_pages[page] = memory;
+        write_pages[page] = code_pages[(memory - work_ram.data()) / 0x100] ? nullptr : memory;
+        ram_pages[page] = memory;
+    }
+
+    /* OAM, IO and zero page RAM share pages with registers or unusable
+     * memory, so 0xFE and 0xFF are always handled by the slow path */
+
+    unmap_watched_pages();
+}
+
+/* VRAM is read directly, but written through Video so that it can track
+ * which decoded tiles go stale */
+void MMU::map_video_ram_pages() {
+    std::array<const u8*, 0x100>& pages = mapped_read_pages();
+    const u8* bank = &gb.video.video_ram[gb.video.vram_bank * VIDEO_RAM_BANK_SIZE];
+
+    for (uint page = 0x80; page <= 0x9F; page++) {
+        pages[page] = &bank[(page - 0x80) * 0x100];
+    }
+}
+
+/* 0xC000-0xCFFF is always bank 0, and 0xE000-0xFDFF echoes 0xC000-0xDDFF */
+auto MMU::work_ram_page(const uint page) const -> u8* {
+    uint offset = ((page - 0xC0) % 0x20) * 0x100;
+    if (offset >= WORK_RAM_BANK_SIZE) { offset += (work_ram_bank - 1) * WORK_RAM_BANK_SIZE; }
+    return &work_ram[offset];
+}
+
+void MMU::map_work_ram_bank() {
+    std::array<const u8*, 0x100>& reads = mapped_read_pages();
+    std::array<u8*, 0x100>& writes = mapped_write_pages();
+
+    for (uint page = 0xD0; page <= 0xFD; page++) {
+        if (page >= 0xE0 && page < 0xF0) { continue; }
+
+        u8* memory = work_ram_page(page);
+        reads[page] = memory;
+        ram_pages[page] = memory;
+
+        bool protect = code_pages[(memory - work_ram.data()) / 0x100] || watched_pages[page];
+        writes[page] = protect ? nullptr : memory;
+    }
+}
+
+namespace {
+struct MMUState {
+    u64 dma_end;
+    u16 vram_dma_source;
+    u16 vram_dma_destination;
+    u8 disable_boot_rom_switch;
+    u8 dma_active;
+    u8 work_ram_bank;
+    u8 vram_dma_length;
+    u8 hblank_dma_active;
+    u8 unused[7];
+};
+} // namespace
+
+void MMU::save_state(StateWriter& writer) const {
+    MMUState state = {};
+    state.dma_end = dma_end;
+    state.disable_boot_rom_switch = disable_boot_rom_switch.value();
+    state.dma_active = dma_active;
+    state.work_ram_bank = static_cast<u8>(work_ram_bank);
+    state.vram_dma_source = vram_dma_source;
+    state.vram_dma_destination = vram_dma_destination;
+    state.vram_dma_length = vram_dma_length;
+    state.hblank_dma_active = hblank_dma_active;
+    writer.write(StateSection::MMU, state);
+
+    writer.write_bytes(StateSection::WorkRam, work_ram.data(), static_cast<uint>(work_ram.size()));
+    writer.write_bytes(StateSection::OamRam, oam_ram.data(), static_cast<uint>(oam_ram.size()));
+    writer.write_bytes(StateSection::HighRam, high_ram.data(), static_cast<uint>(high_ram.size()));
+}
+
+void MMU::load_state(StateReader& reader) {
+    MMUState state;
+    reader.read(StateSection::MMU, state);
+    disable_boot_rom_switch.set(state.disable_boot_rom_switch);
+    work_ram_bank = state.work_ram_bank;
+    vram_dma_source = state.vram_dma_source;
+    vram_dma_destination = state.vram_dma_destination;
+    vram_dma_length = state.vram_dma_length;
+    hblank_dma_active = state.hblank_dma_active != 0;
+
+    load_work_ram(reader.read_view(StateSection::WorkRam, static_cast<uint>(work_ram.size())));
+    reader.read_bytes(StateSection::OamRam, oam_ram.data(), static_cast<uint>(oam_ram.size()));
+    reader.read_bytes(StateSection::HighRam, high_ram.data(), static_cast<uint>(high_ram.size()));
+
+    dma_active = false;
+    map_pages();
+
+    dma_end = state.dma_end;
+    if (state.dma_active != 0) { lock_bus(); }
+}
+
+/* Only bytes which differ are written, and any code decoded from them is
+ * dropped as a write would drop it, so the rest of the block cache is
+ * still good after e.g. run-ahead restores its snapshot */
+void MMU::load_work_ram(const u8* saved) {
+    for (uint page = 0; page < code_pages.size(); page++) {
+        u8* memory = &work_ram[page * 0x100];
+        const u8* source = saved + page * 0x100;
+        if (std::memcmp(memory, source, 0x100) == 0) { continue; }
+
+        if (!code_pages[page]) {
+            std::memcpy(memory, source, 0x100);
+            continue;
+        }
+
+        for (uint offset = 0; offset < 0x100; offset++) {
+            if (memory[offset] == source[offset]) { continue; }
+
+            memory[offset] = source[offset];
+            if (code_pages[page] && !gb.cpu.invalidate_code(memory, static_cast<u8>(offset))) {
+                code_pages[page] = false;
+            }
+        }
+    }
 }
 
-auto MMU::read(const Address& address) const -> u8 {
+auto MMU::peek(const u16 address, u8* bytes, const uint size) const -> uint {
+    for (uint i = 0; i < size; i++) {
+        auto at = static_cast<u16>(address + i);
+        const u8* page = read_pages[at >> 8];
+        if (page == nullptr) { return i; }
+        bytes[i] = page[at & 0xFF];
+    }
+    return size;
+}
+
+void MMU::protect_code_page(const u8 page) {
+    const u8* memory = ram_pages[page];
+    if (memory == nullptr) { return; }
+    code_pages[(memory - work_ram.data()) / 0x100] = true;
+
+    /* Work RAM is visible through its echo too */
+    std::array<u8*, 0x100>& pages = mapped_write_pages();
+    for (uint other = 0; other < 0x100; other++) {
+        if (ram_pages[other] == memory) { pages[other] = nullptr; }
+    }
+}
+
+void MMU::unprotect_code_page(const u8 page) {
+    const u8* memory = ram_pages[page];
+    code_pages[(memory - work_ram.data()) / 0x100] = false;
+
+    std::array<u8*, 0x100>& pages = mapped_write_pages();
+    for (uint other = 0; other < 0x100; other++) {
+        if (ram_pages[other] == memory && !watched_pages[other]) { pages[other] = ram_pages[other]; }
+    }
+}
+
+void MMU::watch_writes(const u8 page, const bool watched) {
+    if (watched_pages[page] == watched) { return; }
+    watched_pages[page] = watched;
+
+    /* An unwatched RAM page stays on the slow path until a write finds no
+     * cached code in it, as it may have been protected meanwhile */
+    if (watched) {
+        mapped_write_pages()[page] = nullptr;
+    } else if (page >= 0xA0 && page <= 0xBF) {
+        mapped_write_pages()[page] = gb.cartridge->write_page(page);
+    }
+}
+
+void MMU::unmap_watched_pages() {
+    std::array<u8*, 0x100>& pages = mapped_write_pages();
+    for (uint page = 0; page < 0x100; page++) {
+        if (watched_pages[page]) { pages[page] = nullptr; }
+    }
+}
+
+void MMU::map_cartridge_pages() {
+    /* Writes to ROM are MBC register writes and always take the slow path */
+    for (uint page = 0x00; page <= 0x7F; page++) {
+        read_pages[page] = gb.cartridge->read_page(static_cast<u8>(page));
+    }
+
+    for (uint page = 0xA0; page <= 0xBF; page++) {
+        read_pages[page] = gb.cartridge->read_page(static_cast<u8>(page));
+        write_pages[page] = gb.cartridge->write_page(static_cast<u8>(page));
+    }
+
+    if (boot_rom_active()) { read_pages[0x00] = bootDMG.data(); }
+
+    unmap_watched_pages();
+}
+
+#ifdef GBEMU_PROFILER
+void MMU::count_access(const u16 address, const bool write) const {
+    if (write) {
+        gb.profiler.count_write(address);
+    } else {
+        gb.profiler.count_read(address);
+    }
+}
+#endif
+
+auto MMU::slow_read(const Address& address) -> u8 {
+    if (dma_active && dma_blocks(address)) { return 0xFF; }
+
     if (address.in_range(0x0, 0x7FFF)) {
         if (address.in_range(0x0, 0xFF) && boot_rom_active()) {
             return bootDMG[address.value()];
@@ -38,7 +257,7 @@ auto MMU::read(const Address& address) const -> u8 {
 
     /* Internal work RAM */
     if (address.in_range(0xC000, 0xDFFF)) {
-        return work_ram.at(address.value() - 0xC000);
+        return work_ram_page(address.value() >> 8)[address.value() & 0xFF];
     }
 
     if (address.in_range(0xE000, 0xFDFF)) {
@@ -58,6 +277,7 @@ auto MMU::read(const Address& address) const -> u8 {
 
     /* Mapped IO */
     if (address.in_range(0xFF00, 0xFF7F)) {
+        sync_io(address);
         return read_io(address);
     }
 
@@ -74,6 +294,18 @@ auto MMU::read(const Address& address) const -> u8 {
     fatal_error("Attempted to read from unmapped memory address 0x%X", address.value());
 }
 
+void MMU::sync_io(const Address& address) const {
+    if (address.in_range(0xFF04, 0xFF07)) {
+        gb.sync(EventType::Timer);
+    } else if (address.in_range(0xFF01, 0xFF02)) {
+        gb.sync(EventType::Serial);
+    } else if (address.in_range(0xFF10, 0xFF3F)) {
+        gb.sync(EventType::Audio);
+    } else if (address.in_range(0xFF40, 0xFF4B)) {
+        gb.sync(EventType::Video);
+    }
+}
+
 auto MMU::read_io(const Address& address) const -> u8 {
     // Route APU register reads to audio
     if (address.value() >= 0xFF10 && address.value() <= 0xFF3F) {
@@ -87,8 +319,7 @@ auto MMU::read_io(const Address& address) const -> u8 {
             return gb.serial.read();
 
         case 0xFF02:
-            log_unimplemented("Attempted to read serial transfer control");
-            return 0xFF;
+            return gb.serial.read_control();
 
         case 0xFF03:
             return unmapped_io_read(address);
@@ -197,7 +428,8 @@ auto MMU::read_io(const Address& address) const -> u8 {
             return gb.video.control_byte;
 
         case 0xFF41:
-            return gb.video.lcd_status.value();
+            /* Bit 7 is unused, and reads as set */
+            return gb.video.lcd_status.value() | 0x80;
 
         case 0xFF42:
             return gb.video.scroll_y.value();
@@ -234,37 +466,34 @@ auto MMU::read_io(const Address& address) const -> u8 {
         case 0xFF4C:
             return 0xFF;
 
+        /* KEY1: the current speed, and whether a switch is armed */
         case 0xFF4D:
-            log_unimplemented("Attempted to read from 'Prepare Speed Switch' register");
-            return 0x0;
+            if (!gb.cgb) { return unmapped_io_read(address); }
+            return static_cast<u8>(0x7E | (gb.double_speed ? 0x80 : 0) | (gb.speed_switch_armed ? 0x1 : 0));
 
         case 0xFF4E:
-        case 0xFF4F:
             return unmapped_io_read(address);
 
+        /* VBK: VRAM bank */
+        case 0xFF4F:
+            if (!gb.cgb) { return unmapped_io_read(address); }
+            return static_cast<u8>(0xFE | gb.video.vram_bank);
+
         /* Disable boot rom switch */
         case 0xFF50:
             return disable_boot_rom_switch.value();
 
+        /* VRAM DMA source and destination, which are write-only */
         case 0xFF51:
-            log_unimplemented("Attempted to read from VRAM DMA Source (hi)");
-            return 0xFF;
-
         case 0xFF52:
-            log_unimplemented("Attempted to read from VRAM DMA Source (lo)");
-            return 0xFF;
-
         case 0xFF53:
-            log_unimplemented("Attempted to read from VRAM DMA Destination (hi)");
-            return 0xFF;
-
         case 0xFF54:
-            log_unimplemented("Attempted to read from VRAM DMA Destination (lo)");
             return 0xFF;
 
+        /* HDMA5: VRAM DMA length/mode/start */
         case 0xFF55:
-            log_unimplemented("Attempted to read from VRAM DMA Length/Mode/Start");
-            return 0xFF;
+            if (!gb.cgb) { return unmapped_io_read(address); }
+            return vram_dma_status();
 
         case 0xFF56:
             log_unimplemented("Attempted to read from infrared port");
@@ -289,40 +518,40 @@ auto MMU::read_io(const Address& address) const -> u8 {
         case 0xFF67:
             return unmapped_io_read(address);
 
-        /* TODO: Background color palette spec/index */
+        /* Background color palette spec/index */
         case 0xFF68:
-            log_unimplemented("Attempted to read from CGB background color palette spec/index");
-            return 0xFF;
+            if (!gb.cgb) { return unmapped_io_read(address); }
+            return gb.video.bg_palettes.read_index();
 
-        /* TODO: Background color palette data */
+        /* Background color palette data */
         case 0xFF69:
-            log_unimplemented("Attempted to read from CGB background color data");
-            return 0xFF;
+            if (!gb.cgb) { return unmapped_io_read(address); }
+            return gb.video.bg_palettes.read_data();
 
-        /* TODO: OBJ color palette spec/index */
+        /* OBJ color palette spec/index */
         case 0xFF6A:
-            log_unimplemented("Attempted to read from CGB OBJ color palette spec/index");
-            return 0xFF;
+            if (!gb.cgb) { return unmapped_io_read(address); }
+            return gb.video.sprite_palettes.read_index();
 
-        /* TODO: OBJ color palette data */
+        /* OBJ color palette data */
         case 0xFF6B:
-            log_unimplemented("Attempted to read from CGB OBJ color palette data");
-            return 0xFF;
+            if (!gb.cgb) { return unmapped_io_read(address); }
+            return gb.video.sprite_palettes.read_data();
 
-        /* TODO: Object priority mode */
+        /* Object priority mode */
         case 0xFF6C:
-            log_unimplemented("Attempted to read from CGB object priority mode");
-            return 0xFF;
+            if (!gb.cgb) { return unmapped_io_read(address); }
+            return static_cast<u8>(0xFE | gb.video.object_priority);
 
         case 0xFF6D:
         case 0xFF6E:
         case 0xFF6F:
             return unmapped_io_read(address);
 
-        /* TODO: CGB WRAM bank */
+        /* SVBK: CGB WRAM bank */
         case 0xFF70:
-            log_unimplemented("Attempted to read from CGB WRAM bank");
-            return 0xFF;
+            if (!gb.cgb) { return unmapped_io_read(address); }
+            return static_cast<u8>(0xF8 | work_ram_bank);
 
         /* TODO: Some undocumented registers in this range */
         case 0xFF71:
@@ -352,7 +581,22 @@ auto MMU::unmapped_io_read(const Address& address) const -> u8 {
     return 0xFF;
 }
 
-void MMU::write(const Address& address, const u8 byte) {
+void MMU::slow_write(const Address& address, const u8 byte) {
+    if (dma_active && dma_blocks(address)) { return; }
+
+    auto page = static_cast<u8>(address.value() >> 8);
+    if (watched_pages[page]) { gb.debugger.memory_written(address.value(), byte); }
+
+    /* A directly mapped RAM page only gets here if it holds decoded code,
+     * or is being watched */
+    if (ram_pages[page] != nullptr) {
+        auto offset = static_cast<u8>(address.value() & 0xFF);
+        ram_pages[page][offset] = byte;
+
+        if (!gb.cpu.invalidate_code(ram_pages[page], offset)) { unprotect_code_page(page); }
+        return;
+    }
+
     if (address.in_range(0x0000, 0x7FFF)) {
         gb.cartridge->write(address, byte);
         return;
@@ -372,19 +616,19 @@ void MMU::write(const Address& address, const u8 byte) {
 
     /* Internal work RAM */
     if (address.in_range(0xC000, 0xDFFF)) {
-        work_ram.at(address.value() - 0xC000) = byte;
+        work_ram_page(address.value() >> 8)[address.value() & 0xFF] = byte;
         return;
     }
 
     /* Mirrored RAM */
     if (address.in_range(0xE000, 0xFDFF)) {
-        log_warn("Attempting to write to mirrored work RAM");
         write(address.value() - 0x2000, byte);
         return;
     }
 
     /* OAM */
     if (address.in_range(0xFE00, 0xFE9F)) {
+        gb.video.catch_up_memory();
         oam_ram.at(address.value() - 0xFE00) = byte;
         return;
     }
@@ -396,7 +640,10 @@ void MMU::write(const Address& address, const u8 byte) {
 
     /* Mapped IO */
     if (address.in_range(0xFF00, 0xFF7F)) {
+        sync_io(address);
         write_io(address, byte);
+        /* Syncing again reschedules the component from its new state */
+        sync_io(address);
         return;
     }
 
@@ -421,6 +668,11 @@ void MMU::write_io(const Address& address, const u8 byte) {
         gb.audio.write_register(address.value(), byte);
         return;
     }
+    /* Anything the line being drawn depends on, so the pixels already
+     * out are drawn the old way (see Video::catch_up_line) */
+    if (address.in_range(0xFF40, 0xFF4B)) {
+        gb.video.catch_up_line();
+    }
     switch (address.value()) {
         case 0xFF00:
             gb.input.write(byte);
@@ -432,7 +684,7 @@ void MMU::write_io(const Address& address, const u8 byte) {
             return;
 
         case 0xFF02:
-            /* Serial data transfer (SB) */
+            /* Serial transfer control (SC) */
             gb.serial.write_control(byte);
             return;
 
@@ -441,6 +693,11 @@ void MMU::write_io(const Address& address, const u8 byte) {
 
         case 0xFF04:
             gb.timer.reset_divider();
+            /* The APU's frame sequencer runs off DIV as well. It's brought up
+             * to now first, then synced again to reschedule its next step */
+            gb.sync(EventType::Audio);
+            gb.audio.reset_frame_sequencer();
+            gb.sync(EventType::Audio);
             return;
 
         case 0xFF05:
@@ -553,7 +810,7 @@ void MMU::write_io(const Address& address, const u8 byte) {
             return;
 
         case 0xFF41:
-            gb.video.lcd_status.set(byte);
+            gb.video.write_status(byte);
             return;
 
         /* Vertical Scroll Register */
@@ -573,7 +830,7 @@ void MMU::write_io(const Address& address, const u8 byte) {
             return;
 
         case 0xFF45:
-            gb.video.ly_compare.set(byte);
+            gb.video.write_ly_compare(byte);
             return;
 
         case 0xFF46:
@@ -607,39 +864,61 @@ void MMU::write_io(const Address& address, const u8 byte) {
         case 0xFF4C:
             return;
 
+        /* KEY1: arms a speed switch for the next STOP */
         case 0xFF4D:
-            log_unimplemented("Attempted to write to 'Prepare Speed Switch' register");
+            if (!gb.cgb) { return unmapped_io_write(address, byte); }
+            gb.speed_switch_armed = (byte & 0x1) != 0;
             return;
 
         case 0xFF4E:
-        case 0xFF4F:
             return unmapped_io_write(address, byte);
 
+        /* VBK: VRAM bank */
+        case 0xFF4F:
+            if (!gb.cgb) { return unmapped_io_write(address, byte); }
+            gb.video.vram_bank = byte & 0x1;
+            map_video_ram_pages();
+            return;
+
         /* Disable boot rom switch */
         case 0xFF50:
+            /* Once off, the boot ROM stays off */
+            if (!boot_rom_active()) { return; }
             disable_boot_rom_switch.set(byte);
-            global_logger.enable_tracing();
+            if (boot_rom_active()) { return; }
+            map_cartridge_pages();
+            if (gb.cgb) { gb.cpu.set_cgb_boot_registers(); }
+            current_logger().enable_tracing();
+            if (options.trace || !options.trace_file.empty()) { gb.start_trace(options.trace_file); }
             log_debug("Boot rom was disabled");
             return;
 
+        /* VRAM DMA source, in 16 byte steps */
         case 0xFF51:
-            log_unimplemented("Attempted to write to VRAM DMA Source (hi)");
+            if (!gb.cgb) { return unmapped_io_write(address, byte); }
+            vram_dma_source = static_cast<u16>(byte << 8 | (vram_dma_source & 0xFF));
             return;
 
         case 0xFF52:
-            log_unimplemented("Attempted to write to VRAM DMA Source (lo)");
+            if (!gb.cgb) { return unmapped_io_write(address, byte); }
+            vram_dma_source = static_cast<u16>((vram_dma_source & 0xFF00) | (byte & 0xF0));
             return;
 
+        /* VRAM DMA destination, as an offset into VRAM in 16 byte steps */
         case 0xFF53:
-            log_unimplemented("Attempted to write to VRAM DMA Destination (hi)");
+            if (!gb.cgb) { return unmapped_io_write(address, byte); }
+            vram_dma_destination = static_cast<u16>((byte & 0x1F) << 8 | (vram_dma_destination & 0xFF));
             return;
 
         case 0xFF54:
-            log_unimplemented("Attempted to write to VRAM DMA Destination (lo)");
+            if (!gb.cgb) { return unmapped_io_write(address, byte); }
+            vram_dma_destination = static_cast<u16>((vram_dma_destination & 0x1F00) | (byte & 0xF0));
             return;
 
+        /* HDMA5: VRAM DMA length/mode/start */
         case 0xFF55:
-            log_unimplemented("Attempted to write to VRAM DMA Length/Mode/Start");
+            if (!gb.cgb) { return unmapped_io_write(address, byte); }
+            start_vram_dma(byte);
             return;
 
         case 0xFF56:
@@ -665,29 +944,34 @@ void MMU::write_io(const Address& address, const u8 byte) {
         case 0xFF67:
             return unmapped_io_write(address, byte);
 
-        /* TODO: Background color palette spec/index */
+        /* Background color palette spec/index */
         case 0xFF68:
-            log_unimplemented("Attempted to write to CGB background color palette spec/index");
+            if (!gb.cgb) { return unmapped_io_write(address, byte); }
+            gb.video.bg_palettes.write_index(byte);
             return;
 
-        /* TODO: Background color palette data */
+        /* Background color palette data */
         case 0xFF69:
-            log_unimplemented("Attempted to write to CGB background color data");
+            if (!gb.cgb) { return unmapped_io_write(address, byte); }
+            gb.video.bg_palettes.write_data(byte);
             return;
 
-        /* TODO: OBJ color palette spec/index */
+        /* OBJ color palette spec/index */
         case 0xFF6A:
-            log_unimplemented("Attempted to write to CGB OBJ color palette spec/index");
+            if (!gb.cgb) { return unmapped_io_write(address, byte); }
+            gb.video.sprite_palettes.write_index(byte);
             return;
 
-        /* TODO: OBJ color palette data */
+        /* OBJ color palette data */
         case 0xFF6B:
-            log_unimplemented("Attempted to write to CGB OBJ color palette data");
+            if (!gb.cgb) { return unmapped_io_write(address, byte); }
+            gb.video.sprite_palettes.write_data(byte);
             return;
 
-        /* TODO: Object priority mode */
+        /* Object priority mode */
         case 0xFF6C:
-            log_unimplemented("Attempted to write to CGB object priority mode");
+            if (!gb.cgb) { return unmapped_io_write(address, byte); }
+            gb.video.object_priority = byte & 0x1;
             return;
 
         case 0xFF6D:
@@ -695,9 +979,11 @@ void MMU::write_io(const Address& address, const u8 byte) {
         case 0xFF6F:
             return unmapped_io_write(address, byte);
 
-        /* TODO: CGB WRAM bank */
+        /* SVBK: CGB WRAM bank, where 0 selects bank 1 */
         case 0xFF70:
-            log_unimplemented("Attempted to write to CGB WRAM bank");
+            if (!gb.cgb) { return unmapped_io_write(address, byte); }
+            work_ram_bank = std::max(byte & 0x7u, 1u);
+            map_work_ram_bank();
             return;
 
         /* TODO: Some undocumented registers in this range */
@@ -727,16 +1013,107 @@ void MMU::unmapped_io_write(const Address& address, const u8 byte) {
     log_warn("Attempting to write to unused IO address 0x%x - 0x%x", address.value(), byte);
 }
 
-auto MMU::boot_rom_active() const -> bool { return read(0xFF50) != 0x1; }
+auto MMU::boot_rom_active() const -> bool { return disable_boot_rom_switch.value() != 0x1; }
+
+/* Machine cycles the CPU is kept off the bus for by an OAM DMA */
+const uint DMA_CYCLES = 160;
 
 void MMU::dma_transfer(const u8 byte) {
-    Address start_address = byte * 0x100;
+    /* Sources past work RAM read its echo, on up through 0xFFFF */
+    u8 source_page = byte >= 0xE0 ? static_cast<u8>(byte - 0x20) : byte;
+
+    if (const u8* source = read_pages[source_page]) {
+        std::memcpy(oam_ram.data(), source, oam_ram.size());
+    } else {
+        for (uint i = 0; i < oam_ram.size(); i++) {
+            oam_ram[i] = slow_read(Address(static_cast<u16>(source_page << 8 | i)));
+        }
+    }
+
+    /* FF46 is out of reach during a transfer, so one can't already be running */
+    lock_bus();
+    dma_end = gb.scheduler.now() + (gb.double_speed ? DMA_CYCLES / 2 : DMA_CYCLES);
+}
+
+void MMU::lock_bus() {
+    dma_read_pages = read_pages;
+    dma_write_pages = write_pages;
+    read_pages.fill(nullptr);
+    write_pages.fill(nullptr);
+    dma_active = true;
+}
+
+void MMU::finish_dma() {
+    dma_active = false;
+    read_pages = dma_read_pages;
+    write_pages = dma_write_pages;
+}
+
+/* HRAM and IE stay reachable; everything else is on the buses the DMA has */
+auto MMU::dma_blocks(const Address& address) -> bool {
+    if (gb.scheduler.now() >= dma_end) {
+        finish_dma();
+        return false;
+    }
+    return address.value() < 0xFF80;
+}
+
+/* Clocks the CPU is stalled for per block of 16 bytes, at either speed */
+const uint VRAM_DMA_BLOCK_CYCLES = 8;
+const uint VRAM_DMA_BLOCK_BYTES = 0x10;
+
+void MMU::start_vram_dma(const u8 byte) {
+    /* Clearing bit 7 during an HBlank transfer stops it */
+    if (hblank_dma_active && !bitwise::check_bit(byte, 7)) {
+        hblank_dma_active = false;
+        return;
+    }
 
-    for (u8 i = 0x0; i <= 0x9F; i++) {
-        Address from_address = start_address.value() + i;
-        Address to_address = 0xFE00 + i;
+    vram_dma_length = byte & 0x7F;
 
-        u8 value_at_address = read(from_address);
-        write(to_address, value_at_address);
+    if (bitwise::check_bit(byte, 7)) {
+        hblank_dma_active = true;
+        return;
+    }
+
+    copy_vram_blocks(vram_dma_length + 1u);
+    vram_dma_length = 0x7F;
+}
+
+void MMU::hblank_started() {
+    if (!hblank_dma_active) { return; }
+
+    copy_vram_blocks(1);
+    if (vram_dma_length-- == 0) {
+        hblank_dma_active = false;
+        vram_dma_length = 0x7F;
     }
 }
+
+/* Bit 7 is clear while an HBlank transfer is still going; the rest are the
+ * blocks to go, less one, which is 0x7F once a transfer is complete */
+auto MMU::vram_dma_status() const -> u8 {
+    return static_cast<u8>((hblank_dma_active ? 0x00 : 0x80) | vram_dma_length);
+}
+
+void MMU::copy_vram_blocks(const uint blocks) {
+    std::array<u8, VRAM_DMA_BLOCK_BYTES> block;
+
+    for (uint i = 0; i < blocks; i++) {
+        /* A block never crosses a page, so mapped sources are one copy */
+        if (const u8* page = read_pages[vram_dma_source >> 8]) {
+            std::memcpy(block.data(), page + (vram_dma_source & 0xFF), block.size());
+        } else {
+            for (uint byte = 0; byte < block.size(); byte++) {
+                block[byte] = slow_read(Address(static_cast<u16>(vram_dma_source + byte)));
+            }
+        }
+
+        gb.video.write_block(vram_dma_destination, block.data(), static_cast<uint>(block.size()));
+
+        vram_dma_source = static_cast<u16>(vram_dma_source + VRAM_DMA_BLOCK_BYTES);
+        vram_dma_destination = static_cast<u16>((vram_dma_destination + VRAM_DMA_BLOCK_BYTES) & 0x1FF0);
+    }
+
+    gb.stall_cpu(blocks * VRAM_DMA_BLOCK_CYCLES);
+}
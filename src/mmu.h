@@ -1,40 +1,176 @@
 #pragma once
 
 #include "address.h"
+#include "guest_memory.h"
 #include "options.h"
 #include "cartridge/cartridge.h"
 
+#include <array>
 #include <vector>
 #include <memory>
 
 class Gameboy;
+class StateWriter;
+class StateReader;
 
 class MMU {
 public:
     MMU(Gameboy& inGb, Options& options);
 
-    auto read(const Address& address) const -> u8;
+    /* Not const: reads bring IO registers up to date, and can be what
+     * notices that an OAM DMA has finished */
+    auto read(const Address& address) -> u8;
     void write(const Address& address, u8 byte);
 
+    /* Host memory directly mapped at a page, or nullptr for slow-path pages */
+    auto page_memory(u8 page) const -> const u8* { return read_pages[page]; }
+
+    /* Copies up to 'size' bytes from 'address' on, as far as they're in
+     * directly mapped memory. Unlike read() it has no side effects, and
+     * neither watchpoints nor the profiler see it. Returns the bytes copied */
+    auto peek(u16 address, u8* bytes, uint size) const -> uint;
+
+    /* Sends writes to RAM backing this page through slow_write, so the CPU
+     * can drop blocks decoded from it when it's modified */
+    void protect_code_page(u8 page);
+
+    /* Sends every write to a page through slow_write and on to the
+     * debugger, for watchpoints. Pages are as the CPU addresses them, so
+     * the echo of a watched work RAM page isn't watched */
+    void watch_writes(u8 page, bool watched);
+
+    /* Called by Video as each visible line enters HBlank, for the CGB's
+     * HBlank DMA */
+    void hblank_started();
+
+    /* Work RAM, OAM, HRAM, the boot ROM switch and the CGB's banking and
+     * VRAM DMA registers. Loading remaps every page, which also lifts any
+     * code write protection */
+    void save_state(StateWriter& writer) const;
+    void load_state(StateReader& reader);
+
 private:
+    void unprotect_code_page(u8 page);
+    void load_work_ram(const u8* saved);
+
     auto boot_rom_active() const -> bool;
 
+#ifdef GBEMU_PROFILER
+    /* Out of line, as the profiler lives in the Gameboy */
+    void count_access(u16 address, bool write) const;
+#endif
+
+    /* Accesses to pages without a direct mapping: IO, OAM, HRAM, MBC
+     * registers and anything the cartridge does not expose directly */
+    auto slow_read(const Address& address) -> u8;
+    void slow_write(const Address& address, u8 byte);
+
+    void map_pages();
+    void map_cartridge_pages();
+    void unmap_watched_pages();
+
+    /* The CGB's banked halves of VRAM (VBK) and of work RAM (SVBK) */
+    void map_video_ram_pages();
+    void map_work_ram_bank();
+    auto work_ram_page(uint page) const -> u8*;
+
+    /* Catches up whichever component owns an IO register before it is accessed */
+    void sync_io(const Address& address) const;
+
     auto read_io(const Address& address) const -> u8;
     void write_io(const Address& address, u8 byte);
 
     auto unmapped_io_read(const Address& address) const -> u8;
     void unmapped_io_write(const Address& address, u8 byte);
 
+    /* OAM DMA copies all 160 bytes at once, then leaves the CPU with only
+     * HRAM for as long as the transfer takes. Both page tables are emptied
+     * meanwhile, so every access takes the slow path, which checks for the
+     * end of the transfer */
     void dma_transfer(u8 byte);
+    void lock_bus();
+    void finish_dma();
+    auto dma_blocks(const Address& address) -> bool;
+
+    /* CGB VRAM DMA: a general purpose transfer copies everything at once,
+     * an HBlank one a block of 16 bytes per line. The CPU is stalled for
+     * as long as each would take */
+    void start_vram_dma(u8 byte);
+    void copy_vram_blocks(uint blocks);
+    auto vram_dma_status() const -> u8;
+
+    /* The page tables to edit mappings in: put aside during a DMA */
+    auto mapped_read_pages() -> std::array<const u8*, 0x100>& {
+        return dma_active ? dma_read_pages : read_pages;
+    }
+    auto mapped_write_pages() -> std::array<u8*, 0x100>& {
+        return dma_active ? dma_write_pages : write_pages;
+    }
 
     Gameboy& gb;
     Options& options;
 
-    std::vector<u8> work_ram;
-    std::vector<u8> oam_ram;
-    std::vector<u8> high_ram;
+    /* In the instance's GuestMemory */
+    std::array<u8, WORK_RAM_SIZE>& work_ram;
+    std::array<u8, OAM_RAM_SIZE>& oam_ram;
+    std::array<u8, HIGH_RAM_SIZE>& high_ram;
 
     ByteRegister disable_boot_rom_switch;
 
+    /* One entry per 256-byte page (indexed by the high byte of the address),
+     * pointing at the start of the backing memory for reads and writes.
+     * nullptr sends the access through slow_read/slow_write. */
+    std::array<const u8*, 0x100> read_pages = {};
+    std::array<u8*, 0x100> write_pages = {};
+
+    /* The fixed VRAM and work RAM mappings, kept so write-protected code
+     * pages can be restored */
+    std::array<u8*, 0x100> ram_pages = {};
+
+    /* Pages the debugger watches writes to, by address as the CPU sees it */
+    std::array<bool, 0x100> watched_pages = {};
+
+    /* Pages of work RAM, by offset, which hold decoded code. They stay
+     * write protected wherever a bank switch maps them */
+    std::array<bool, WORK_RAM_SIZE / 0x100> code_pages = {};
+
+    /* SVBK: the bank at 0xD000-0xDFFF, 1-7. Always 1 on a DMG */
+    uint work_ram_bank = 1;
+
+    /* HDMA1-HDMA5. The length is in blocks of 16 bytes, less one */
+    u16 vram_dma_source = 0;
+    u16 vram_dma_destination = 0;
+    u8 vram_dma_length = 0;
+    bool hblank_dma_active = false;
+
+    bool dma_active = false;
+    u64 dma_end = 0;
+    std::array<const u8*, 0x100> dma_read_pages = {};
+    std::array<u8*, 0x100> dma_write_pages = {};
+
     friend class Debugger;
+
+    /* Scans OAM directly on every scanline */
+    friend class Video;
 };
+
+inline auto MMU::read(const Address& address) -> u8 {
+#ifdef GBEMU_PROFILER
+    count_access(address.value(), false);
+#endif
+    const u8* page = read_pages[address.value() >> 8];
+    if (page != nullptr) { return page[address.value() & 0xFF]; }
+    return slow_read(address);
+}
+
+inline void MMU::write(const Address& address, const u8 byte) {
+#ifdef GBEMU_PROFILER
+    count_access(address.value(), true);
+#endif
+    u8* page = write_pages[address.value() >> 8];
+    if (page != nullptr) {
+        page[address.value() & 0xFF] = byte;
+        return;
+    }
+    slow_write(address, byte);
+}
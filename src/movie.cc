@@ -0,0 +1,68 @@
+#include "movie.h"
+
+#include "util/log.h"
+
+#include <cstring>
+
+static const u32 MOVIE_MAGIC = 0x564D4247; /* "GBMV" */
+static const uint HEADER_SIZE = 5 * sizeof(u32);
+
+Movie::Movie(const u32 inRomChecksum, std::vector<u8> inStartState) :
+    rom_checksum(inRomChecksum),
+    state(std::move(inStartState))
+{
+}
+
+auto Movie::parse(const std::vector<u8>& data, const u32 rom_checksum) -> std::unique_ptr<Movie> {
+    u32 header[5];
+    if (data.size() < HEADER_SIZE) {
+        log_error("Not a movie");
+        return nullptr;
+    }
+    std::memcpy(header, data.data(), HEADER_SIZE);
+
+    if (header[0] != MOVIE_MAGIC) {
+        log_error("Not a movie");
+        return nullptr;
+    }
+    if (header[1] != MOVIE_VERSION) {
+        log_error("Unsupported movie version %u", header[1]);
+        return nullptr;
+    }
+    if (header[2] != rom_checksum) {
+        log_error("Movie was recorded with a different ROM");
+        return nullptr;
+    }
+
+    u32 frame_count = header[3];
+    u32 state_size = header[4];
+    if (data.size() != HEADER_SIZE + static_cast<size_t>(state_size) + frame_count) {
+        log_error("Movie is truncated or corrupt");
+        return nullptr;
+    }
+    if (frame_count == 0) {
+        log_error("Movie has no frames");
+        return nullptr;
+    }
+
+    auto state_start = data.begin() + HEADER_SIZE;
+    auto movie = std::make_unique<Movie>(rom_checksum, std::vector<u8>(state_start, state_start + state_size));
+    movie->frames.assign(state_start + state_size, data.end());
+    return movie;
+}
+
+auto Movie::serialize() const -> std::vector<u8> {
+    const u32 header[5] = {
+        MOVIE_MAGIC,
+        MOVIE_VERSION,
+        rom_checksum,
+        static_cast<u32>(frames.size()),
+        static_cast<u32>(state.size()),
+    };
+
+    std::vector<u8> data(HEADER_SIZE);
+    std::memcpy(data.data(), header, HEADER_SIZE);
+    data.insert(data.end(), state.begin(), state.end());
+    data.insert(data.end(), frames.begin(), frames.end());
+    return data;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "definitions.h"
+
+#include <memory>
+#include <vector>
+
+/*
+ * Input movies: the joypad state for every emulated frame of a session,
+ * plus the machine state it started from, so the session replays exactly.
+ *
+ *   header:  "GBMV", format version, ROM checksum, frame count,
+ *            start state size                          (5 x u32)
+ *   then:    the save state the recording started from
+ *   then:    one byte per frame, the buttons held (bit n for GbButton n)
+ *
+ * Values are stored in host byte order, as in save states.
+ */
+const u32 MOVIE_VERSION = 1;
+
+class Movie {
+public:
+    Movie(u32 inRomChecksum, std::vector<u8> inStartState);
+
+    /* Null, after logging why, if the data isn't a movie for this ROM */
+    static auto parse(const std::vector<u8>& data, u32 rom_checksum) -> std::unique_ptr<Movie>;
+    auto serialize() const -> std::vector<u8>;
+
+    auto start_state() const -> const std::vector<u8>& { return state; }
+
+    auto length() const -> uint { return static_cast<uint>(frames.size()); }
+    auto buttons(uint frame) const -> u8 { return frames[frame]; }
+    void record(u8 buttons) { frames.push_back(buttons); }
+
+private:
+    u32 rom_checksum;
+    std::vector<u8> state;
+    std::vector<u8> frames;
+};
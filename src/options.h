@@ -1,11 +1,128 @@
 #pragma once
 
+#include "definitions.h"
+#include "util/log.h"
+
+#include <array>
+#include <string>
+
+enum class SpeedMode {
+    /* Pace emulation to the Gameboy's native ~59.73 frames per second */
+    Normal,
+    /* Pace emulation to a multiple of native speed (see speed_multiplier) */
+    FastForward,
+    /* Run as fast as the host allows, with no frame pacing at all */
+    Unthrottled,
+};
+
+/* What the watchdog does with an instance it finds stuck (see watchdog.h) */
+enum class WatchdogAction {
+    /* Only show it in the instance's health report */
+    Report,
+    /* Pace it to real time whatever its speed, until it recovers. run()
+     * sleeps to do so; steps leave it to their caller, as BatchRunner does
+     * (see StepResult::throttled) */
+    Throttle,
+    /* Stop it for good, as a fatal error would */
+    Stop,
+};
+
+enum class PpuTiming {
+    /* Each line is drawn whole as mode 3 starts, with the registers as
+     * they are then. Mode 3 still ends, and HBlank and the STAT interrupt
+     * start, when they would on the hardware */
+    Fast,
+    /* Each line is drawn as its pixels come out of the PPU, so registers
+     * written during mode 3 take effect from the pixel they would, and so
+     * do VRAM and OAM written then */
+    Accurate,
+};
+
+/* Most frames in a row skipped by --frame-skip=auto */
+const uint DEFAULT_ADAPTIVE_FRAME_SKIP = 4;
+
+/* Set by name through config.h, which lists which of these can be changed
+ * on a running instance (see Gameboy::configure) */
 struct Options {
     bool debugger = false;
     bool trace = false;
     bool disable_logs = false;
+    /* Least severe messages logged, unless trace or disable_logs is set */
+    LogLevel log_level = LogLevel::Info;
     bool headless = false;
     bool show_full_framebuffer = false;
     bool exit_on_infinite_jr = false;
     bool print_serial = false;
+    bool block_cache = true;
+
+    /* Jump over loops which only poll LY, STAT or IF until something
+     * changes (see CPU::is_idle). Exact, but the skipped iterations aren't
+     * seen by the profiler's opcode counts */
+    bool skip_idle_loops = false;
+
+    /* Frontends print the profiler's report when the emulator stops. Only
+     * available in builds with -DGBEMU_PROFILER=ON */
+    bool print_profile = false;
+
+    /* Record a binary instruction trace here (see trace_file.h) instead of
+     * printing one, from when the boot ROM hands over */
+    std::string trace_file;
+
+    /* Input movies for the frontends to record to or replay (see movie.h) */
+    std::string record_movie;
+    std::string play_movie;
+
+    /* Skip audio synthesis entirely; the APU registers (and NR52's
+     * channel status bits) still behave, but no samples are produced */
+    bool mute_audio = false;
+
+    /* Output rate of the APU, in Hz: 22050, 44100 or 48000 */
+    uint audio_sample_rate = 44100;
+
+    /* Rewind history, in frames (0 disables rewinding), and how many frames
+     * apart the snapshots in it are taken */
+    uint rewind_window = 0;
+    uint rewind_interval = 4;
+
+    /* Draw only one frame in every frame_skip + 1. The skipped frames still
+     * run exactly, but nothing is drawn for them (see Video::set_frame_drawn).
+     * With adaptive_frame_skip, frames are only skipped while run() falls
+     * behind its pacing, at most frame_skip in a row */
+    uint frame_skip = 0;
+    bool adaptive_frame_skip = false;
+
+    /* Draw lines on a second thread (see video/render_thread.h). Frames
+     * come out identical; the emulation thread only waits for the drawing
+     * to catch up at the end of each drawn frame */
+    bool threaded_video = false;
+
+    /* How closely drawing follows the PPU's timing within a line. Timing
+     * itself is the same either way; only raster effects made during mode
+     * 3 differ, at some cost to speed for Accurate */
+    PpuTiming ppu_timing = PpuTiming::Fast;
+
+    /* Run-ahead, to hide the game's own input lag: as each frame starts,
+     * this many frames are run on from a snapshot with the buttons held
+     * now, the last of them is shown, and the snapshot is restored. The
+     * real frame then runs undrawn. Costs this many extra frames of
+     * emulation per frame; 0 turns it off */
+    uint run_ahead_frames = 0;
+
+    /* An instance counts as stuck once its LCD has been off, or its CPU
+     * locked in a loop nothing can break, for this many emulated seconds;
+     * 0 turns the watchdog, and the sampling of PC hotspots, off */
+    uint watchdog_seconds = 0;
+    WatchdogAction watchdog_action = WatchdogAction::Report;
+
+    /* Run cartridges which support the CGB as on a DMG anyway */
+    bool force_dmg = false;
+
+    PixelFormat pixel_format = PixelFormat::RGBA8888;
+
+    /* The four DMG shades, lightest first, as 0xRRGGBB. Frames in the
+     * Index8 format hold the shade itself, so they aren't affected */
+    std::array<u32, 4> dmg_palette = {0xFFFFFF, 0xC0C0C0, 0x606060, 0x000000};
+
+    SpeedMode speed_mode = SpeedMode::Normal;
+    uint speed_multiplier = 1;
 };
@@ -0,0 +1,155 @@
+#include "profiler.h"
+
+#include "cpu/opcode_names.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+auto Profiler::component(const ProfiledComponent component) const -> const ComponentProfile& {
+    return components[index(component)];
+}
+
+auto Profiler::memory(const MemoryRegion region) const -> const MemoryProfile& {
+    return regions[static_cast<uint>(region)];
+}
+
+auto Profiler::region_of(const u16 address) -> MemoryRegion {
+    if (address < 0x4000) { return MemoryRegion::ROM0; }
+    if (address < 0x8000) { return MemoryRegion::ROMX; }
+    if (address < 0xA000) { return MemoryRegion::VRAM; }
+    if (address < 0xC000) { return MemoryRegion::ExternalRAM; }
+    if (address < 0xE000) { return MemoryRegion::WRAM; }
+    if (address < 0xFE00) { return MemoryRegion::Echo; }
+    if (address < 0xFEA0) { return MemoryRegion::OAM; }
+    if (address < 0xFF00) { return MemoryRegion::Unusable; }
+    if (address < 0xFF80) { return MemoryRegion::IO; }
+    if (address < 0xFFFF) { return MemoryRegion::HRAM; }
+    return MemoryRegion::IE;
+}
+
+auto Profiler::name_of(const ProfiledComponent component) -> const char* {
+    switch (component) {
+        case ProfiledComponent::CPU: return "CPU";
+        case ProfiledComponent::Video: return "Video";
+        case ProfiledComponent::Audio: return "Audio";
+        case ProfiledComponent::Timer: return "Timer";
+        case ProfiledComponent::Debugger: return "Debugger";
+    }
+    return "";
+}
+
+auto Profiler::name_of(const MemoryRegion region) -> const char* {
+    switch (region) {
+        case MemoryRegion::ROM0: return "ROM0";
+        case MemoryRegion::ROMX: return "ROMX";
+        case MemoryRegion::VRAM: return "VRAM";
+        case MemoryRegion::ExternalRAM: return "External RAM";
+        case MemoryRegion::WRAM: return "WRAM";
+        case MemoryRegion::Echo: return "Echo RAM";
+        case MemoryRegion::OAM: return "OAM";
+        case MemoryRegion::Unusable: return "Unusable";
+        case MemoryRegion::IO: return "IO";
+        case MemoryRegion::HRAM: return "HRAM";
+        case MemoryRegion::IE: return "IE";
+    }
+    return "";
+}
+
+void Profiler::reset() {
+    components = {};
+    opcodes = {};
+    cb_opcodes = {};
+    regions = {};
+    last_switch = clock::now();
+}
+
+void Profiler::charge_active(const clock::time_point now) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - last_switch);
+    components[active].nanoseconds += static_cast<u64>(elapsed.count());
+    last_switch = now;
+}
+
+auto Profiler::enter(const ProfiledComponent component) -> uint {
+    charge_active(clock::now());
+    components[index(component)].calls++;
+
+    uint previous = active;
+    active = index(component);
+    return previous;
+}
+
+void Profiler::leave(const uint previous) {
+    charge_active(clock::now());
+    active = previous;
+}
+
+namespace {
+struct OpcodeCount {
+    const char* name;
+    bool cb;
+    u8 opcode;
+    u64 count;
+};
+
+auto percent(u64 part, u64 total) -> double {
+    return total == 0 ? 0.0 : 100.0 * static_cast<double>(part) / static_cast<double>(total);
+}
+} // namespace
+
+auto Profiler::report() const -> std::string {
+    std::string text;
+    char line[128];
+
+    if (!compiled_in) { return "Profiler not compiled in (configure with -DGBEMU_PROFILER=ON)\n"; }
+
+    u64 total_ns = 0;
+    for (uint i = 0; i < PROFILED_COMPONENT_COUNT; i++) { total_ns += components[i].nanoseconds; }
+
+    text += "Component         calls          cycles   time (ms)   share\n";
+    for (uint i = 0; i < PROFILED_COMPONENT_COUNT; i++) {
+        const ComponentProfile& profile = components[i];
+        snprintf(line, sizeof(line), "%-9s %13llu %15llu %11.2f %6.1f%%\n",
+                 name_of(static_cast<ProfiledComponent>(i)),
+                 static_cast<unsigned long long>(profile.calls),
+                 static_cast<unsigned long long>(profile.cycles),
+                 static_cast<double>(profile.nanoseconds) / 1e6,
+                 percent(profile.nanoseconds, total_ns));
+        text += line;
+    }
+
+    std::vector<OpcodeCount> counts;
+    u64 total_opcodes = 0;
+    for (uint i = 0; i < 256; i++) {
+        if (opcodes[i] > 0) { counts.push_back({ opcode_names[i], false, static_cast<u8>(i), opcodes[i] }); }
+        if (cb_opcodes[i] > 0) { counts.push_back({ opcode_cb_names[i], true, static_cast<u8>(i), cb_opcodes[i] }); }
+        total_opcodes += opcodes[i] + cb_opcodes[i];
+    }
+    std::stable_sort(counts.begin(), counts.end(),
+                     [](const OpcodeCount& a, const OpcodeCount& b) { return a.count > b.count; });
+
+    const size_t top = std::min<size_t>(counts.size(), 20);
+    snprintf(line, sizeof(line), "\nTop %zu of %zu opcodes executed (%llu instructions)\n",
+             top, counts.size(), static_cast<unsigned long long>(total_opcodes));
+    text += line;
+    for (size_t i = 0; i < top; i++) {
+        snprintf(line, sizeof(line), "%s%02X  %-16s %11llu %6.1f%%\n",
+                 counts[i].cb ? "CB " : "   ",
+                 counts[i].opcode,
+                 counts[i].name,
+                 static_cast<unsigned long long>(counts[i].count),
+                 percent(counts[i].count, total_opcodes));
+        text += line;
+    }
+
+    text += "\nRegion                reads          writes\n";
+    for (uint i = 0; i < MEMORY_REGION_COUNT; i++) {
+        snprintf(line, sizeof(line), "%-12s %14llu %15llu\n",
+                 name_of(static_cast<MemoryRegion>(i)),
+                 static_cast<unsigned long long>(regions[i].reads),
+                 static_cast<unsigned long long>(regions[i].writes));
+        text += line;
+    }
+
+    return text;
+}
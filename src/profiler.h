@@ -0,0 +1,139 @@
+#pragma once
+
+#include "definitions.h"
+
+#include <array>
+#include <chrono>
+#include <string>
+
+/*
+ * Built-in profiler: wall time, calls and emulated cycles per component,
+ * an execution count per opcode and memory accesses by region.
+ *
+ * Recording only happens in builds configured with -DGBEMU_PROFILER=ON.
+ * Otherwise the profile_* hooks compile to nothing and every count stays
+ * zero, so the instrumentation costs nothing in normal builds.
+ */
+
+enum class ProfiledComponent {
+    CPU,
+    Video,
+    Audio,
+    Timer,
+    Debugger,
+};
+
+const uint PROFILED_COMPONENT_COUNT = 5;
+
+enum class MemoryRegion {
+    ROM0,        /* 0000-3FFF, including the boot ROM */
+    ROMX,        /* 4000-7FFF */
+    VRAM,        /* 8000-9FFF */
+    ExternalRAM, /* A000-BFFF */
+    WRAM,        /* C000-DFFF */
+    Echo,        /* E000-FDFF */
+    OAM,         /* FE00-FE9F */
+    Unusable,    /* FEA0-FEFF */
+    IO,          /* FF00-FF7F */
+    HRAM,        /* FF80-FFFE */
+    IE,          /* FFFF */
+};
+
+const uint MEMORY_REGION_COUNT = 11;
+
+struct ComponentProfile {
+    u64 calls = 0;
+    u64 cycles = 0;
+
+    /* Exclusive: time spent in components it calls into (e.g. video caught
+     * up by a CPU access to its registers) is counted for those instead */
+    u64 nanoseconds = 0;
+};
+
+/* Accesses through MMU::read/write. Opcode fetches the block cache skips
+ * aren't among them */
+struct MemoryProfile {
+    u64 reads = 0;
+    u64 writes = 0;
+};
+
+class Profiler {
+public:
+    static constexpr bool compiled_in =
+#ifdef GBEMU_PROFILER
+        true;
+#else
+        false;
+#endif
+
+    auto component(ProfiledComponent component) const -> const ComponentProfile&;
+    auto opcode_count(u8 opcode) const -> u64 { return opcodes[opcode]; }
+    auto cb_opcode_count(u8 opcode) const -> u64 { return cb_opcodes[opcode]; }
+    auto memory(MemoryRegion region) const -> const MemoryProfile&;
+
+    static auto region_of(u16 address) -> MemoryRegion;
+    static auto name_of(ProfiledComponent component) -> const char*;
+    static auto name_of(MemoryRegion region) -> const char*;
+
+    void reset();
+
+    /* Human-readable summary: the components, the most executed opcodes
+     * and the memory regions */
+    auto report() const -> std::string;
+
+    /* Used through the profile_* macros below */
+    auto enter(ProfiledComponent component) -> uint;
+    void leave(uint previous);
+    void add_cycles(ProfiledComponent component, uint cycles) { components[index(component)].cycles += cycles; }
+    void count_opcode(u8 opcode) { opcodes[opcode]++; }
+    void count_cb_opcode(u8 opcode) { cb_opcodes[opcode]++; }
+    void count_read(u16 address) { regions[static_cast<uint>(region_of(address))].reads++; }
+    void count_write(u16 address) { regions[static_cast<uint>(region_of(address))].writes++; }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    static auto index(ProfiledComponent component) -> uint { return static_cast<uint>(component); }
+
+    void charge_active(clock::time_point now);
+
+    /* The extra slot is time outside any profiled component, not reported */
+    static constexpr uint UNPROFILED = PROFILED_COMPONENT_COUNT;
+    std::array<ComponentProfile, PROFILED_COMPONENT_COUNT + 1> components = {};
+
+    std::array<u64, 256> opcodes = {};
+    std::array<u64, 256> cb_opcodes = {};
+    std::array<MemoryProfile, MEMORY_REGION_COUNT> regions = {};
+
+    uint active = UNPROFILED;
+    clock::time_point last_switch;
+};
+
+/* Charges the time until the end of the enclosing block to a component */
+class ProfileScope {
+public:
+    ProfileScope(Profiler& inProfiler, ProfiledComponent component)
+        : profiler(inProfiler), previous(inProfiler.enter(component)) {}
+    ~ProfileScope() { profiler.leave(previous); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    auto operator=(const ProfileScope&) -> ProfileScope& = delete;
+
+private:
+    Profiler& profiler;
+    uint previous;
+};
+
+#ifdef GBEMU_PROFILER
+#define profile_concat_(a, b) a##b
+#define profile_name_(line) profile_concat_(profile_scope_, line)
+#define profile_scope(profiler, component) ProfileScope profile_name_(__LINE__)((profiler), (component))
+#define profile_cycles(profiler, component, cycles) (profiler).add_cycles((component), (cycles))
+#define profile_opcode(profiler, opcode) (profiler).count_opcode(opcode)
+#define profile_cb_opcode(profiler, opcode) (profiler).count_cb_opcode(opcode)
+#else
+#define profile_scope(profiler, component) do {} while (false)
+#define profile_cycles(profiler, component, cycles) do {} while (false)
+#define profile_opcode(profiler, opcode) do {} while (false)
+#define profile_cb_opcode(profiler, opcode) do {} while (false)
+#endif
@@ -1,13 +1,17 @@
 #pragma once
 
 #include "definitions.h"
+#include "util/bitwise.h"
+
+/* Registers are plain, non-virtual values with every accessor inlined: the
+ * CPU touches them on every instruction, so they need to compile down to
+ * ordinary loads and stores rather than indirect calls */
 
 class ByteRegister : Noncopyable {
 public:
     ByteRegister() = default;
-    virtual ~ByteRegister() = default;
 
-    virtual void set(u8 new_value);
+    void set(u8 new_value);
     void reset();
     auto value() const -> u8;
 
@@ -29,7 +33,7 @@ public:
 
     /* Specialise behaviour for the flag register 'f'.
      * (its lower nibble is always 0s */
-    void set(u8 new_value) override;
+    void set(u8 new_value);
 
     void set_flag_zero(bool set);
     void set_flag_subtract(bool set);
@@ -47,29 +51,16 @@ public:
     auto flag_carry_value() const -> u8;
 };
 
-class WordValue : Noncopyable {
-public:
-    WordValue() = default;
-    virtual ~WordValue() = default;
-
-    virtual void set(u16 new_value) = 0;
-
-    virtual auto value() const -> u16 = 0;
-
-    virtual auto low() const -> u8 = 0;
-    virtual auto high() const -> u8 = 0;
-};
-
-class WordRegister : public WordValue {
+class WordRegister : Noncopyable {
 public:
     WordRegister() = default;
 
-    void set(u16 new_value) override;
+    void set(u16 new_value);
 
-    auto value() const -> u16 override;
+    auto value() const -> u16;
 
-    auto low() const -> u8 override;
-    auto high() const -> u8 override;
+    auto low() const -> u8;
+    auto high() const -> u8;
 
     void increment();
     void decrement();
@@ -78,16 +69,20 @@ private:
     u16 val = 0x0;
 };
 
-class RegisterPair : public WordValue {
+class RegisterPair : Noncopyable {
 public:
     RegisterPair(ByteRegister& high, ByteRegister& low);
 
-    void set(u16 word) override;
+    /* Used for 'af', where 'low' is the flag register: as set() is not
+     * virtual, the pair applies the flag register's mask itself */
+    RegisterPair(ByteRegister& high, FlagRegister& low);
+
+    void set(u16 word);
 
-    auto value() const -> u16 override;
+    auto value() const -> u16;
 
-    auto low() const -> u8 override;
-    auto high() const -> u8 override;
+    auto low() const -> u8;
+    auto high() const -> u8;
 
     void increment();
     void decrement();
@@ -95,4 +90,100 @@ public:
 private:
     ByteRegister& low_byte;
     ByteRegister& high_byte;
+    u8 low_mask = 0xFF;
 };
+
+
+inline void ByteRegister::set(const u8 new_value) { val = new_value; }
+
+inline void ByteRegister::reset() { val = 0; }
+
+inline auto ByteRegister::value() const -> u8 { return val; }
+
+inline auto ByteRegister::check_bit(u8 bit) const -> bool { return bitwise::check_bit(val, bit); }
+
+inline void ByteRegister::set_bit_to(u8 bit, bool set) { val = bitwise::set_bit_to(val, bit, set); }
+
+inline void ByteRegister::increment() { val += 1; }
+
+inline void ByteRegister::decrement() { val -= 1; }
+
+inline auto ByteRegister::operator==(u8 other) const -> bool { return val == other; }
+
+
+inline void FlagRegister::set(const u8 new_value) { val = new_value & 0xF0; }
+
+inline void FlagRegister::set_flag_zero(bool set) { set_bit_to(7, set); }
+
+inline void FlagRegister::set_flag_subtract(bool set) { set_bit_to(6, set); }
+
+inline void FlagRegister::set_flag_half_carry(bool set) { set_bit_to(5, set); }
+
+inline void FlagRegister::set_flag_carry(bool set) { set_bit_to(4, set); }
+
+inline auto FlagRegister::flag_zero() const -> bool { return check_bit(7); }
+
+inline auto FlagRegister::flag_subtract() const -> bool { return check_bit(6); }
+
+inline auto FlagRegister::flag_half_carry() const -> bool { return check_bit(5); }
+
+inline auto FlagRegister::flag_carry() const -> bool { return check_bit(4); }
+
+inline auto FlagRegister::flag_zero_value() const -> u8 { return static_cast<u8>(flag_zero() ? 1 : 0); }
+
+inline auto FlagRegister::flag_subtract_value() const -> u8 {
+    return static_cast<u8>(flag_subtract() ? 1 : 0);
+}
+
+inline auto FlagRegister::flag_half_carry_value() const -> u8 {
+    return static_cast<u8>(flag_half_carry() ? 1 : 0);
+}
+
+inline auto FlagRegister::flag_carry_value() const -> u8 { return static_cast<u8>(flag_carry() ? 1 : 0); }
+
+
+inline void WordRegister::set(const u16 new_value) { val = new_value; }
+
+inline auto WordRegister::value() const -> u16 { return val; }
+
+inline auto WordRegister::low() const -> u8 { return static_cast<u8>(val); }
+
+inline auto WordRegister::high() const -> u8 { return static_cast<u8>((val) >> 8); }
+
+inline void WordRegister::increment() { val += 1; }
+
+inline void WordRegister::decrement() { val -= 1; }
+
+
+inline RegisterPair::RegisterPair(ByteRegister& high, ByteRegister& low) :
+        low_byte(low),
+        high_byte(high)
+{
+}
+
+inline RegisterPair::RegisterPair(ByteRegister& high, FlagRegister& low) :
+        low_byte(low),
+        high_byte(high),
+        low_mask(0xF0)
+{
+}
+
+inline void RegisterPair::set(const u16 word) {
+    /* Discard the upper byte */
+    low_byte.set(static_cast<u8>(word & low_mask));
+
+    /* Discard the lower byte */
+    high_byte.set(static_cast<u8>((word) >> 8));
+}
+
+inline auto RegisterPair::low() const -> u8 { return low_byte.value(); }
+
+inline auto RegisterPair::high() const -> u8 { return high_byte.value(); }
+
+inline auto RegisterPair::value() const -> u16 {
+    return bitwise::compose_bytes(high_byte.value(), low_byte.value());
+}
+
+inline void RegisterPair::increment() { set(value() + 1); }
+
+inline void RegisterPair::decrement() { set(value() - 1); }
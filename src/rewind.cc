@@ -0,0 +1,118 @@
+#include "rewind.h"
+
+#include <algorithm>
+
+/* The delta encoding is a series of (zero run, literal run) pairs, each
+ * length a little-endian base-128 varint, followed by the literal bytes */
+static void write_varint(std::vector<u8>& out, uint value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<u8>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<u8>(value));
+}
+
+static auto read_varint(const std::vector<u8>& in, uint& position) -> uint {
+    uint value = 0;
+    uint shift = 0;
+    u8 byte;
+    do {
+        byte = in[position++];
+        value |= static_cast<uint>(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+RewindBuffer::RewindBuffer(const uint _capacity) : capacity(_capacity) {}
+
+void RewindBuffer::push(std::vector<u8> state) {
+    /* A different layout (e.g. another ROM) can't be delta encoded */
+    if (!newest.empty() && newest.size() != state.size()) { clear(); }
+
+    if (!newest.empty() && capacity > 0) {
+        if (deltas.size() == capacity) {
+            /* Reuse the oldest entry's storage for the new delta */
+            std::vector<u8> recycled = std::move(deltas.front());
+            deltas.pop_front();
+            encode_delta(newest, state, recycled);
+            deltas.push_back(std::move(recycled));
+        } else {
+            deltas.emplace_back();
+            encode_delta(newest, state, deltas.back());
+        }
+    }
+
+    newest = std::move(state);
+}
+
+auto RewindBuffer::rewind(const uint steps) -> const std::vector<u8>& {
+    for (uint step = 1; step < steps && !deltas.empty(); step++) {
+        apply_delta(deltas.back(), newest);
+        deltas.pop_back();
+    }
+
+    return newest;
+}
+
+auto RewindBuffer::size() const -> uint {
+    return newest.empty() ? 0 : static_cast<uint>(deltas.size() + 1);
+}
+
+auto RewindBuffer::memory_used() const -> uint {
+    auto total = newest.capacity();
+    for (const auto& delta : deltas) { total += delta.capacity(); }
+    return static_cast<uint>(total);
+}
+
+void RewindBuffer::clear() {
+    newest.clear();
+    deltas.clear();
+}
+
+void RewindBuffer::encode_delta(const std::vector<u8>& older, const std::vector<u8>& newer, std::vector<u8>& out) {
+    out.clear();
+
+    const uint size = static_cast<uint>(older.size());
+    uint position = 0;
+
+    while (position < size) {
+        uint zeros_start = position;
+        while (position < size && older[position] == newer[position]) { position++; }
+
+        /* Short runs of equal bytes are cheaper to keep as literals than
+         * to end the literal run for */
+        uint literal_start = position;
+        while (position < size) {
+            if (older[position] != newer[position]) {
+                position++;
+                continue;
+            }
+
+            uint run_end = position;
+            while (run_end < size && run_end - position < 4 && older[run_end] == newer[run_end]) { run_end++; }
+            if (run_end - position >= 4 || run_end == size) { break; }
+            position = run_end;
+        }
+
+        write_varint(out, literal_start - zeros_start);
+        write_varint(out, position - literal_start);
+        for (uint i = literal_start; i < position; i++) {
+            out.push_back(static_cast<u8>(older[i] ^ newer[i]));
+        }
+    }
+}
+
+void RewindBuffer::apply_delta(const std::vector<u8>& delta, std::vector<u8>& state) {
+    uint in = 0;
+    uint position = 0;
+
+    while (in < delta.size()) {
+        position += read_varint(delta, in);
+        uint literals = read_varint(delta, in);
+
+        for (uint i = 0; i < literals; i++) {
+            state[position++] ^= delta[in++];
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "definitions.h"
+
+#include <deque>
+#include <vector>
+
+/*
+ * History of save states for rewinding. Only the newest state is kept
+ * whole; each older one is stored as the XOR against its successor, run
+ * length encoded. Consecutive snapshots differ in a few hundred bytes of
+ * RAM and registers, so the XOR is almost entirely zeros and each entry
+ * shrinks to a tiny fraction of a full state.
+ */
+class RewindBuffer {
+public:
+    /* Keeps up to 'capacity' snapshots besides the newest */
+    explicit RewindBuffer(uint capacity);
+
+    void push(std::vector<u8> state);
+
+    /* Drops the newest state and the 'steps - 1' before it, returning the
+     * state now at the front (or an empty vector if nothing is kept). The
+     * returned state stays in the buffer, so it can be rewound to again */
+    auto rewind(uint steps) -> const std::vector<u8>&;
+
+    /* Snapshots available to rewind to */
+    auto size() const -> uint;
+
+    /* Bytes used by the stored states, for tuning the window */
+    auto memory_used() const -> uint;
+
+    void clear();
+
+private:
+    static void encode_delta(const std::vector<u8>& older, const std::vector<u8>& newer, std::vector<u8>& out);
+    static void apply_delta(const std::vector<u8>& delta, std::vector<u8>& state);
+
+    uint capacity;
+
+    std::vector<u8> newest;
+
+    /* Oldest at the front; each one turns its successor (or 'newest' for
+     * the back one) into the state before it */
+    std::deque<std::vector<u8>> deltas;
+};
@@ -0,0 +1,101 @@
+#include "save_state.h"
+
+#include "util/log.h"
+
+static const u32 SAVE_STATE_MAGIC = 0x54534247; /* "GBST" */
+static const uint HEADER_SIZE = 3 * sizeof(u32);
+static const uint SECTION_HEADER_SIZE = 2 * sizeof(u32);
+
+static auto read_u32(const std::vector<u8>& blob, uint offset) -> u32 {
+    u32 value;
+    std::memcpy(&value, &blob[offset], sizeof(value));
+    return value;
+}
+
+StateWriter::StateWriter(const u32 rom_checksum) {
+    append_u32(SAVE_STATE_MAGIC);
+    append_u32(SAVE_STATE_VERSION);
+    append_u32(rom_checksum);
+}
+
+void StateWriter::append_u32(const u32 value) {
+    auto offset = blob.size();
+    blob.resize(offset + sizeof(value));
+    std::memcpy(&blob[offset], &value, sizeof(value));
+}
+
+void StateWriter::write_bytes(const StateSection tag, const void* data, const uint size) {
+    append_u32(static_cast<u32>(tag));
+    append_u32(size);
+
+    auto offset = blob.size();
+    blob.resize(offset + size);
+    std::memcpy(&blob[offset], data, size);
+}
+
+StateReader::StateReader(const std::vector<u8>& in_blob, const u32 rom_checksum) : blob(in_blob) {
+    if (blob.size() < HEADER_SIZE || read_u32(blob, 0) != SAVE_STATE_MAGIC) {
+        log_error("Not a save state");
+        return;
+    }
+
+    if (read_u32(blob, 4) != SAVE_STATE_VERSION) {
+        log_error("Unsupported save state version %d (expected %d)", read_u32(blob, 4), SAVE_STATE_VERSION);
+        return;
+    }
+
+    if (read_u32(blob, 8) != rom_checksum) {
+        log_error("Save state was made with a different ROM");
+        return;
+    }
+
+    uint offset = HEADER_SIZE;
+    while (offset < blob.size()) {
+        if (blob.size() - offset < SECTION_HEADER_SIZE) {
+            log_error("Truncated save state section header at offset %d", offset);
+            return;
+        }
+
+        auto tag = static_cast<StateSection>(read_u32(blob, offset));
+        uint size = read_u32(blob, offset + 4);
+        offset += SECTION_HEADER_SIZE;
+
+        if (blob.size() - offset < size) {
+            log_error("Truncated save state section %d", static_cast<u32>(tag));
+            return;
+        }
+
+        sections.push_back({ tag, size, offset });
+        offset += size;
+    }
+
+    is_valid = true;
+}
+
+auto StateReader::same_layout(const StateReader& other) const -> bool {
+    if (!is_valid || !other.is_valid || sections.size() != other.sections.size()) { return false; }
+
+    for (uint i = 0; i < sections.size(); i++) {
+        if (sections[i].tag != other.sections[i].tag) { return false; }
+        if (sections[i].size != other.sections[i].size) { return false; }
+    }
+
+    return true;
+}
+
+void StateReader::read_bytes(const StateSection tag, void* data, const uint size) {
+    std::memcpy(data, read_view(tag, size), size);
+}
+
+auto StateReader::read_view(const StateSection tag, const uint size) -> const u8* {
+    if (!is_valid || next_section >= sections.size()) {
+        fatal_error("Read past the end of a save state");
+    }
+
+    const Section& section = sections[next_section++];
+    if (section.tag != tag || section.size != size) {
+        fatal_error("Save state section %d does not match the expected layout", static_cast<u32>(tag));
+    }
+
+    return blob.data() + section.offset;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "definitions.h"
+
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Save states are a flat, versioned binary blob:
+ *
+ *   header:   "GBST", format version, ROM checksum      (3 x u32)
+ *   sections: tag, size in bytes, then the bytes        (2 x u32 + data)
+ *
+ * Each component saves its registers as one plain struct with no padding,
+ * and its memories as raw byte arrays, so every section is written and read
+ * back with a single memcpy. Values are stored in host byte order.
+ *
+ * Any change to the layout of a section struct must bump
+ * SAVE_STATE_VERSION.
+ */
+const u32 SAVE_STATE_VERSION = 7;
+
+enum class StateSection : u32 {
+    Gameboy = 1,
+    CPU,
+    MMU,
+    WorkRam,
+    OamRam,
+    HighRam,
+    Video,
+    VideoRam,
+    Timer,
+    Audio,
+    Input,
+    Serial,
+    Cartridge,
+    CartridgeRam,
+};
+
+class StateWriter {
+public:
+    explicit StateWriter(u32 rom_checksum);
+
+    template <typename T>
+    void write(StateSection tag, const T& section) {
+        static_assert(std::is_trivially_copyable<T>::value, "Save state sections are copied with memcpy");
+        static_assert(std::has_unique_object_representations<T>::value,
+                      "Save state sections must not contain padding");
+        write_bytes(tag, &section, sizeof(T));
+    }
+
+    void write_bytes(StateSection tag, const void* data, uint size);
+
+    auto data() -> std::vector<u8>& { return blob; }
+
+private:
+    void append_u32(u32 value);
+
+    std::vector<u8> blob;
+};
+
+class StateReader {
+public:
+    /* Checks the header and the framing of every section; a reader which
+     * is not valid() returns nothing from its sections */
+    StateReader(const std::vector<u8>& blob, u32 rom_checksum);
+
+    auto valid() const -> bool { return is_valid; }
+
+    /* Whether both blobs have the same sections, of the same sizes, in the
+     * same order. Sections can then be read without any further checks */
+    auto same_layout(const StateReader& other) const -> bool;
+
+    template <typename T>
+    void read(StateSection tag, T& section) {
+        static_assert(std::is_trivially_copyable<T>::value, "Save state sections are copied with memcpy");
+        read_bytes(tag, &section, sizeof(T));
+    }
+
+    void read_bytes(StateSection tag, void* data, uint size);
+
+    /* A section's bytes where they are in the blob, for a component to
+     * take over only what differs from what it has */
+    auto read_view(StateSection tag, uint size) -> const u8*;
+
+private:
+    struct Section {
+        StateSection tag;
+        uint size;
+        uint offset;
+    };
+
+    const std::vector<u8>& blob;
+    std::vector<Section> sections;
+    uint next_section = 0;
+    bool is_valid = false;
+};
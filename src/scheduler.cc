@@ -0,0 +1,25 @@
+#include "scheduler.h"
+
+#include <algorithm>
+
+/* Every component is synced at least this often, even with nothing
+ * scheduled, which keeps catch-up deltas well within a uint */
+const uint MAX_SYNC_INTERVAL = 70224;
+
+void Scheduler::schedule(const EventType type, const uint cycles_from_now) {
+    deadlines[index(type)] = timestamp + std::min(cycles_from_now, MAX_SYNC_INTERVAL);
+    next_deadline = *std::min_element(deadlines.begin(), deadlines.end());
+}
+
+auto Scheduler::catch_up(const EventType type) -> uint {
+    auto cycles = static_cast<uint>(timestamp - synced_at[index(type)]);
+    synced_at[index(type)] = timestamp;
+    return cycles;
+}
+
+void Scheduler::restore(const u64 new_timestamp) {
+    timestamp = new_timestamp;
+    synced_at.fill(new_timestamp);
+    deadlines.fill(new_timestamp);
+    next_deadline = new_timestamp;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "definitions.h"
+
+#include <array>
+#include <limits>
+
+/* Components which are only brought up to date when one of their events
+ * falls due, or when the CPU touches one of their registers */
+enum class EventType {
+    Video,
+    Timer,
+    Audio,
+    Serial,
+    /* PC samples, only scheduled with the watchdog on */
+    Watchdog,
+};
+
+const uint EVENT_TYPE_COUNT = 5;
+
+/* Returned by components which have nothing scheduled */
+const uint NO_EVENT = std::numeric_limits<uint>::max();
+
+class Scheduler {
+public:
+    /* Emulated time, in the same units the CPU reports per instruction */
+    auto now() const -> u64 { return timestamp; }
+    void advance(uint cycles) { timestamp += cycles; }
+
+    /* Earliest deadline over all components */
+    auto next_event() const -> u64 { return next_deadline; }
+    auto is_due(EventType type) const -> bool { return deadlines[index(type)] <= timestamp; }
+
+    void schedule(EventType type, uint cycles_from_now);
+
+    /* Returns the cycles which passed since the component was last synced */
+    auto catch_up(EventType type) -> uint;
+
+    /* Jumps to a timestamp with every component counted as synced there,
+     * e.g. when loading a save state. Components then need rescheduling */
+    void restore(u64 new_timestamp);
+
+private:
+    static auto index(EventType type) -> uint { return static_cast<uint>(type); }
+
+    u64 timestamp = 0;
+    u64 next_deadline = 0;
+
+    std::array<u64, EVENT_TYPE_COUNT> deadlines = {};
+    std::array<u64, EVENT_TYPE_COUNT> synced_at = {};
+};
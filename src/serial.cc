@@ -1,19 +1,112 @@
 #include "serial.h"
 
+#include "gameboy.h"
+#include "cpu/cpu.h"
 #include "util/bitwise.h"
 #include "util/log.h"
+#include "save_state.h"
 
 #include <cstdio>
 
+/* One bit per 512 clocks, i.e. 128 of the scheduler's: 8192 Hz */
+const uint CYCLES_PER_BIT = 128;
+/* The CGB's fast clock is 32 times quicker */
+const uint FAST_CLOCK_FACTOR = 32;
+
+Serial::Serial(Gameboy& inGb, Options& inOptions) : gb(inGb), options(inOptions) {}
+
 auto Serial::read() const -> u8 { return data; }
 
 void Serial::write(const u8 byte) {
     data = byte;
 }
 
-void Serial::write_control(const u8 byte) const {
-    if (bitwise::check_bit(byte, 7) && options.print_serial) {
-        printf("%c", data);
-        fflush(stdout);
+auto Serial::read_control() const -> u8 {
+    /* Unused bits read as 1; the fast clock bit only exists on a CGB */
+    return gb.cgb ? (control | 0x7C) : (control | 0x7E);
+}
+
+void Serial::write_control(const u8 byte) {
+    control = gb.cgb ? (byte & 0x83) : (byte & 0x81);
+    if (!bitwise::check_bit(control, 7)) { return; }
+
+    /* Frames run ahead are undone, so what they send isn't passed on */
+    if (!gb.running_ahead) {
+        if (options.print_serial) {
+            printf("%c", data);
+            fflush(stdout);
+        }
+
+        if (serial_callback) { serial_callback(data); }
     }
+
+    if (clocking()) { transfer_done_at = gb.scheduler.now() + transfer_cycles(); }
+}
+
+auto Serial::clocking() const -> bool {
+    return bitwise::check_bit(control, 7) && bitwise::check_bit(control, 0);
+}
+
+auto Serial::transfer_cycles() const -> uint {
+    uint bit = CYCLES_PER_BIT;
+    if (bitwise::check_bit(control, 1)) { bit /= FAST_CLOCK_FACTOR; }
+    if (gb.double_speed) { bit /= 2; }
+    return 8 * bit;
+}
+
+void Serial::update() {
+    if (!clocking() || gb.scheduler.now() < transfer_done_at) { return; }
+
+    finish_transfer(link != nullptr ? link->exchange(data, transfer_done_at) : 0xFF);
+}
+
+auto Serial::cycles_until_next_event() const -> uint {
+    if (!clocking()) { return NO_EVENT; }
+
+    u64 now = gb.scheduler.now();
+    return transfer_done_at > now ? static_cast<uint>(transfer_done_at - now) : 0;
+}
+
+auto Serial::clocked_externally(const u8 incoming) -> u8 {
+    if (!bitwise::check_bit(control, 7) || bitwise::check_bit(control, 0)) { return 0xFF; }
+
+    u8 outgoing = data;
+    finish_transfer(incoming);
+    return outgoing;
+}
+
+void Serial::finish_transfer(const u8 incoming) {
+    data = incoming;
+    control = bitwise::clear_bit(control, 7);
+    gb.cpu.interrupt_flag.set_bit_to(3, true);
+}
+
+void Serial::register_serial_callback(const serial_callback_t& callback) {
+    serial_callback = callback;
+}
+
+namespace {
+struct SerialState {
+    u64 transfer_done_at;
+    u8 data;
+    u8 control;
+    u8 unused[6];
+};
+} // namespace
+
+void Serial::save_state(StateWriter& writer) const {
+    SerialState state = {};
+    state.transfer_done_at = transfer_done_at;
+    state.data = data;
+    state.control = control;
+    writer.write(StateSection::Serial, state);
+}
+
+void Serial::load_state(StateReader& reader) {
+    SerialState state;
+    reader.read(StateSection::Serial, state);
+
+    transfer_done_at = state.transfer_done_at;
+    data = state.data;
+    control = state.control;
 }
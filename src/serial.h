@@ -3,16 +3,84 @@
 #include "definitions.h"
 #include "options.h"
 
+#include <functional>
+
+class Gameboy;
+class StateWriter;
+class StateReader;
+
+/* Called with each byte the Gameboy starts sending over the link port */
+using serial_callback_t = std::function<void(u8)>;
+
+/* What sits at the other end of the link port (see link.h) */
+class LinkCable {
+public:
+    virtual ~LinkCable() = default;
+
+    /* A transfer this end clocks has shifted out 'sent', finishing at
+     * 'time' on this end's scheduler. Returns the byte shifted in */
+    virtual auto exchange(u8 sent, u64 time) -> u8 = 0;
+};
+
+/*
+ * SB and SC. A transfer on the internal clock shifts a bit out and one in
+ * every 512 clocks (16 on a CGB's fast clock), and is an event of its own:
+ * when its eighth bit is done, the byte is exchanged with the cable and
+ * the serial interrupt raised. With nothing connected, 0xFF is shifted in.
+ *
+ * A transfer on the external clock waits for the other end to clock it,
+ * through clocked_externally().
+ */
 class Serial {
 public:
-    Serial(Options& inOptions) : options(inOptions) {}
+    Serial(Gameboy& inGb, Options& inOptions);
 
     auto read() const -> u8;
     void write(u8 byte);
-    void write_control(u8 byte) const;
+    auto read_control() const -> u8;
+    void write_control(u8 byte);
+
+    /* Finishes a transfer on the internal clock once it's due */
+    void update();
+    auto cycles_until_next_event() const -> uint;
+
+    /* The other end clocked a whole byte in. If a transfer on the external
+     * clock is waiting, it finishes with 'incoming' and this returns what
+     * was in SB; otherwise nothing changes and it returns 0xFF */
+    auto clocked_externally(u8 incoming) -> u8;
+
+    /* Null disconnects the cable */
+    void attach_link(LinkCable* cable) { link = cable; }
+    auto linked() const -> bool { return link != nullptr; }
+
+    /* A transfer on the internal clock is under way, finishing at done_at() */
+    auto clocking() const -> bool;
+    auto done_at() const -> u64 { return transfer_done_at; }
+
+    void register_serial_callback(const serial_callback_t& callback);
+
+    void save_state(StateWriter& writer) const;
+    void load_state(StateReader& reader);
 
 private:
+    /* Scheduler clocks for the eight bits of a transfer at the current
+     * clock speed and CPU speed */
+    auto transfer_cycles() const -> uint;
+    void finish_transfer(u8 incoming);
+
+    Gameboy& gb;
     Options& options;
 
-    u8 data;
+    u8 data = 0;
+    /* Bit 7: transfer under way, 1: fast clock (CGB), 0: internal clock */
+    u8 control = 0;
+    u64 transfer_done_at = 0;
+
+    LinkCable* link = nullptr;
+
+    serial_callback_t serial_callback;
 };
+
+/* Shortest transfer either kind of Gameboy can make, in scheduler clocks */
+const uint MIN_SERIAL_TRANSFER_CYCLES_DMG = 8 * 128;
+const uint MIN_SERIAL_TRANSFER_CYCLES_CGB = 8 * 2;
@@ -4,64 +4,155 @@
 #include "gameboy.h"
 #include "cpu/cpu.h"
 #include "util/bitwise.h"
+#include "scheduler.h"
+#include "save_state.h"
 
 const uint CLOCKS_PER_CYCLE = 4;
 
 Timer::Timer(Gameboy& _gb) : gb(_gb) {}
 
-void Timer::tick(uint cycles) {
-    u8 new_divider = static_cast<u8>(divider.value() + cycles);
-    divider.set(new_divider);
+auto Timer::clocks_per_cycle() const -> uint {
+    return gb.double_speed ? CLOCKS_PER_CYCLE * 2 : CLOCKS_PER_CYCLE;
+}
 
-    clocks += cycles * CLOCKS_PER_CYCLE;
+/* Only for times since the base, which every update leaves it at or before */
+auto Timer::clocks_at(const u64 time) const -> u64 {
+    return base_clocks + (time - base_time) * clocks_per_cycle();
+}
 
-    auto timer_is_on = timer_control.check_bit(2);
-    if (timer_is_on == 0) { return; }
+auto Timer::clocks_since_reset() const -> u64 {
+    return clocks_at(gb.scheduler.now());
+}
 
-    auto clock_limit = clocks_needed_to_increment();
+void Timer::update() {
+    u64 now = gb.scheduler.now();
 
-    if (clocks >= clock_limit) {
-        clocks = clocks % clock_limit;
+    if (timer_enabled()) {
+        /* One increment per multiple of the period passed since the last update */
+        u64 period = clocks_needed_to_increment();
+        u64 from = clocks_at(timer_updated_at);
+        u64 to = clocks_at(now);
+        increment_timer(to / period - from / period);
+    }
 
-        u8 old_timer_counter = timer_counter.value();
-        timer_counter.increment();
+    timer_updated_at = now;
+}
 
-        if (timer_counter.value() < old_timer_counter) {
-            gb.cpu.interrupt_flag.set_bit_to(2, true);
-            timer_counter.set(timer_modulo.value());
+void Timer::increment_timer(u64 increments) {
+    /* Events keep this to one overflow at most, short of a very long sync */
+    while (increments > 0) {
+        uint until_overflow = 0x100 - timer_counter.value();
+        if (increments < until_overflow) {
+            timer_counter.set(static_cast<u8>(timer_counter.value() + increments));
+            return;
         }
+
+        increments -= until_overflow;
+        timer_counter.set(timer_modulo.value());
+        gb.cpu.interrupt_flag.set_bit_to(2, true);
     }
 }
 
-auto Timer::get_divider() const -> u8 { return divider.value(); }
+namespace {
+struct TimerState {
+    u64 base_time;
+    u64 base_clocks;
+    u64 updated_at;
+    u8 timer_counter;
+    u8 timer_modulo;
+    u8 timer_control;
+    u8 unused[5];
+};
+} // namespace
+
+void Timer::save_state(StateWriter& writer) const {
+    TimerState state = {};
+    state.base_time = base_time;
+    state.base_clocks = base_clocks;
+    state.updated_at = timer_updated_at;
+    state.timer_counter = timer_counter.value();
+    state.timer_modulo = timer_modulo.value();
+    state.timer_control = timer_control.value();
+    writer.write(StateSection::Timer, state);
+}
+
+void Timer::load_state(StateReader& reader) {
+    TimerState state;
+    reader.read(StateSection::Timer, state);
+
+    base_time = state.base_time;
+    base_clocks = state.base_clocks;
+    timer_updated_at = state.updated_at;
+    timer_counter.set(state.timer_counter);
+    timer_modulo.set(state.timer_modulo);
+    timer_control.set(state.timer_control);
+}
+
+auto Timer::cycles_until_next_event() const -> uint {
+    if (!timer_enabled()) { return NO_EVENT; }
+
+    u64 period = clocks_needed_to_increment();
+    u64 clocks = clocks_since_reset();
+
+    /* The next falling edge, then one more per increment left */
+    u64 increments_until_overflow = 0x100 - timer_counter.value();
+    u64 overflow = (clocks / period + increments_until_overflow) * period;
+
+    uint rate = clocks_per_cycle();
+    return static_cast<uint>((overflow - clocks + rate - 1) / rate);
+}
+
+auto Timer::get_divider() const -> u8 { return static_cast<u8>(clocks_since_reset() >> 8); }
 
 auto Timer::get_timer() const -> u8 { return timer_counter.value(); }
 
 auto Timer::get_timer_modulo() const -> u8 { return timer_modulo.value(); }
 
 // Only the bottom three bits of this register are usable
-auto Timer::get_timer_control() const -> u8 { return timer_control.value() & 0x3; }
+auto Timer::get_timer_control() const -> u8 { return timer_control.value() & 0x7; }
 
+/* Resetting the counter drops the selected bit, so TIMA counts once more if
+ * it was set */
 void Timer::reset_divider() {
-    divider.set(0x0);
+    update();
+    if (timer_signal()) { increment_timer(1); }
+    base_time = gb.scheduler.now();
+    base_clocks = 0;
+}
+
+void Timer::change_speed() {
+    update();
+    base_clocks = clocks_since_reset();
+    base_time = gb.scheduler.now();
 }
 
 void Timer::set_timer(u8 value) {
+    update();
     timer_counter.set(value);
 }
 
 void Timer::set_timer_modulo(u8 value) {
+    update();
     timer_modulo.set(value);
 }
 
+/* Turning the timer off, or moving to a bit which is clear, while the old
+ * bit is set looks the same as a falling edge to the DMG */
 void Timer::set_timer_control(u8 value) {
+    update();
+    bool old_signal = timer_signal();
     timer_control.set(value);
+    if (old_signal && !timer_signal()) { increment_timer(1); }
 }
 
-uint Timer::clocks_needed_to_increment() {
-    using bitwise::check_bit;
+auto Timer::timer_enabled() const -> bool { return timer_control.check_bit(2); }
+
+auto Timer::timer_signal() const -> bool {
+    return timer_enabled() && (clocks_since_reset() & (clocks_needed_to_increment() / 2)) != 0;
+}
 
-    switch (get_timer_control()) {
+auto Timer::clocks_needed_to_increment() const -> uint {
+    switch (timer_control.value() & 0x3) {
         case 0: return CLOCK_RATE / 4096;
         case 1: return CLOCK_RATE / 262144;
         case 2: return CLOCK_RATE / 65536;
@@ -4,12 +4,24 @@
 #include "register.h"
 
 class Gameboy;
+class StateWriter;
+class StateReader;
 
+/*
+ * DIV is the top byte of a 16-bit counter which counts every clock, and
+ * TIMA counts the falling edges of the counter bit selected by TAC. Neither
+ * is stepped: the counter is worked out from the scheduler's clock and the
+ * time DIV was last reset (or the CPU last changed speed), and TIMA from
+ * how many edges have gone by since it was last brought up to date. The
+ * only event is the next TIMA overflow.
+ */
 class Timer {
 public:
     Timer(Gameboy& inGb);
 
-    void tick(uint cycles);
+    /* Brings TIMA up to now, raising the interrupt for an overflow */
+    void update();
+    auto cycles_until_next_event() const -> uint;
 
     auto get_divider() const -> u8;
     auto get_timer() const -> u8;
@@ -21,14 +33,39 @@ public:
     void set_timer_modulo(u8 value);
     void set_timer_control(u8 value);
 
+    /* Called just before the CPU switches speed. The counter keeps its
+     * value, and counts at the CPU's new rate from then on */
+    void change_speed();
+
+    void save_state(StateWriter& writer) const;
+    void load_state(StateReader& reader);
+
 private:
-    uint clocks_needed_to_increment();
+    /* Clocks counted since DIV was last reset; the DIV counter is the low
+     * 16 bits of it */
+    auto clocks_since_reset() const -> u64;
+    auto clocks_at(u64 time) const -> u64;
+
+    /* Counter clocks per scheduler clock: twice as many in double speed */
+    auto clocks_per_cycle() const -> uint;
 
-    uint clocks = 0;
+    /* Clocks per TIMA increment: twice the value of the bit TAC selects */
+    auto clocks_needed_to_increment() const -> uint;
+    auto timer_enabled() const -> bool;
+
+    /* Whether the bit TAC selects is set - TIMA counts when this falls */
+    auto timer_signal() const -> bool;
+
+    void increment_timer(u64 increments);
 
     Gameboy& gb;
 
-    ByteRegister divider;
+    /* The counter stood at 'base_clocks' at scheduler time 'base_time' */
+    u64 base_time = 0;
+    u64 base_clocks = 0;
+    /* Scheduler time up to which 'timer_counter' is current */
+    u64 timer_updated_at = 0;
+
     ByteRegister timer_counter;
 
     ByteRegister timer_modulo;
@@ -0,0 +1,63 @@
+#include "trace.h"
+
+#include "cpu/opcode_names.h"
+#include "util/log.h"
+
+#include <algorithm>
+#include <chrono>
+
+Tracer::Tracer(trace_sink_t inSink) :
+    sink(std::move(inSink)),
+    records(CAPACITY),
+    write_position(0),
+    read_position(0),
+    stopping(false)
+{
+    writer = std::thread([this]() { write_records(); });
+}
+
+Tracer::~Tracer() {
+    stopping.store(true, std::memory_order_release);
+    writer.join();
+}
+
+void Tracer::write_records() {
+    while (true) {
+        /* Checked before looking for records, so the last ones pushed
+         * before stopping are always seen */
+        bool stop = stopping.load(std::memory_order_acquire);
+
+        u64 read = read_position.load(std::memory_order_relaxed);
+        u64 written = write_position.load(std::memory_order_acquire);
+
+        if (read == written) {
+            if (stop) { return; }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        /* Up to the end of the ring at most, so the sink sees one run */
+        uint start = static_cast<uint>(read & (CAPACITY - 1));
+        uint count = static_cast<uint>(std::min<u64>(written - read, CAPACITY - start));
+        sink(&records[start], count);
+        read_position.store(read + count, std::memory_order_release);
+    }
+}
+
+auto Tracer::text_sink(FILE* file) -> trace_sink_t {
+    return [file](const TraceRecord* records, uint count) {
+        for (uint i = 0; i < count; i++) {
+            const TraceRecord& record = records[i];
+            const char* name = record.prefix == 0xCB
+                ? opcode_cb_names[record.opcode]
+                : opcode_names[record.opcode];
+
+            fprintf(file, "%s| %s0x%04X: %-16s %s%02X  AF=%04X BC=%04X DE=%04X HL=%04X SP=%04X  %llu\n",
+                    COLOR_TRACE, COLOR_RESET,
+                    record.pc, name,
+                    record.prefix == 0xCB ? "CB " : "", record.opcode,
+                    record.af, record.bc, record.de, record.hl, record.sp,
+                    static_cast<unsigned long long>(record.cycle));
+        }
+    };
+}
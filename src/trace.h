@@ -0,0 +1,75 @@
+#pragma once
+
+#include "definitions.h"
+
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <vector>
+
+/* One executed instruction, with the registers as they were before it ran */
+struct TraceRecord {
+    u64 cycle;
+    u16 pc;
+    u16 af;
+    u16 bc;
+    u16 de;
+    u16 hl;
+    u16 sp;
+    u8 opcode;
+    /* 0xCB for CB-prefixed opcodes, otherwise 0 */
+    u8 prefix;
+    u16 unused;
+};
+
+/* Receives records in the order they were executed, on the writer thread */
+using trace_sink_t = std::function<void(const TraceRecord* records, uint count)>;
+
+/*
+ * Instruction trace for --trace. The CPU only copies a record into a ring
+ * buffer per instruction; a writer thread formats or stores them. When the
+ * writer falls behind the CPU waits for it rather than dropping records,
+ * so the trace is always complete. Destroying the tracer writes out
+ * whatever is still buffered.
+ */
+class Tracer {
+public:
+    explicit Tracer(trace_sink_t inSink);
+    ~Tracer();
+
+    Tracer(const Tracer&) = delete;
+    auto operator=(const Tracer&) -> Tracer& = delete;
+
+    /* Emulator thread only */
+    void record(const TraceRecord& record);
+
+    /* One line of disassembly and registers per instruction */
+    static auto text_sink(FILE* file) -> trace_sink_t;
+
+private:
+    /* In records; a power of two so positions can be masked */
+    static const uint CAPACITY = 1 << 16;
+
+    void write_records();
+
+    trace_sink_t sink;
+    std::vector<TraceRecord> records;
+
+    /* Record counts which only ever increase; each is written by one side */
+    alignas(64) std::atomic<u64> write_position;
+    alignas(64) std::atomic<u64> read_position;
+
+    std::atomic<bool> stopping;
+    std::thread writer;
+};
+
+inline void Tracer::record(const TraceRecord& record) {
+    u64 position = write_position.load(std::memory_order_relaxed);
+    while (position - read_position.load(std::memory_order_acquire) >= CAPACITY) {
+        std::this_thread::yield();
+    }
+
+    records[position & (CAPACITY - 1)] = record;
+    write_position.store(position + 1, std::memory_order_release);
+}
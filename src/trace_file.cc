@@ -0,0 +1,177 @@
+#include "trace_file.h"
+
+#include "util/log.h"
+
+#include <cstring>
+
+namespace {
+const u8 FLAG_AF = 1 << 0;
+const u8 FLAG_BC = 1 << 1;
+const u8 FLAG_DE = 1 << 2;
+const u8 FLAG_HL = 1 << 3;
+const u8 FLAG_SP = 1 << 4;
+const u8 FLAG_CB = 1 << 5;
+
+void put_varint(std::vector<u8>& out, u64 value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<u8>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<u8>(value));
+}
+
+void put_word(std::vector<u8>& out, u16 value) {
+    out.push_back(static_cast<u8>(value & 0xFF));
+    out.push_back(static_cast<u8>(value >> 8));
+}
+
+auto zigzag(int value) -> u64 {
+    return static_cast<u64>(value < 0 ? -2 * value - 1 : 2 * value);
+}
+
+auto unzigzag(u64 value) -> int {
+    return (value & 1) ? -static_cast<int>((value + 1) / 2) : static_cast<int>(value / 2);
+}
+} // namespace
+
+TraceFileWriter::TraceFileWriter(const std::string& filename) :
+    file(fopen(filename.c_str(), "wb"))
+{
+    if (file == nullptr) { fatal_error("Cannot create trace file: %s", filename.c_str()); }
+
+    TraceFileHeader header = {};
+    memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_FILE_VERSION;
+    header.block_records = BLOCK_RECORDS;
+    fwrite(&header, sizeof(header), 1, file);
+
+    block.reserve(BLOCK_RECORDS * 8);
+}
+
+TraceFileWriter::~TraceFileWriter() {
+    if (block_records > 0) { write_block(); }
+    fclose(file);
+}
+
+auto TraceFileWriter::sink(const std::string& filename) -> trace_sink_t {
+    auto writer = std::make_shared<TraceFileWriter>(filename);
+    return [writer](const TraceRecord* records, uint count) { writer->write(records, count); };
+}
+
+void TraceFileWriter::write(const TraceRecord* records, const uint count) {
+    for (uint i = 0; i < count; i++) {
+        const TraceRecord& record = records[i];
+
+        u8 flags = 0;
+        if (record.af != previous.af) { flags |= FLAG_AF; }
+        if (record.bc != previous.bc) { flags |= FLAG_BC; }
+        if (record.de != previous.de) { flags |= FLAG_DE; }
+        if (record.hl != previous.hl) { flags |= FLAG_HL; }
+        if (record.sp != previous.sp) { flags |= FLAG_SP; }
+        if (record.prefix == 0xCB) { flags |= FLAG_CB; }
+
+        block.push_back(flags);
+        put_varint(block, record.cycle - previous.cycle);
+        put_varint(block, zigzag(record.pc - previous.pc));
+        block.push_back(record.opcode);
+        if (flags & FLAG_AF) { put_word(block, record.af); }
+        if (flags & FLAG_BC) { put_word(block, record.bc); }
+        if (flags & FLAG_DE) { put_word(block, record.de); }
+        if (flags & FLAG_HL) { put_word(block, record.hl); }
+        if (flags & FLAG_SP) { put_word(block, record.sp); }
+
+        previous = record;
+        if (++block_records == BLOCK_RECORDS) { write_block(); }
+    }
+}
+
+void TraceFileWriter::write_block() {
+    TraceBlockHeader header = {};
+    header.records = block_records;
+    header.bytes = static_cast<u32>(block.size());
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(block.data(), 1, block.size(), file);
+
+    block.clear();
+    block_records = 0;
+    previous = {};
+}
+
+TraceReader::TraceReader(const u8* inData, const size_t inSize) :
+    data(inData),
+    size(inSize)
+{
+    TraceFileHeader header = {};
+    if (size < sizeof(header)) { fatal_error("Not a trace file: too short"); }
+
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)) != 0) { fatal_error("Not a trace file"); }
+    if (header.version != TRACE_FILE_VERSION) { fatal_error("Unsupported trace file version %u", header.version); }
+
+    block_start = block_end = position = sizeof(header);
+}
+
+auto TraceReader::next_block() -> bool {
+    block_start = block_end;
+    block_records = records_left = 0;
+    if (block_start == size) { return false; }
+
+    /* What a killed emulator leaves behind: the trace up to there is fine */
+    TraceBlockHeader header = {};
+    bool truncated = size - block_start < sizeof(header);
+    if (!truncated) {
+        memcpy(&header, data + block_start, sizeof(header));
+        truncated = size - block_start - sizeof(header) < header.bytes;
+    }
+    if (truncated) {
+        log_warn("Trace truncated at offset %zu; ignoring the rest", block_start);
+        block_end = size;
+        return false;
+    }
+
+    position = block_start + sizeof(header);
+    block_end = position + header.bytes;
+    block_records = records_left = header.records;
+    previous = {};
+    return true;
+}
+
+auto TraceReader::read_byte() -> u8 {
+    if (position >= block_end) { fatal_error("Corrupt trace block at offset %zu", block_start); }
+    return data[position++];
+}
+
+auto TraceReader::read_varint() -> u64 {
+    u64 value = 0;
+    for (uint shift = 0; shift < 64; shift += 7) {
+        u8 byte = read_byte();
+        value |= static_cast<u64>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) { return value; }
+    }
+    fatal_error("Corrupt varint in trace block at offset %zu", block_start);
+}
+
+auto TraceReader::next_record(TraceRecord& record) -> bool {
+    if (records_left == 0) { return false; }
+    records_left--;
+
+    auto read_word = [this]() {
+        u8 low = read_byte();
+        return static_cast<u16>(low | (read_byte() << 8));
+    };
+
+    u8 flags = read_byte();
+    record = previous;
+    record.cycle = previous.cycle + read_varint();
+    record.pc = static_cast<u16>(previous.pc + unzigzag(read_varint()));
+    record.opcode = read_byte();
+    record.prefix = (flags & FLAG_CB) ? 0xCB : 0;
+    if (flags & FLAG_AF) { record.af = read_word(); }
+    if (flags & FLAG_BC) { record.bc = read_word(); }
+    if (flags & FLAG_DE) { record.de = read_word(); }
+    if (flags & FLAG_HL) { record.hl = read_word(); }
+    if (flags & FLAG_SP) { record.sp = read_word(); }
+
+    previous = record;
+    return true;
+}
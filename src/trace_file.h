@@ -0,0 +1,98 @@
+#pragma once
+
+#include "trace.h"
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Binary instruction traces (--trace-file), for comparing runs against
+ * each other or against a reference emulator.
+ *
+ * A file is a TraceFileHeader followed by blocks of up to block_records
+ * records. Each block is a TraceBlockHeader and its encoded records; the
+ * first record of a block is encoded against an all-zero record, so
+ * blocks can be decoded on their own. Every record is:
+ *
+ *   u8      flags: bits 0-4 set if af/bc/de/hl/sp changed, bit 5 for a CB prefix
+ *   varint  cycles since the previous record
+ *   varint  zigzag-encoded pc change
+ *   u8      opcode
+ *   u16     each changed register, in flag order, little endian
+ *
+ * Varints are LEB128: seven bits at a time, low bits first. A typical
+ * record is five or six bytes instead of the 24 of a TraceRecord.
+ */
+
+struct TraceFileHeader {
+    char magic[8];
+    u32 version;
+    u32 block_records;
+};
+
+struct TraceBlockHeader {
+    u32 records;
+    u32 bytes;
+};
+
+const char TRACE_FILE_MAGIC[8] = { 'G', 'B', 'T', 'R', 'A', 'C', 'E', '\0' };
+const u32 TRACE_FILE_VERSION = 1;
+
+/* Encodes records as they arrive and writes a block at a time. The last,
+ * partial block is written on destruction */
+class TraceFileWriter : Noncopyable {
+public:
+    /* Throws FatalError if the file can't be created */
+    explicit TraceFileWriter(const std::string& filename);
+    ~TraceFileWriter();
+
+    void write(const TraceRecord* records, uint count);
+
+    /* For Tracer: the writer is owned by the sink and closed with it */
+    static auto sink(const std::string& filename) -> trace_sink_t;
+
+    static const uint BLOCK_RECORDS = 1 << 16;
+
+private:
+    void write_block();
+
+    FILE* file;
+    std::vector<u8> block;
+    uint block_records = 0;
+    TraceRecord previous = {};
+};
+
+/* Decodes a trace held in memory, e.g. a mapped file. A partly written
+ * last block is ignored; anything else malformed throws FatalError */
+class TraceReader {
+public:
+    TraceReader(const u8* inData, size_t inSize);
+
+    /* Moves to the next block; false at the end of the trace */
+    auto next_block() -> bool;
+
+    /* The undecoded bytes of the current block (header included), so
+     * identical blocks can be skipped without decoding them */
+    auto block_data() const -> const u8* { return data + block_start; }
+    auto block_size() const -> size_t { return block_end - block_start; }
+    auto block_record_count() const -> uint { return block_records; }
+
+    /* Next record of the current block; false once it's exhausted */
+    auto next_record(TraceRecord& record) -> bool;
+
+private:
+    auto read_byte() -> u8;
+    auto read_varint() -> u64;
+
+    const u8* data;
+    size_t size;
+
+    size_t block_start = 0;
+    size_t block_end = 0;
+    size_t position = 0;
+    uint block_records = 0;
+    uint records_left = 0;
+    TraceRecord previous = {};
+};
@@ -16,13 +16,20 @@ auto read_bytes(const std::string& filename) -> std::vector<u8> {
     ifstream::pos_type position = stream.tellg();
     auto file_size = static_cast<size_t>(position);
 
-    std::vector<char> file_contents(file_size);
+    std::vector<u8> data(file_size);
 
     stream.seekg(0, ios::beg);
-    stream.read(&file_contents[0], static_cast<std::streamsize>(position));
+    stream.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(position));
     stream.close();
 
-    auto data = std::vector<u8>(file_contents.begin(), file_contents.end());
-
     return data;
 }
+
+void write_bytes(const std::string& filename, const std::vector<u8>& data) {
+    std::ofstream stream(filename.c_str(), std::ios::binary);
+    stream.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+    if (!stream.good()) {
+        fatal_error("Cannot write to file: %s", filename.c_str());
+    }
+}
@@ -6,3 +6,4 @@
 #include "../definitions.h"
 
 auto read_bytes(const std::string& filename) -> std::vector<u8>;
+void write_bytes(const std::string& filename, const std::vector<u8>& data);
@@ -17,10 +17,15 @@
 #include "log.h"
 
 #include "string_utils.h"
+#include "../definitions.h"
 
 #include <cstdarg>
 
-Logger global_logger;
+namespace {
+thread_local Logger default_logger;
+thread_local Logger* active_logger = nullptr;
+} // namespace
+
 const char* COLOR_TRACE = "\033[1;30m";
 const char* COLOR_DEBUG = "\033[1;37m";
 const char* COLOR_UNIMPLEMENTED = "\033[1;35m";
@@ -29,8 +34,13 @@ const char* COLOR_WARNING = "\033[1;33m";
 const char* COLOR_ERROR = "\033[1;31m";
 const char* COLOR_RESET = "\033[0m";
 
+Logger::Logger(LogLevel level) :
+    current_level(level)
+{
+}
+
 void Logger::log(LogLevel level, const char* fmt, ...) {
-    if (!should_log(level)) {
+    if (!should_log(level) || suppress_repeat(level, fmt)) {
         return;
     }
 
@@ -39,6 +49,15 @@ void Logger::log(LogLevel level, const char* fmt, ...) {
     std::string msg = str_format(fmt, args);
     va_end(args);
 
+    if ((level == LogLevel::Warning || level == LogLevel::Unimplemented) && repeats[fmt] == REPEAT_LIMIT) {
+        msg += " (repeated; further messages like this are suppressed)";
+    }
+
+    if (sink) {
+        sink(level, msg);
+        return;
+    }
+
     fprintf((level < LogLevel::Error) ? stdout : stderr,
         "%s| %s%s\n",
         level_color(level), COLOR_RESET, msg.c_str());
@@ -48,14 +67,22 @@ void Logger::set_level(LogLevel level) {
     current_level = level;
 }
 
+void Logger::set_sink(const log_sink_t& _sink) {
+    sink = _sink;
+}
+
 void Logger::enable_tracing() {
     tracing_enabled = true;
 }
 
-auto Logger::should_log(LogLevel level) const -> bool {
-    if (!tracing_enabled && level == LogLevel::Trace) { return false; }
+auto Logger::suppress_repeat(LogLevel level, const char* fmt) -> bool {
+    if (level != LogLevel::Warning && level != LogLevel::Unimplemented) { return false; }
+
+    uint& count = repeats[fmt];
+    if (count >= REPEAT_LIMIT) { return true; }
 
-    return enabled && (current_level <= level);
+    count++;
+    return false;
 }
 
 inline auto Logger::level_color(LogLevel level) -> const char* {
@@ -75,6 +102,29 @@ inline auto Logger::level_color(LogLevel level) -> const char* {
     }
 }
 
+auto current_logger() -> Logger& {
+    return active_logger != nullptr ? *active_logger : default_logger;
+}
+
+LogScope::LogScope(Logger& logger) :
+    previous(active_logger)
+{
+    active_logger = &logger;
+}
+
+LogScope::~LogScope() {
+    active_logger = previous;
+}
+
 void log_set_level(LogLevel level) {
-    global_logger.set_level(level);
+    current_logger().set_level(level);
+}
+
+void throw_fatal_error(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    std::string msg = str_format(fmt, args);
+    va_end(args);
+
+    throw FatalError(msg);
 }
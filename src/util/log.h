@@ -16,7 +16,9 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <functional>
 #include <string>
+#include <unordered_map>
 
 enum class LogLevel {
     Trace,
@@ -27,25 +29,67 @@ enum class LogLevel {
     Error,
 };
 
+/* Messages below this level are compiled out (0 is Trace, as in LogLevel).
+ * Set through the GBEMU_LOG_LEVEL CMake option */
+#ifndef GBEMU_LOG_LEVEL
+#define GBEMU_LOG_LEVEL 0
+#endif
+
+/* Receives each formatted message instead of stdout/stderr */
+using log_sink_t = std::function<void(LogLevel level, const std::string& message)>;
+
 class Logger {
 public:
     Logger() = default;
+    explicit Logger(LogLevel level);
 
     void log(LogLevel level, const char* fmt, ...);
     void set_level(LogLevel level);
+    void set_sink(const log_sink_t& sink);
 
     void enable_tracing();
 
+    /* Checked by the log_* macros before anything is formatted */
+    auto should_log(LogLevel level) const -> bool {
+        if (!tracing_enabled && level == LogLevel::Trace) { return false; }
+        return enabled && (current_level <= level);
+    }
+
+    /* Warnings and unimplemented-feature messages logged from the same
+     * place more often than this are dropped, so a ROM hammering an odd
+     * register can't flood the output */
+    static const uint REPEAT_LIMIT = 10;
+
 private:
-    auto should_log(LogLevel level) const -> bool;
     static auto level_color(LogLevel level) -> const char*;
+    auto suppress_repeat(LogLevel level, const char* fmt) -> bool;
 
     LogLevel current_level = LogLevel::Debug;
     bool enabled = true;
     bool tracing_enabled = false;
+    log_sink_t sink;
+
+    /* By format string, which identifies the call site */
+    std::unordered_map<const char*, uint> repeats;
+};
+
+/* The logger the log_* macros write to. Each Gameboy installs its own with
+ * a LogScope while it runs; outside of one, every thread has a default */
+extern auto current_logger() -> Logger&;
+
+/* Makes a logger current on this thread until the scope ends */
+class LogScope {
+public:
+    explicit LogScope(Logger& logger);
+    ~LogScope();
+
+    LogScope(const LogScope&) = delete;
+    auto operator=(const LogScope&) -> LogScope& = delete;
+
+private:
+    Logger* previous;
 };
 
-extern Logger global_logger;
 extern const char* COLOR_TRACE;
 extern const char* COLOR_DEBUG;
 extern const char* COLOR_UNIMPLEMENTED;
@@ -57,12 +101,22 @@ extern const char* COLOR_RESET;
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wgnu-zero-variadic-macro-arguments"
 
-#define log_trace(...) global_logger.log(LogLevel::Trace, ##__VA_ARGS__);
-#define log_debug(...) global_logger.log(LogLevel::Debug, ##__VA_ARGS__);
-#define log_unimplemented(...) global_logger.log(LogLevel::Unimplemented, ##__VA_ARGS__);
-#define log_info(...) global_logger.log(LogLevel::Info, ##__VA_ARGS__);
-#define log_warn(...) global_logger.log(LogLevel::Warning, ##__VA_ARGS__);
-#define log_error(...) global_logger.log(LogLevel::Error, ##__VA_ARGS__);
+/* Levels below GBEMU_LOG_LEVEL leave dead code behind, which the compiler
+ * drops while still type-checking the arguments */
+#define log_at_level(level, ...) \
+    do { \
+        if (static_cast<int>(level) >= GBEMU_LOG_LEVEL) { \
+            Logger& log_logger = current_logger(); \
+            if (log_logger.should_log(level)) { log_logger.log((level), ##__VA_ARGS__); } \
+        } \
+    } while (false)
+
+#define log_trace(...) log_at_level(LogLevel::Trace, ##__VA_ARGS__);
+#define log_debug(...) log_at_level(LogLevel::Debug, ##__VA_ARGS__);
+#define log_unimplemented(...) log_at_level(LogLevel::Unimplemented, ##__VA_ARGS__);
+#define log_info(...) log_at_level(LogLevel::Info, ##__VA_ARGS__);
+#define log_warn(...) log_at_level(LogLevel::Warning, ##__VA_ARGS__);
+#define log_error(...) log_at_level(LogLevel::Error, ##__VA_ARGS__);
 
 #pragma clang diagnostic pop
 
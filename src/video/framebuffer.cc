@@ -1,22 +1,191 @@
 #include "framebuffer.h"
+#include "../guest_memory.h"
 
-FrameBuffer::FrameBuffer(uint _width, uint _height) :
-    width(_width),
-    height(_height),
-    buffer(width*height, Color::White)
+#include <algorithm>
+#include <cstring>
+
+static auto bytes_for_format(PixelFormat format) -> uint {
+    switch (format) {
+        case PixelFormat::RGBA8888: return 4;
+        case PixelFormat::RGB565: return 2;
+        case PixelFormat::Index8: return 1;
+    }
+
+    return 4;
+}
+
+FrameBuffer::FrameBuffer(uint _width, uint _height, PixelFormat format) :
+    frame_width(_width),
+    frame_height(_height),
+    pixel_format(format),
+    /* Rounded up so the emulator's back buffer and the frontend's front
+     * buffer never share a cache line */
+    buffer_size((pitch() * _height + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE),
+    pixels(buffer_size * BUFFER_COUNT),
+    ready(2)
 {
+    for (uint i = 0; i < 4; i++) {
+        native_colors[i] = native_color(static_cast<Color>(i), format);
+    }
+
+    /* Start every buffer as a white screen: one line is converted, then
+     * copied down the rest */
+    std::vector<Color> white_line(frame_width, Color::White);
+    write_line(0, white_line.data());
+    for (uint buffer = 0; buffer < BUFFER_COUNT; buffer++) {
+        for (uint y = 0; y < frame_height; y++) {
+            if (buffer == 0 && y == 0) { continue; }
+            std::memcpy(&pixels[buffer * buffer_size + y * pitch()], pixels.data(), pitch());
+        }
+    }
+}
+
+auto FrameBuffer::native_color(Color color, PixelFormat format) -> u32 {
+    u8 shade = 0;
+    switch (color) {
+        case Color::White: shade = 255; break;
+        case Color::LightGray: shade = 192; break;
+        case Color::DarkGray: shade = 96; break;
+        case Color::Black: shade = 0; break;
+    }
+
+    return native_shade(static_cast<uint>(color), shade * 0x010101u, format);
+}
+
+auto FrameBuffer::native_shade(uint shade, u32 rgb, PixelFormat format) -> u32 {
+    u32 r = (rgb >> 16) & 0xFF;
+    u32 g = (rgb >> 8) & 0xFF;
+    u32 b = rgb & 0xFF;
+
+    switch (format) {
+        case PixelFormat::RGBA8888:
+            return (r << 24) | (g << 16) | (b << 8) | 0xFF;
+        case PixelFormat::RGB565:
+            return (r >> 3 << 11) | (g >> 2 << 5) | (b >> 3);
+        case PixelFormat::Index8:
+            return shade;
+    }
+
+    return 0;
+}
+
+auto FrameBuffer::native_rgb555(u16 color, PixelFormat format) -> u32 {
+    u32 r = color & 0x1F;
+    u32 g = (color >> 5) & 0x1F;
+    u32 b = (color >> 10) & 0x1F;
+
+    switch (format) {
+        case PixelFormat::RGBA8888:
+            return ((r << 3 | r >> 2) << 24) | ((g << 3 | g >> 2) << 16) | ((b << 3 | b >> 2) << 8) | 0xFF;
+        case PixelFormat::RGB565:
+            return (r << 11) | ((g << 1 | g >> 4) << 5) | b;
+        case PixelFormat::Index8: {
+            /* Out of 31 * 10 */
+            u32 luminance = r * 3 + g * 6 + b;
+            return 3 - std::min(luminance * 4 / (31 * 10 + 1), 3u);
+        }
+    }
+
+    return 0;
+}
+
+void FrameBuffer::write_line(uint y, const Color* colors) {
+    u8* line = &pixels[back * buffer_size + y * pitch()];
+
+    /* Pixels are stored in host byte order, as SDL-style packed formats expect */
+    switch (pixel_format) {
+        case PixelFormat::RGBA8888:
+            for (uint x = 0; x < frame_width; x++) {
+                u32 pixel = native_colors[static_cast<uint>(colors[x])];
+                std::memcpy(line + x * 4, &pixel, 4);
+            }
+            break;
+        case PixelFormat::RGB565:
+            for (uint x = 0; x < frame_width; x++) {
+                auto pixel = static_cast<u16>(native_colors[static_cast<uint>(colors[x])]);
+                std::memcpy(line + x * 2, &pixel, 2);
+            }
+            break;
+        case PixelFormat::Index8:
+            for (uint x = 0; x < frame_width; x++) {
+                line[x] = static_cast<u8>(colors[x]);
+            }
+            break;
+    }
+}
+
+void FrameBuffer::write_native_line(uint y, const u32* line_pixels, const uint first_x, const uint end_x) {
+    u8* line = &pixels[back * buffer_size + y * pitch()];
+
+    switch (pixel_format) {
+        case PixelFormat::RGBA8888:
+            std::memcpy(line + first_x * 4, line_pixels + first_x, (end_x - first_x) * 4);
+            break;
+        case PixelFormat::RGB565:
+            for (uint x = first_x; x < end_x; x++) {
+                auto pixel = static_cast<u16>(line_pixels[x]);
+                std::memcpy(line + x * 2, &pixel, 2);
+            }
+            break;
+        case PixelFormat::Index8:
+            for (uint x = first_x; x < end_x; x++) {
+                line[x] = static_cast<u8>(line_pixels[x]);
+            }
+            break;
+    }
 }
 
-void FrameBuffer::set_pixel(uint x, uint y, Color color) {
-    buffer[pixel_index(x, y)] = color;
+void FrameBuffer::write_indexed_line(uint y, const u8* indices, const u32* palette, const uint first_x,
+                                     const uint end_x) {
+    u8* line = &pixels[back * buffer_size + y * pitch()];
+
+    /* One table lookup per pixel, with the format decided once per line */
+    switch (pixel_format) {
+        case PixelFormat::RGBA8888:
+            for (uint x = first_x; x < end_x; x++) {
+                u32 pixel = palette[indices[x]];
+                std::memcpy(line + x * 4, &pixel, 4);
+            }
+            break;
+        case PixelFormat::RGB565:
+            for (uint x = first_x; x < end_x; x++) {
+                auto pixel = static_cast<u16>(palette[indices[x]]);
+                std::memcpy(line + x * 2, &pixel, 2);
+            }
+            break;
+        case PixelFormat::Index8:
+            for (uint x = first_x; x < end_x; x++) {
+                line[x] = static_cast<u8>(palette[indices[x]]);
+            }
+            break;
+    }
 }
 
-auto FrameBuffer::get_pixel(uint x, uint y) const -> Color { return buffer.at(pixel_index(x, y)); }
+void FrameBuffer::present() {
+    back = ready.exchange(back | READY_FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+}
 
-inline auto FrameBuffer::pixel_index(uint x, uint y) const -> uint { return (y * width) + x; }
+void FrameBuffer::copy_from(const FrameBuffer& other) {
+    std::copy(other.pixels.begin(), other.pixels.end(), pixels.begin());
+    back = other.back;
+    front_index = other.front_index;
+    ready.store(other.ready.load(std::memory_order_acquire), std::memory_order_release);
+}
 
-void FrameBuffer::reset() {
-    for (uint i = 0; i < width * height; i++) {
-        buffer[i] = Color::White;
+auto FrameBuffer::front() const -> const u8* {
+    if ((ready.load(std::memory_order_acquire) & READY_FRESH) != 0) {
+        front_index = ready.exchange(front_index, std::memory_order_acq_rel) & INDEX_MASK;
     }
+
+    return &pixels[front_index * buffer_size];
 }
+
+auto FrameBuffer::format() const -> PixelFormat { return pixel_format; }
+
+auto FrameBuffer::width() const -> uint { return frame_width; }
+
+auto FrameBuffer::height() const -> uint { return frame_height; }
+
+auto FrameBuffer::bytes_per_pixel() const -> uint { return bytes_for_format(pixel_format); }
+
+auto FrameBuffer::pitch() const -> uint { return frame_width * bytes_per_pixel(); }
@@ -2,22 +2,80 @@
 
 #include "../definitions.h"
 
+#include <array>
+#include <atomic>
 #include <vector>
 
+/* Frames are stored directly in the frontend's pixel format, so a finished
+ * frame can be handed to e.g. a streaming texture as-is.
+ *
+ * Video draws into the back buffer and calls present() at VBlank, which
+ * publishes it as the latest completed frame. A frontend reads that frame
+ * through front(). A third buffer sits between the two so that a frontend
+ * on another thread never has to lock or copy: each side only ever swaps
+ * an index with the shared 'ready' slot. */
 class FrameBuffer {
 public:
-    FrameBuffer(uint width, uint height);
+    FrameBuffer(uint width, uint height, PixelFormat format = PixelFormat::RGBA8888);
 
-    void set_pixel(uint x, uint y, Color color);
-    auto get_pixel(uint x, uint y) const -> Color;
+    /* Write a whole line of the back buffer, converting to the native format */
+    void write_line(uint y, const Color* colors);
 
-    void reset();
+    /* Write pixels first_x up to end_x of a line, from pixels already in
+     * the native format (see native_rgb555), indexed by x */
+    void write_native_line(uint y, const u32* pixels, uint first_x, uint end_x);
+
+    /* The same from indices into a table of native pixels */
+    void write_indexed_line(uint y, const u8* indices, const u32* palette, uint first_x, uint end_x);
+
+    /* Publish the back buffer as the latest completed frame */
+    void present();
+
+    /* Takes over the frames of another buffer of the same size and format,
+     * the one being drawn included. Neither may be in use on another thread */
+    void copy_from(const FrameBuffer& other);
+
+    /* The latest completed frame. The view stays valid until the next call
+     * to front(), and should only be called from one thread */
+    auto front() const -> const u8*;
+
+    auto format() const -> PixelFormat;
+    auto width() const -> uint;
+    auto height() const -> uint;
+    auto bytes_per_pixel() const -> uint;
+    /* Bytes per line of pixels */
+    auto pitch() const -> uint;
+
+    /* The native value of a color in a format, i.e. 0xRRGGBBAA, RGB565 or
+     * the shade index, truncated to bytes_per_pixel */
+    static auto native_color(Color color, PixelFormat format) -> u32;
+
+    /* The same for a DMG shade shown as an 0xRRGGBB colour. Index8 keeps
+     * the shade */
+    static auto native_shade(uint shade, u32 rgb, PixelFormat format) -> u32;
+
+    /* The same for a CGB colour, 0bbbbbgggggrrrrr. Index8 gets the nearest
+     * shade by luminance */
+    static auto native_rgb555(u16 color, PixelFormat format) -> u32;
 
 private:
-    uint width;
-    uint height;
+    static const uint BUFFER_COUNT = 3;
+    static const uint READY_FRESH = 0x4;
+    static const uint INDEX_MASK = 0x3;
+
+    uint frame_width;
+    uint frame_height;
+    PixelFormat pixel_format;
+
+    std::array<u32, 4> native_colors;
 
-    auto pixel_index(uint x, uint y) const -> uint;
+    /* The three buffers, one after the other in a single allocation */
+    uint buffer_size;
+    std::vector<u8> pixels;
+    uint back = 0;
+    mutable uint front_index = 1;
 
-    std::vector<Color> buffer;
+    /* Index of the latest completed frame, plus READY_FRESH if it has not
+     * been read through front() yet */
+    mutable std::atomic<uint> ready;
 };
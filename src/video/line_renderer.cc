@@ -0,0 +1,409 @@
+#include "line_renderer.h"
+#include "framebuffer.h"
+
+#include "../util/bitwise.h"
+#include "../util/log.h"
+
+#include <algorithm>
+
+using bitwise::check_bit;
+
+LineRenderer::LineRenderer(const u8* in_video_ram, const bool in_cgb, const PixelFormat in_format,
+                           const std::array<u32, 4>& dmg_palette) :
+    video_ram(in_video_ram),
+    cgb(in_cgb),
+    format(in_format)
+{
+    for (uint shade = 0; shade < shade_pixels.size(); shade++) {
+        shade_pixels[shade] = FrameBuffer::native_shade(shade, dmg_palette[shade], format);
+    }
+    line_palette[BLANK_COLOR] = shade_pixels[0];
+
+    all_vram_written();
+}
+
+void LineRenderer::vram_written(const u16 address) {
+    uint tile = (address % VIDEO_RAM_BANK_SIZE) / TILE_BYTES;
+    if (tile >= TILE_COUNT) { return; }
+
+    tile += address / VIDEO_RAM_BANK_SIZE * TILE_COUNT;
+    if (!tile_dirty[tile]) {
+        tile_dirty[tile] = true;
+        dirty_tiles.push_back(static_cast<u16>(tile));
+    }
+}
+
+void LineRenderer::all_vram_written() {
+    /* A DMG never touches the second bank */
+    uint tiles = cgb ? BANK_COUNT * TILE_COUNT : TILE_COUNT;
+
+    dirty_tiles.clear();
+    for (uint tile = 0; tile < tiles; tile++) {
+        tile_dirty[tile] = true;
+        dirty_tiles.push_back(static_cast<u16>(tile));
+    }
+}
+
+void LineRenderer::decode_dirty_tiles() {
+    for (u16 tile : dirty_tiles) {
+        const u8* data = &video_ram[tile / TILE_COUNT * VIDEO_RAM_BANK_SIZE + tile % TILE_COUNT * TILE_BYTES];
+        u64* rows = &decoded_tiles[tile * TILE_HEIGHT_PX];
+
+        for (uint row = 0; row < TILE_HEIGHT_PX; row++) {
+            rows[row] = decode_tile_row(data[row * 2], data[row * 2 + 1]);
+        }
+
+        tile_dirty[tile] = false;
+    }
+
+    dirty_tiles.clear();
+}
+
+void LineRenderer::draw_line(const LineState& state, FrameBuffer& buffer) {
+    if (cgb) {
+        draw_cgb_line(state, buffer);
+        return;
+    }
+
+    line_indices.fill(BLANK_COLOR);
+
+    /* Bit 7 of LCDC: display enabled */
+    if (check_bit(state.lcd_control, 7)) {
+        decode_dirty_tiles();
+        load_palettes(state);
+
+        if (check_bit(state.lcd_control, 0) && !(state.debug_flags & LineState::DEBUG_NO_BACKGROUND)) {
+            draw_bg_line(state);
+        } else {
+            original_colors.fill(GBColor::Color0);
+        }
+
+        if (check_bit(state.lcd_control, 5) && !(state.debug_flags & LineState::DEBUG_NO_WINDOW)) {
+            draw_window_line(state);
+        }
+
+        if (check_bit(state.lcd_control, 1) && !(state.debug_flags & LineState::DEBUG_NO_SPRITES)) {
+            draw_sprites_line(state);
+        }
+    }
+
+    buffer.write_indexed_line(state.line, line_indices.data(), line_palette.data(), state.first_x, state.end_x);
+}
+
+/* Byte i of spread_table[b] holds bit (7 - i) of b, i.e. the pixel at x = i
+ * of one bitplane of a tile row. Combining both bitplanes then yields all
+ * eight colour indices of the row with one shift and OR */
+static constexpr auto spread_bits(u8 byte) -> u64 {
+    u64 spread = 0;
+    for (uint i = 0; i < 8; i++) {
+        spread |= static_cast<u64>((byte >> (7 - i)) & 1) << (i * 8);
+    }
+    return spread;
+}
+
+static constexpr auto make_spread_table() -> std::array<u64, 256> {
+    std::array<u64, 256> table = {};
+    for (uint byte = 0; byte < 256; byte++) {
+        table[byte] = spread_bits(static_cast<u8>(byte));
+    }
+    return table;
+}
+
+static constexpr std::array<u64, 256> spread_table = make_spread_table();
+
+auto LineRenderer::decode_tile_row(u8 byte1, u8 byte2) -> u64 {
+    return spread_table[byte1] | (spread_table[byte2] << 1);
+}
+
+auto LineRenderer::tile_index(const LineState& state, u8 tile_id) -> uint {
+    /* Note: tileset two uses signed numbering to share half the tiles with
+     * tileset 1, so its tile 0 is tile 256 of the whole tile data area */
+    return check_bit(state.lcd_control, 4)
+        ? tile_id
+        : static_cast<uint>(256 + static_cast<s8>(tile_id));
+}
+
+void LineRenderer::draw_tile_line(const LineState& state, const u8* tile_map_row, uint map_x, uint tile_pixel_y,
+                                  uint screen_x) {
+    /* Work a whole tile at a time: fetch its ID and decoded row once, then
+     * emit its pixels. Only the first and last tile of the line are partial */
+    while (screen_x < GAMEBOY_WIDTH) {
+        uint tile_x = (map_x / TILE_WIDTH_PX) % TILES_PER_LINE;
+        uint tile_pixel_x = map_x % TILE_WIDTH_PX;
+
+        u64 indices = decoded_tiles[tile_index(state, tile_map_row[tile_x]) * TILE_HEIGHT_PX + tile_pixel_y];
+
+        uint count = std::min(TILE_WIDTH_PX - tile_pixel_x, GAMEBOY_WIDTH - screen_x);
+        for (uint i = 0; i < count; i++) {
+            auto index = static_cast<uint>(indices >> ((tile_pixel_x + i) * 8)) & 0x3;
+            original_colors[screen_x + i] = static_cast<GBColor>(index);
+            line_indices[screen_x + i] = static_cast<u8>(BG_COLORS + index);
+        }
+
+        screen_x += count;
+        map_x += count;
+    }
+}
+
+void LineRenderer::draw_bg_line(const LineState& state) {
+    /* Bit 3 of LCDC: background tile map */
+    Address tile_map_address = check_bit(state.lcd_control, 3)
+        ? TILE_MAP_ONE_ADDRESS
+        : TILE_MAP_ZERO_ADDRESS;
+
+    /* Work out which row of the full background map this line shows */
+    uint bg_map_y = (state.line + state.scroll_y) % BG_MAP_SIZE;
+    uint tile_y = bg_map_y / TILE_HEIGHT_PX;
+
+    const u8* tile_map_row = &video_ram[tile_map_address.value() - 0x8000 + tile_y * TILES_PER_LINE];
+
+    if (cgb) {
+        draw_cgb_tile_line(tile_map_row, state.scroll_x, bg_map_y % TILE_HEIGHT_PX, 0, state);
+    } else {
+        draw_tile_line(state, tile_map_row, state.scroll_x, bg_map_y % TILE_HEIGHT_PX, 0);
+    }
+}
+
+void LineRenderer::draw_window_line(const LineState& state) {
+    /* Bit 6 of LCDC: window tile map */
+    Address tile_map_address = check_bit(state.lcd_control, 6)
+        ? TILE_MAP_ONE_ADDRESS
+        : TILE_MAP_ZERO_ADDRESS;
+
+    uint window_line = static_cast<uint>(state.line) - state.window_y;
+    if (window_line >= GAMEBOY_HEIGHT) { return; }
+
+    /* The window starts at WX - 7 on screen and is always drawn from its
+     * own left edge */
+    int window_start = state.window_x - 7;
+    uint screen_x = static_cast<uint>(std::max(window_start, 0));
+    if (screen_x >= GAMEBOY_WIDTH) { return; }
+
+    uint tile_y = window_line / TILE_HEIGHT_PX;
+
+    const u8* tile_map_row = &video_ram[tile_map_address.value() - 0x8000 + tile_y * TILES_PER_LINE];
+
+    uint map_x = static_cast<uint>(static_cast<int>(screen_x) - window_start);
+    if (cgb) {
+        draw_cgb_tile_line(tile_map_row, map_x, window_line % TILE_HEIGHT_PX, screen_x, state);
+    } else {
+        draw_tile_line(state, tile_map_row, map_x, window_line % TILE_HEIGHT_PX, screen_x);
+    }
+}
+
+void LineRenderer::draw_sprites_line(const LineState& state) {
+    /* Bit 2 of LCDC: 8x16 sprites */
+    uint sprite_height = check_bit(state.lcd_control, 2) ? TILE_HEIGHT_PX * 2 : TILE_HEIGHT_PX;
+
+    /* The sprite with the lowest X wins where sprites overlap, and the one
+     * earlier in OAM on a tie. The sprites are already in OAM order */
+    std::array<u8, MAX_SPRITES_PER_LINE> by_priority = {};
+    for (uint i = 0; i < state.sprite_count; i++) { by_priority[i] = static_cast<u8>(i); }
+    std::stable_sort(by_priority.begin(), by_priority.begin() + state.sprite_count,
+        [&state](u8 left, u8 right) {
+            return state.sprites[left][1] < state.sprites[right][1];
+        });
+
+    /* Set once the highest priority sprite has an opaque pixel at an X,
+     * whether or not it ends up hidden behind the background */
+    std::array<bool, GAMEBOY_WIDTH> claimed = {};
+
+    for (uint i = 0; i < state.sprite_count; i++) {
+        const u8* sprite = state.sprites[by_priority[i]].data();
+
+        int start_x = sprite[1] - 8;
+        uint sprite_line = state.line + 16u - sprite[0];
+        u8 pattern_n = sprite[2];
+        u8 sprite_attrs = sprite[3];
+
+        /* Bits 0-3 are used only for CGB */
+        bool use_palette_1 = check_bit(sprite_attrs, 4);
+        bool flip_x = check_bit(sprite_attrs, 5);
+        bool flip_y = check_bit(sprite_attrs, 6);
+        bool obj_behind_bg = check_bit(sprite_attrs, 7);
+
+        u8 colors = use_palette_1 ? SPRITE_1_COLORS : SPRITE_0_COLORS;
+
+        if (flip_y) { sprite_line = sprite_height - sprite_line - 1; }
+
+        /* Sprites are always taken from the first tileset. In 8x16 mode the
+         * low bit of the tile number is ignored, and the second tile's rows
+         * directly follow the first's */
+        if (sprite_height > TILE_HEIGHT_PX) { pattern_n &= 0xFE; }
+        u64 row = decoded_tiles[pattern_n * TILE_HEIGHT_PX + sprite_line];
+
+        for (uint x = 0; x < TILE_WIDTH_PX; x++) {
+            int screen_x = start_x + static_cast<int>(x);
+            if (screen_x < 0 || screen_x >= static_cast<int>(GAMEBOY_WIDTH)) { continue; }
+
+            uint tile_x = !flip_x ? x : TILE_WIDTH_PX - x - 1;
+            auto gb_color = static_cast<GBColor>((row >> (tile_x * 8)) & 0x3);
+
+            // Color 0 is transparent
+            if (gb_color == GBColor::Color0) { continue; }
+
+            if (claimed[screen_x]) { continue; }
+            claimed[screen_x] = true;
+
+            /* Sprites behind the background only show through its color 0 */
+            if (obj_behind_bg && original_colors[screen_x] != GBColor::Color0) { continue; }
+
+            line_indices[screen_x] = static_cast<u8>(colors + static_cast<u8>(gb_color));
+        }
+    }
+}
+
+void LineRenderer::load_palettes(const LineState& state) {
+    const u8 palettes[3] = { state.bg_palette, state.sprite_palette_0, state.sprite_palette_1 };
+
+    /* Each register holds the shade of colours 0-3, two bits apiece */
+    for (uint palette = 0; palette < 3; palette++) {
+        for (uint color = 0; color < 4; color++) {
+            line_palette[palette * 4 + color] = shade_pixels[(palettes[palette] >> (color * 2)) & 0x3];
+        }
+    }
+}
+
+/* Reverses the order of a decoded row's pixels, for tiles flipped in X */
+static auto reverse_pixels(u64 row) -> u64 {
+    row = (row >> 32) | (row << 32);
+    row = ((row & 0xFFFF0000FFFF0000ull) >> 16) | ((row & 0x0000FFFF0000FFFFull) << 16);
+    return ((row & 0xFF00FF00FF00FF00ull) >> 8) | ((row & 0x00FF00FF00FF00FFull) << 8);
+}
+
+void LineRenderer::load_cgb_palettes(const LineState& state) {
+    for (uint i = 0; i < CGB_PALETTE_COLORS; i++) {
+        auto bg = static_cast<u16>(state.bg_palette_ram[i * 2] | state.bg_palette_ram[i * 2 + 1] << 8);
+        auto sprite = static_cast<u16>(state.sprite_palette_ram[i * 2] | state.sprite_palette_ram[i * 2 + 1] << 8);
+
+        bg_colors[i] = FrameBuffer::native_rgb555(bg, format);
+        sprite_colors[i] = FrameBuffer::native_rgb555(sprite, format);
+    }
+}
+
+void LineRenderer::draw_cgb_line(const LineState& state, FrameBuffer& buffer) {
+    const u32 white = FrameBuffer::native_rgb555(0x7FFF, format);
+
+    /* Bit 7 of LCDC: display enabled */
+    if (!check_bit(state.lcd_control, 7)) {
+        line_pixels.fill(white);
+        buffer.write_native_line(state.line, line_pixels.data(), state.first_x, state.end_x);
+        return;
+    }
+
+    decode_dirty_tiles();
+    load_cgb_palettes(state);
+
+    /* The background is always drawn on a CGB; LCDC bit 0 only decides
+     * whether it can hide sprites */
+    if (!(state.debug_flags & LineState::DEBUG_NO_BACKGROUND)) {
+        draw_bg_line(state);
+    } else {
+        line_pixels.fill(white);
+        original_colors.fill(GBColor::Color0);
+        bg_priority.fill(false);
+    }
+
+    if (check_bit(state.lcd_control, 5) && !(state.debug_flags & LineState::DEBUG_NO_WINDOW)) {
+        draw_window_line(state);
+    }
+
+    if (check_bit(state.lcd_control, 1) && !(state.debug_flags & LineState::DEBUG_NO_SPRITES)) {
+        draw_cgb_sprites_line(state);
+    }
+
+    buffer.write_native_line(state.line, line_pixels.data(), state.first_x, state.end_x);
+}
+
+void LineRenderer::draw_cgb_tile_line(const u8* tile_map_row, uint map_x, const uint tile_pixel_y, uint screen_x,
+                                      const LineState& state) {
+    /* Each map entry's attributes sit at the same place in bank 1 */
+    const u8* attribute_row = tile_map_row + VIDEO_RAM_BANK_SIZE;
+
+    while (screen_x < GAMEBOY_WIDTH) {
+        uint tile_x = (map_x / TILE_WIDTH_PX) % TILES_PER_LINE;
+        uint tile_pixel_x = map_x % TILE_WIDTH_PX;
+
+        /* Bits 0-2: palette, 3: tile bank, 5: X flip, 6: Y flip, 7: priority over sprites */
+        u8 attributes = attribute_row[tile_x];
+        uint tile = tile_index(state, tile_map_row[tile_x]) + (check_bit(attributes, 3) ? TILE_COUNT : 0);
+        uint row = check_bit(attributes, 6) ? TILE_HEIGHT_PX - 1 - tile_pixel_y : tile_pixel_y;
+
+        u64 indices = decoded_tiles[tile * TILE_HEIGHT_PX + row];
+        if (check_bit(attributes, 5)) { indices = reverse_pixels(indices); }
+
+        const u32* colors = &bg_colors[(attributes & 0x7) * 4];
+        bool priority = check_bit(attributes, 7);
+
+        uint count = std::min(TILE_WIDTH_PX - tile_pixel_x, GAMEBOY_WIDTH - screen_x);
+        for (uint i = 0; i < count; i++) {
+            auto index = static_cast<uint>(indices >> ((tile_pixel_x + i) * 8)) & 0x3;
+            original_colors[screen_x + i] = static_cast<GBColor>(index);
+            bg_priority[screen_x + i] = priority;
+            line_pixels[screen_x + i] = colors[index];
+        }
+
+        screen_x += count;
+        map_x += count;
+    }
+}
+
+void LineRenderer::draw_cgb_sprites_line(const LineState& state) {
+    uint sprite_height = check_bit(state.lcd_control, 2) ? TILE_HEIGHT_PX * 2 : TILE_HEIGHT_PX;
+
+    /* On a CGB the sprite earlier in OAM wins outright, unless OPRI asks
+     * for the DMG's priority by X */
+    std::array<u8, MAX_SPRITES_PER_LINE> by_priority = {};
+    for (uint i = 0; i < state.sprite_count; i++) { by_priority[i] = static_cast<u8>(i); }
+    if (state.object_priority != 0) {
+        std::stable_sort(by_priority.begin(), by_priority.begin() + state.sprite_count,
+            [&state](u8 left, u8 right) {
+                return state.sprites[left][1] < state.sprites[right][1];
+            });
+    }
+
+    /* With LCDC bit 0 clear, sprites are always drawn over the background */
+    bool bg_can_win = check_bit(state.lcd_control, 0);
+
+    std::array<bool, GAMEBOY_WIDTH> claimed = {};
+
+    for (uint i = 0; i < state.sprite_count; i++) {
+        const u8* sprite = state.sprites[by_priority[i]].data();
+
+        int start_x = sprite[1] - 8;
+        uint sprite_line = state.line + 16u - sprite[0];
+        u8 pattern_n = sprite[2];
+        u8 sprite_attrs = sprite[3];
+
+        /* Bits 0-2: palette, 3: tile bank */
+        const u32* colors = &sprite_colors[(sprite_attrs & 0x7) * 4];
+        uint bank_tiles = check_bit(sprite_attrs, 3) ? TILE_COUNT : 0;
+        bool flip_x = check_bit(sprite_attrs, 5);
+        bool flip_y = check_bit(sprite_attrs, 6);
+        bool obj_behind_bg = check_bit(sprite_attrs, 7);
+
+        if (flip_y) { sprite_line = sprite_height - sprite_line - 1; }
+        if (sprite_height > TILE_HEIGHT_PX) { pattern_n &= 0xFE; }
+
+        u64 row = decoded_tiles[(bank_tiles + pattern_n) * TILE_HEIGHT_PX + sprite_line];
+        if (flip_x) { row = reverse_pixels(row); }
+
+        for (uint x = 0; x < TILE_WIDTH_PX; x++) {
+            int screen_x = start_x + static_cast<int>(x);
+            if (screen_x < 0 || screen_x >= static_cast<int>(GAMEBOY_WIDTH)) { continue; }
+
+            auto index = static_cast<uint>(row >> (x * 8)) & 0x3;
+            if (index == 0) { continue; }
+
+            if (claimed[screen_x]) { continue; }
+            claimed[screen_x] = true;
+
+            /* Either the map entry or the sprite can put it behind the
+             * background, which still only hides it with colours 1-3 */
+            bool behind = obj_behind_bg || bg_priority[screen_x];
+            if (bg_can_win && behind && original_colors[screen_x] != GBColor::Color0) { continue; }
+
+            line_pixels[screen_x] = colors[index];
+        }
+    }
+}
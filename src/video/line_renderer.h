@@ -0,0 +1,137 @@
+#pragma once
+
+#include "tile.h"
+
+#include "../definitions.h"
+#include "../guest_memory.h"
+
+#include <array>
+#include <vector>
+
+class FrameBuffer;
+
+/* Each of the CGB's palette memories holds eight palettes of four BGR555
+ * colours, two bytes each, low byte first */
+const uint PALETTE_RAM_SIZE = 64;
+const uint CGB_PALETTE_COLORS = PALETTE_RAM_SIZE / 2;
+
+/* Everything drawing one line needs besides VRAM: the registers as they
+ * were when it was drawn, and the OAM entries of its sprites */
+struct LineState {
+    u8 line;
+    /* The pixels of the line to draw, which is all of it unless registers
+     * changed partway through (see PpuTiming::Accurate) */
+    u8 first_x;
+    u8 end_x;
+    u8 lcd_control;
+    u8 scroll_y;
+    u8 scroll_x;
+    u8 window_y;
+    u8 window_x;
+    u8 bg_palette;
+    u8 sprite_palette_0;
+    u8 sprite_palette_1;
+
+    /* Video's debug toggles, as DEBUG_* bits */
+    u8 debug_flags;
+
+    /* In OAM order */
+    u8 sprite_count;
+    std::array<std::array<u8, SPRITE_BYTES>, MAX_SPRITES_PER_LINE> sprites;
+
+    /* CGB only: palette memory, and OPRI (1 for DMG-style priority by X) */
+    std::array<u8, PALETTE_RAM_SIZE> bg_palette_ram;
+    std::array<u8, PALETTE_RAM_SIZE> sprite_palette_ram;
+    u8 object_priority;
+
+    static const u8 DEBUG_NO_BACKGROUND = 0x1;
+    static const u8 DEBUG_NO_WINDOW = 0x2;
+    static const u8 DEBUG_NO_SPRITES = 0x4;
+};
+
+/*
+ * Draws lines from a LineState and a view of VRAM into a frame buffer.
+ *
+ * Tile data is kept decoded to one u64 of colour indices per tile row. A
+ * write to a tile has to be reported through vram_written(), which marks
+ * it dirty; it is re-decoded before the next line uses it.
+ *
+ * In CGB mode both VRAM banks are used, with the map attributes in bank 1,
+ * and colours come from palette memory. Those are converted to the frame
+ * buffer's format once per line, and lines are written out as native
+ * pixels.
+ *
+ * On a DMG, a line is drawn as indices into a table of the three palettes
+ * (BGP, OBP0, OBP1) in the frame buffer's format, built once per line, so
+ * the palettes and the output colours are applied in a single lookup.
+ */
+class LineRenderer {
+public:
+    /* 'dmg_palette' as in Options */
+    LineRenderer(const u8* video_ram, bool cgb, PixelFormat format, const std::array<u32, 4>& dmg_palette);
+
+    /* An offset into VRAM, either bank */
+    void vram_written(u16 address);
+    void all_vram_written();
+
+    void draw_line(const LineState& state, FrameBuffer& buffer);
+
+private:
+    void draw_bg_line(const LineState& state);
+    void draw_window_line(const LineState& state);
+    void draw_tile_line(const LineState& state, const u8* tile_map_row, uint map_x, uint tile_pixel_y, uint screen_x);
+    void draw_sprites_line(const LineState& state);
+
+    void draw_cgb_line(const LineState& state, FrameBuffer& buffer);
+    void draw_cgb_tile_line(const u8* tile_map_row, uint map_x, uint tile_pixel_y, uint screen_x,
+                            const LineState& state);
+    void draw_cgb_sprites_line(const LineState& state);
+    void load_cgb_palettes(const LineState& state);
+
+    /* Expand a tile row's two bitplanes into eight colour indices, one per
+     * byte with the leftmost pixel in the lowest byte */
+    static auto decode_tile_row(u8 byte1, u8 byte2) -> u64;
+    static auto tile_index(const LineState& state, u8 tile_id) -> uint;
+    void decode_dirty_tiles();
+
+    /* Fills line_palette for BGP, OBP0 and OBP1 */
+    void load_palettes(const LineState& state);
+
+    const u8* video_ram;
+    bool cgb;
+    PixelFormat format;
+
+    /* The tiles of bank 1 follow those of bank 0 */
+    static const uint BANK_COUNT = VIDEO_RAM_SIZE / VIDEO_RAM_BANK_SIZE;
+    /* Left uninitialised: every tile starts out dirty, so none is read
+     * before it's decoded, and an instance which never draws (or a fork
+     * until it does) doesn't touch the memory at all */
+    std::array<u64, BANK_COUNT * TILE_COUNT * TILE_HEIGHT_PX> decoded_tiles;
+    std::array<bool, BANK_COUNT * TILE_COUNT> tile_dirty = {};
+    std::vector<u16> dirty_tiles;
+
+    /* The line being drawn, as indices into line_palette: the background
+     * and window's colours come first, then OBP0's, then OBP1's, then
+     * white for a line without a background */
+    static constexpr u8 BG_COLORS = 0;
+    static constexpr u8 SPRITE_0_COLORS = 4;
+    static constexpr u8 SPRITE_1_COLORS = 8;
+    static constexpr u8 BLANK_COLOR = 12;
+    std::array<u8, GAMEBOY_WIDTH> line_indices = {};
+    std::array<u32, 16> line_palette = {};
+
+    /* The four shades in the frame buffer's format */
+    std::array<u32, 4> shade_pixels;
+
+    /* Background/window color indices (before the palette) of the line
+     * being drawn, for sprites which sit behind the background */
+    std::array<GBColor, GAMEBOY_WIDTH> original_colors = {};
+
+    /* CGB mode: the line in the frame buffer's format, which background
+     * pixels have their map attribute's priority bit set, and the palettes
+     * converted for the line */
+    std::array<u32, GAMEBOY_WIDTH> line_pixels = {};
+    std::array<bool, GAMEBOY_WIDTH> bg_priority = {};
+    std::array<u32, CGB_PALETTE_COLORS> bg_colors = {};
+    std::array<u32, CGB_PALETTE_COLORS> sprite_colors = {};
+};
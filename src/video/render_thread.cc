@@ -0,0 +1,129 @@
+#include "render_thread.h"
+#include "framebuffer.h"
+
+#include <cstring>
+
+RenderThread::RenderThread(FrameBuffer& in_buffer, const u8* in_video_ram, const bool cgb,
+                           const std::array<u32, 4>& dmg_palette) :
+    buffer(in_buffer),
+    renderer(video_ram.data(), cgb, in_buffer.format(), dmg_palette),
+    lines(LINE_CAPACITY),
+    writes(WRITE_CAPACITY),
+    lines_written(0),
+    writes_written(0),
+    lines_read(0),
+    writes_read(0),
+    sleeping(false)
+{
+    std::memcpy(video_ram.data(), in_video_ram, video_ram.size());
+    thread = std::thread([this]() { run(); });
+}
+
+RenderThread::~RenderThread() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+void RenderThread::vram_written(const u16 address, const u8 value) {
+    u64 position = writes_written.load(std::memory_order_relaxed);
+    wait_for_space(writes_read, position, WRITE_CAPACITY);
+
+    writes[position & (WRITE_CAPACITY - 1)] = static_cast<u32>(address) << 8 | value;
+    writes_written.store(position + 1, std::memory_order_release);
+}
+
+void RenderThread::draw_line(const LineState& state) {
+    u64 position = lines_written.load(std::memory_order_relaxed);
+    wait_for_space(lines_read, position, LINE_CAPACITY);
+
+    PendingLine& line = lines[position & (LINE_CAPACITY - 1)];
+    line.state = state;
+    line.writes_before = writes_written.load(std::memory_order_relaxed);
+    lines_written.store(position + 1, std::memory_order_release);
+
+    wake_worker();
+}
+
+void RenderThread::finish() {
+    u64 target = lines_written.load(std::memory_order_relaxed);
+    if (lines_read.load(std::memory_order_acquire) == target) { return; }
+
+    wake_worker();
+    while (lines_read.load(std::memory_order_acquire) != target) { std::this_thread::yield(); }
+}
+
+void RenderThread::wait_for_space(const std::atomic<u64>& read_position, const u64 write_position,
+                                  const uint capacity) {
+    if (write_position - read_position.load(std::memory_order_acquire) < capacity) { return; }
+
+    wake_worker();
+    while (write_position - read_position.load(std::memory_order_acquire) >= capacity) {
+        std::this_thread::yield();
+    }
+}
+
+void RenderThread::wake_worker() {
+    /* Pairs with the fence in run(): either the worker sees the new work,
+     * or this sees it asleep */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!sleeping.load(std::memory_order_relaxed)) { return; }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    wake.notify_one();
+}
+
+auto RenderThread::has_work() const -> bool {
+    return lines_read.load(std::memory_order_relaxed) != lines_written.load(std::memory_order_acquire) ||
+           writes_read.load(std::memory_order_relaxed) != writes_written.load(std::memory_order_acquire);
+}
+
+void RenderThread::apply_writes(const u64 until) {
+    u64 position = writes_read.load(std::memory_order_relaxed);
+
+    for (; position < until; position++) {
+        u32 write = writes[position & (WRITE_CAPACITY - 1)];
+        auto address = static_cast<u16>(write >> 8);
+
+        video_ram[address] = static_cast<u8>(write);
+        renderer.vram_written(address);
+    }
+
+    writes_read.store(position, std::memory_order_release);
+}
+
+void RenderThread::run() {
+    while (true) {
+        /* Read before checking for lines: a write seen here was made before
+         * any line not seen yet, so it can be replayed before drawing it */
+        u64 writes_available = writes_written.load(std::memory_order_acquire);
+        u64 line_position = lines_read.load(std::memory_order_relaxed);
+
+        if (line_position != lines_written.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            const PendingLine& line = lines[line_position & (LINE_CAPACITY - 1)];
+
+            apply_writes(line.writes_before);
+            renderer.draw_line(line.state, buffer);
+            lines_read.store(line_position + 1, std::memory_order_release);
+            continue;
+        }
+
+        if (writes_read.load(std::memory_order_relaxed) != writes_available) {
+            std::lock_guard<std::mutex> lock(mutex);
+            apply_writes(writes_available);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (stopping) { return; }
+
+        sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        wake.wait(lock, [this]() { return stopping || has_work(); });
+        sleeping.store(false, std::memory_order_relaxed);
+    }
+}
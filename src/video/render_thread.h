@@ -0,0 +1,80 @@
+#pragma once
+
+#include "line_renderer.h"
+
+#include "../guest_memory.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class FrameBuffer;
+
+/*
+ * Draws lines on a thread of its own, for Options::threaded_video.
+ *
+ * The emulation thread hands over each line's LineState as the line would
+ * have been drawn, and every VRAM write as it happens. The worker keeps its
+ * own copy of VRAM, and replays the writes which came before a line just
+ * before drawing it, so mid-frame changes to registers, tiles and sprites
+ * show up exactly where they would without the thread.
+ *
+ * Both are handed over through single-producer, single-consumer rings, so
+ * neither side takes a lock unless the worker has gone to sleep for lack
+ * of work or a ring is full.
+ */
+class RenderThread {
+public:
+    RenderThread(FrameBuffer& buffer, const u8* video_ram, bool cgb, const std::array<u32, 4>& dmg_palette);
+    ~RenderThread();
+
+    /* Emulation thread side */
+    void vram_written(u16 address, u8 value);
+    void draw_line(const LineState& state);
+
+    /* Waits until every line handed over is in the frame buffer */
+    void finish();
+
+private:
+    /* Powers of two, so positions can be masked. A frame's lines fit in
+     * the line ring several times over; the VRAM ring holds several times
+     * a full rewrite of VRAM */
+    static const uint LINE_CAPACITY = 512;
+    static const uint WRITE_CAPACITY = 32768;
+
+    struct PendingLine {
+        LineState state;
+        /* Position of the VRAM ring this line was drawn at */
+        u64 writes_before;
+    };
+
+    void run();
+    auto has_work() const -> bool;
+    void apply_writes(u64 until);
+    void wake_worker();
+    void wait_for_space(const std::atomic<u64>& read_position, u64 write_position, uint capacity);
+
+    FrameBuffer& buffer;
+
+    std::array<u8, VIDEO_RAM_SIZE> video_ram = {};
+    LineRenderer renderer;
+
+    std::vector<PendingLine> lines;
+    /* Address in the upper bits, value in the low byte */
+    std::vector<u32> writes;
+
+    /* Counts which only ever increase, each written by one side */
+    alignas(64) std::atomic<u64> lines_written;
+    std::atomic<u64> writes_written;
+    alignas(64) std::atomic<u64> lines_read;
+    std::atomic<u64> writes_read;
+
+    alignas(64) std::atomic<bool> sleeping;
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable wake;
+
+    std::thread thread;
+};
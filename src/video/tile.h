@@ -2,9 +2,6 @@
 
 #include "../address.h"
 #include "../definitions.h"
-#include "../mmu.h"
-
-#include <array>
 
 const uint TILES_PER_LINE = 32;
 const uint TILE_HEIGHT_PX = 8;
@@ -19,17 +16,11 @@ const Address TILE_MAP_ONE_ADDRESS = 0x9C00;
 /* A single tile contains 8 lines, each of which is two bytes */
 const uint TILE_BYTES = 2 * 8;
 
-const uint SPRITE_BYTES = 4;
-
-class Tile {
-public:
-    Tile(Address& address, MMU& mmu, uint size_multiplier = 1);
+/* Tile data spans 0x8000-0x97FF */
+const uint TILE_COUNT = 384;
 
-    auto get_pixel(uint x, uint y) const -> GBColor;
-
-private:
-    static auto pixel_index(uint x, uint y) -> uint;
-    static auto get_pixel_line(u8 byte1, u8 byte2) -> std::vector<u8>;
+const uint SPRITE_BYTES = 4;
+const uint SPRITE_COUNT = 40;
 
-    std::array<GBColor, TILE_HEIGHT_PX * 2 * TILE_WIDTH_PX> buffer;
-};
+/* The PPU only picks up the first ten sprites (in OAM order) on each line */
+const uint MAX_SPRITES_PER_LINE = 10;
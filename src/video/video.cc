@@ -1,438 +1,518 @@
 #include "video.h"
 
-#include "color.h"
+#include "render_thread.h"
 #include "../gameboy.h"
 #include "../cpu/cpu.h"
 
 #include "../util/bitwise.h"
 #include "../util/log.h"
+#include "../save_state.h"
+
+#include <algorithm>
+#include <array>
 
 using bitwise::check_bit;
 
 Video::Video(Gameboy& inGb, Options& inOptions) :
     gb(inGb),
-    buffer(GAMEBOY_WIDTH, GAMEBOY_HEIGHT),
-    background_map(BG_MAP_SIZE, BG_MAP_SIZE)
+    cgb(inGb.cgb_mode()),
+    buffer(GAMEBOY_WIDTH, GAMEBOY_HEIGHT, inOptions.pixel_format),
+    video_ram(inGb.memory.video_ram),
+    renderer(video_ram.data(), cgb, inOptions.pixel_format, inOptions.dmg_palette),
+    ppu_timing(inOptions.ppu_timing)
 {
-    video_ram = std::vector<u8>(0x4000);
-}
+    if (inOptions.threaded_video) {
+        render_thread = std::make_unique<RenderThread>(buffer, video_ram.data(), cgb, inOptions.dmg_palette);
+    }
 
-u8 Video::read(const Address& address) {
-    return video_ram.at(address.value());
-}
+    /* Palette memory starts out white, except for background palette 0,
+     * given the DMG's shades so that a game which never sets them shows up */
+    if (cgb) {
+        bg_palettes.bytes.fill(0xFF);
+        sprite_palettes.bytes.fill(0xFF);
 
-void Video::write(const Address& address, u8 value) {
-    video_ram.at(address.value()) = value;
+        const std::array<u16, 4> greys = {0x7FFF, 0x5294, 0x294A, 0x0000};
+        for (uint i = 0; i < greys.size(); i++) {
+            bg_palettes.bytes[i * 2] = static_cast<u8>(greys[i]);
+            bg_palettes.bytes[i * 2 + 1] = static_cast<u8>(greys[i] >> 8);
+        }
+    }
 }
 
-void Video::tick(Cycles cycles) {
-    cycle_counter += cycles.cycles;
+Video::~Video() = default;
 
-    switch (current_mode) {
-        case VideoMode::ACCESS_OAM:
-            if (cycle_counter >= CLOCKS_PER_SCANLINE_OAM) {
-                cycle_counter = cycle_counter % CLOCKS_PER_SCANLINE_OAM;
-                lcd_status.set_bit_to(1, true);
-                lcd_status.set_bit_to(0, true);
-                current_mode = VideoMode::ACCESS_VRAM;
-            }
-            break;
-        case VideoMode::ACCESS_VRAM:
-            if (cycle_counter >= CLOCKS_PER_SCANLINE_VRAM) {
-                cycle_counter = cycle_counter % CLOCKS_PER_SCANLINE_VRAM;
-                current_mode = VideoMode::HBLANK;
-
-                bool hblank_interrupt = bitwise::check_bit(lcd_status.value(), 3);
-
-                if (hblank_interrupt) {
-                    gb.cpu.interrupt_flag.set_bit_to(1, true);
-                }
+void Video::copy_frames(Video& other) {
+    if (other.render_thread) { other.render_thread->finish(); }
 
-                bool ly_coincidence_interrupt = bitwise::check_bit(lcd_status.value(), 6);
-                bool ly_coincidence = ly_compare.value() == line.value();
-                if (ly_coincidence_interrupt && ly_coincidence) {
-                    gb.cpu.interrupt_flag.set_bit_to(1, true);
-                }
-                lcd_status.set_bit_to(2, ly_coincidence);
-
-                lcd_status.set_bit_to(1, false);
-                lcd_status.set_bit_to(0, false);
-            }
-            break;
-        case VideoMode::HBLANK:
-            if (cycle_counter >= CLOCKS_PER_HBLANK) {
-
-                write_scanline(line.value());
-                line.increment();
-
-                cycle_counter = cycle_counter % CLOCKS_PER_HBLANK;
-
-                /* Line 145 (index 144) is the first line of VBLANK */
-                if (line == 144) {
-                    current_mode = VideoMode::VBLANK;
-                    lcd_status.set_bit_to(1, false);
-                    lcd_status.set_bit_to(0, true);
-                    gb.cpu.interrupt_flag.set_bit_to(0, true);
-                } else {
-                    lcd_status.set_bit_to(1, true);
-                    lcd_status.set_bit_to(0, false);
-                    current_mode = VideoMode::ACCESS_OAM;
-                }
-            }
-            break;
-        case VideoMode::VBLANK:
-            if (cycle_counter >= CLOCKS_PER_SCANLINE) {
-                line.increment();
+    buffer.copy_from(other.buffer);
+    frames_completed = other.frames_completed;
+    frames_drawn = other.frames_drawn;
+    draw_frame = other.draw_frame;
+}
 
-                cycle_counter = cycle_counter % CLOCKS_PER_SCANLINE;
+void Video::set_threaded(const bool threaded, const std::array<u32, 4>& dmg_palette) {
+    if (threaded == (render_thread != nullptr)) { return; }
 
-                /* Line 155 (index 154) is the last line */
-                if (line == 154) {
-                    write_sprites();
-                    draw();
-                    buffer.reset();
-                    line.reset();
-                    current_mode = VideoMode::ACCESS_OAM;
-                    lcd_status.set_bit_to(1, true);
-                    lcd_status.set_bit_to(0, false);
-                };
-            }
-            break;
+    if (threaded) {
+        render_thread = std::make_unique<RenderThread>(buffer, video_ram.data(), cgb, dmg_palette);
+        return;
     }
+
+    /* The inline renderer missed every write while the thread had them */
+    render_thread->finish();
+    render_thread.reset();
+    renderer.all_vram_written();
 }
 
-auto Video::display_enabled() const -> bool { return check_bit(control_byte, 7); }
-auto Video::window_tile_map() const -> bool { return check_bit(control_byte, 6); }
-auto Video::window_enabled() const -> bool { return check_bit(control_byte, 5); }
-auto Video::bg_window_tile_data() const -> bool { return check_bit(control_byte, 4); }
-auto Video::bg_tile_map_display() const -> bool { return check_bit(control_byte, 3); }
-auto Video::sprite_size() const -> bool { return check_bit(control_byte, 2); }
-auto Video::sprites_enabled() const -> bool { return check_bit(control_byte, 1); }
-auto Video::bg_enabled() const -> bool { return check_bit(control_byte, 0); }
+u8 Video::read(const Address& address) {
+    return video_ram.at(vram_bank * VIDEO_RAM_BANK_SIZE + address.value());
+}
 
-void Video::write_scanline(u8 current_line) {
-    if (!display_enabled()) { return; }
+void Video::write(const Address& address, u8 value) {
+    catch_up_memory();
 
-    if (bg_enabled() && !debug_disable_background) {
-        draw_bg_line(current_line);
-    }
+    uint offset = vram_bank * VIDEO_RAM_BANK_SIZE + address.value();
+    video_ram.at(offset) = value;
 
-    if (window_enabled() && !debug_disable_window) {
-        draw_window_line(current_line);
+    /* The render thread keeps its own copy, so it gets every write, even
+     * during frames which aren't drawn */
+    if (render_thread) {
+        render_thread->vram_written(static_cast<u16>(offset), value);
+    } else {
+        renderer.vram_written(static_cast<u16>(offset));
     }
 }
 
-void Video::write_sprites() {
-    if (!sprites_enabled() || debug_disable_sprites) { return; }
+void Video::write_block(const u16 offset, const u8* data, const uint size) {
+    catch_up_memory();
 
-    for (uint sprite_n = 0; sprite_n < 40; sprite_n++) {
-        draw_sprite(sprite_n);
-    }
-}
+    uint start = vram_bank * VIDEO_RAM_BANK_SIZE + offset;
+    std::copy_n(data, size, &video_ram.at(start));
 
-void Video::draw_bg_line(uint current_line) {
-    /* Note: tileset two uses signed numbering to share half the tiles with tileset 1 */
-    bool use_tile_set_zero = bg_window_tile_data();
-    bool use_tile_map_zero = !bg_tile_map_display();
-
-    Palette palette = load_palette(bg_palette);
-
-    Address tile_set_address = use_tile_set_zero
-        ? TILE_SET_ZERO_ADDRESS
-        : TILE_SET_ONE_ADDRESS;
-
-    Address tile_map_address = use_tile_map_zero
-        ? TILE_MAP_ZERO_ADDRESS
-        : TILE_MAP_ONE_ADDRESS;
-
-    /* The pixel row we're drawing on the screen is constant since we're only
-     * drawing a single line */
-    uint screen_y = current_line;
-
-    // Cache para armazenar os dados de linha de cada tile
-    struct TileLineData {
-        u8 pixels_1;
-        u8 pixels_2;
-    };
-    std::unordered_map<uint, TileLineData> tile_line_cache;
-
-    for (uint screen_x = 0; screen_x < GAMEBOY_WIDTH; screen_x++) {
-        /* Work out the position of the pixel in the framebuffer */
-        uint scrolled_x = screen_x + scroll_x.value();
-        uint scrolled_y = screen_y + scroll_y.value();
-
-        /* Work out the index of the pixel in the full background map */
-        uint bg_map_x = scrolled_x % BG_MAP_SIZE;
-        uint by_map_y = scrolled_y % BG_MAP_SIZE;
-
-        /* Work out which tile of the bg_map this pixel is in, and the index of that tile
-         * in the array of all tiles */
-        uint tile_x = bg_map_x / TILE_WIDTH_PX;
-        uint tile_y = by_map_y / TILE_HEIGHT_PX;
-
-        /* Work out which specific (x,y) inside that tile we're going to render */
-        uint tile_pixel_x = bg_map_x % TILE_WIDTH_PX;
-        uint tile_pixel_y = by_map_y % TILE_HEIGHT_PX;
-
-        /* Work out the address of the tile ID from the tile map */
-        uint tile_index = tile_y * TILES_PER_LINE + tile_x;
-        Address tile_id_address = tile_map_address + tile_index;
-
-        /* Grab the ID of the tile we'll get data from in the tile map */
-        u8 tile_id = gb.mmu.read(tile_id_address);
-
-        /* Calculate the offset from the start of the tile data memory where
-         * the data for our tile lives */
-        uint tile_data_mem_offset = use_tile_set_zero
-            ? tile_id * TILE_BYTES
-            : (static_cast<s8>(tile_id) + 128) * TILE_BYTES;
-
-        /* Calculate the extra offset to the data for the line of pixels we
-         * are rendering from.
-         * 2 (bytes per line of pixels) * y (lines) */
-        uint tile_data_line_offset = tile_pixel_y * 2;
-
-        Address tile_line_data_start_address = tile_set_address + tile_data_mem_offset + tile_data_line_offset;
-
-        // Criar uma chave única para o cache baseada no endereço da linha do tile
-        uint cache_key = tile_line_data_start_address.value();
-        
-        // Verificar se os dados da linha já estão no cache
-        TileLineData line_data;
-        if (tile_line_cache.find(cache_key) == tile_line_cache.end()) {
-            // Se não estiver no cache, buscar da memória e armazenar
-            line_data.pixels_1 = gb.mmu.read(tile_line_data_start_address);
-            line_data.pixels_2 = gb.mmu.read(tile_line_data_start_address + 1);
-            tile_line_cache[cache_key] = line_data;
-        } else {
-            // Se estiver no cache, usar os dados armazenados
-            line_data = tile_line_cache[cache_key];
+    for (uint i = 0; i < size; i++) {
+        if (render_thread) {
+            render_thread->vram_written(static_cast<u16>(start + i), data[i]);
+        } else if (i % TILE_BYTES == 0 || i == size - 1) {
+            /* The renderer only needs to hear of each tile once */
+            renderer.vram_written(static_cast<u16>(start + i));
         }
-
-        GBColor pixel_color = get_pixel_from_line(line_data.pixels_1, line_data.pixels_2, tile_pixel_x);
-        Color screen_color = get_color_from_palette(pixel_color, palette);
-
-        buffer.set_pixel(screen_x, screen_y, screen_color);
     }
 }
 
-void Video::draw_window_line(uint current_line) {
-    /* Note: tileset two uses signed numbering to share half the tiles with tileset 1 */
-    bool use_tile_set_zero = bg_window_tile_data();
-    bool use_tile_map_zero = !window_tile_map();
-
-    Palette palette = load_palette(bg_palette);
-
-    Address tile_set_address = use_tile_set_zero
-        ? TILE_SET_ZERO_ADDRESS
-        : TILE_SET_ONE_ADDRESS;
-
-    Address tile_map_address = use_tile_map_zero
-        ? TILE_MAP_ZERO_ADDRESS
-        : TILE_MAP_ONE_ADDRESS;
-
-    uint screen_y = current_line;
-    uint scrolled_y = screen_y - window_y.value();
-
-    if (scrolled_y >= GAMEBOY_HEIGHT) { return; }
-    // if (!is_on_screen_y(scrolled_y)) { return; }
-
-    // Cache para armazenar os dados de linha de cada tile
-    struct TileLineData {
-        u8 pixels_1;
-        u8 pixels_2;
-    };
-    std::unordered_map<uint, TileLineData> tile_line_cache;
-
-    for (uint screen_x = 0; screen_x < GAMEBOY_WIDTH; screen_x++) {
-        /* Work out the position of the pixel in the framebuffer */
-        uint scrolled_x = screen_x + window_x.value() - 7;
-
-        /* Work out which tile of the bg_map this pixel is in, and the index of that tile
-         * in the array of all tiles */
-        uint tile_x = scrolled_x / TILE_WIDTH_PX;
-        uint tile_y = scrolled_y / TILE_HEIGHT_PX;
-
-        /* Work out which specific (x,y) inside that tile we're going to render */
-        uint tile_pixel_x = scrolled_x % TILE_WIDTH_PX;
-        uint tile_pixel_y = scrolled_y % TILE_HEIGHT_PX;
-
-        /* Work out the address of the tile ID from the tile map */
-        uint tile_index = tile_y * TILES_PER_LINE + tile_x;
-        Address tile_id_address = tile_map_address + tile_index;
-
-        /* Grab the ID of the tile we'll get data from in the tile map */
-        u8 tile_id = gb.mmu.read(tile_id_address);
-
-        /* Calculate the offset from the start of the tile data memory where
-         * the data for our tile lives */
-        uint tile_data_mem_offset = use_tile_set_zero
-            ? tile_id * TILE_BYTES
-            : (static_cast<s8>(tile_id) + 128) * TILE_BYTES;
-
-        /* Calculate the extra offset to the data for the line of pixels we
-         * are rendering from.
-         * 2 (bytes per line of pixels) * y (lines) */
-        uint tile_data_line_offset = tile_pixel_y * 2;
-
-        Address tile_line_data_start_address = tile_set_address + tile_data_mem_offset + tile_data_line_offset;
-
-        // Criar uma chave única para o cache baseada no endereço da linha do tile
-        uint cache_key = tile_line_data_start_address.value();
-        
-        // Verificar se os dados da linha já estão no cache
-        TileLineData line_data;
-        if (tile_line_cache.find(cache_key) == tile_line_cache.end()) {
-            // Se não estiver no cache, buscar da memória e armazenar
-            line_data.pixels_1 = gb.mmu.read(tile_line_data_start_address);
-            line_data.pixels_2 = gb.mmu.read(tile_line_data_start_address + 1);
-            tile_line_cache[cache_key] = line_data;
+namespace {
+struct VideoState {
+    u32 cycle_counter;
+    u32 line_sprite_count;
+    std::array<u8, MAX_SPRITES_PER_LINE> line_sprites;
+    u8 current_mode;
+    u8 control_byte;
+    u8 lcd_control;
+    u8 lcd_status;
+    u8 scroll_y;
+    u8 scroll_x;
+    u8 line;
+    u8 ly_compare;
+    u8 window_y;
+    u8 window_x;
+    u8 bg_palette;
+    u8 sprite_palette_0;
+    u8 sprite_palette_1;
+    u8 dma_transfer;
+    u8 vram_bank;
+    u8 bg_palette_index;
+    u8 sprite_palette_index;
+    u8 object_priority;
+    /* Mode 3's clocks beyond the least, and the pixels of its line drawn */
+    u8 vram_extra_clocks;
+    u8 drawn_x;
+    u8 stat_line;
+    u8 unused;
+    std::array<u8, PALETTE_RAM_SIZE> bg_palette_ram;
+    std::array<u8, PALETTE_RAM_SIZE> sprite_palette_ram;
+};
+} // namespace
+
+void Video::save_state(StateWriter& writer) const {
+    VideoState state = {};
+    state.cycle_counter = cycle_counter;
+    state.line_sprite_count = line_sprite_count;
+    state.line_sprites = line_sprites;
+    state.current_mode = static_cast<u8>(current_mode);
+    state.control_byte = control_byte;
+    state.lcd_control = lcd_control.value();
+    state.lcd_status = lcd_status.value();
+    state.scroll_y = scroll_y.value();
+    state.scroll_x = scroll_x.value();
+    state.line = line.value();
+    state.ly_compare = ly_compare.value();
+    state.window_y = window_y.value();
+    state.window_x = window_x.value();
+    state.bg_palette = bg_palette.value();
+    state.sprite_palette_0 = sprite_palette_0.value();
+    state.sprite_palette_1 = sprite_palette_1.value();
+    state.dma_transfer = dma_transfer.value();
+    state.vram_bank = static_cast<u8>(vram_bank);
+    state.bg_palette_index = bg_palettes.index;
+    state.sprite_palette_index = sprite_palettes.index;
+    state.object_priority = object_priority;
+    state.vram_extra_clocks = static_cast<u8>(vram_clocks - CLOCKS_PER_SCANLINE_VRAM);
+    state.drawn_x = static_cast<u8>(drawn_x);
+    state.stat_line = stat_line ? 1 : 0;
+    state.bg_palette_ram = bg_palettes.bytes;
+    state.sprite_palette_ram = sprite_palettes.bytes;
+
+    writer.write(StateSection::Video, state);
+    writer.write_bytes(StateSection::VideoRam, video_ram.data(), static_cast<uint>(video_ram.size()));
+}
+
+void Video::load_state(StateReader& reader) {
+    VideoState state;
+    reader.read(StateSection::Video, state);
+
+    cycle_counter = state.cycle_counter;
+    line_sprite_count = state.line_sprite_count;
+    line_sprites = state.line_sprites;
+    current_mode = static_cast<VideoMode>(state.current_mode);
+    control_byte = state.control_byte;
+    lcd_control.set(state.lcd_control);
+    lcd_status.set(state.lcd_status);
+    scroll_y.set(state.scroll_y);
+    scroll_x.set(state.scroll_x);
+    line.set(state.line);
+    ly_compare.set(state.ly_compare);
+    window_y.set(state.window_y);
+    window_x.set(state.window_x);
+    bg_palette.set(state.bg_palette);
+    sprite_palette_0.set(state.sprite_palette_0);
+    sprite_palette_1.set(state.sprite_palette_1);
+    dma_transfer.set(state.dma_transfer);
+    vram_bank = state.vram_bank & 0x1;
+    bg_palettes.index = state.bg_palette_index;
+    sprite_palettes.index = state.sprite_palette_index;
+    object_priority = state.object_priority;
+    bg_palettes.bytes = state.bg_palette_ram;
+    sprite_palettes.bytes = state.sprite_palette_ram;
+    stat_line = state.stat_line != 0;
+
+    /* Where the stalls are isn't kept, only where the line has got to, so
+     * the line's sprites and the plan are redone from OAM and the
+     * registers as they are now. Its length is kept as it was, which the
+     * rest of the line's timing depends on */
+    if (current_mode == VideoMode::ACCESS_VRAM || current_mode == VideoMode::HBLANK) { scan_oam(line.value()); }
+    plan_vram_access();
+    vram_clocks = CLOCKS_PER_SCANLINE_VRAM + state.vram_extra_clocks;
+    drawn_x = std::min<uint>(state.drawn_x, GAMEBOY_WIDTH);
+
+    /* The MMU's state is loaded first, with the bank it mapped still the old one */
+    gb.mmu.map_video_ram_pages();
+
+    /* Taken over as if written, so only the tiles which differ are
+     * decoded again, which matters to run-ahead restoring every frame */
+    const u8* saved = reader.read_view(StateSection::VideoRam, static_cast<uint>(video_ram.size()));
+    for (uint offset = 0; offset < video_ram.size(); offset++) {
+        if (video_ram[offset] == saved[offset]) { continue; }
+
+        video_ram[offset] = saved[offset];
+        if (render_thread) {
+            render_thread->vram_written(static_cast<u16>(offset), saved[offset]);
         } else {
-            // Se estiver no cache, usar os dados armazenados
-            line_data = tile_line_cache[cache_key];
+            renderer.vram_written(static_cast<u16>(offset));
         }
+    }
+}
 
-        GBColor pixel_color = get_pixel_from_line(line_data.pixels_1, line_data.pixels_2, tile_pixel_x);
-        Color screen_color = get_color_from_palette(pixel_color, palette);
+void Video::tick(Cycles cycles) {
+    cycle_counter += cycles.cycles;
 
-        buffer.set_pixel(screen_x, screen_y, screen_color);
+    /* The scheduler may hand over enough cycles for several mode changes */
+    while (cycle_counter >= clocks_for_mode(current_mode)) {
+        cycle_counter -= clocks_for_mode(current_mode);
+        advance_mode();
     }
 }
 
-void Video::draw_sprite(const uint sprite_n) {
-    using bitwise::check_bit;
+auto Video::cycles_until_next_event() const -> uint {
+    return clocks_for_mode(current_mode) - cycle_counter;
+}
 
-    /* Each sprite is represented by 4 bytes, or 8 bytes in 8x16 mode */
-    Address offset_in_oam = sprite_n * SPRITE_BYTES;
+auto Video::clocks_for_mode(VideoMode mode) const -> uint {
+    switch (mode) {
+        case VideoMode::ACCESS_OAM: return CLOCKS_PER_SCANLINE_OAM;
+        case VideoMode::ACCESS_VRAM: return vram_clocks;
+        case VideoMode::HBLANK: return CLOCKS_PER_SCANLINE - CLOCKS_PER_SCANLINE_OAM - vram_clocks;
+        case VideoMode::VBLANK: return CLOCKS_PER_SCANLINE;
+    }
 
-    Address oam_start = 0xFE00 + offset_in_oam.value();
-    u8 sprite_y = gb.mmu.read(oam_start);
-    u8 sprite_x = gb.mmu.read(oam_start + 1);
+    fatal_error("Invalid video mode");
+}
 
-    /* If the sprite would be drawn offscreen, don't draw it */
-    if (sprite_y == 0 || sprite_y >= 160) { return; }
-    if (sprite_x == 0 || sprite_x >= 168) { return; }
+void Video::advance_mode() {
+    switch (current_mode) {
+        case VideoMode::ACCESS_OAM:
+            /* The sprites decide mode 3's length, so they are picked
+             * whether or not the frame is drawn */
+            scan_oam(line.value());
+            plan_vram_access();
+            set_mode(VideoMode::ACCESS_VRAM);
+
+            drawn_x = 0;
+            if (!draw_frame) {
+                drawn_x = GAMEBOY_WIDTH;
+            } else if (ppu_timing == PpuTiming::Fast) {
+                write_scanline(line.value(), 0, GAMEBOY_WIDTH);
+                drawn_x = GAMEBOY_WIDTH;
+            }
+            break;
+        case VideoMode::ACCESS_VRAM:
+            finish_line();
+            set_mode(VideoMode::HBLANK);
 
-    uint sprite_size_multiplier = sprite_size()
-        ? 2 : 1;
+            /* A transfer of HDMA's HBlank mode moves a block now */
+            gb.mmu.hblank_started();
+            break;
+        case VideoMode::HBLANK:
+            line.increment();
+            update_ly_coincidence();
+
+            /* Line 145 (index 144) is the first line of VBLANK */
+            if (line == 144) {
+                gb.cpu.interrupt_flag.set_bit_to(0, true);
+                set_mode(VideoMode::VBLANK);
+            } else {
+                set_mode(VideoMode::ACCESS_OAM);
+            }
+            break;
+        case VideoMode::VBLANK:
+            line.increment();
+
+            /* Line 155 (index 154) is the last line */
+            if (line == 154) {
+                frames_completed++;
+                if (draw_frame) {
+                    if (render_thread) { render_thread->finish(); }
+                    buffer.present();
+                    frames_drawn++;
+                    draw();
+                }
+                line.reset();
+                update_ly_coincidence();
+                set_mode(VideoMode::ACCESS_OAM);
+            } else {
+                update_ly_coincidence();
+                update_stat_line();
+            }
+            break;
+    }
+}
 
-    /* Sprites are always taken from the first tileset */
-    Address tile_set_location = TILE_SET_ZERO_ADDRESS;
+void Video::set_mode(VideoMode mode) {
+    current_mode = mode;
 
-    u8 pattern_n = gb.mmu.read(oam_start + 2);
-    u8 sprite_attrs = gb.mmu.read(oam_start + 3);
+    /* STAT bits 0-1: 0 in HBlank, 1 in VBlank, 2 in mode 2, 3 in mode 3 */
+    u8 number = 0;
+    switch (mode) {
+        case VideoMode::HBLANK: number = 0; break;
+        case VideoMode::VBLANK: number = 1; break;
+        case VideoMode::ACCESS_OAM: number = 2; break;
+        case VideoMode::ACCESS_VRAM: number = 3; break;
+    }
+    lcd_status.set(static_cast<u8>((lcd_status.value() & ~0x3) | number));
 
-    /* Bits 0-3 are used only for CGB */
-    bool use_palette_1 = check_bit(sprite_attrs, 4);
-    bool flip_x = check_bit(sprite_attrs, 5);
-    bool flip_y = check_bit(sprite_attrs, 6);
-    bool obj_behind_bg = check_bit(sprite_attrs, 7);
+    update_stat_line();
+}
 
-    Palette palette = use_palette_1
-        ? load_palette(sprite_palette_1)
-        : load_palette(sprite_palette_0);
+void Video::update_ly_coincidence() {
+    lcd_status.set_bit_to(2, ly_compare.value() == line.value());
+}
 
-    uint tile_offset = pattern_n * TILE_BYTES;
+void Video::update_stat_line() {
+    u8 status = lcd_status.value();
+    bool high = (check_bit(status, 3) && current_mode == VideoMode::HBLANK)
+             || (check_bit(status, 4) && current_mode == VideoMode::VBLANK)
+             || (check_bit(status, 5) && current_mode == VideoMode::ACCESS_OAM)
+             || (check_bit(status, 6) && check_bit(status, 2));
 
-    Address pattern_address = tile_set_location + tile_offset;
+    if (high && !stat_line) { gb.cpu.interrupt_flag.set_bit_to(1, true); }
+    stat_line = high;
+}
 
-    Tile tile(pattern_address, gb.mmu, sprite_size_multiplier);
-    int start_y = sprite_y - 16;
-    int start_x = sprite_x - 8;
+void Video::write_status(const u8 value) {
+    /* The mode and coincidence bits are read-only */
+    lcd_status.set(static_cast<u8>((value & 0x78) | (lcd_status.value() & 0x07)));
+    update_stat_line();
+}
 
-    for (uint y = 0; y < TILE_HEIGHT_PX * sprite_size_multiplier; y++) {
-        for (uint x = 0; x < TILE_WIDTH_PX; x++) {
-            uint maybe_flipped_y = !flip_y ? y : (TILE_HEIGHT_PX * sprite_size_multiplier) - y - 1;
-            uint maybe_flipped_x = !flip_x ? x : TILE_WIDTH_PX - x - 1;
+void Video::write_ly_compare(const u8 value) {
+    ly_compare.set(value);
+    update_ly_coincidence();
+    update_stat_line();
+}
 
-            GBColor gb_color = tile.get_pixel(maybe_flipped_x, maybe_flipped_y);
+/* Mode 3 takes CLOCKS_PER_SCANLINE_VRAM at the least: two tile fetches
+ * before the first pixel, then a pixel a clock. The pixels SCX scrolls
+ * off the first tile are fetched and thrown away, one a clock; starting
+ * the window restarts the fetcher; and each sprite stalls it while its
+ * tile is fetched, for longer if it's the first sprite over a background
+ * or window tile and lies near that tile's left edge, which the fetcher
+ * has to finish first (as described in Pan Docs' "Mode 3 length") */
+void Video::plan_vram_access() {
+    fine_scroll = scroll_x.value() & 0x7;
+    stall_count = 0;
+
+    uint current_line = line.value();
+    bool window = check_bit(control_byte, 5) && current_line >= window_y.value() && window_x.value() <= 166;
+    int window_start = window ? window_x.value() - 7 : static_cast<int>(GAMEBOY_WIDTH);
+    if (window) {
+        stalls[stall_count++] = {static_cast<u8>(std::max(window_start, 0)), CLOCKS_PER_WINDOW_START};
+    }
 
-            // Color 0 is transparent
-            if (gb_color == GBColor::Color0) { continue; }
+    if (check_bit(control_byte, 1)) {
+        const u8* oam = gb.mmu.oam_ram.data();
+        /* One bit per background and window tile a sprite has been
+         * fetched over */
+        u32 bg_tiles = 0;
+        u32 window_tiles = 0;
+
+        for (uint i = 0; i < line_sprite_count; i++) {
+            /* OAM holds X plus 8; the fetcher never reaches those past the
+             * right edge */
+            uint sprite_x = oam[line_sprites[i] * SPRITE_BYTES + 1];
+            if (sprite_x >= GAMEBOY_WIDTH + 8) { continue; }
+
+            int left = static_cast<int>(sprite_x) - 8;
+            bool over_window = window && left >= window_start;
+            /* Within the line as fetched, which starts a tile to the left
+             * of the screen for sprites partly off it */
+            uint fetched_x = over_window
+                ? static_cast<uint>(left - window_start)
+                : sprite_x + fine_scroll;
+
+            u32& tiles = over_window ? window_tiles : bg_tiles;
+            u32 tile = 1u << (fetched_x / TILE_WIDTH_PX);
+
+            uint clocks = CLOCKS_PER_SPRITE_FETCH;
+            if (!(tiles & tile)) {
+                clocks += static_cast<uint>(std::max(5 - static_cast<int>(fetched_x % TILE_WIDTH_PX), 0));
+                tiles |= tile;
+            }
 
-            int screen_x = start_x + x;
-            int screen_y = start_y + y;
+            stalls[stall_count++] = {static_cast<u8>(std::max(left, 0)), static_cast<u8>(clocks)};
+        }
+    }
 
-            if (!is_on_screen(screen_x, screen_y)) { continue; }
+    /* In order of X, the window first where both are at one spot, as it
+     * starts before the sprites there are fetched */
+    std::stable_sort(stalls.begin(), stalls.begin() + stall_count,
+                     [](const PixelStall& a, const PixelStall& b) { return a.x < b.x; });
 
-            // Armazenar a cor original do fundo antes de aplicar a paleta
-            GBColor bg_gb_color = get_original_color_at(screen_x, screen_y);
-            
-            // Se o objeto deve ficar atrás do fundo e o fundo não é transparente (Color0)
-            if (obj_behind_bg && bg_gb_color != GBColor::Color0) { continue; }
+    vram_clocks = CLOCKS_PER_SCANLINE_VRAM + fine_scroll;
+    for (uint i = 0; i < stall_count; i++) { vram_clocks += stalls[i].clocks; }
+}
 
-            Color screen_color = get_color_from_palette(gb_color, palette);
-            buffer.set_pixel(screen_x, screen_y, screen_color);
-        }
+/* The pixels of the line out after this many clocks of mode 3 */
+auto Video::pixels_out(const uint clocks) const -> uint {
+    uint before_first = CLOCKS_BEFORE_FIRST_PIXEL + fine_scroll;
+    if (clocks <= before_first) { return 0; }
+
+    uint left = clocks - before_first;
+    uint x = 0;
+    for (uint i = 0; i < stall_count; i++) {
+        uint run = stalls[i].x - x;
+        if (left <= run) { return x + left; }
+
+        x = stalls[i].x;
+        left -= run;
+        if (left <= stalls[i].clocks) { return x; }
+        left -= stalls[i].clocks;
     }
+
+    return std::min(x + left, GAMEBOY_WIDTH);
 }
 
-auto Video::get_pixel_from_line(u8 byte1, u8 byte2, u8 pixel_index) -> GBColor {
-    using bitwise::bit_value;
+void Video::catch_up_line() {
+    if (ppu_timing != PpuTiming::Accurate || current_mode != VideoMode::ACCESS_VRAM) { return; }
 
-    u8 color_u8 = static_cast<u8>((bit_value(byte2, 7-pixel_index) << 1) | bit_value(byte1, 7-pixel_index));
-    return get_color(color_u8);
-}
+    uint x = pixels_out(cycle_counter);
+    if (x <= drawn_x) { return; }
 
-auto Video::is_on_screen_x(u8 x) -> bool { return x < GAMEBOY_WIDTH; }
-
-auto Video::is_on_screen_y(u8 y) -> bool { return y < GAMEBOY_HEIGHT; }
-
-auto Video::is_on_screen(u8 x, u8 y) -> bool { return is_on_screen_x(x) && is_on_screen_y(y); }
-
-// Novo método para armazenar a cor original (antes da paleta) de cada pixel
-auto Video::get_original_color_at(u8 x, u8 y) -> GBColor {
-    // Implementação simplificada - em uma implementação completa, 
-    // seria necessário armazenar as cores originais em um buffer separado
-    // Esta é uma aproximação baseada na cor atual
-    Color current_color = buffer.get_pixel(x, y);
-    
-    if (current_color == Color::White) return GBColor::Color0;
-    if (current_color == Color::LightGray) return GBColor::Color1;
-    if (current_color == Color::DarkGray) return GBColor::Color2;
-    if (current_color == Color::Black) return GBColor::Color3;
-    
-    // Fallback
-    return GBColor::Color0;
+    write_scanline(line.value(), drawn_x, x);
+    drawn_x = x;
 }
 
-auto Video::load_palette(ByteRegister& palette_register) -> Palette {
-    using bitwise::compose_bits;
-    using bitwise::bit_value;
+void Video::catch_up_memory() {
+    if (ppu_timing != PpuTiming::Accurate || current_mode != VideoMode::ACCESS_VRAM || drawn_x >= GAMEBOY_WIDTH) {
+        return;
+    }
 
-    // Implementação mais eficiente usando bitmasking
-    u8 palette_value = palette_register.value();
-    u8 color0 = palette_value & 0x03;
-    u8 color1 = (palette_value >> 2) & 0x03;
-    u8 color2 = (palette_value >> 4) & 0x03;
-    u8 color3 = (palette_value >> 6) & 0x03;
+    /* Unlike the registers, VRAM and OAM are written without the PPU
+     * being brought up to now first */
+    gb.sync(EventType::Video);
+    catch_up_line();
+}
 
-    Color real_color_0 = get_real_color(color0);
-    Color real_color_1 = get_real_color(color1);
-    Color real_color_2 = get_real_color(color2);
-    Color real_color_3 = get_real_color(color3);
+void Video::finish_line() {
+    if (drawn_x >= GAMEBOY_WIDTH) { return; }
 
-    return { real_color_0, real_color_1, real_color_2, real_color_3 };
+    write_scanline(line.value(), drawn_x, GAMEBOY_WIDTH);
+    drawn_x = GAMEBOY_WIDTH;
 }
 
-auto Video::get_color_from_palette(GBColor color, const Palette& palette) -> Color {
-    switch (color) {
-        case GBColor::Color0: return palette.color0;
-        case GBColor::Color1: return palette.color1;
-        case GBColor::Color2: return palette.color2;
-        case GBColor::Color3: return palette.color3;
+auto Video::sprite_size() const -> bool { return check_bit(control_byte, 2); }
+
+void Video::write_scanline(u8 current_line, const uint first_x, const uint end_x) {
+    LineState state;
+    state.line = current_line;
+    state.first_x = static_cast<u8>(first_x);
+    state.end_x = static_cast<u8>(end_x);
+    state.lcd_control = control_byte;
+    state.scroll_y = scroll_y.value();
+    state.scroll_x = scroll_x.value();
+    state.window_y = window_y.value();
+    state.window_x = window_x.value();
+    state.bg_palette = bg_palette.value();
+    state.sprite_palette_0 = sprite_palette_0.value();
+    state.sprite_palette_1 = sprite_palette_1.value();
+
+    state.debug_flags = 0;
+    if (debug_disable_background) { state.debug_flags |= LineState::DEBUG_NO_BACKGROUND; }
+    if (debug_disable_window) { state.debug_flags |= LineState::DEBUG_NO_WINDOW; }
+    if (debug_disable_sprites) { state.debug_flags |= LineState::DEBUG_NO_SPRITES; }
+
+    /* OAM as it is now, since the line is drawn as if it were now */
+    const u8* oam = gb.mmu.oam_ram.data();
+    state.sprite_count = static_cast<u8>(line_sprite_count);
+    for (uint i = 0; i < state.sprite_count && i < MAX_SPRITES_PER_LINE; i++) {
+        std::copy_n(&oam[line_sprites[i] * SPRITE_BYTES], SPRITE_BYTES, state.sprites[i].begin());
+    }
+
+    if (cgb) {
+        state.bg_palette_ram = bg_palettes.bytes;
+        state.sprite_palette_ram = sprite_palettes.bytes;
+        state.object_priority = object_priority;
+    }
+
+    if (render_thread) {
+        render_thread->draw_line(state);
+    } else {
+        renderer.draw_line(state, buffer);
     }
 }
 
+void Video::scan_oam(uint current_line) {
+    const u8* oam = gb.mmu.oam_ram.data();
+    uint sprite_height = sprite_size() ? TILE_HEIGHT_PX * 2 : TILE_HEIGHT_PX;
+
+    /* OAM holds each sprite's Y position plus 16, so sprites can scroll in
+     * from above the top of the screen */
+    uint oam_line = current_line + 16;
+
+    line_sprite_count = 0;
+    for (uint sprite_n = 0; sprite_n < SPRITE_COUNT; sprite_n++) {
+        uint sprite_y = oam[sprite_n * SPRITE_BYTES];
+        if (oam_line < sprite_y || oam_line >= sprite_y + sprite_height) { continue; }
 
-auto Video::get_real_color(u8 pixel_value) -> Color {
-    switch (pixel_value) {
-        case 0: return Color::White;
-        case 1: return Color::LightGray;
-        case 2: return Color::DarkGray;
-        case 3: return Color::Black;
-        default:
-            fatal_error("Invalid color value");
+        line_sprites[line_sprite_count++] = static_cast<u8>(sprite_n);
+        if (line_sprite_count == MAX_SPRITES_PER_LINE) { break; }
     }
 }
 
@@ -441,5 +521,5 @@ void Video::register_vblank_callback(const vblank_callback_t& _vblank_callback)
 }
 
 void Video::draw() {
-    vblank_callback(buffer);
+    if (vblank_callback) { vblank_callback(buffer); }
 }
@@ -1,22 +1,63 @@
 #pragma once
 
 #include "framebuffer.h"
+#include "line_renderer.h"
 #include "tile.h"
 
+#include "../guest_memory.h"
 #include "../mmu.h"
 #include "../register.h"
 #include "../definitions.h"
 #include "../options.h"
 
+#include <array>
 #include <vector>
 #include <memory>
 #include <functional>
-#include <unordered_map>
 
 class Gameboy;
+class RenderThread;
+class StateWriter;
+class StateReader;
+
+/* Mode 3 takes at least CLOCKS_PER_SCANLINE_VRAM, and mode 0 the rest of
+ * the line (see Video::plan_vram_access) */
+const uint CLOCKS_PER_HBLANK = 204; /* Mode 0, at the most */
+const uint CLOCKS_PER_SCANLINE_OAM = 80; /* Mode 2 */
+const uint CLOCKS_PER_SCANLINE_VRAM = 172; /* Mode 3, at the least */
+const uint CLOCKS_PER_SCANLINE =
+    (CLOCKS_PER_SCANLINE_OAM + CLOCKS_PER_SCANLINE_VRAM + CLOCKS_PER_HBLANK);
+
+const uint CLOCKS_PER_VBLANK = 4560; /* Mode 1 */
+const uint SCANLINES_PER_FRAME = 144;
+const uint CLOCKS_PER_FRAME = (CLOCKS_PER_SCANLINE * SCANLINES_PER_FRAME) + CLOCKS_PER_VBLANK;
+
+/* Mode 3 before the first pixel comes out, two tile fetches */
+const uint CLOCKS_BEFORE_FIRST_PIXEL = 12;
+/* Added to mode 3 by the window starting, and by each sprite fetched at
+ * the least */
+const uint CLOCKS_PER_WINDOW_START = 6;
+const uint CLOCKS_PER_SPRITE_FETCH = 6;
 
 using vblank_callback_t = std::function<void(const FrameBuffer&)>;
 
+/* BCPS/BCPD and OCPS/OCPD: palette memory reached through an index, which
+ * can step forward on every data write */
+struct ColorPaletteRam {
+    std::array<u8, PALETTE_RAM_SIZE> bytes = {};
+    u8 index = 0;
+
+    auto read_index() const -> u8 { return index | 0x40; }
+    void write_index(u8 value) { index = value & 0xBF; }
+
+    auto read_data() const -> u8 { return bytes[index & 0x3F]; }
+    void write_data(u8 value) {
+        bytes[index & 0x3F] = value;
+        /* Bit 7: auto-increment, wrapping within the palette memory */
+        if (index & 0x80) { index = static_cast<u8>(0x80 | ((index + 1) & 0x3F)); }
+    }
+};
+
 enum class VideoMode {
     ACCESS_OAM,
     ACCESS_VRAM,
@@ -24,21 +65,70 @@ enum class VideoMode {
     VBLANK,
 };
 
-struct TileInfo {
-    u8 line;
-    std::vector<u8> pixels;
-};
-
 class Video {
 public:
     Video(Gameboy& inGb, Options& inOptions);
+    ~Video();
 
     void tick(Cycles cycles);
+    auto cycles_until_next_event() const -> uint;
     void register_vblank_callback(const vblank_callback_t& _vblank_callback);
 
+    /* Frames completed since power-on (not part of save states) */
+    auto frame_count() const -> u64 { return frames_completed; }
+
+    /* LCDC bit 7 */
+    auto lcd_enabled() const -> bool { return (control_byte & 0x80) != 0; }
+
+    /* Whether the frame now starting gets drawn. A skipped frame keeps its
+     * exact timing, STAT changes and interrupts, but none of its lines are
+     * drawn and it is neither presented nor passed to the vblank callback */
+    void set_frame_drawn(bool drawn) { draw_frame = drawn; }
+
+    auto frame_drawn() const -> bool { return draw_frame; }
+
+    /* Puts the count back after frames run ahead (see Options::run_ahead_frames) */
+    void set_frame_count(u64 count) { frames_completed = count; }
+
+    /* Of the frames completed, those which were drawn */
+    auto drawn_frame_count() const -> u64 { return frames_drawn; }
+
+    auto frame_buffer() const -> const FrameBuffer& { return buffer; }
+
+    /* For Gameboy::fork: the frame counts and the frame buffer, lines
+     * drawn so far included, so the frame being drawn comes out whole */
+    void copy_frames(Video& other);
+
+    /* Moves drawing onto a render thread or back (see
+     * Options::threaded_video). Only between frames */
+    void set_threaded(bool threaded, const std::array<u32, 4>& dmg_palette);
+
+    /* See Options::ppu_timing. Takes effect from the next line */
+    void set_timing(PpuTiming timing) { ppu_timing = timing; }
+
+    /* With PpuTiming::Accurate, draws the pixels of the current line which
+     * are already out, before a register they depend on is written */
+    void catch_up_line();
+
+    /* The same before VRAM or OAM is written */
+    void catch_up_memory();
+
+    /* STAT and LYC, which can raise the STAT interrupt as they change */
+    void write_status(u8 value);
+    void write_ly_compare(u8 value);
+
+    /* Through the VRAM bank selected by VBK */
     u8 read(const Address& address);
     void write(const Address& address, u8 byte);
 
+    /* A run of bytes into the current bank, for HDMA */
+    void write_block(u16 offset, const u8* data, uint size);
+
+    /* Registers, VRAM and the position within the frame. The frame buffer
+     * isn't saved: it is redrawn from the next line on */
+    void save_state(StateWriter& writer) const;
+    void load_state(StateReader& reader);
+
     u8 control_byte;
 
     ByteRegister lcd_control;
@@ -58,8 +148,11 @@ public:
     ByteRegister sprite_palette_0; /* OBP0 */
     ByteRegister sprite_palette_1; /* OBP1 */
 
-    /* TODO: LCD Color Palettes (CGB) */
-    /* TODO: LCD VRAM Bank (CGB) */
+    /* CGB only. VBK, the palettes and OPRI */
+    uint vram_bank = 0;
+    ColorPaletteRam bg_palettes;
+    ColorPaletteRam sprite_palettes;
+    u8 object_priority = 0;
 
     ByteRegister dma_transfer; /* DMA */
 
@@ -68,58 +161,68 @@ public:
     bool debug_disable_window = false;
 
 private:
-    void write_scanline(u8 current_line);
-    void write_sprites();
+    /* Where the pixel fetcher stops to fetch a sprite or start the window
+     * during mode 3, and for how many clocks */
+    struct PixelStall {
+        u8 x;
+        u8 clocks;
+    };
+
+    auto clocks_for_mode(VideoMode mode) const -> uint;
+    void advance_mode();
+    void set_mode(VideoMode mode);
+    void update_ly_coincidence();
+    void update_stat_line();
+
+    void plan_vram_access();
+    auto pixels_out(uint clocks) const -> uint;
+
+    void write_scanline(u8 current_line, uint first_x, uint end_x);
+    void finish_line();
+    void scan_oam(uint current_line);
     void draw();
-    void draw_bg_line(uint current_line);
-    void draw_window_line(uint current_line);
-    void draw_sprite(uint sprite_n);
-    static auto get_pixel_from_line(u8 byte1, u8 byte2, u8 pixel_index) -> GBColor;
-
-    static auto is_on_screen(u8 x, u8 y) -> bool;
-    static auto is_on_screen_x(u8 x) -> bool;
-    static auto is_on_screen_y(u8 y) -> bool;
-
-    auto display_enabled() const -> bool;
-    auto window_tile_map() const -> bool;
-    auto window_enabled() const -> bool;
-    auto bg_window_tile_data() const -> bool;
-    auto bg_tile_map_display() const -> bool;
-    auto sprite_size() const -> bool;
-    auto sprites_enabled() const -> bool;
-    auto bg_enabled() const -> bool;
-
-    auto get_tile_info(Address tile_set_location, u8 tile_id, u8 tile_line) const -> TileInfo;
-    
-    // Novo método para obter a cor original (antes da paleta) de um pixel
-    auto get_original_color_at(u8 x, u8 y) -> GBColor;
 
-    static auto get_real_color(u8 pixel_value) -> Color;
-    static auto load_palette(ByteRegister& palette_register) -> Palette;
-    static auto get_color_from_palette(GBColor color, const Palette& palette) -> Color;
+    auto sprite_size() const -> bool;
 
     Gameboy& gb;
+    bool cgb;
 
     FrameBuffer buffer;
-    FrameBuffer background_map;
 
-    std::vector<u8> video_ram;
+    /* In the instance's GuestMemory */
+    std::array<u8, VIDEO_RAM_SIZE>& video_ram;
+    /* Mapped directly into the MMU's page table for reads */
+    friend class MMU;
+
+    /* Draws each line on this thread, or with Options::threaded_video
+     * hands it over to render_thread, which has a renderer of its own */
+    LineRenderer renderer;
+    std::unique_ptr<RenderThread> render_thread;
 
     VideoMode current_mode = VideoMode::ACCESS_OAM;
     uint cycle_counter = 0;
+    PpuTiming ppu_timing;
+
+    /* Mode 3's length on the current line, the stalls making it longer
+     * than the least it can be, in order of X, and the pixels of the line
+     * drawn so far */
+    uint vram_clocks = CLOCKS_PER_SCANLINE_VRAM;
+    uint fine_scroll = 0;
+    std::array<PixelStall, MAX_SPRITES_PER_LINE + 1> stalls = {};
+    uint stall_count = 0;
+    uint drawn_x = 0;
+
+    /* The STAT interrupt is raised as any of its enabled sources going
+     * high takes this from low to high, so one never follows another
+     * without a gap */
+    bool stat_line = false;
 
     vblank_callback_t vblank_callback;
+    u64 frames_completed = 0;
+    u64 frames_drawn = 0;
+    bool draw_frame = true;
     
-    // Buffer para armazenar as cores originais dos pixels
-    std::vector<GBColor> original_colors;
+    /* Sprites on the current line, in OAM order, picked during mode 2 */
+    std::array<u8, MAX_SPRITES_PER_LINE> line_sprites = {};
+    uint line_sprite_count = 0;
 };
-
-const uint CLOCKS_PER_HBLANK = 204; /* Mode 0 */
-const uint CLOCKS_PER_SCANLINE_OAM = 80; /* Mode 2 */
-const uint CLOCKS_PER_SCANLINE_VRAM = 172; /* Mode 3 */
-const uint CLOCKS_PER_SCANLINE =
-    (CLOCKS_PER_SCANLINE_OAM + CLOCKS_PER_SCANLINE_VRAM + CLOCKS_PER_HBLANK);
-
-const uint CLOCKS_PER_VBLANK = 4560; /* Mode 1 */
-const uint SCANLINES_PER_FRAME = 144;
-const uint CLOCKS_PER_FRAME = (CLOCKS_PER_SCANLINE * SCANLINES_PER_FRAME) + CLOCKS_PER_VBLANK;
@@ -0,0 +1,115 @@
+#include "watchdog.h"
+
+#include "scheduler.h"
+
+#include <algorithm>
+
+auto stall_reason_name(const StallReason reason) -> const char* {
+    switch (reason) {
+        case StallReason::None: return "none";
+        case StallReason::LcdOff: return "no VBlank with the LCD on";
+        case StallReason::Locked: return "CPU locked up";
+    }
+    return "unknown";
+}
+
+Watchdog::Watchdog(const Options& inOptions) : options(inOptions) {}
+
+auto Watchdog::cycles_until_next_event() const -> uint {
+    return options.watchdog_seconds > 0 ? PC_SAMPLE_INTERVAL : NO_EVENT;
+}
+
+auto Watchdog::sample(const u64 now, const u16 pc, const bool cpu_locked) -> StallReason {
+    std::lock_guard<std::mutex> lock(mutex);
+    restart_if_rewound(now);
+
+    pc_histogram[pc]++;
+    health.pc_samples++;
+    health.cycles = now;
+
+    if (!cpu_locked) {
+        locked_since = NEVER;
+    } else if (locked_since == NEVER) {
+        locked_since = now;
+    }
+
+    return update_stall(now);
+}
+
+auto Watchdog::frame_started(const u64 now, const u64 frames, const u64 frames_drawn, const bool lcd_enabled)
+    -> StallReason {
+    std::lock_guard<std::mutex> lock(mutex);
+    restart_if_rewound(now);
+
+    health.cycles = now;
+    health.frames = frames;
+    health.frames_drawn = frames_drawn;
+    health.lcd_enabled = lcd_enabled;
+    if (lcd_enabled) { last_vblank_at = now; }
+
+    /* Measured over host time, so it only needs a clock read per frame */
+    auto host_now = std::chrono::steady_clock::now();
+    if (!window_started) {
+        window_start = host_now;
+        window_cycles = now;
+        window_started = true;
+    } else {
+        double seconds = std::chrono::duration<double>(host_now - window_start).count();
+        if (seconds >= 1.0) {
+            health.cycles_per_second = static_cast<double>(now - window_cycles) / seconds;
+            window_start = host_now;
+            window_cycles = now;
+        }
+    }
+
+    return update_stall(now);
+}
+
+void Watchdog::set_throttled(const bool throttled) {
+    std::lock_guard<std::mutex> lock(mutex);
+    health.throttled = throttled;
+}
+
+auto Watchdog::report() const -> HealthReport {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    HealthReport report = health;
+    report.seconds_since_vblank = static_cast<double>(last_seen - last_vblank_at) / CLOCK_RATE;
+
+    report.hotspots.reserve(pc_histogram.size());
+    for (const auto& entry : pc_histogram) { report.hotspots.push_back({ entry.first, entry.second }); }
+
+    auto top = report.hotspots.begin() + std::min<size_t>(report.hotspots.size(), HEALTH_HOTSPOTS);
+    std::partial_sort(report.hotspots.begin(), top, report.hotspots.end(),
+                      [](const PcHotspot& a, const PcHotspot& b) {
+                          return a.samples != b.samples ? a.samples > b.samples : a.pc < b.pc;
+                      });
+    report.hotspots.erase(top, report.hotspots.end());
+
+    return report;
+}
+
+void Watchdog::restart_if_rewound(const u64 now) {
+    if (now < last_seen) {
+        last_vblank_at = now;
+        locked_since = NEVER;
+        window_started = false;
+    }
+    last_seen = now;
+}
+
+auto Watchdog::update_stall(const u64 now) -> StallReason {
+    StallReason stall = StallReason::None;
+
+    if (options.watchdog_seconds > 0) {
+        u64 window = static_cast<u64>(options.watchdog_seconds) * CLOCK_RATE;
+        if (locked_since != NEVER && now - locked_since >= window) {
+            stall = StallReason::Locked;
+        } else if (now - last_vblank_at >= window) {
+            stall = StallReason::LcdOff;
+        }
+    }
+
+    health.stall = stall;
+    return stall;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "definitions.h"
+#include "options.h"
+
+#include <chrono>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/* Why an instance looks stuck */
+enum class StallReason {
+    None,
+    /* No VBlank with the LCD on for the whole watchdog window */
+    LcdOff,
+    /* The CPU has been in a HALT or a jump to itself, with no interrupt
+     * enabled which could get it out, for the whole window */
+    Locked,
+};
+
+auto stall_reason_name(StallReason reason) -> const char*;
+
+/* Clocks between the PC samples the hotspots and lock-ups are found from */
+const uint PC_SAMPLE_INTERVAL = 4096;
+
+/* Most-sampled program counters given in a health report */
+const uint HEALTH_HOTSPOTS = 16;
+
+struct PcHotspot {
+    u16 pc;
+    u64 samples;
+};
+
+/* What a host's monitoring pulls out of an instance (see Gameboy::health) */
+struct HealthReport {
+    /* Emulated clocks (CLOCK_RATE a second) as of the last frame or sample */
+    u64 cycles = 0;
+    /* Frames completed, drawn or skipped, and those drawn */
+    u64 frames = 0;
+    u64 frames_drawn = 0;
+
+    /* Emulated clocks per second of host time while the instance was
+     * being stepped, over about the last second; CLOCK_RATE is real time */
+    double cycles_per_second = 0.0;
+
+    /* Emulated seconds since the last frame with the LCD on */
+    double seconds_since_vblank = 0.0;
+    bool lcd_enabled = false;
+
+    /* Set once a stall has lasted Options::watchdog_seconds */
+    StallReason stall = StallReason::None;
+    /* The stall is being dealt with by WatchdogAction::Throttle */
+    bool throttled = false;
+
+    /* Only sampled while the watchdog is on, every PC_SAMPLE_INTERVAL
+     * clocks. The most frequent come first */
+    u64 pc_samples = 0;
+    std::vector<PcHotspot> hotspots;
+};
+
+/*
+ * Keeps an instance's health metrics and decides whether it is stuck. The
+ * emulation thread feeds it as each frame starts and at every PC sample
+ * (a scheduler event of its own); report() can be called from any thread.
+ *
+ * The emulated clock going backwards, from loading a state or rewinding,
+ * restarts the watchdog window rather than counting as a stall.
+ */
+class Watchdog {
+public:
+    explicit Watchdog(const Options& inOptions);
+
+    /* Until the next PC sample, or NO_EVENT with the watchdog off */
+    auto cycles_until_next_event() const -> uint;
+
+    /* Each of these returns the stall found, if any, once it has lasted
+     * the watchdog window */
+    auto sample(u64 now, u16 pc, bool cpu_locked) -> StallReason;
+    auto frame_started(u64 now, u64 frames, u64 frames_drawn, bool lcd_enabled) -> StallReason;
+
+    void set_throttled(bool throttled);
+
+    auto report() const -> HealthReport;
+
+private:
+    static constexpr u64 NEVER = ~0ull;
+
+    void restart_if_rewound(u64 now);
+    auto update_stall(u64 now) -> StallReason;
+
+    const Options& options;
+
+    mutable std::mutex mutex;
+    HealthReport health;
+
+    u64 last_seen = 0;
+    u64 last_vblank_at = 0;
+    u64 locked_since = NEVER;
+
+    /* Where the current cycles_per_second measurement started */
+    std::chrono::steady_clock::time_point window_start;
+    u64 window_cycles = 0;
+    bool window_started = false;
+
+    std::unordered_map<u16, u64> pc_histogram;
+};